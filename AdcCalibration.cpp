@@ -0,0 +1,229 @@
+// AdcCalibration.cpp
+#include "AdcCalibration.h"
+#include "AppConfig.h"
+#include "Epoch.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr int kCodes = 65536;
+
+double interpolate(const float *t, double code)
+{
+    const double c = std::clamp(code, 0.0, static_cast<double>(kCodes - 1));
+    const int i = std::min(static_cast<int>(c), kCodes - 2);
+    return t[i] + (c - i) * (t[i + 1] - t[i]);
+}
+
+uint64_t sum_codes(const uint16_t *data, int n)
+{
+    uint64_t sum = 0;
+    int i = 0;
+#ifdef __SSE2__
+    // Bias to signed so madd can pair-sum, flush the 32-bit lanes before they could overflow
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i ones = _mm_set1_epi16(1);
+    while (i + 8 <= n) {
+        __m128i acc = _mm_setzero_si128();
+        const int end = std::min(n - 7, i + 8 * 4096);
+        for (; i < end; i += 8) {
+            const __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), bias);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(v, ones));
+        }
+        alignas(16) int32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        sum += static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+    sum += static_cast<uint64_t>(i) * 0x8000;  // undo the bias
+#endif
+    for (; i < n; ++i)
+        sum += data[i];
+    return sum;
+}
+}
+
+AdcCalibration::AdcCalibration()
+    : zeroCode(AppConfig::adcOffset), nominal(AppConfig::adcToMicroWatts)
+{
+    // The nominal linear scale until a measured table is loaded
+    float *linear = new float[kCodes];
+    for (int c = 0; c < kCodes; ++c)
+        linear[c] = static_cast<float>(c * nominal);
+    table.store(linear, std::memory_order_release);
+}
+
+AdcCalibration::~AdcCalibration()
+{
+    // Owner outlives every reader; tables replaced earlier are already with Epoch
+    delete[] table.load(std::memory_order_acquire);
+}
+
+void AdcCalibration::track(const uint16_t *data, int n)
+{
+    if (n <= 0)
+        return;
+
+    const double blockMean = static_cast<double>(sum_codes(data, n)) / n;
+    if (!primed.load(std::memory_order_relaxed)) {
+        mean.store(blockMean, std::memory_order_relaxed);
+        primed.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    // Weight by block length so the time constant doesn't depend on the USB block size
+    const double alpha = 1.0 - std::exp(-n / (AppConfig::dcTrackSeconds * AppConfig::adcSampleRate));
+    const double m = mean.load(std::memory_order_relaxed);
+    mean.store(m + alpha * (blockMean - m), std::memory_order_relaxed);
+}
+
+double AdcCalibration::meanCode() const
+{
+    return primed.load(std::memory_order_relaxed) ? mean.load(std::memory_order_relaxed)
+                                                  : zeroCode.load(std::memory_order_relaxed);
+}
+
+double AdcCalibration::offsetCode() const
+{
+    if (AppConfig::trackAdcOffset && primed.load(std::memory_order_relaxed))
+        return mean.load(std::memory_order_relaxed);
+    return zeroCode.load(std::memory_order_relaxed);
+}
+
+void AdcCalibration::zero()
+{
+    setOffset(meanCode());
+}
+
+void AdcCalibration::setOffset(double code)
+{
+    zeroCode.store(code, std::memory_order_relaxed);
+    qDebug() << "[AdcCalibration] Zero point" << code << "codes";
+}
+
+void AdcCalibration::toMicroWatts(const uint16_t *codes, int n, float *out) const
+{
+    Epoch::Guard guard;
+    const float *t = table.load(std::memory_order_acquire);
+    const float zero = static_cast<float>(interpolate(t, offsetCode()));
+
+    int i = 0;
+#ifdef __AVX2__
+    const __m256 z = _mm256_set1_ps(zero);
+    for (; i + 8 <= n; i += 8) {
+        const __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)));
+        _mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_i32gather_ps(t, index, 4), z));
+    }
+#endif
+    // No gather before AVX2: four independent lookups per step keep the loads overlapped
+    for (; i + 4 <= n; i += 4) {
+        const float a = t[codes[i]], b = t[codes[i + 1]], c = t[codes[i + 2]], d = t[codes[i + 3]];
+        out[i] = a - zero;
+        out[i + 1] = b - zero;
+        out[i + 2] = c - zero;
+        out[i + 3] = d - zero;
+    }
+    for (; i < n; ++i)
+        out[i] = t[codes[i]] - zero;
+}
+
+double AdcCalibration::toMicroWatts(double code) const
+{
+    Epoch::Guard guard;
+    const float *t = table.load(std::memory_order_acquire);
+    return interpolate(t, code) - interpolate(t, offsetCode());
+}
+
+uint16_t AdcCalibration::toCode(double microWatts) const
+{
+    Epoch::Guard guard;
+    const float *t = table.load(std::memory_order_acquire);
+    const double target = microWatts + interpolate(t, offsetCode());
+
+    // Tables are monotonic rising; first code at or above the target
+    const float *hit = std::lower_bound(t, t + kCodes, static_cast<float>(target));
+    return static_cast<uint16_t>(std::min<ptrdiff_t>(hit - t, kCodes - 1));
+}
+
+double AdcCalibration::slope(double code) const
+{
+    // The float table would round a linear scale off by a few 1e-3, keep that one exact
+    if (!measured.load(std::memory_order_acquire))
+        return nominal;
+
+    Epoch::Guard guard;
+    const float *t = table.load(std::memory_order_acquire);
+    const double c = std::clamp(code, 1.0, kCodes - 2.0);
+    return (interpolate(t, c + 1.0) - interpolate(t, c - 1.0)) / 2.0;
+}
+
+QString AdcCalibration::tableFile() const
+{
+    pthread_mutex_lock(&pathMutex);
+    const QString name = tablePath;
+    pthread_mutex_unlock(&pathMutex);
+    return name;
+}
+
+bool AdcCalibration::loadTable(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "[AdcCalibration] Cannot open" << fileName;
+        return false;
+    }
+
+    std::map<double, double> points;  // code -> µW, sorted
+    while (!file.atEnd()) {
+        const QStringList fields = QString::fromUtf8(file.readLine()).trimmed().split(',');
+        bool okCode = false, okPower = false;
+        if (fields.size() < 2)
+            continue;
+        const double code = fields[0].toDouble(&okCode);
+        const double power = fields[1].toDouble(&okPower);
+        if (okCode && okPower)  // header and comment lines fall through here
+            points[code] = power;
+    }
+    if (points.size() < 2) {
+        qWarning() << "[AdcCalibration]" << fileName << "needs at least two code,uW rows";
+        return false;
+    }
+
+    // Linear between points, the end segments extended
+    float *next = new float[kCodes];
+    auto hi = std::next(points.begin());
+    for (int c = 0; c < kCodes; ++c) {
+        while (std::next(hi) != points.end() && hi->first < c)
+            ++hi;
+        const auto lo = std::prev(hi);
+        const double f = (c - lo->first) / (hi->first - lo->first);
+        next[c] = static_cast<float>(lo->second + f * (hi->second - lo->second));
+    }
+    for (int c = 1; c < kCodes; ++c) {
+        if (next[c] < next[c - 1]) {
+            qWarning() << "[AdcCalibration]" << fileName << "is not monotonic around code" << c;
+            delete[] next;
+            return false;
+        }
+    }
+
+    const float *previous = table.exchange(next, std::memory_order_acq_rel);
+    Epoch::retire([previous]() { delete[] previous; });
+    measured.store(true, std::memory_order_release);
+    pthread_mutex_lock(&pathMutex);
+    tablePath = fileName;
+    pthread_mutex_unlock(&pathMutex);
+    qDebug() << "[AdcCalibration] Loaded" << points.size() << "calibration points from" << fileName;
+    return true;
+}
@@ -0,0 +1,64 @@
+// AdcCalibration.h
+#ifndef ADCCALIBRATION_H
+#define ADCCALIBRATION_H
+
+#include <QString>
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+
+/*!
+ * ADC code <-> µW conversion and DC tracking of one device, shared by every
+ * consumer of its raw stream (time plot, exports, trigger levels, FFT
+ * chains). Each FFTProcess owns one, so detectors are zeroed separately.
+ *
+ * The callback folds each block into a running mean of the raw codes
+ * (time constant AppConfig::dcTrackSeconds); the chains subtract it before
+ * the FFT so the DC component stays out of the spectrum. Power is read
+ * from a 65536-entry table, µW = table[code] - table(zero point), linear
+ * (AppConfig::adcToMicroWatts) unless a measured calibration is loaded.
+ * The zero point starts at AppConfig::adcOffset; zero() adopts the running
+ * mean (detector dark), AppConfig::trackAdcOffset follows it continuously.
+ */
+class AdcCalibration
+{
+public:
+    AdcCalibration();
+    ~AdcCalibration();
+    AdcCalibration(const AdcCalibration &) = delete;
+    AdcCalibration &operator=(const AdcCalibration &) = delete;
+
+    // Callback side, a few hundred ns per block
+    void track(const uint16_t *data, int n);
+
+    double meanCode() const;    // running mean of the raw stream, ADC codes
+    double offsetCode() const;  // zero point of the µW scale
+    void zero();                // the running mean becomes the zero point
+    void setOffset(double code);
+
+    void toMicroWatts(const uint16_t *codes, int n, float *out) const;  // table lookups, block at a time
+    double toMicroWatts(double code) const;                             // interpolated
+    uint16_t toCode(double microWatts) const;                           // inverse, for trigger levels
+    double slope(double code) const;    // µW per code around `code`, exactly AppConfig::adcToMicroWatts while linear
+
+    // Measured table in use, empty while on the nominal linear scale
+    QString tableFile() const;
+
+    // "code,uW" rows, at least two, linear between them; false leaves the current table in place
+    bool loadTable(const QString &fileName);
+
+private:
+    std::atomic<double> mean{0.0};
+    std::atomic<bool> primed{false};
+    std::atomic<double> zeroCode;
+
+    // µW of each code before the zero point is taken off; replaced whole, never edited
+    std::atomic<const float*> table{nullptr};
+    std::atomic<bool> measured{false};
+    double nominal;  // linear scale the table started with
+
+    mutable pthread_mutex_t pathMutex = PTHREAD_MUTEX_INITIALIZER;
+    QString tablePath;
+};
+
+#endif // ADCCALIBRATION_H
@@ -3,10 +3,54 @@
 #define APPCONFIG_H
 
 #include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// What transfer_callback does when the FFT workers fall behind
+enum class BackpressurePolicy {
+    DropNewest = 0,     // discard the frame just filled, keep the queue
+    DropOldest = 1,     // evict the oldest queued frame, always show the freshest spectrum
+    DecimateFrames = 2, // while lagging, only queue every k-th hop
+    AdaptiveHop = 3     // widen the hop while lagging, narrow it back when caught up
+};
+
+// Analysis window applied to every FFT frame, normalised to the same coherent gain
+enum class FFTWindow {
+    Rectangular = 0,
+    Hann = 1,
+    BlackmanHarris = 2,
+    FlatTop = 3
+};
+
+// One analysis chain fanned out from the ADC stream: decimated to sampleRate, own FFT
+struct AnalysisChainConfig {
+    const char *name;
+    double sampleRate;  // rounded to adcSampleRate / integer
+    int fftSize;
+};
+
+// One DPD80 streamed by its own FFTProcess/TimeDProcess pair; -1 / 0 leaves the choice to the scheduler
+struct DeviceConfig {
+    int acquisitionCore = -1;  // pin the libri callback thread (ideally an isolated core)
+    int dspFirstCore = -1;     // DSP worker i is pinned to dspFirstCore + i
+    int dspThreads = 0;        // worker pool size, 0 = an equal share of the cores left by the acquisition threads
+    int numaNode = -1;         // keep all threads (and so, by first touch, all buffers) on this node's cores
+    std::string calibrationFile = "";  // empty = adcCalibrationFile
+};
 
 struct AppConfig {
-    static inline double sampleRate   = 80e6;
+    static constexpr double adcSampleRate = 80e6;  // DPD80 stream rate, the time buffer always runs at this
+    static inline double sampleRate   = 80e6;  // rate of the chain being viewed, GUI side only
     static inline double timeWindowSeconds  = 100e-6;
+    static constexpr double maxTimeWindowSeconds = 10.0;
+
+    // trigger, depth follows the time window up to the preallocated capture size
+    static inline int maxTriggerDepthSamples = 1 << 20;    // ~13 ms at 80 MS/s
+    static inline double triggerPreFraction = 0.2;         // share of the capture before the trigger
+    static inline double triggerHoldoffSeconds = 0.0;
+    static inline double triggerMinPulseSeconds = 0.0;     // PulseWidth acceptance band
+    static inline double triggerMaxPulseSeconds = 1e-3;
     static inline int maxPointsToPlot  = 10000;
     static inline int plotRefreshRateMs  = 5; // lower the better tbh, but theres better ways to improve responsiveness
 
@@ -16,14 +60,100 @@ struct AppConfig {
 
     static inline int fftBins = fftSize / 2 + 1;
 
-    static inline constexpr double fftOverlapFraction = 0.5;
+    static inline double fftOverlapFraction = 0.5;
+    static inline FFTWindow fftWindow = FFTWindow::Rectangular;
     static inline int fftHopSize = static_cast<int>(fftSize * (1.0 - fftOverlapFraction));
 
+    // every chain runs all the time, the mode combo only picks which spectrum is shown
+    static inline std::vector<AnalysisChainConfig> analysisChains = {
+        { "0-40MHz",  80e6,  19683 },
+        { "0-100kHz", 200e3, 19683 },
+        { "0-1MHz",   2e6,   19683 },  // custom rate
+    };
+
+    // DDC zoom FFT on the raw ADC stream, re-targeted to the visible FFT span
+    static inline int zoomFftSize = 4096;  // power of two
+    static inline size_t zoomMaxCaptureSamples = size_t(1) << 26;  // longest record per zoom refresh (~0.84 s), sets the narrowest span
+
+    // max/min-hold and averaged traces, fed by every FFT frame of every chain
+    static inline double spectrumAverageAlpha = 0.05;  // exponential average weight of the newest frame
+    static inline int welchFrames = 32;                // frames per Welch block (segments overlap by fftOverlapFraction)
+
+    // per-chain ring of every spectrum as int16 dB, scrubbed while paused
+    static inline double spectrumHistorySeconds = 1.0;
+    static inline int spectrumHistoryMaxMB = 512;  // per chain; caps the 80 MS/s chain below the requested seconds
+
+    // Goertzel tone tracker on the raw stream, empty = off
+    static inline std::vector<double> trackedTonesHz = {};
+    static inline double toneTrackerRateHz = 10e3;  // amplitude/phase points per second per tone
+    static inline int toneTrackerRingSamples = 1 << 23;   // staging copy the tracker catches up from, ~0.1 s at 80 MS/s
+
+    // digital-phosphor time view: every triggered capture (trigger off: every time window) binned into an image
+    static inline int persistenceColumns = 1024;
+    static inline int persistenceRows = 256;
+    static inline double persistenceDecaySeconds = 0.5;   // stream time for a hit to fade to 1/e, 0 = never fades
+    static inline int persistenceRingSamples = 1 << 24;   // staging copy the workers draw from, ~0.2 s at 80 MS/s
+    static inline int persistenceRefreshMs = 40;          // image redraws, the accumulation itself never waits on them
+
+    // TCP stream of spectra, peaks and the time envelope (Backend_Base_Funcs/Stream_LoopbackClient.c)
+    static inline int streamPort = 5555;  // 0 = off
+    static inline std::string streamBindAddress = "127.0.0.1";  // "0.0.0.0" to serve the LAN
+    static inline double streamRateHz = 20.0;
+    static inline int streamPeaks = 8;        // strongest local maxima per chain and frame
+    static inline int streamTimeBins = 4096;  // min/max pairs covering the samples since the last frame
+
+    // shared-memory segment for sibling processes (Backend_Base_Funcs/SharedStream_Reader.h), empty name = off
+    static inline std::string sharedMemoryName = "ultracoustics";
+    static inline int sharedRingSamples = 1 << 25;       // 64 MB, ~0.4 s at 80 MS/s
+    static inline double sharedSpectrumRateHz = 1000.0;  // per chain, 0 = every frame
+
+    // Extra analyses beside the chains, one StageGraph branch per line, e.g.
+    //   "lf = raw | decimate(40) | dc | frame(8192, 0.5) | window(hann) | fft", "lfmax = lf | maxhold"
+    static inline std::vector<std::string> stageGraph = {};
+    static inline std::string stageGraphPlot = "";  // branch drawn over the FFT plot, must end in a linear spectrum
+
+    static inline int deviceRetryMs = 500;  // how often a missing or lost device is looked for
+
+    // entry n gets the n-th unit libri enumerates (opened in index order, whichever is ready first);
+    // entry 0 is the one the GUI shows, the others stream headless
+    // (shared memory and event log names get a "-N" suffix). libri can't tell units apart, so with
+    // several devices a lost one is not reopened (hot-plug reconnect is single-device only)
+    static inline std::vector<DeviceConfig> devices = { DeviceConfig() };
+
+    // thread placement shared by every device, -1 / 0 leaves the choice to the scheduler
+    static inline int acquisitionRtPriority = 0;   // SCHED_FIFO priority for the callback threads
+    static inline int dspNice = 0;
+    static inline bool lockSampleBuffers = false;  // mlockall so sample buffers never page out
+    static inline bool arenaHugePages = true;      // back the pipeline arena with huge pages when available
+
+    // overload handling between acquisition and the FFT workers
+    static inline BackpressurePolicy backpressurePolicy = BackpressurePolicy::DropNewest;
+    static inline int decimateFrameStride = 4;  // DecimateFrames: keep 1 of every k hops while lagging
+
+    // autocorrelation period estimate of the viewed chain, one extra inverse FFT per frame
+    static inline bool correlationEnabled = true;
+    static inline double correlationMinConfidence = 0.2;  // weaker repeats don't count as a period
+
     static constexpr double epsilon = 1e-12;
 
+    // spectral events on every frame of every chain, logged lock-free and spilled to a .uce file
+    // (Backend_Base_Funcs/EventLog_Dump.c); levels are dB of |X|
+    static inline bool eventDetection = true;
+    static inline double eventOnDb = 20.0;             // a bin this far above the floor opens an event
+    static inline double eventOffDb = 14.0;            // bins above this keep it open (hysteresis)
+    static inline bool eventRelativeToFloor = true;    // above the frame's median bin; false = absolute 20 log10 |X|
+    static inline int eventHoldFrames = 1;             // frames below the off level before an event ends
+    static inline int eventMinFrames = 1;              // shorter events aren't logged
+    static inline std::vector<std::pair<double, double>> eventMasksHz = {};  // bands never reported, {lowHz, highHz}
+    static inline std::string eventLogFile = "";       // empty = in memory only
+
     // signal val to uW conversion
     static inline double adcOffset = 49555.0;
     static inline double adcToMicroWatts   = 0.0147;
+    static inline std::string adcCalibrationFile = "";  // "code,uW" rows replacing the linear scale
+    static inline double dcTrackSeconds = 0.1;          // time constant of the running DC estimate
+    static inline bool removeDc = true;                 // subtract the running DC before every FFT
+    static inline bool trackAdcOffset = false;          // µW zero follows the running DC instead of adcOffset
 };
 
 #endif // APPCONFIG_H
@@ -0,0 +1,53 @@
+// Arena.cpp
+#include "Arena.h"
+#include "HugePages.h"
+#include "AppConfig.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+Arena::~Arena()
+{
+    for (const Mapping &m : mappings)
+        HugePages::release(m.base, m.bytes);
+}
+
+void *Arena::map(size_t bytes)
+{
+    bool huge = false;
+    void *p = HugePages::allocate(bytes, &huge, AppConfig::arenaHugePages);
+    if (!p) {
+        failed = true;  // a pipeline without its buffers can't run; build_pipeline checks ok() and gives it up
+        return nullptr;
+    }
+    mappings.push_back({ p, bytes });
+    mapped += bytes;
+    if (huge)
+        hugeMapped += bytes;
+    return p;
+}
+
+void *Arena::allocate(size_t bytes, ArenaUse use)
+{
+    bytes = (std::max<size_t>(bytes, 1) + kAlignment - 1) & ~(kAlignment - 1);
+    if (sealed && !warned) {
+        warned = true;
+        qWarning() << "[Arena]" << bytes << "bytes requested after the pipeline was built";
+    }
+    used[static_cast<int>(use)] += bytes;
+
+    if (bytes > kChunkBytes / 2)
+        return map(bytes);  // history rings and other big blocks: no chunk tail wasted
+
+    if (!cursor || static_cast<size_t>(limit - cursor) < bytes) {
+        char *chunk = static_cast<char *>(map(kChunkBytes));
+        if (!chunk)
+            return nullptr;
+        cursor = chunk;
+        limit = cursor + kChunkBytes;
+    }
+    void *p = cursor;
+    cursor += bytes;
+    return p;
+}
@@ -0,0 +1,69 @@
+// Arena.h
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+enum class ArenaUse {
+    Frames,   // frame buffers and decimator output
+    Spectra,  // FFT outputs, magnitudes, traces
+    History,  // spectrum history rings
+    Scratch,  // per-worker windowed copies, correlator and detector work space
+    Count
+};
+
+/*!
+ * Bump allocator owning every buffer of one pipeline. Blocks are 64-byte
+ * aligned and zeroed, carved from 4 MB chunks mapped through HugePages
+ * (huge pages when AppConfig::arenaHugePages and the system allows);
+ * blocks over half a chunk get a mapping of their own. Nothing is freed
+ * individually: the arena is released with its pipeline.
+ *
+ * Build time only, one thread. seal() marks the end of the build, so a
+ * stray allocation on the streaming path shows up in the log. A mapping
+ * that fails returns nullptr and clears ok() for good: whoever builds from
+ * the arena checks it before using what it got.
+ */
+class Arena
+{
+public:
+    static constexpr size_t kAlignment = 64;       // cache line, enough for any SIMD load
+    static constexpr size_t kChunkBytes = 4u << 20;
+
+    Arena() = default;
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t bytes, ArenaUse use);
+    template <typename T>
+    T *allocate(size_t count, ArenaUse use) { return static_cast<T *>(allocate(count * sizeof(T), use)); }
+
+    void seal() { sealed = true; }
+    bool ok() const { return !failed; }
+
+    size_t bytes(ArenaUse use) const { return used[static_cast<int>(use)]; }
+    size_t mappedBytes() const { return mapped; }       // chunk tails included
+    size_t hugeBytes() const { return hugeMapped; }
+
+private:
+    struct Mapping {
+        void *base;
+        size_t bytes;
+    };
+
+    void *map(size_t bytes);
+
+    std::vector<Mapping> mappings;
+    char *cursor = nullptr;
+    char *limit = nullptr;
+    size_t used[static_cast<int>(ArenaUse::Count)] = {};
+    size_t mapped = 0;
+    size_t hugeMapped = 0;
+    bool sealed = false;
+    bool warned = false;
+    bool failed = false;
+};
+
+#endif // ARENA_H
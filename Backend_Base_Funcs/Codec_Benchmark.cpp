@@ -0,0 +1,155 @@
+// Throughput / ratio benchmark for SampleCodec, no device needed
+// Synthetic run: DPD80-like signal (codes around adcOffset: a tone plus noise), encoded and
+// decoded in 1M-sample chunks on 1..N threads, every chunk verified bit-exact.
+// With a .ucr file argument: decodes a recording made with the Record button, checks every
+// chunk and reports its ratio, decode speed and any sample gaps.
+
+// g++ -O2 -std=c++17 -I.. Codec_Benchmark.cpp ../SampleCodec.cpp -o codec_bench -lpthread
+// ./codec_bench [capture.ucr]
+
+#include "SampleCodec.h"
+#include "SampleRecorder.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define CHUNK_SAMPLES (1 << 20)
+#define NUM_CHUNKS    64          // 67M samples, ~0.84 s of signal at 80 MS/s
+#define ADC_OFFSET    49555.0
+#define SAMPLE_RATE   80e6
+
+static double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static int run_synthetic(void)
+{
+    std::vector<uint16_t> signal(static_cast<size_t>(CHUNK_SAMPLES) * NUM_CHUNKS);
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0.0, 6.0);
+    for (size_t i = 0; i < signal.size(); ++i)
+        signal[i] = static_cast<uint16_t>(std::lround(ADC_OFFSET + 300.0 * std::sin(2.0 * M_PI * 1.234e6 * i / SAMPLE_RATE) + noise(rng)));
+
+    const size_t maxBytes = SampleCodec::maxEncodedBytes(CHUNK_SAMPLES);
+    std::vector<std::vector<uint8_t>> encoded(NUM_CHUNKS, std::vector<uint8_t>(maxBytes));
+    std::vector<size_t> sizes(NUM_CHUNKS);
+    std::vector<std::vector<uint16_t>> decoded(NUM_CHUNKS, std::vector<uint16_t>(CHUNK_SAMPLES));
+
+    const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    printf("%u threads max, %d chunks of %d samples\n\n", maxThreads, NUM_CHUNKS, CHUNK_SAMPLES);
+    printf("threads   encode MS/s   decode MS/s   ratio\n");
+
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        auto work = [&](bool encode) {
+            std::vector<std::thread> pool;
+            for (unsigned t = 0; t < threads; ++t) {
+                pool.emplace_back([&, t]() {
+                    for (int c = t; c < NUM_CHUNKS; c += threads) {
+                        const uint16_t *in = signal.data() + static_cast<size_t>(c) * CHUNK_SAMPLES;
+                        if (encode)
+                            sizes[c] = SampleCodec::encode(in, CHUNK_SAMPLES, encoded[c].data());
+                        else if (!SampleCodec::decode(encoded[c].data(), sizes[c], decoded[c].data(), CHUNK_SAMPLES))
+                            sizes[c] = 0;
+                    }
+                });
+            }
+            for (auto &th : pool)
+                th.join();
+        };
+
+        auto t0 = std::chrono::steady_clock::now();
+        work(true);
+        const double encodeSeconds = seconds_since(t0);
+        t0 = std::chrono::steady_clock::now();
+        work(false);
+        const double decodeSeconds = seconds_since(t0);
+
+        size_t total = 0;
+        for (int c = 0; c < NUM_CHUNKS; ++c) {
+            const uint16_t *in = signal.data() + static_cast<size_t>(c) * CHUNK_SAMPLES;
+            if (sizes[c] == 0 || memcmp(in, decoded[c].data(), CHUNK_SAMPLES * sizeof(uint16_t)) != 0) {
+                printf("chunk %d did not round-trip\n", c);
+                return 1;
+            }
+            total += sizes[c];
+        }
+
+        const double samples = static_cast<double>(signal.size());
+        printf("%7u   %11.1f   %11.1f   %5.2fx\n", threads, samples / encodeSeconds / 1e6,
+               samples / decodeSeconds / 1e6, samples * 2.0 / total);
+    }
+    printf("\nNeeded for real time: 80 MS/s encode across the DSP workers\n");
+    return 0;
+}
+
+static int run_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+
+    RecordFileHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "UCRAW01", 8) != 0) {
+        printf("%s is not a .ucr capture\n", path);
+        fclose(f);
+        return 1;
+    }
+    fseek(f, header.headerBytes, SEEK_SET);
+    printf("%s: %.0f Hz, offset %.1f, %u samples per chunk\n", path, header.sampleRate, header.adcOffset, header.chunkSamples);
+
+    std::vector<uint8_t> payload;
+    std::vector<uint16_t> samples;
+    uint64_t chunks = 0, total = 0, bytes = sizeof(header), gaps = 0, gapSamples = 0, expected = 0;
+    double decodeSeconds = 0.0;
+    RecordChunkHeader chunk;
+
+    while (fread(&chunk, sizeof(chunk), 1, f) == 1) {
+        if (chunk.magic != SampleRecorder::kChunkMagic) {
+            printf("bad chunk magic after %llu chunks\n", (unsigned long long)chunks);
+            break;
+        }
+        payload.resize(chunk.payloadBytes);
+        samples.resize(chunk.sampleCount);
+        if (fread(payload.data(), 1, chunk.payloadBytes, f) != chunk.payloadBytes) {
+            printf("truncated chunk %llu\n", (unsigned long long)chunks);
+            break;
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        const bool ok = SampleCodec::decode(payload.data(), payload.size(), samples.data(), chunk.sampleCount);
+        decodeSeconds += seconds_since(t0);
+        if (!ok) {
+            printf("chunk %llu failed to decode\n", (unsigned long long)chunks);
+            break;
+        }
+
+        if (chunks > 0 && chunk.firstSample != expected) {
+            ++gaps;
+            gapSamples += chunk.firstSample - expected;
+        }
+        expected = chunk.firstSample + chunk.sampleCount;
+        ++chunks;
+        total += chunk.sampleCount;
+        bytes += sizeof(chunk) + chunk.payloadBytes;
+    }
+    fclose(f);
+
+    printf("%llu chunks, %llu samples (%.3f s), ratio %.2fx, decode %.1f MS/s single thread\n",
+           (unsigned long long)chunks, (unsigned long long)total, total / header.sampleRate,
+           total * 2.0 / bytes, decodeSeconds > 0 ? total / decodeSeconds / 1e6 : 0.0);
+    printf("%llu gaps, %llu samples dropped during capture\n", (unsigned long long)gaps, (unsigned long long)gapSamples);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    return argc > 1 ? run_file(argv[1]) : run_synthetic();
+}
@@ -0,0 +1,91 @@
+
+// Dumps a .uce spectral event file (EventLog spill, AppConfig::eventLogFile) as CSV
+// One row per event in the order they ended, then a summary on stderr: events per
+// chain, flagged ones, and the strongest event.
+// Keep the structs below in sync with EventLog.h.
+
+// gcc -O2 EventLog_Dump.c -o event_dump
+// ./event_dump events.uce [chain]    (chain filters, default all)
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include <stdint.h>
+
+#define EVENT_TRUNCATED  1
+#define EVENT_AFTER_DROP 2
+#define MAX_CHAINS       256
+
+typedef struct {
+    char magic[8];          // "UCEVT01"
+    uint32_t headerBytes;
+    uint32_t recordBytes;
+    double adcSampleRate;
+} EventFileHeader;
+
+typedef struct {
+    uint64_t start;         // ADC sample index
+    uint64_t duration;      // ADC samples
+    double frequencyHz;
+    float peakDb;
+    uint16_t widthBins;
+    uint8_t chain;
+    uint8_t flags;
+} EventRecord;
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s events.uce [chain]\n", argv[0]);
+        return 1;
+    }
+    const int onlyChain = argc > 2 ? atoi(argv[2]) : -1;
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    EventFileHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "UCEVT01", 8) != 0
+        || header.recordBytes != sizeof(EventRecord) || header.adcSampleRate <= 0.0) {
+        fprintf(stderr, "%s: not a version 1 event file\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+    fseek(f, (long)header.headerBytes, SEEK_SET);
+
+    unsigned long long perChain[MAX_CHAINS] = { 0 };
+    unsigned long long total = 0, truncated = 0, afterDrop = 0;
+    EventRecord strongest = { 0 };
+    strongest.peakDb = -1e30f;
+
+    printf("start_s,duration_us,frequency_hz,peak_db,width_bins,chain,truncated,after_drop\n");
+    EventRecord e;
+    while (fread(&e, sizeof(e), 1, f) == 1) {
+        if (onlyChain >= 0 && e.chain != onlyChain)
+            continue;
+        printf("%.9f,%.3f,%.1f,%.2f,%u,%u,%d,%d\n",
+               e.start / header.adcSampleRate, e.duration / header.adcSampleRate * 1e6,
+               e.frequencyHz, e.peakDb, e.widthBins, e.chain,
+               (e.flags & EVENT_TRUNCATED) != 0, (e.flags & EVENT_AFTER_DROP) != 0);
+
+        ++total;
+        ++perChain[e.chain];
+        truncated += (e.flags & EVENT_TRUNCATED) != 0;
+        afterDrop += (e.flags & EVENT_AFTER_DROP) != 0;
+        if (e.peakDb > strongest.peakDb)
+            strongest = e;
+    }
+    fclose(f);
+
+    fprintf(stderr, "%llu events, %llu truncated by a gap, %llu with dropped frames\n", total, truncated, afterDrop);
+    for (int c = 0; c < MAX_CHAINS; ++c)
+        if (perChain[c])
+            fprintf(stderr, "  chain %d: %llu\n", c, perChain[c]);
+    if (total)
+        fprintf(stderr, "strongest: %.2f dB at %.1f Hz, t = %.9f s\n",
+                strongest.peakDb, strongest.frequencyHz, strongest.start / header.adcSampleRate);
+    return 0;
+}
@@ -0,0 +1,141 @@
+
+// Jitter benchmark for thread placement, no device needed
+// A "callback" thread wakes every PERIOD_US (roughly the libri block cadence) while
+// NUM_LOAD_THREADS busy threads compete for the cores, like the FFT workers + GUI do.
+// Run 1: scheduler decides. Run 2: callback pinned to PINNED_CORE with SCHED_FIFO,
+// load threads kept off that core. Prints wake-up latency stats for both.
+
+// Linux: gcc -O2 Placement_JitterTest.c -o jitter -lpthread
+// SCHED_FIFO needs root or CAP_SYS_NICE, otherwise run 2 is pinning only
+// Best results with the core isolated (isolcpus=3 on the kernel command line)
+
+#define _GNU_SOURCE
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PERIOD_US        100     // ~ one 8k-sample USB block at 80 MS/s
+#define NUM_WAKEUPS      50000   // 5 s per run
+#define NUM_LOAD_THREADS 4
+#define PINNED_CORE      3
+
+static atomic_int stop_load = 0;
+static long long latencies_ns[NUM_WAKEUPS];
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *load_thread(void *arg)
+{
+    int avoid_core = *(int *)arg;
+    if (avoid_core >= 0) // keep the FFT-like load off the acquisition core
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int c = 0; c < cores; c++)
+            if (c != avoid_core)
+                CPU_SET(c, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    volatile double x = 1.0;
+    while (!atomic_load(&stop_load))
+        x = x * 1.0000001 + 1e-9; // burn cycles
+    return NULL;
+}
+
+static void *callback_thread(void *arg)
+{
+    int pinned = *(int *)arg;
+    if (pinned)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(PINNED_CORE, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+        struct sched_param param = {.sched_priority = 80};
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+            printf("  (SCHED_FIFO denied, pinning only)\n");
+    }
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (int i = 0; i < NUM_WAKEUPS; i++)
+    {
+        next.tv_nsec += PERIOD_US * 1000;
+        if (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        long long target = (long long)next.tv_sec * 1000000000LL + next.tv_nsec;
+        latencies_ns[i] = now_ns() - target;
+    }
+    return NULL;
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char *name, int pinned)
+{
+    pthread_t load[NUM_LOAD_THREADS], cb;
+    int avoid_core = pinned ? PINNED_CORE : -1;
+
+    atomic_store(&stop_load, 0);
+    for (int i = 0; i < NUM_LOAD_THREADS; i++)
+        pthread_create(&load[i], NULL, load_thread, &avoid_core);
+
+    pthread_create(&cb, NULL, callback_thread, &pinned);
+    pthread_join(cb, NULL);
+
+    atomic_store(&stop_load, 1);
+    for (int i = 0; i < NUM_LOAD_THREADS; i++)
+        pthread_join(load[i], NULL);
+
+    qsort(latencies_ns, NUM_WAKEUPS, sizeof(long long), cmp_ll);
+    long long sum = 0;
+    int late = 0;
+    for (int i = 0; i < NUM_WAKEUPS; i++)
+    {
+        sum += latencies_ns[i];
+        if (latencies_ns[i] > PERIOD_US * 1000LL) // missed a whole block period
+            late++;
+    }
+
+    printf("%-10s avg %7.1f us  p50 %7.1f us  p99 %7.1f us  p99.9 %7.1f us  max %8.1f us  late %d\n",
+           name,
+           sum / (double)NUM_WAKEUPS / 1000.0,
+           latencies_ns[NUM_WAKEUPS / 2] / 1000.0,
+           latencies_ns[NUM_WAKEUPS * 99 / 100] / 1000.0,
+           latencies_ns[NUM_WAKEUPS * 999 / 1000] / 1000.0,
+           latencies_ns[NUM_WAKEUPS - 1] / 1000.0,
+           late);
+}
+
+int main(void)
+{
+    printf("period %d us, %d wakeups, %d load threads, %ld cores\n",
+           PERIOD_US, NUM_WAKEUPS, NUM_LOAD_THREADS, sysconf(_SC_NPROCESSORS_ONLN));
+
+    run("unpinned", 0);
+    run("pinned", 1);
+    return 0;
+}
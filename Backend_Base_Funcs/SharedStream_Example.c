@@ -0,0 +1,96 @@
+
+// Follows the app's shared-memory stream at full rate, no device access needed
+// Attaches to the segment published while FFT_Qwt_Plotter runs, consumes every raw sample
+// in place (zero copy) for RUN_SECONDS and prints the rate it kept up with, samples lost
+// to overruns, the mean signal in uW and the strongest bin of each chain's latest spectrum.
+
+// Linux:   gcc -O2 -I.. SharedStream_Example.c SharedStream_Reader.c -o shm_example
+// Windows: gcc -O2 -I.. SharedStream_Example.c SharedStream_Reader.c -o shm_example
+// ./shm_example [segment name]
+
+#include "SharedStream_Reader.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include <time.h>
+
+#define RUN_SECONDS  5
+#define MAX_PER_READ (1 << 20)
+
+static double now_s(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    ucshm_reader r;
+    const int err = ucshm_open(&r, argc > 1 ? argv[1] : NULL);
+    if (err != 0) {
+        printf("no shared stream (%d), is the app running with AppConfig::sharedMemoryName set?\n", err);
+        return 1;
+    }
+    const UcShmHeader *h = r.header;
+    printf("attached: %.0f Hz, ring %llu samples (%.2f s), publisher pid %u\n", h->sampleRate,
+           (unsigned long long)h->ringCapacity, h->ringCapacity / h->sampleRate, h->publisherPid);
+
+    uint64_t next = ucshm_cursor(&r);  // start at live data
+    uint64_t consumed = 0, lost = 0, sum = 0;
+    const double t0 = now_s();
+
+    while (now_s() - t0 < RUN_SECONDS) {
+        const uint16_t *span[2];
+        uint64_t len[2];
+        const uint64_t n = ucshm_view(&r, next, MAX_PER_READ, span, len);
+        if (n == 0) {
+            const uint64_t oldest = ucshm_oldest(&r);
+            if (next < oldest) {  // fell a whole ring behind
+                lost += oldest - next;
+                next = oldest;
+            } else if (!ucshm_alive(&r, 1000000)) {
+                printf("publisher stopped\n");
+                break;
+            }
+            continue;
+        }
+
+        uint64_t blockSum = 0;
+        for (int s = 0; s < 2; ++s)
+            for (uint64_t i = 0; i < len[s]; ++i)
+                blockSum += span[s][i];
+
+        if (ucshm_still_valid(&r, next)) {
+            sum += blockSum;
+            consumed += n;
+        } else {
+            lost += n;  // lapped while reading, those samples were torn
+        }
+        next += n;
+    }
+
+    const double elapsed = now_s() - t0;
+    printf("\n%.1f s: %.1f MS/s consumed, %llu samples lost to overruns\n", elapsed,
+           consumed / elapsed / 1e6, (unsigned long long)lost);
+    if (consumed)
+        printf("mean signal %.3f uW%s\n", (sum / (double)consumed - h->adcOffset) * h->adcToMicroWatts,
+               (h->adcFlags & UCSHM_ADC_MEASURED) ? " (linearized around the zero point of a measured table)" : "");
+
+    float *mags = (float *)malloc(UCSHM_MAX_BINS * sizeof(float));
+    for (uint32_t c = 0; c < h->chainCount; ++c) {
+        UcShmChain info;
+        const int bins = ucshm_read_spectrum(&r, (int)c, mags, UCSHM_MAX_BINS, &info);
+        if (bins < 2)
+            continue;
+        int best = 1;
+        for (int i = 1; i < bins; ++i)
+            if (mags[i] > mags[best])
+                best = i;
+        printf("chain %u (%s): %d bins, %llu spectra, strongest %.4f MHz\n", c, info.name, bins,
+               (unsigned long long)(info.seq / 2), best * info.sampleRate / info.fftSize / 1e6);
+    }
+
+    free(mags);
+    ucshm_close(&r);
+    return 0;
+}
@@ -0,0 +1,190 @@
+
+// Reader side of the app's shared-memory stream, see SharedStream_Reader.h
+
+#include "SharedStream_Reader.h"
+#include "stdio.h"
+#include "string.h"
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SPECTRUM_RETRIES 64
+
+static uint64_t load_acquire(const uint64_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static uint64_t load_relaxed(const uint64_t *p) { return __atomic_load_n(p, __ATOMIC_RELAXED); }
+
+int ucshm_open(ucshm_reader *r, const char *name)
+{
+    char path[128];
+    void *base = NULL;
+    size_t size = 0;
+
+    memset(r, 0, sizeof(*r));
+    if (!name)
+        name = UCSHM_DEFAULT_NAME;
+
+#ifdef _WIN32
+    snprintf(path, sizeof(path), "Local\\%s", name);
+    HANDLE h = OpenFileMappingA(FILE_MAP_READ, FALSE, path);
+    if (!h)
+        return -1;
+    base = MapViewOfFile(h, FILE_MAP_READ, 0, 0, 0);
+    if (!base) {
+        CloseHandle(h);
+        return -1;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(base, &info, sizeof(info));
+    size = info.RegionSize;
+    r->handle = h;
+#else
+    struct stat st;
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(UcShmHeader)) {
+        close(fd);
+        return -1;
+    }
+    size = (size_t)st.st_size;
+    base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+#endif
+
+    const UcShmHeader *h0 = (const UcShmHeader *)base;
+    char magic[8];
+    memcpy(magic, h0->magic, sizeof(magic));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (memcmp(magic, UCSHM_MAGIC, sizeof(magic)) != 0 || h0->version != UCSHM_VERSION
+        || h0->headerBytes != sizeof(UcShmHeader) || h0->totalBytes > size) {
+        r->header = h0;
+        r->bytes = size;
+        ucshm_close(r);
+        return -2;  // not ready yet, closed, or another layout version
+    }
+
+    r->header = h0;
+    r->ring = (const uint16_t *)((const char *)base + h0->ringOffset);
+    r->mask = h0->ringCapacity - 1;
+    r->bytes = size;
+    return 0;
+}
+
+void ucshm_close(ucshm_reader *r)
+{
+    if (!r->header)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile((void *)r->header);
+    CloseHandle((HANDLE)r->handle);
+#else
+    munmap((void *)r->header, r->bytes);
+#endif
+    memset(r, 0, sizeof(*r));
+}
+
+int ucshm_alive(const ucshm_reader *r, uint64_t max_age_us)
+{
+    if (memcmp((const char *)r->header->magic, UCSHM_MAGIC, 8) != 0)
+        return 0;
+
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    const uint64_t now = (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+    const uint64_t beat = load_relaxed(&r->header->heartbeatUs);
+    return now < beat || now - beat <= max_age_us;
+}
+
+uint64_t ucshm_cursor(const ucshm_reader *r)
+{
+    return load_acquire(&r->header->writeCursor);
+}
+
+uint64_t ucshm_oldest(const ucshm_reader *r)
+{
+    const uint64_t head = load_relaxed(&r->header->writeHead);
+    return head > r->mask + 1 ? head - (r->mask + 1) : 0;
+}
+
+uint64_t ucshm_view(const ucshm_reader *r, uint64_t first, uint64_t count,
+                    const uint16_t *span[2], uint64_t span_len[2])
+{
+    const uint64_t end = ucshm_cursor(r);
+    span[0] = span[1] = NULL;
+    span_len[0] = span_len[1] = 0;
+
+    if (first >= end || first < ucshm_oldest(r))
+        return 0;
+    if (count > end - first)
+        count = end - first;
+
+    const uint64_t pos = first & r->mask;
+    const uint64_t a = count < r->mask + 1 - pos ? count : r->mask + 1 - pos;
+    span[0] = r->ring + pos;
+    span_len[0] = a;
+    if (count > a) {
+        span[1] = r->ring;
+        span_len[1] = count - a;
+    }
+    return count;
+}
+
+int ucshm_still_valid(const ucshm_reader *r, uint64_t first)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);  // the reads of the samples happen before the head check
+    return first + r->mask + 1 >= load_relaxed(&r->header->writeHead);
+}
+
+int64_t ucshm_copy(const ucshm_reader *r, uint64_t first, uint64_t count, uint16_t *dst)
+{
+    const uint16_t *span[2];
+    uint64_t len[2];
+    const uint64_t n = ucshm_view(r, first, count, span, len);
+    if (n == 0)
+        return first < ucshm_oldest(r) ? -1 : 0;
+
+    memcpy(dst, span[0], len[0] * sizeof(uint16_t));
+    if (len[1])
+        memcpy(dst + len[0], span[1], len[1] * sizeof(uint16_t));
+    return ucshm_still_valid(r, first) ? (int64_t)n : -1;
+}
+
+int ucshm_read_spectrum(const ucshm_reader *r, int chain, float *dst, int max_bins, UcShmChain *info)
+{
+    if (chain < 0 || chain >= UCSHM_MAX_CHAINS)
+        return 0;
+
+    const UcShmChain *slot = &r->header->chains[chain];
+    for (int attempt = 0; attempt < SPECTRUM_RETRIES; ++attempt) {
+        const uint64_t seq = load_acquire(&slot->seq);
+        if (seq == 0)
+            return 0;  // nothing published on this chain yet
+        if (seq & 1)
+            continue;
+
+        UcShmChain copy;
+        memcpy(&copy, slot, sizeof(copy));
+        int bins = (int)copy.bins < max_bins ? (int)copy.bins : max_bins;
+        if (bins > UCSHM_MAX_BINS)
+            bins = UCSHM_MAX_BINS;
+        memcpy(dst, (const char *)r->header + copy.dataOffset, (size_t)bins * sizeof(float));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (load_relaxed(&slot->seq) == seq) {
+            if (info)
+                *info = copy;
+            return bins;
+        }
+    }
+    return 0;  // publisher kept rewriting it, try again later
+}
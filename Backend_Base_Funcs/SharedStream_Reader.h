@@ -0,0 +1,62 @@
+
+// Reader side of the app's shared-memory stream (SharedPublisher), plain C
+// Maps the segment read-only; nothing here can slow down the app's acquisition.
+// Protocol and layout: ../SharedStreamLayout.h
+
+// Linux:   gcc -O2 -I.. your_tool.c SharedStream_Reader.c -o your_tool   (-lrt on glibc < 2.34)
+// Windows: gcc -O2 -I.. your_tool.c SharedStream_Reader.c -o your_tool
+
+#ifndef SHAREDSTREAM_READER_H
+#define SHAREDSTREAM_READER_H
+
+#include "SharedStreamLayout.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const UcShmHeader *header;
+    const uint16_t    *ring;
+    uint64_t           mask;    /* ringCapacity - 1 */
+    size_t             bytes;
+    void              *handle;  /* Windows mapping handle */
+} ucshm_reader;
+
+/* 0 on success. name NULL = UCSHM_DEFAULT_NAME */
+int  ucshm_open(ucshm_reader *r, const char *name);
+void ucshm_close(ucshm_reader *r);
+
+/* Publisher still there: segment not closed and fed within max_age_us */
+int  ucshm_alive(const ucshm_reader *r, uint64_t max_age_us);
+
+/* One past the newest published sample (absolute index) */
+uint64_t ucshm_cursor(const ucshm_reader *r);
+
+/* Oldest sample index still in the ring */
+uint64_t ucshm_oldest(const ucshm_reader *r);
+
+/*
+ * Zero copy: points span[0]/span[1] straight into the ring for samples
+ * [first, first + count), clipped to what is published (second span only
+ * when the range wraps). Returns the number of samples covered, 0 if
+ * first is no longer in the ring. Check ucshm_still_valid(first) after
+ * consuming: if it fails the publisher lapped you and the data is torn.
+ */
+uint64_t ucshm_view(const ucshm_reader *r, uint64_t first, uint64_t count,
+                    const uint16_t *span[2], uint64_t span_len[2]);
+int      ucshm_still_valid(const ucshm_reader *r, uint64_t first);
+
+/* Copying variant: samples copied, -1 if overwritten before or during the copy */
+int64_t  ucshm_copy(const ucshm_reader *r, uint64_t first, uint64_t count, uint16_t *dst);
+
+/* Consistent copy of a chain's latest spectrum (linear magnitudes). Returns bins copied, 0 if none yet */
+int      ucshm_read_spectrum(const ucshm_reader *r, int chain, float *dst, int max_bins, UcShmChain *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHAREDSTREAM_READER_H
@@ -0,0 +1,186 @@
+
+// Reference client for the app's TCP stream (StreamServer), no device logic needed
+// Connects, reads frames for RUN_SECONDS and prints per-type frame rates, throughput,
+// sequence gaps (frames the server skipped for us) and a sample of each frame type.
+// Keep the FrameHeader below in sync with StreamServer.h.
+
+// Linux:   gcc -O2 Stream_LoopbackClient.c -o stream_client
+// Windows: gcc -O2 Stream_LoopbackClient.c -o stream_client -lws2_32
+// ./stream_client [host] [port]    (default 127.0.0.1 5555)
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include <stdint.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define close_socket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define close_socket close
+#endif
+
+#define STREAM_MAGIC   0x54534355u   // "UCST"
+#define RUN_SECONDS    10
+#define MAX_PAYLOAD    (16 << 20)
+
+#pragma pack(push, 1)
+typedef struct {
+    uint32_t magic;
+    uint16_t type;          // 1 spectrum, 2 peaks, 3 time envelope
+    uint16_t version;
+    uint32_t payloadBytes;
+    uint32_t sequence;
+    uint64_t timestampUs;
+} FrameHeader;
+#pragma pack(pop)
+
+static int read_exact(socket_t s, void *dst, size_t n)
+{
+    char *p = (char *)dst;
+    while (n > 0) {
+        int got = recv(s, p, (int)n, 0);
+        if (got <= 0)
+            return 0;
+        p += got;
+        n -= (size_t)got;
+    }
+    return 1;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void show_spectrum(const uint8_t *p)
+{
+    uint32_t chain, bins, fftSize;
+    double rate;
+    float dbStep;
+    memcpy(&chain, p, 4);
+    memcpy(&bins, p + 4, 4);
+    memcpy(&rate, p + 8, 8);
+    memcpy(&fftSize, p + 16, 4);
+    memcpy(&dbStep, p + 20, 4);
+
+    const int16_t *codes = (const int16_t *)(p + 24);
+    uint32_t best = 1;
+    for (uint32_t i = 1; i < bins; ++i)
+        if (codes[i] > codes[best])
+            best = i;
+    printf("  spectrum  chain %u: %u bins, strongest %.4f MHz at %.2f dB\n",
+           chain, bins, best * rate / fftSize / 1e6, codes[best] * dbStep);
+}
+
+static void show_peaks(const uint8_t *p)
+{
+    uint32_t chain, count;
+    memcpy(&chain, p, 4);
+    memcpy(&count, p + 4, 4);
+    printf("  peaks     chain %u:", chain);
+    for (uint32_t k = 0; k < count && k < 4; ++k) {
+        double freq;
+        float db;
+        memcpy(&freq, p + 8 + k * 16, 8);
+        memcpy(&db, p + 16 + k * 16, 4);
+        printf(" %.4f MHz (%.1f dB)", freq / 1e6, db);
+    }
+    printf("\n");
+}
+
+static void show_envelope(const uint8_t *p)
+{
+    uint64_t first;
+    double rate, perBin;
+    uint32_t bins;
+    memcpy(&first, p, 8);
+    memcpy(&rate, p + 8, 8);
+    memcpy(&perBin, p + 16, 8);
+    memcpy(&bins, p + 24, 4);
+
+    const uint16_t *mins = (const uint16_t *)(p + 32);
+    const uint16_t *maxs = mins + bins;
+    uint16_t lo = 0xFFFF, hi = 0;
+    for (uint32_t i = 0; i < bins; ++i) {
+        if (mins[i] < lo) lo = mins[i];
+        if (maxs[i] > hi) hi = maxs[i];
+    }
+    printf("  envelope  sample %llu: %u bins x %.0f samples (%.2f ms), codes %u..%u\n",
+           (unsigned long long)first, bins, perBin, bins * perBin / rate * 1e3, lo, hi);
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+    const int port = argc > 2 ? atoi(argv[2]) : 5555;
+
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+
+    socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    if (connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        printf("cannot connect to %s:%d, is the app running with AppConfig::streamPort set?\n", host, port);
+        return 1;
+    }
+    printf("connected to %s:%d, reading for %d s\n", host, port, RUN_SECONDS);
+
+    uint8_t *payload = (uint8_t *)malloc(MAX_PAYLOAD);
+    unsigned long long frames[4] = {0}, bytes = 0, gaps = 0;
+    int shown[4] = {0};
+    uint32_t lastSeq = 0;
+    const double t0 = now_s();
+
+    while (now_s() - t0 < RUN_SECONDS) {
+        FrameHeader h;
+        if (!read_exact(s, &h, sizeof(h))) {
+            printf("server closed the connection (too slow?)\n");
+            break;
+        }
+        if (h.magic != STREAM_MAGIC || h.payloadBytes > MAX_PAYLOAD) {
+            printf("bad frame header, lost sync\n");
+            break;
+        }
+        if (!read_exact(s, payload, h.payloadBytes))
+            break;
+
+        if (frames[0] + frames[1] + frames[2] + frames[3] > 0 && h.sequence != lastSeq + 1)
+            gaps += h.sequence - lastSeq - 1;
+        lastSeq = h.sequence;
+        frames[h.type < 4 ? h.type : 0]++;
+        bytes += sizeof(h) + h.payloadBytes;
+
+        if (h.type < 4 && !shown[h.type]) {
+            shown[h.type] = 1;
+            if (h.type == 1) show_spectrum(payload);
+            if (h.type == 2) show_peaks(payload);
+            if (h.type == 3) show_envelope(payload);
+        }
+    }
+
+    const double elapsed = now_s() - t0;
+    printf("\n%.1f s: spectrum %.1f/s, peaks %.1f/s, envelope %.1f/s, unknown %llu\n", elapsed,
+           frames[1] / elapsed, frames[2] / elapsed, frames[3] / elapsed, frames[0]);
+    printf("%.2f MB/s, %llu frames missed (sequence gaps)\n", bytes / elapsed / 1e6, gaps);
+
+    free(payload);
+    close_socket(s);
+    return 0;
+}
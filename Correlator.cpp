@@ -0,0 +1,286 @@
+// Correlator.cpp
+#include "Correlator.h"
+#include "ZoomFFT.h"
+#include "AppConfig.h"
+#include "Arena.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double kSpreadAlpha = 0.05;  // EMA weight of one period estimate
+
+double full_energy(const std::complex<double> *x, int half, int n)
+{
+    double e = 0.0;
+    for (int k = 1; k < half; ++k)
+        e += (2 * k == n ? 1.0 : 2.0) * std::norm(x[k]);  // the mirrored half counts too, Nyquist once
+    return e;
+}
+
+// Variance of a Gaussian through three equally spaced samples (a parabola in the log), 0 if they aren't one
+double gaussian_variance(double a, double b, double c)
+{
+    if (a <= 0.0 || b <= 0.0 || c <= 0.0)
+        return 0.0;
+    const double curvature = std::log(a) - 2.0 * std::log(b) + std::log(c);
+    return curvature < 0.0 ? -1.0 / curvature : 0.0;
+}
+}
+
+Correlator::Correlator(int fftSize, double sampleRate, const std::vector<double> &window, int workers, Arena &arena)
+    : n(fftSize), half(fftSize / 2 + 1), rate(sampleRate), scratch(workers)
+{
+    for (Scratch &s : scratch) {  // 64-byte aligned, fine for the new-array execute
+        s.in = arena.allocate<fftw_complex>(n, ArenaUse::Scratch);
+        s.out = arena.allocate<fftw_complex>(n, ArenaUse::Scratch);
+        s.rho = arena.allocate<double>(half, ArenaUse::Scratch);
+    }
+    autocorrTrace.reserve(half);  // copied into under resultMutex, never grown there
+    crossTrace.reserve(n);
+
+    double *w = static_cast<double*>(fftw_malloc(sizeof(double) * n));
+    fftw_complex *a = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * n));
+    fftw_complex *b = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * n));
+
+    pthread_mutex_lock(&ZoomFFT::plannerMutex());
+    fftw_plan forward = fftw_plan_dft_r2c_1d(n, w, a, FFTW_ESTIMATE);
+    realInverse = fftw_plan_dft_c2r_1d(n, a, reinterpret_cast<double*>(b), FFTW_ESTIMATE);
+    complexInverse = fftw_plan_dft_1d(n, a, b, FFTW_BACKWARD, FFTW_ESTIMATE);
+    pthread_mutex_unlock(&ZoomFFT::plannerMutex());
+
+    // The window's own autocorrelation, the taper every frame's autocorrelation carries
+    for (int i = 0; i < n; ++i)
+        w[i] = window.empty() ? 1.0 : window[i];
+    fftw_execute(forward);
+    for (int k = 0; k < half; ++k) {
+        a[k][0] = a[k][0] * a[k][0] + a[k][1] * a[k][1];
+        a[k][1] = 0.0;
+    }
+    fftw_execute_dft_c2r(realInverse, a, w);
+    windowAc.assign(w, w + half);
+    const double floor = 1e-3 * windowAc[0];
+    for (double &v : windowAc)
+        v = std::max(v, floor);
+
+    pthread_mutex_lock(&ZoomFFT::plannerMutex());
+    fftw_destroy_plan(forward);
+    pthread_mutex_unlock(&ZoomFFT::plannerMutex());
+    fftw_free(w);
+    fftw_free(a);
+    fftw_free(b);
+}
+
+Correlator::~Correlator()
+{
+    pthread_mutex_lock(&ZoomFFT::plannerMutex());
+    fftw_destroy_plan(realInverse);
+    fftw_destroy_plan(complexInverse);
+    pthread_mutex_unlock(&ZoomFFT::plannerMutex());
+}
+
+void Correlator::process(const fftw_complex *spectrum, uint64_t stamp, int worker)
+{
+    Scratch &s = scratch[worker];
+
+    if (capture.exchange(false, std::memory_order_acq_rel)) {
+        auto captured = std::make_shared<Spectrum>(half);
+        for (int k = 0; k < half; ++k)
+            (*captured)[k] = {spectrum[k][0], spectrum[k][1]};
+        setReferenceSpectrum(captured);
+    }
+
+    pthread_mutex_lock(&referenceMutex);
+    const std::shared_ptr<const Spectrum> ref = reference;
+    const double refEnergy = referenceEnergy;
+    pthread_mutex_unlock(&referenceMutex);
+
+    // One inverse transform: P alone through c2r, or P + iC through c2c
+    const double *ac;
+    const double *cc = nullptr;
+    int stride = 1;
+    if (!ref) {
+        for (int k = 0; k < half; ++k) {
+            s.in[k][0] = spectrum[k][0] * spectrum[k][0] + spectrum[k][1] * spectrum[k][1];
+            s.in[k][1] = 0.0;
+        }
+        s.in[0][0] = 0.0;
+        fftw_execute_dft_c2r(realInverse, s.in, reinterpret_cast<double*>(s.out));
+        ac = reinterpret_cast<const double*>(s.out);
+    } else {
+        const std::complex<double> *r = ref->data();
+        for (int k = 0; k < half; ++k) {
+            const std::complex<double> x(spectrum[k][0], spectrum[k][1]);
+            const double p = std::norm(x);
+            const std::complex<double> c = x * std::conj(r[k]);
+            s.in[k][0] = p - c.imag();
+            s.in[k][1] = c.real();
+            if (k > 0 && 2 * k != n) {  // mirror bin n - k holds conj(C): P + i conj(C)
+                s.in[n - k][0] = p + c.imag();
+                s.in[n - k][1] = c.real();
+            }
+        }
+        s.in[0][0] = s.in[0][1] = 0.0;
+        fftw_execute_dft(complexInverse, s.in, s.out);
+        ac = &s.out[0][0];
+        cc = &s.out[0][1];
+        stride = 2;
+    }
+
+    const double energy = ac[0];
+    if (!(energy > 0.0))
+        return;  // a flat frame, nothing to correlate
+
+    double *rho = s.rho;
+    const double scale = windowAc[0] / energy;
+    for (int l = 0; l < half; ++l)
+        rho[l] = ac[l * stride] / windowAc[l] * scale;
+
+    // Leave the zero-lag lobe, then the strongest repeat, then the earliest one nearly as strong
+    CorrelationResult r;
+    r.stamp = stamp;
+    const int maxLag = half - 2;
+    int first = 1;
+    while (first < maxLag && (rho[first] > 0.5 || rho[first + 1] < rho[first]))
+        ++first;
+    int best = first;
+    for (int l = first; l <= maxLag; ++l)
+        if (rho[l] > rho[best])
+            best = l;
+    if (rho[best] >= AppConfig::correlationMinConfidence) {
+        for (int l = first; l < best; ++l) {
+            if (rho[l] >= 0.9 * rho[best] && rho[l] >= rho[l - 1] && rho[l] >= rho[l + 1]) {
+                best = l;
+                break;
+            }
+        }
+        const double a = rho[best - 1], b = rho[best], c = rho[best + 1];
+        const double curvature = a - 2.0 * b + c;
+        const double delta = curvature < 0.0 ? 0.5 * (a - c) / curvature : 0.0;
+        const double peak = b - 0.25 * (a - c) * delta;
+
+        r.periodSeconds = (best + delta) / rate;
+        r.confidence = std::clamp(peak, 0.0, 1.0);
+        // Lag 0 also holds the white-noise power, so the zero-lag Gaussian comes from lags 1 and 2
+        const double zeroLag = rho[1] > rho[2] && rho[2] > 0.0 ? 1.5 / std::log(rho[1] / rho[2]) : 0.0;
+        const double broadening = gaussian_variance(a, b, c) - zeroLag;
+        r.jitterSeconds = std::sqrt(std::max(0.0, broadening / 2.0)) / rate;
+    }
+
+    if (cc) {
+        r.hasReference = true;
+        const double norm = 1.0 / std::sqrt(energy * refEnergy);
+        int bestLag = 0;
+        for (int l = 1; l < n; ++l)
+            if (cc[2 * l] > cc[2 * bestLag])
+                bestLag = l;
+        r.match = cc[2 * bestLag] * norm;
+        r.delaySeconds = (bestLag > n / 2 ? bestLag - n : bestLag) / rate;
+    }
+
+    pthread_mutex_lock(&resultMutex);
+    if (r.periodSeconds > 0.0) {
+        if (periodMean == 0.0) {
+            periodMean = r.periodSeconds;
+        } else {
+            const double d = r.periodSeconds - periodMean;
+            periodMean += kSpreadAlpha * d;
+            periodVar = (1.0 - kSpreadAlpha) * (periodVar + kSpreadAlpha * d * d);
+        }
+    }
+    r.spreadSeconds = std::sqrt(periodVar);
+    r.frames = published.frames + 1;
+    if (stamp >= published.stamp)  // frames of one chain finish out of order
+        published = r;
+    else
+        published.frames = r.frames;
+
+    if (tracesWanted.exchange(false, std::memory_order_relaxed)) {
+        autocorrTrace.assign(rho, rho + half);
+        crossTrace.clear();
+        if (cc) {
+            const double norm = 1.0 / std::sqrt(energy * refEnergy);
+            crossTrace.resize(n);
+            for (int i = 0; i < n; ++i)
+                crossTrace[i] = cc[2 * ((i - n / 2 + n) % n)] * norm;
+        }
+    }
+    pthread_mutex_unlock(&resultMutex);
+}
+
+void Correlator::setReference(const std::vector<double> &pulse)
+{
+    if (pulse.empty()) {
+        setReferenceSpectrum(nullptr);
+        return;
+    }
+
+    double *x = static_cast<double*>(fftw_malloc(sizeof(double) * n));
+    fftw_complex *X = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * half));
+    const size_t count = std::min(pulse.size(), static_cast<size_t>(n));
+    std::copy(pulse.begin(), pulse.begin() + count, x);
+    std::fill(x + count, x + n, 0.0);
+
+    pthread_mutex_lock(&ZoomFFT::plannerMutex());
+    fftw_plan forward = fftw_plan_dft_r2c_1d(n, x, X, FFTW_ESTIMATE);
+    pthread_mutex_unlock(&ZoomFFT::plannerMutex());
+    fftw_execute(forward);
+
+    auto spectrum = std::make_shared<Spectrum>(half);
+    for (int k = 0; k < half; ++k)
+        (*spectrum)[k] = {X[k][0], X[k][1]};
+
+    pthread_mutex_lock(&ZoomFFT::plannerMutex());
+    fftw_destroy_plan(forward);
+    pthread_mutex_unlock(&ZoomFFT::plannerMutex());
+    fftw_free(x);
+    fftw_free(X);
+
+    setReferenceSpectrum(spectrum);
+}
+
+void Correlator::captureReference()
+{
+    capture.store(true, std::memory_order_release);
+}
+
+void Correlator::setReferenceSpectrum(std::shared_ptr<const Spectrum> spectrum)
+{
+    double energy = 0.0;
+    if (spectrum) {
+        auto cleared = std::make_shared<Spectrum>(*spectrum);
+        (*cleared)[0] = 0.0;  // the frames' DC bin is dropped too
+        energy = full_energy(cleared->data(), half, n);
+        spectrum = energy > 0.0 ? std::move(cleared) : nullptr;
+    }
+
+    pthread_mutex_lock(&referenceMutex);
+    reference = std::move(spectrum);
+    referenceEnergy = energy;
+    pthread_mutex_unlock(&referenceMutex);
+}
+
+bool Correlator::result(CorrelationResult &out, std::vector<double> *autocorr, std::vector<double> *cross)
+{
+    pthread_mutex_lock(&resultMutex);
+    out = published;
+    if (autocorr)
+        *autocorr = autocorrTrace;
+    if (cross)
+        *cross = crossTrace;
+    pthread_mutex_unlock(&resultMutex);
+
+    if (autocorr || cross)
+        tracesWanted.store(true, std::memory_order_relaxed);
+    return out.frames > 0;
+}
+
+void Correlator::reset()
+{
+    pthread_mutex_lock(&resultMutex);
+    published = CorrelationResult();
+    periodMean = periodVar = 0.0;
+    autocorrTrace.clear();
+    crossTrace.clear();
+    pthread_mutex_unlock(&resultMutex);
+}
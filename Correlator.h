@@ -0,0 +1,101 @@
+// Correlator.h
+#ifndef CORRELATOR_H
+#define CORRELATOR_H
+
+#include <fftw3.h>
+#include <pthread.h>
+#include <atomic>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Arena;
+
+struct CorrelationResult {
+    double periodSeconds = 0.0;   // 0 = no repetition found
+    double confidence = 0.0;      // normalised autocorrelation at the period, 0..1
+    double jitterSeconds = 0.0;   // RMS timing jitter from the broadening of the period peak
+    double spreadSeconds = 0.0;   // frame-to-frame spread of the period estimate
+    bool hasReference = false;
+    double delaySeconds = 0.0;    // lag of the best match against the reference
+    double match = 0.0;           // normalised cross-correlation there, -1..1
+    uint64_t stamp = 0;           // SampleTimeline index (ADC rate) just past the frame
+    uint64_t frames = 0;          // frames analysed since the last reset
+};
+
+/*!
+ * Autocorrelation and reference cross-correlation of an analysis chain,
+ * taken from the spectra the chain already computes (Wiener-Khinchin):
+ * the power spectrum |X|^2 and the cross spectrum X R* go back through
+ * one inverse FFT per frame. With a reference both are packed into a
+ * single complex transform, P + iC, since each inverts to a real series:
+ * the real part is the autocorrelation, the imaginary part the cross-
+ * correlation.
+ *
+ * Frames are windowed, so the autocorrelation is divided by the window's
+ * own and normalised to 1 at lag 0. The period is the first autocorrelation
+ * peak past the zero-lag lobe within 90% of the highest one (so a missing
+ * pulse doesn't double it), refined by parabolic interpolation. Timing
+ * jitter broadens the peak at the period relative to the one at lag 0:
+ * both are fitted as Gaussians through their three samples and their
+ * variances differ by twice the jitter variance. That needs pulses at
+ * least a few samples wide at the chain rate. Lags reach fftSize / 2.
+ *
+ * process() runs on the DSP workers, several frames of one chain at once;
+ * each worker has its own scratch, carved from the pipeline's arena up
+ * front; results are published under a mutex.
+ */
+class Correlator
+{
+public:
+    Correlator(int fftSize, double sampleRate, const std::vector<double> &window, int workers, Arena &arena);
+    ~Correlator();
+
+    // Pool worker: spectrum is the frame's r2c output, fftSize / 2 + 1 bins
+    void process(const fftw_complex *spectrum, uint64_t stamp, int worker);
+
+    // Pulse shape at the chain rate, at most fftSize samples; empty clears the reference
+    void setReference(const std::vector<double> &pulse);
+    void captureReference();  // the next analysed frame becomes the reference
+
+    // Latest result; traces (when asked for) are copied by the frame after the request,
+    // autocorr over lags 0..fftSize/2, cross over lags -fftSize/2..fftSize/2-1
+    bool result(CorrelationResult &out, std::vector<double> *autocorr = nullptr, std::vector<double> *cross = nullptr);
+    void reset();
+
+    int size() const { return n; }
+
+private:
+    using Spectrum = std::vector<std::complex<double>>;
+
+    struct Scratch {
+        fftw_complex *in = nullptr;   // n complex
+        fftw_complex *out = nullptr;  // n complex, or n doubles for the real-only inverse
+        double *rho = nullptr;        // half
+    };
+
+    void setReferenceSpectrum(std::shared_ptr<const Spectrum> spectrum);
+
+    const int n;
+    const int half;  // n / 2 + 1
+    const double rate;
+    std::vector<double> windowAc;  // window autocorrelation, lags 0..n/2
+
+    fftw_plan realInverse = nullptr;     // c2r, autocorrelation only
+    fftw_plan complexInverse = nullptr;  // c2c backward, autocorrelation + cross-correlation
+    std::vector<Scratch> scratch;        // one per worker, in the arena
+
+    pthread_mutex_t referenceMutex = PTHREAD_MUTEX_INITIALIZER;
+    std::shared_ptr<const Spectrum> reference;  // DC bin cleared
+    double referenceEnergy = 0.0;               // sum of |R|^2 over the full spectrum
+    std::atomic<bool> capture{false};
+
+    pthread_mutex_t resultMutex = PTHREAD_MUTEX_INITIALIZER;
+    CorrelationResult published;
+    double periodMean = 0.0, periodVar = 0.0;
+    std::atomic<bool> tracesWanted{false};
+    std::vector<double> autocorrTrace, crossTrace;
+};
+
+#endif // CORRELATOR_H
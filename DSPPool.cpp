@@ -0,0 +1,147 @@
+// DSPPool.cpp
+#include "DSPPool.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <thread>
+
+static thread_local int tls_worker_index = -1;
+
+DSPPool::DSPPool(int threads, StartHook onStart)
+    : startHook(std::move(onStart))
+{
+    const int count = threads > 0 ? threads : defaultThreadCount();
+
+    workers.reserve(count);
+    startArgs.resize(count);
+    for (int i = 0; i < count; ++i)
+        workers.push_back(std::make_unique<Worker>());
+
+    for (int i = 0; i < count; ++i) {
+        startArgs[i] = { this, i };
+        pthread_create(&workers[i]->thread, nullptr, &DSPPool::workerMain, &startArgs[i]);
+    }
+
+    qDebug() << "[DSPPool] Started" << count << "workers";
+}
+
+DSPPool::~DSPPool()
+{
+    shutdown();
+}
+
+int DSPPool::defaultThreadCount()
+{
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(1, cores - 1);
+}
+
+int DSPPool::currentWorker()
+{
+    return tls_worker_index;
+}
+
+void DSPPool::submit(Task task)
+{
+    if (stopRequested())
+        return;
+
+    // Workers keep their follow-up work local; outside callers spread round-robin
+    int target = tls_worker_index;
+    if (target < 0 || target >= size())
+        target = static_cast<int>(nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size());
+
+    Worker &w = *workers[target];
+    pthread_mutex_lock(&w.lock);
+    w.tasks.push_back(std::move(task));
+    pthread_mutex_unlock(&w.lock);
+
+    pthread_mutex_lock(&idleMutex);
+    pending.fetch_add(1, std::memory_order_relaxed);
+    pthread_cond_signal(&idleCond);
+    pthread_mutex_unlock(&idleMutex);
+}
+
+void DSPPool::shutdown()
+{
+    if (joined)
+        return;
+
+    pthread_mutex_lock(&idleMutex);
+    stopping.store(true);
+    pthread_cond_broadcast(&idleCond);
+    pthread_mutex_unlock(&idleMutex);
+
+    for (auto &w : workers)
+        pthread_join(w->thread, nullptr);
+
+    for (auto &w : workers)
+        w->tasks.clear();
+
+    joined = true;
+    qDebug() << "[DSPPool] Joined" << size() << "workers";
+}
+
+void* DSPPool::workerMain(void *arg)
+{
+    auto *args = static_cast<StartArgs *>(arg);
+    tls_worker_index = args->index;
+    if (args->pool->startHook)
+        args->pool->startHook(args->index);
+    args->pool->run(args->index);
+    return nullptr;
+}
+
+bool DSPPool::popLocal(int index, Task &task)
+{
+    Worker &w = *workers[index];
+    pthread_mutex_lock(&w.lock);
+    bool found = !w.tasks.empty();
+    if (found) {
+        task = std::move(w.tasks.back());
+        w.tasks.pop_back();
+    }
+    pthread_mutex_unlock(&w.lock);
+    return found;
+}
+
+bool DSPPool::steal(int thief, Task &task)
+{
+    const int n = size();
+    for (int k = 1; k < n; ++k) {
+        Worker &victim = *workers[(thief + k) % n];
+        if (pthread_mutex_trylock(&victim.lock) != 0)
+            continue;
+
+        bool found = !victim.tasks.empty();
+        if (found) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+        pthread_mutex_unlock(&victim.lock);
+
+        if (found)
+            return true;
+    }
+    return false;
+}
+
+void DSPPool::run(int index)
+{
+    Task task;
+
+    while (!stopRequested()) {
+        if (popLocal(index, task) || steal(index, task)) {
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        // A failed trylock can leave work behind; only sleep when nothing is pending
+        pthread_mutex_lock(&idleMutex);
+        while (pending.load(std::memory_order_relaxed) == 0 && !stopRequested())
+            pthread_cond_wait(&idleCond, &idleMutex);
+        pthread_mutex_unlock(&idleMutex);
+    }
+}
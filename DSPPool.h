@@ -0,0 +1,68 @@
+// DSPPool.h
+#ifndef DSPPOOL_H
+#define DSPPOOL_H
+
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*!
+ * Work-stealing pool for the DSP side of the pipeline (FFT, magnitude,
+ * peak search, decimation, export). Every worker owns a deque: it runs its
+ * own tasks newest-first and steals the oldest tasks from the others when
+ * it runs dry. Sized at runtime, joined on shutdown.
+ */
+class DSPPool
+{
+public:
+    using Task = std::function<void()>;
+    using StartHook = std::function<void(int)>;  // runs first on every worker, e.g. for pinning
+
+    explicit DSPPool(int threads = 0, StartHook onStart = nullptr);  // 0 = one per core, minus one for acquisition
+    ~DSPPool();
+
+    void submit(Task task);
+
+    // Cooperative cancellation: running tasks should poll stopRequested()
+    // and return early; queued tasks are dropped. Joins all workers.
+    void shutdown();
+    bool stopRequested() const { return stopping.load(std::memory_order_relaxed); }
+
+    int size() const { return static_cast<int>(workers.size()); }
+    static int currentWorker();  // calling worker's index, -1 outside any pool
+
+    static int defaultThreadCount();
+
+private:
+    struct Worker {
+        pthread_t thread;
+        pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+        std::deque<Task> tasks;
+    };
+
+    struct StartArgs {
+        DSPPool *pool;
+        int index;
+    };
+
+    static void* workerMain(void *arg);
+    void run(int index);
+    bool popLocal(int index, Task &task);
+    bool steal(int thief, Task &task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<StartArgs> startArgs;
+    StartHook startHook;
+
+    pthread_mutex_t idleMutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t  idleCond  = PTHREAD_COND_INITIALIZER;
+    std::atomic<int>  pending{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<unsigned> nextWorker{0};
+    bool joined = false;
+};
+
+#endif // DSPPOOL_H
@@ -0,0 +1,132 @@
+// Decimator.cpp
+#include "Decimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+Decimator::Decimator(int factor)
+    : total(std::max(factor, 1))
+{
+    firStage = total >= 4 && total % 2 == 0;
+    cicRatio = firStage ? total / 2 : total;
+    gain = std::pow(static_cast<double>(cicRatio), kOrder);
+    designFilter();
+}
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kPassband = 0.2;   // of the CIC output rate, flat up to here
+constexpr double kStopband = 0.25;  // the output Nyquist: stopband from here on
+constexpr double kKaiserBeta = 6.76;  // ~70 dB
+
+// Modified Bessel function of the first kind, order 0 (Kaiser window)
+double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// |H(f)| of a 3rd-order CIC decimating by R, f as a fraction of its output rate
+double cic_droop(double f, int R)
+{
+    if (f < 1e-12)
+        return 1.0;
+    return std::pow(std::abs(std::sin(kPi * f) / (R * std::sin(kPi * f / R))), 3);
+}
+}
+
+double Decimator::usableFraction() const
+{
+    if (total == 1)
+        return 1.0;
+    return firStage ? kPassband / kStopband : 0.5;  // CIC alone: the top half droops and aliases
+}
+
+void Decimator::designFilter()
+{
+    // Kaiser-windowed CIC compensator: ideal response 1 / droop up to the transition midpoint, 0 above.
+    // The impulse response comes from integrating that numerically; it is built once per chain.
+    taps.resize(kTaps);
+    const int mid = kTaps / 2;
+    const double edge = (kPassband + kStopband) / 2.0;
+    constexpr int kSteps = 2048;
+    const double df = edge / kSteps;
+    double sum = 0.0;
+    for (int t = 0; t < kTaps; ++t) {
+        const int k = t - mid;
+        double h = 0.0;
+        for (int i = 0; i < kSteps; ++i) {
+            const double f = (i + 0.5) * df;
+            h += std::cos(2.0 * kPi * f * k) / cic_droop(f, cicRatio);
+        }
+        h *= 2.0 * df;
+
+        const double r = static_cast<double>(k) / mid;
+        taps[t] = h * bessel_i0(kKaiserBeta * std::sqrt(1.0 - r * r)) / bessel_i0(kKaiserBeta);
+        sum += taps[t];
+    }
+    for (double &t : taps)
+        t /= sum;
+}
+
+// One CIC output in, at most one FIR output out (every second call)
+bool Decimator::pushFir(double x, double *y)
+{
+    history[head] = x;
+    history[head + kTaps] = x;
+    head = (head + 1) % kTaps;
+
+    odd = !odd;
+    if (odd)
+        return false;
+
+    // Symmetric taps: fold the window around its centre, half the multiplies
+    const double *window = history + head;  // oldest .. newest
+    constexpr int mid = kTaps / 2;
+    double acc = taps[mid] * window[mid];
+    for (int t = 0; t < mid; ++t)
+        acc += taps[t] * (window[t] + window[kTaps - 1 - t]);
+    *y = acc;
+    return true;
+}
+
+int Decimator::process(const uint16_t *in, int n, double *out)
+{
+    if (total == 1) {
+        for (int i = 0; i < n; ++i)
+            out[i] = in[i];
+        return n;
+    }
+
+    // Integrators wrap modulo 2^64 on purpose, the combs undo it exactly
+    int written = 0;
+    for (int i = 0; i < n; ++i) {
+        uint64_t x = in[i];
+        for (int k = 0; k < kOrder; ++k) {
+            integrators[k] += x;
+            x = integrators[k];
+        }
+
+        if (++phase < cicRatio)
+            continue;
+        phase = 0;
+
+        uint64_t y = x;
+        for (int k = 0; k < kOrder; ++k) {
+            const uint64_t d = y - combs[k];
+            combs[k] = y;
+            y = d;
+        }
+
+        const double v = static_cast<double>(y) / gain;
+        if (!firStage)
+            out[written++] = v;
+        else if (pushFir(v, out + written))
+            ++written;
+    }
+    return written;
+}
@@ -0,0 +1,51 @@
+// Decimator.h
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Anti-aliased integer-rate decimator for one analysis chain, fed straight
+ * from the USB callback. Even factors run a 3rd-order CIC by D/2 followed by
+ * a 101-tap FIR that halves the rate again: its passband undoes the CIC
+ * droop and is flat to 0.8 of the new Nyquist, and its stopband (~70 dB)
+ * starts at the new Nyquist, so nothing folds back into the band. Odd
+ * factors use the CIC alone, which droops and aliases towards the band
+ * edge. Factor 1 is a plain copy. Output is in ADC codes (CIC gain divided out).
+ */
+class Decimator
+{
+public:
+    explicit Decimator(int factor = 1);
+
+    int factor() const { return total; }
+    int pending() const { return firStage && odd ? phase + cicRatio : phase; }  // inputs taken toward the next output
+    double usableFraction() const;  // of the output Nyquist, flat and alias-free
+
+    // Consumes n input samples, writes at most n / factor + 1 outputs, returns how many
+    int process(const uint16_t *in, int n, double *out);
+
+private:
+    static constexpr int kOrder = 3;
+    static constexpr int kTaps = 101;  // odd, symmetric
+
+    void designFilter();
+    bool pushFir(double x, double *y);
+
+    int total;
+    int cicRatio;
+    bool firStage;
+
+    uint64_t integrators[kOrder] = {};
+    uint64_t combs[kOrder] = {};
+    int phase = 0;
+    double gain = 1.0;
+
+    std::vector<double> taps;
+    double history[2 * kTaps] = {};  // each sample stored twice so the window is contiguous
+    int head = 0;
+    bool odd = false;
+};
+
+#endif // DECIMATOR_H
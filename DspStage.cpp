@@ -0,0 +1,656 @@
+// DspStage.cpp
+#include "DspStage.h"
+#include "Decimator.h"
+#include "SpectrumAccumulator.h"
+#include "ZoomFFT.h"
+
+#include <fftw3.h>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+constexpr double kPi = 3.14159265358979323846;
+
+const char *blockKindName(BlockKind kind)
+{
+    switch (kind) {
+    case BlockKind::Raw:      return "raw";
+    case BlockKind::Samples:  return "samples";
+    case BlockKind::Complex:  return "complex";
+    case BlockKind::Spectrum: return "spectrum";
+    case BlockKind::Peaks:    return "peaks";
+    }
+    return "?";
+}
+
+std::vector<double> makeWindow(FFTWindow type, int n)
+{
+    if (type == FFTWindow::Rectangular || n < 2)
+        return {};
+
+    std::vector<double> w(n);
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        const double a = 2.0 * kPi * i / n;
+        switch (type) {
+        case FFTWindow::Hann:
+            w[i] = 0.5 - 0.5 * std::cos(a);
+            break;
+        case FFTWindow::BlackmanHarris:
+            w[i] = 0.35875 - 0.48829 * std::cos(a) + 0.14128 * std::cos(2 * a) - 0.01168 * std::cos(3 * a);
+            break;
+        case FFTWindow::FlatTop:
+            w[i] = 0.21557895 - 0.41663158 * std::cos(a) + 0.277263158 * std::cos(2 * a)
+                 - 0.083578947 * std::cos(3 * a) + 0.006947368 * std::cos(4 * a);
+            break;
+        case FFTWindow::Rectangular:
+            w[i] = 1.0;
+            break;
+        }
+        sum += w[i];
+    }
+    for (double& v : w)
+        v *= n / sum;
+    return w;
+}
+
+// ---------------------------------------------------------------------------
+// Blocks
+
+int DspBlock::valueCount() const
+{
+    switch (kind) {
+    case BlockKind::Raw:      return 0;
+    case BlockKind::Complex:
+    case BlockKind::Peaks:    return 2 * count;
+    default:                  return count;
+    }
+}
+
+BlockRef::BlockRef(DspBlock *b)
+    : block(b)
+{
+    if (block)
+        block->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+BlockRef::BlockRef(const BlockRef &other)
+    : BlockRef(other.block)
+{
+}
+
+BlockRef::BlockRef(BlockRef &&other) noexcept
+    : block(other.block)
+{
+    other.block = nullptr;
+}
+
+BlockRef &BlockRef::operator=(BlockRef other) noexcept
+{
+    std::swap(block, other.block);
+    return *this;
+}
+
+BlockRef::~BlockRef()
+{
+    if (block && block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        block->pool->release(block);
+}
+
+BlockPool::~BlockPool()
+{
+    for (SizeClass &c : classes) {
+        for (DspBlock *block : c.free) {
+            fftw_free(block->storage);
+            delete block;
+        }
+    }
+}
+
+BlockRef BlockPool::acquire(BlockKind kind, size_t bytes)
+{
+    int shift = kMinShift;
+    while ((size_t(1) << shift) < bytes)
+        ++shift;
+    const int index = std::min(shift - kMinShift, kClasses - 1);
+    SizeClass &c = classes[index];
+
+    DspBlock *block = nullptr;
+    pthread_mutex_lock(&c.mutex);
+    if (!c.free.empty()) {
+        block = c.free.back();
+        c.free.pop_back();
+    }
+    pthread_mutex_unlock(&c.mutex);
+
+    if (!block) {
+        block = new DspBlock;
+        block->capacity = size_t(1) << (index + kMinShift);
+        block->storage = fftw_malloc(block->capacity);
+        block->sizeClass = index;
+        block->pool = this;
+        allocated.fetch_add(block->capacity, std::memory_order_relaxed);
+    }
+
+    block->kind = kind;
+    block->count = 0;
+    block->stamp = 0;
+    block->sampleRate = 0.0;
+    block->frameSize = 0;
+    return BlockRef(block);
+}
+
+void BlockPool::release(DspBlock *block)
+{
+    SizeClass &c = classes[block->sizeClass];
+    pthread_mutex_lock(&c.mutex);
+    c.free.push_back(block);
+    pthread_mutex_unlock(&c.mutex);
+}
+
+// ---------------------------------------------------------------------------
+// Stages
+
+namespace {
+
+// New block with the same stream position and rate as `from`
+BlockRef derive(BlockPool &pool, const DspBlock &from, BlockKind kind, int count, size_t bytesPerValue)
+{
+    BlockRef out = pool.acquire(kind, std::max<size_t>(1, count * bytesPerValue));
+    out->count = count;
+    out->stamp = from.stamp;
+    out->sampleRate = from.sampleRate;
+    out->frameSize = from.frameSize;
+    return out;
+}
+
+// Raw ADC codes to doubles, inserted by the graph in front of the first Samples stage
+class ToSamples : public DspStage
+{
+public:
+    ToSamples() { label = "samples"; }
+    BlockKind input() const override { return BlockKind::Raw; }
+    BlockKind output() const override { return BlockKind::Samples; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        BlockRef b = derive(pool, *in, BlockKind::Samples, in->count, sizeof(double));
+        const uint16_t *src = in->raw();
+        double *dst = b->values();
+        for (int i = 0; i < in->count; ++i)
+            dst[i] = src[i];
+        out.push_back(std::move(b));
+    }
+};
+
+// Subtracts a slow running mean (one-pole, weight alpha per sample)
+class DcRemove : public DspStage
+{
+public:
+    explicit DcRemove(double a) : alpha(a) {}
+    BlockKind input() const override { return BlockKind::Samples; }
+    BlockKind output() const override { return BlockKind::Samples; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        BlockRef b = derive(pool, *in, BlockKind::Samples, in->count, sizeof(double));
+        const double *src = in->values();
+        double *dst = b->values();
+        if (!primed && in->count > 0) {
+            mean = src[0];
+            primed = true;
+        }
+        for (int i = 0; i < in->count; ++i) {
+            mean += alpha * (src[i] - mean);
+            dst[i] = src[i] - mean;
+        }
+        out.push_back(std::move(b));
+    }
+
+private:
+    double alpha;
+    double mean = 0.0;
+    bool primed = false;
+};
+
+// Windowed-sinc FIR (Blackman), unity gain at DC, designed for the rate of the first block
+class Lowpass : public DspStage
+{
+public:
+    Lowpass(double cutoff, int n) : cutoffHz(cutoff), tapCount(n | 1) {}
+    BlockKind input() const override { return BlockKind::Samples; }
+    BlockKind output() const override { return BlockKind::Samples; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        if (in->sampleRate != designedRate)
+            design(in->sampleRate);
+
+        // History then the new block, contiguous so each output is one dot product
+        const int n = in->count;
+        const int hist = tapCount - 1;
+        scratch.resize(hist + n);
+        std::copy(tail.begin(), tail.end(), scratch.begin());
+        std::copy(in->values(), in->values() + n, scratch.begin() + hist);
+
+        BlockRef b = derive(pool, *in, BlockKind::Samples, n, sizeof(double));
+        double *dst = b->values();
+        const double *h = taps.data();
+        for (int i = 0; i < n; ++i) {
+            const double *x = scratch.data() + i;
+            double acc = 0.0;
+            for (int k = 0; k < tapCount; ++k)
+                acc += h[k] * x[k];
+            dst[i] = acc;
+        }
+        std::copy(scratch.end() - hist, scratch.end(), tail.begin());
+        out.push_back(std::move(b));
+    }
+
+private:
+    void design(double rate)
+    {
+        designedRate = rate;
+        const double fc = std::min(cutoffHz / rate, 0.49);
+        const int m = tapCount - 1;
+        taps.resize(tapCount);
+        double sum = 0.0;
+        for (int k = 0; k < tapCount; ++k) {
+            const double t = k - m / 2.0;
+            const double sinc = t == 0.0 ? 2.0 * fc : std::sin(2.0 * kPi * fc * t) / (kPi * t);
+            const double w = 0.42 - 0.5 * std::cos(2.0 * kPi * k / m) + 0.08 * std::cos(4.0 * kPi * k / m);
+            taps[k] = sinc * w;
+            sum += taps[k];
+        }
+        for (double &h : taps)
+            h /= sum;
+        tail.assign(tapCount - 1, 0.0);
+    }
+
+    double cutoffHz;
+    int tapCount;
+    double designedRate = -1.0;
+    std::vector<double> taps, tail, scratch;
+};
+
+// Anti-aliased decimation of the raw stream, same filter as the analysis chains
+class Decimate : public DspStage
+{
+public:
+    explicit Decimate(int f) : decimator(f) {}
+    BlockKind input() const override { return BlockKind::Raw; }
+    BlockKind output() const override { return BlockKind::Samples; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        const int factor = decimator.factor();
+        if (!started) {
+            produced = in->stamp / factor;
+            started = true;
+        }
+        BlockRef b = pool.acquire(BlockKind::Samples, (in->count / factor + 1) * sizeof(double));
+        b->count = decimator.process(in->raw(), in->count, b->values());
+        b->stamp = produced;
+        b->sampleRate = in->sampleRate / factor;
+        produced += b->count;
+        if (b->count > 0)
+            out.push_back(std::move(b));
+    }
+
+private:
+    Decimator decimator;
+    uint64_t produced = 0;
+    bool started = false;
+};
+
+// Keeps every k-th sample, put a lowpass in front of it
+class Downsample : public DspStage
+{
+public:
+    explicit Downsample(int k) : factor(k) {}
+    BlockKind input() const override { return BlockKind::Samples; }
+    BlockKind output() const override { return BlockKind::Samples; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        BlockRef b = pool.acquire(BlockKind::Samples, (in->count / factor + 1) * sizeof(double));
+        const uint64_t first = in->stamp + (factor - in->stamp % factor) % factor;  // next input index on the grid
+        int n = 0;
+        for (uint64_t i = first - in->stamp; i < static_cast<uint64_t>(in->count); i += factor)
+            b->values()[n++] = in->values()[i];
+        b->count = n;
+        b->stamp = first / factor;
+        b->sampleRate = in->sampleRate / factor;
+        if (n > 0)
+            out.push_back(std::move(b));
+    }
+
+private:
+    int factor;
+};
+
+// Re-blocks a sample stream into frames of `size`, advancing by size * (1 - overlap)
+class Frame : public DspStage
+{
+public:
+    Frame(int n, double overlap) : size(n), hop(std::max(1, static_cast<int>(n * (1.0 - overlap)))) {}
+    BlockKind input() const override { return BlockKind::Samples; }
+    BlockKind output() const override { return BlockKind::Samples; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        const size_t have = buffer.size() - start;
+        if (have == 0 || bufferStamp + have != in->stamp) {  // first block or a gap: restart the frame
+            buffer.clear();
+            start = 0;
+            bufferStamp = in->stamp;
+        }
+        buffer.insert(buffer.end(), in->values(), in->values() + in->count);
+
+        while (buffer.size() - start >= static_cast<size_t>(size)) {
+            BlockRef b = pool.acquire(BlockKind::Samples, size * sizeof(double));
+            std::memcpy(b->values(), buffer.data() + start, size * sizeof(double));
+            b->count = size;
+            b->stamp = bufferStamp;
+            b->sampleRate = in->sampleRate;
+            b->frameSize = size;
+            out.push_back(std::move(b));
+            start += hop;
+            bufferStamp += hop;
+        }
+
+        if (start >= static_cast<size_t>(size)) {  // compact now and then, not per frame
+            buffer.erase(buffer.begin(), buffer.begin() + start);
+            start = 0;
+        }
+    }
+
+private:
+    int size;
+    int hop;
+    std::vector<double> buffer;
+    size_t start = 0;
+    uint64_t bufferStamp = 0;  // stream index of buffer[start]
+};
+
+class Window : public DspStage
+{
+public:
+    explicit Window(FFTWindow t) : type(t) {}
+    BlockKind input() const override { return BlockKind::Samples; }
+    BlockKind output() const override { return BlockKind::Samples; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        if (type == FFTWindow::Rectangular) {
+            out.push_back(in);  // blocks are immutable, pass the same one on
+            return;
+        }
+        if (static_cast<int>(window.size()) != in->count)
+            window = makeWindow(type, in->count);
+
+        BlockRef b = derive(pool, *in, BlockKind::Samples, in->count, sizeof(double));
+        for (int i = 0; i < in->count; ++i)
+            b->values()[i] = in->values()[i] * window[i];
+        out.push_back(std::move(b));
+    }
+
+private:
+    FFTWindow type;
+    std::vector<double> window;
+};
+
+// Real FFT of each frame, planned for the frame length it sees
+class Fft : public DspStage
+{
+public:
+    ~Fft() override { destroyPlan(); }
+    BlockKind input() const override { return BlockKind::Samples; }
+    BlockKind output() const override { return BlockKind::Complex; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        const int n = in->count;
+        if (n < 2)
+            return;
+        if (n != planned)
+            makePlan(n);
+
+        BlockRef b = derive(pool, *in, BlockKind::Complex, n / 2 + 1, sizeof(fftw_complex));
+        b->frameSize = n;
+        fftw_execute_dft_r2c(plan, const_cast<double*>(in->values()), reinterpret_cast<fftw_complex*>(b->values()));
+        out.push_back(std::move(b));
+    }
+
+private:
+    void makePlan(int n)
+    {
+        destroyPlan();
+        // Planned on aligned scratch like the pool's blocks; input kept intact for other branches
+        double *in = static_cast<double*>(fftw_malloc(sizeof(double) * n));
+        fftw_complex *out = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * (n / 2 + 1)));
+        pthread_mutex_lock(&ZoomFFT::plannerMutex());
+        plan = fftw_plan_dft_r2c_1d(n, in, out, FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+        pthread_mutex_unlock(&ZoomFFT::plannerMutex());
+        fftw_free(in);
+        fftw_free(out);
+        planned = n;
+    }
+
+    void destroyPlan()
+    {
+        if (!plan)
+            return;
+        pthread_mutex_lock(&ZoomFFT::plannerMutex());
+        fftw_destroy_plan(plan);
+        pthread_mutex_unlock(&ZoomFFT::plannerMutex());
+        plan = nullptr;
+    }
+
+    fftw_plan plan = nullptr;
+    int planned = 0;
+};
+
+class Magnitude : public DspStage
+{
+public:
+    BlockKind input() const override { return BlockKind::Complex; }
+    BlockKind output() const override { return BlockKind::Spectrum; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        BlockRef b = derive(pool, *in, BlockKind::Spectrum, in->count, sizeof(double));
+        const double *c = in->values();
+        for (int i = 0; i < in->count; ++i)
+            b->values()[i] = std::sqrt(c[2 * i] * c[2 * i] + c[2 * i + 1] * c[2 * i + 1]);
+        out.push_back(std::move(b));
+    }
+};
+
+class Decibels : public DspStage
+{
+public:
+    BlockKind input() const override { return BlockKind::Spectrum; }
+    BlockKind output() const override { return BlockKind::Spectrum; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        BlockRef b = derive(pool, *in, BlockKind::Spectrum, in->count, sizeof(double));
+        for (int i = 0; i < in->count; ++i)
+            b->values()[i] = 20.0 * std::log10(std::max(in->values()[i], AppConfig::epsilon));
+        out.push_back(std::move(b));
+    }
+};
+
+// Hold / average traces through SpectrumAccumulator, one output per input frame (Welch: per block)
+class Accumulate : public DspStage
+{
+public:
+    explicit Accumulate(SpectrumTrace t) : trace(t) {}
+    BlockKind input() const override { return BlockKind::Complex; }
+    BlockKind output() const override { return BlockKind::Spectrum; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        if (!acc || bins != in->count) {
+            acc = std::make_unique<SpectrumAccumulator>(in->count);
+            bins = in->count;
+        }
+        acc->accumulate(in->values());
+
+        BlockRef b = derive(pool, *in, BlockKind::Spectrum, bins, sizeof(double));
+        if (acc->read(trace, b->values(), bins))
+            out.push_back(std::move(b));
+    }
+
+private:
+    SpectrumTrace trace;
+    std::unique_ptr<SpectrumAccumulator> acc;
+    int bins = 0;
+};
+
+// Strongest local maxima of a spectrum (DC bin excluded), strongest first
+class Peaks : public DspStage
+{
+public:
+    explicit Peaks(int n) : maxPeaks(n) {}
+    BlockKind input() const override { return BlockKind::Spectrum; }
+    BlockKind output() const override { return BlockKind::Peaks; }
+
+    void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) override
+    {
+        const double *v = in->values();
+        candidates.clear();
+        for (int i = 1; i + 1 < in->count; ++i)
+            if (v[i] > v[i - 1] && v[i] >= v[i + 1])
+                candidates.push_back(i);
+
+        const int n = std::min<int>(maxPeaks, static_cast<int>(candidates.size()));
+        std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(),
+                          [v](int a, int b) { return v[a] > v[b]; });
+
+        BlockRef b = derive(pool, *in, BlockKind::Peaks, n, 2 * sizeof(double));
+        const double binHz = in->frameSize > 0 ? in->sampleRate / in->frameSize : 1.0;
+        for (int k = 0; k < n; ++k) {
+            b->values()[2 * k] = candidates[k] * binHz;
+            b->values()[2 * k + 1] = v[candidates[k]];
+        }
+        out.push_back(std::move(b));
+    }
+
+private:
+    int maxPeaks;
+    std::vector<int> candidates;
+};
+
+std::string trim(const std::string &s)
+{
+    const size_t a = s.find_first_not_of(" \t");
+    const size_t b = s.find_last_not_of(" \t");
+    return a == std::string::npos ? std::string() : s.substr(a, b - a + 1);
+}
+
+bool to_number(const std::string &s, double *value)
+{
+    char *end = nullptr;
+    *value = std::strtod(s.c_str(), &end);
+    return !s.empty() && end && *end == '\0';
+}
+
+} // namespace
+
+std::unique_ptr<DspStage> DspStage::create(const std::string &spec, std::string *error)
+{
+    auto fail = [&](const std::string &why) -> std::unique_ptr<DspStage> {
+        if (error)
+            *error = "'" + spec + "': " + why;
+        return nullptr;
+    };
+
+    const std::string text = trim(spec);
+    const size_t open = text.find('(');
+    const std::string kind = trim(text.substr(0, open));
+    std::vector<std::string> args;
+    if (open != std::string::npos) {
+        const size_t close = text.rfind(')');
+        if (close == std::string::npos || close < open)
+            return fail("missing ')'");
+        std::string list = text.substr(open + 1, close - open - 1);
+        while (!trim(list).empty()) {
+            const size_t comma = list.find(',');
+            args.push_back(trim(list.substr(0, comma)));
+            if (comma == std::string::npos)
+                break;
+            list = list.substr(comma + 1);
+        }
+    }
+
+    // Numeric argument i, or `fallback` when it was left out
+    double number = 0.0;
+    auto arg = [&](size_t i, double fallback, bool *ok) {
+        if (i >= args.size())
+            return fallback;
+        if (!to_number(args[i], &number))
+            *ok = false;
+        return number;
+    };
+
+    bool ok = true;
+    std::unique_ptr<DspStage> stage;
+    if (kind == "samples") {
+        stage = std::make_unique<ToSamples>();
+    } else if (kind == "dc") {
+        stage = std::make_unique<DcRemove>(arg(0, 1e-4, &ok));
+    } else if (kind == "lowpass") {
+        const double cutoff = arg(0, 0.0, &ok);
+        if (cutoff <= 0.0)
+            return fail("lowpass(cutoffHz [, taps]) needs a cutoff");
+        stage = std::make_unique<Lowpass>(cutoff, std::clamp(static_cast<int>(arg(1, 63, &ok)), 3, 1023));
+    } else if (kind == "decimate" || kind == "downsample") {
+        const int factor = static_cast<int>(arg(0, 0, &ok));
+        if (factor < 1)
+            return fail("needs an integer factor >= 1");
+        if (kind == "decimate")
+            stage = std::make_unique<Decimate>(factor);
+        else
+            stage = std::make_unique<Downsample>(factor);
+    } else if (kind == "frame") {
+        const int size = static_cast<int>(arg(0, 0, &ok));
+        const double overlap = arg(1, 0.0, &ok);
+        if (size < 2 || overlap < 0.0 || overlap >= 1.0)
+            return fail("frame(size [, overlap 0..1))");
+        stage = std::make_unique<Frame>(size, overlap);
+    } else if (kind == "window") {
+        const std::string type = args.empty() ? "hann" : args[0];
+        if (type == "hann")                stage = std::make_unique<Window>(FFTWindow::Hann);
+        else if (type == "blackmanharris") stage = std::make_unique<Window>(FFTWindow::BlackmanHarris);
+        else if (type == "flattop")        stage = std::make_unique<Window>(FFTWindow::FlatTop);
+        else if (type == "rect")           stage = std::make_unique<Window>(FFTWindow::Rectangular);
+        else return fail("window type is hann, blackmanharris, flattop or rect");
+    } else if (kind == "fft") {
+        stage = std::make_unique<Fft>();
+    } else if (kind == "magnitude") {
+        stage = std::make_unique<Magnitude>();
+    } else if (kind == "db") {
+        stage = std::make_unique<Decibels>();
+    } else if (kind == "maxhold" || kind == "minhold" || kind == "average" || kind == "ema" || kind == "welch") {
+        const SpectrumTrace trace = kind == "maxhold" ? SpectrumTrace::MaxHold
+                                  : kind == "minhold" ? SpectrumTrace::MinHold
+                                  : kind == "average" ? SpectrumTrace::LinearAverage
+                                  : kind == "ema"     ? SpectrumTrace::ExponentialAverage
+                                                      : SpectrumTrace::Welch;
+        stage = std::make_unique<Accumulate>(trace);
+    } else if (kind == "peaks") {
+        stage = std::make_unique<Peaks>(std::max(1, static_cast<int>(arg(0, 8, &ok))));
+    } else {
+        return fail("unknown stage");
+    }
+
+    if (!ok)
+        return fail("arguments must be numbers");
+    stage->label = text;
+    return stage;
+}
@@ -0,0 +1,134 @@
+// DspStage.h
+#ifndef DSPSTAGE_H
+#define DSPSTAGE_H
+
+#include "AppConfig.h"
+
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What a block carries; stages declare the kind they take and the kind they emit
+enum class BlockKind {
+    Raw,       // uint16 ADC codes straight from the device
+    Samples,   // real samples (ADC code scale unless a stage says otherwise)
+    Complex,   // FFT output, interleaved re/im, count = bins
+    Spectrum,  // one real value per bin
+    Peaks,     // interleaved { frequency Hz, value }, count = peaks
+};
+
+const char *blockKindName(BlockKind kind);
+
+class BlockPool;
+
+/*!
+ * Pooled, reference-counted buffer passed between stages. A block is
+ * immutable once emitted, so any number of downstream branches can hold
+ * it at once; the last BlockRef to let go returns it to its pool.
+ */
+struct DspBlock {
+    BlockKind kind = BlockKind::Samples;
+    int count = 0;            // samples, bins or peaks
+    uint64_t stamp = 0;       // absolute index of the first sample at sampleRate (frames: first sample of the frame)
+    double sampleRate = 0.0;  // rate of the samples the data came from
+    int frameSize = 0;        // FFT length behind Complex / Spectrum / Peaks blocks
+
+    double *values() { return static_cast<double*>(storage); }
+    const double *values() const { return static_cast<const double*>(storage); }
+    uint16_t *raw() { return static_cast<uint16_t*>(storage); }
+    const uint16_t *raw() const { return static_cast<const uint16_t*>(storage); }
+    int valueCount() const;  // doubles in values(), raw blocks excluded
+
+private:
+    friend class BlockPool;
+    friend class BlockRef;
+
+    void *storage = nullptr;  // fftw_malloc'd, SIMD aligned for new-array FFTW execute
+    size_t capacity = 0;      // bytes
+    int sizeClass = 0;
+    std::atomic<int> refs{0};
+    BlockPool *pool = nullptr;
+};
+
+class BlockRef
+{
+public:
+    BlockRef() = default;
+    explicit BlockRef(DspBlock *block);
+    BlockRef(const BlockRef &other);
+    BlockRef(BlockRef &&other) noexcept;
+    BlockRef &operator=(BlockRef other) noexcept;
+    ~BlockRef();
+
+    DspBlock *operator->() const { return block; }
+    DspBlock &operator*() const { return *block; }
+    DspBlock *get() const { return block; }
+    explicit operator bool() const { return block != nullptr; }
+
+private:
+    DspBlock *block = nullptr;
+};
+
+/*!
+ * Free lists per power-of-two size class. After the first few blocks of a
+ * stream every acquire is a pop from a short, rarely contended list, so
+ * the USB callback can take raw blocks from it.
+ */
+class BlockPool
+{
+public:
+    BlockPool() = default;
+    ~BlockPool();  // every block must be back
+    BlockPool(const BlockPool &) = delete;
+    BlockPool &operator=(const BlockPool &) = delete;
+
+    BlockRef acquire(BlockKind kind, size_t bytes);
+    size_t bytesAllocated() const { return allocated.load(std::memory_order_relaxed); }
+
+private:
+    friend class BlockRef;
+    void release(DspBlock *block);
+
+    static constexpr int kMinShift = 8;  // 256 bytes
+    static constexpr int kClasses = 24;  // up to 2 GB
+
+    struct SizeClass {
+        pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        std::vector<DspBlock*> free;
+    };
+    SizeClass classes[kClasses];
+    std::atomic<size_t> allocated{0};
+};
+
+/*!
+ * One processing step of a StageGraph branch. process() sees the blocks
+ * of its branch strictly in order and never concurrently, so stages keep
+ * their running state (filter history, partial frames) as plain members.
+ * Parameters the stage needs from the stream (rate, frame size) come from
+ * the blocks, so most stages are sized on their first block.
+ */
+class DspStage
+{
+public:
+    virtual ~DspStage() = default;
+
+    virtual BlockKind input() const = 0;
+    virtual BlockKind output() const = 0;
+    virtual void process(const BlockRef &in, BlockPool &pool, std::vector<BlockRef> &out) = 0;
+
+    const std::string &name() const { return label; }
+
+    // "lowpass(1e6, 63)" -> stage, nullptr and *error on unknown names or bad arguments
+    static std::unique_ptr<DspStage> create(const std::string &spec, std::string *error);
+
+protected:
+    std::string label;
+};
+
+// Window scaled so a bin-centred tone reads the same as with no window, empty = rectangular
+std::vector<double> makeWindow(FFTWindow type, int n);
+
+#endif // DSPSTAGE_H
@@ -0,0 +1,147 @@
+// Epoch.cpp
+#include "Epoch.h"
+
+#include <pthread.h>
+#include <algorithm>
+#include <QDebug>
+
+std::atomic<uint64_t> Epoch::global{1};
+std::atomic<uint64_t> Epoch::announced[Epoch::kMaxThreads];
+std::atomic<int> Epoch::slotsUsed{0};
+std::atomic<Epoch::Retired *> Epoch::incoming{nullptr};
+Epoch::Retired *Epoch::waiting = nullptr;
+
+static pthread_mutex_t collect_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t slot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static thread_local int guard_depth = 0;
+
+// Owns the calling thread's announcement slot, returns it to the free list when the thread exits
+struct Epoch::Slot {
+    int index = -1;
+
+    static int freeSlots[kMaxThreads];  // given back by exited threads, under slot_mutex
+    static int freeCount;
+
+    ~Slot()
+    {
+        if (index < 0)
+            return;
+        announced[index].store(0, std::memory_order_release);
+        pthread_mutex_lock(&slot_mutex);
+        freeSlots[freeCount++] = index;
+        pthread_mutex_unlock(&slot_mutex);
+    }
+};
+
+int Epoch::Slot::freeSlots[Epoch::kMaxThreads];
+int Epoch::Slot::freeCount = 0;
+
+int Epoch::slot()
+{
+    static thread_local Slot mine;
+    if (mine.index < 0) {
+        pthread_mutex_lock(&slot_mutex);
+        if (Slot::freeCount > 0)
+            mine.index = Slot::freeSlots[--Slot::freeCount];
+        else if (slotsUsed.load() < kMaxThreads)
+            mine.index = slotsUsed.fetch_add(1);
+        pthread_mutex_unlock(&slot_mutex);
+
+        // Sharing a slot would let one thread's ~Guard clear another's announcement
+        if (mine.index < 0)
+            qFatal("[Epoch] More than %d live threads use guards", kMaxThreads);
+    }
+    return mine.index;
+}
+
+Epoch::Guard::Guard()
+{
+    if (guard_depth++ > 0)
+        return;  // nested: the outer guard already pins an older epoch
+
+    // seq_cst store then re-read: the announcement must be visible before any pointer load
+    std::atomic<uint64_t> &mine = announced[slot()];
+    uint64_t e = global.load();
+    mine.store(e);
+    while (global.load() != e) {
+        e = global.load();
+        mine.store(e);
+    }
+}
+
+Epoch::Guard::~Guard()
+{
+    if (--guard_depth > 0)
+        return;
+    announced[slot()].store(0, std::memory_order_release);
+}
+
+void Epoch::retire(std::function<void()> release, std::function<bool()> drained)
+{
+    // Readers that announced an epoch <= this one may still hold the object
+    Retired *node = new Retired{global.fetch_add(1), std::move(release), std::move(drained), nullptr};
+    node->next = incoming.load(std::memory_order_relaxed);
+    while (!incoming.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+bool Epoch::safe(uint64_t epoch)
+{
+    const int used = std::min(slotsUsed.load(), kMaxThreads);
+    for (int i = 0; i < used; ++i) {
+        const uint64_t a = announced[i].load();
+        if (a != 0 && a <= epoch)
+            return false;
+    }
+    return true;
+}
+
+int Epoch::collect()
+{
+    pthread_mutex_lock(&collect_mutex);
+
+    // Move new retirements onto the waiting list
+    Retired *fresh = incoming.exchange(nullptr, std::memory_order_acquire);
+    while (fresh) {
+        Retired *next = fresh->next;
+        fresh->next = waiting;
+        waiting = fresh;
+        fresh = next;
+    }
+
+    int remaining = 0;
+    Retired **link = &waiting;
+    while (*link) {
+        Retired *node = *link;
+        if (safe(node->epoch) && (!node->drained || node->drained())) {
+            *link = node->next;
+            node->release();
+            delete node;
+        } else {
+            link = &node->next;
+            ++remaining;
+        }
+    }
+
+    pthread_mutex_unlock(&collect_mutex);
+    return remaining;
+}
+
+void Epoch::reclaimAll()
+{
+    pthread_mutex_lock(&collect_mutex);
+    Retired *fresh = incoming.exchange(nullptr);
+    while (fresh) {
+        Retired *next = fresh->next;
+        fresh->next = waiting;
+        waiting = fresh;
+        fresh = next;
+    }
+    while (waiting) {
+        Retired *node = waiting;
+        waiting = node->next;
+        node->release();
+        delete node;
+    }
+    pthread_mutex_unlock(&collect_mutex);
+}
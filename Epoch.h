@@ -0,0 +1,60 @@
+// Epoch.h
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+/*!
+ * Epoch-based reclamation for objects that are swapped out from under
+ * lock-free readers (pipeline configs, plans, frame buffers).
+ *
+ * A reader wraps every access in an Epoch::Guard, which announces the
+ * global epoch it entered in. The writer unpublishes the object first and
+ * then retire()s it; retire bumps the epoch, so the object is freed by
+ * collect() once no thread is still inside an epoch that could have seen
+ * it and its own drained() check (e.g. in-flight frames == 0) passes.
+ * retire() allocates its list node (and the std::functions may too), so
+ * the USB callback never calls it: it queues what it swaps out to a DSP
+ * worker, which retires it.
+ */
+class Epoch
+{
+public:
+    class Guard
+    {
+    public:
+        Guard();
+        ~Guard();
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+
+    static void retire(std::function<void()> release, std::function<bool()> drained = nullptr);
+    static int  collect();     // frees what is safe, returns how many retired objects remain
+    static void reclaimAll();  // shutdown only: every reader and worker must already be stopped
+
+private:
+    struct Retired {
+        uint64_t epoch;
+        std::function<void()> release;
+        std::function<bool()> drained;
+        Retired *next;
+    };
+
+    // Threads inside a guard at the same time; a thread's slot is given back when it exits
+    static constexpr int kMaxThreads = 1024;
+
+    struct Slot;
+    static int  slot();
+    static bool safe(uint64_t epoch);
+
+    static std::atomic<uint64_t> global;
+    static std::atomic<uint64_t> announced[kMaxThreads];  // 0 = outside any guard
+    static std::atomic<int> slotsUsed;                     // high-water mark, what safe() scans
+    static std::atomic<Retired *> incoming;                // lock-free push from retire()
+    static Retired *waiting;                               // collector side only
+};
+
+#endif // EPOCH_H
@@ -0,0 +1,304 @@
+// EventDetector.cpp
+#include "EventDetector.h"
+#include "EventLog.h"
+#include "SampleTimeline.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr int kFloorSamples = 1024;  // bins the noise floor median is taken over
+
+inline double power(const fftw_complex *x, int k)
+{
+    return x[k][0] * x[k][0] + x[k][1] * x[k][1];
+}
+
+// Peak position between bins from the log powers around it (a Gaussian through three points)
+double interpolate(double left, double peak, double right)
+{
+    if (left <= 0.0 || right <= 0.0)
+        return 0.0;
+    const double a = std::log(left), b = std::log(peak), c = std::log(right);
+    const double curvature = a - 2.0 * b + c;
+    return curvature < 0.0 ? std::clamp(0.5 * (a - c) / curvature, -0.5, 0.5) : 0.0;
+}
+}
+
+EventDetector::EventDetector(int fftSize, double sampleRate, uint64_t frameSpan, int chainIndex, int workers, EventLog *eventLog)
+    : n(fftSize), half(fftSize / 2 + 1), rate(sampleRate), span(frameSpan), chain(chainIndex), log(eventLog),
+      scratch(workers), parked(kReorder)
+{
+    levels = prepare(EventSettings());
+
+    // Sized once here: the swaps in process() only pass these capacities around
+    for (Scratch &s : scratch) {
+        s.runs.reserve(kMaxRuns);
+        s.floorSample.reserve(2 * kFloorSamples);  // the stride rounds down, up to twice the samples
+    }
+    for (Frame &frame : parked)
+        frame.runs.reserve(kMaxRuns);
+    open.reserve(kMaxOpen);
+}
+
+EventDetector::~EventDetector()
+{
+    pthread_mutex_lock(&levelsMutex);
+    const std::shared_ptr<const Levels> current = levels;
+    pthread_mutex_unlock(&levelsMutex);
+
+    // Whatever is parked behind a frame that never came still counts, in order
+    std::sort(parked.begin(), parked.end(), [](const Frame &a, const Frame &b) { return a.seq < b.seq; });
+    for (Frame &frame : parked)
+        if (frame.seq != UINT64_MAX && frame.seq >= nextSeq)
+            apply(*current, frame);
+
+    for (const Open &event : open)
+        if (event.frames >= current->minFrames)
+            finish(event, EventTruncated);
+}
+
+std::shared_ptr<const EventDetector::Levels> EventDetector::prepare(const EventSettings &settings) const
+{
+    auto l = std::make_shared<Levels>();
+    l->on = std::pow(10.0, settings.onDb / 10.0);
+    l->off = std::pow(10.0, std::min(settings.offDb, settings.onDb) / 10.0);
+    l->relative = settings.relative;
+    l->holdFrames = std::max(0, settings.holdFrames);
+    l->minFrames = std::max(1, settings.minFrames);
+
+    // Padded to whole SSE2 pairs; DC, masked bands and the padding can never cross
+    const double never = std::numeric_limits<double>::infinity();
+    l->offScale.assign((half + 1) & ~1, l->off);
+    std::fill(l->offScale.begin() + half, l->offScale.end(), never);
+    l->offScale[0] = never;
+    for (const auto &band : settings.masksHz) {
+        const int lo = std::max(0, static_cast<int>(std::floor(band.first * n / rate)));
+        const int hi = std::min(half - 1, static_cast<int>(std::ceil(band.second * n / rate)));
+        for (int k = lo; k <= hi; ++k)
+            l->offScale[k] = never;
+    }
+
+    if (l->relative) {
+        std::vector<int> usable;
+        for (int k = 1; k < half; ++k)
+            if (l->offScale[k] != never)
+                usable.push_back(k);
+        const size_t stride = std::max<size_t>(1, usable.size() / kFloorSamples);
+        for (size_t i = 0; i < usable.size(); i += stride)
+            l->floorBins.push_back(usable[i]);
+    }
+    return l;
+}
+
+void EventDetector::configure(const EventSettings &settings)
+{
+    std::shared_ptr<const Levels> next = prepare(settings);
+    pthread_mutex_lock(&levelsMutex);
+    levels = std::move(next);
+    pthread_mutex_unlock(&levelsMutex);
+}
+
+// Runs of bins above the off level, at most kMaxRuns; false if there were more
+bool EventDetector::scan(const fftw_complex *x, const Levels &l, double floor, std::vector<Run> &runs) const
+{
+    runs.clear();
+    const double *scale = l.offScale.data();
+    const double on = l.on * floor;
+    int lo = -1;  // start of the run being followed
+    bool complete = true;
+
+    auto close = [&](int hi) {
+        if (static_cast<int>(runs.size()) >= kMaxRuns) {
+            complete = false;
+            return;
+        }
+        Run r = { lo, hi, lo, 0.0, 0.0, 0.0, false };
+        for (int k = lo; k <= hi; ++k) {
+            const double p = power(x, k);
+            if (p > r.peakPower) {
+                r.peakPower = p;
+                r.peak = k;
+            }
+        }
+        r.left = r.peak > 0 ? power(x, r.peak - 1) : 0.0;
+        r.right = r.peak + 1 < half ? power(x, r.peak + 1) : 0.0;
+        r.armed = r.peakPower > on;
+        runs.push_back(r);
+    };
+    auto visit = [&](int k, bool above) {
+        if (above && lo < 0)
+            lo = k;
+        else if (!above && lo >= 0) {
+            close(k - 1);
+            lo = -1;
+        }
+    };
+
+    const int pairs = static_cast<int>(l.offScale.size());
+#ifdef __SSE2__
+    const __m128d f = _mm_set1_pd(floor);
+    for (int k = 0; k < pairs; k += 2) {
+        // |X|^2 of bins k and k + 1 (the padding bin reads past `half`, its threshold is infinite)
+        const int k1 = k + 1 < half ? k + 1 : k;
+        const __m128d a = _mm_loadu_pd(x[k]);
+        const __m128d b = _mm_loadu_pd(x[k1]);
+        const __m128d a2 = _mm_mul_pd(a, a), b2 = _mm_mul_pd(b, b);
+        const __m128d p = _mm_add_pd(_mm_unpacklo_pd(a2, b2), _mm_unpackhi_pd(a2, b2));
+        const int above = _mm_movemask_pd(_mm_cmpgt_pd(p, _mm_mul_pd(_mm_loadu_pd(scale + k), f)));
+        if (above == 0 && lo < 0)
+            continue;  // the common case: quiet, and no run to close
+        visit(k, above & 1);
+        visit(k + 1, above & 2);
+    }
+#else
+    for (int k = 0; k < pairs; ++k)
+        visit(k, k < half && power(x, k) > scale[k] * floor);
+#endif
+    if (lo >= 0)
+        close(half - 1);
+
+    return complete;
+}
+
+void EventDetector::process(const fftw_complex *spectrum, uint64_t seq, uint64_t stamp, uint8_t frameFlags, int worker)
+{
+    Scratch &s = scratch[worker];
+
+    pthread_mutex_lock(&levelsMutex);
+    const std::shared_ptr<const Levels> l = levels;
+    pthread_mutex_unlock(&levelsMutex);
+
+    // The heavy part, in parallel: reduce the spectrum to its runs
+    bool complete = true;
+    s.runs.clear();
+    if (!(frameFlags & FrameCorrupt)) {  // a frame across a gap is splatter, it only closes events
+        double floor = 1.0;
+        if (l->relative && !l->floorBins.empty()) {
+            s.floorSample.resize(l->floorBins.size());
+            for (size_t i = 0; i < l->floorBins.size(); ++i)
+                s.floorSample[i] = power(spectrum, l->floorBins[i]);
+            auto mid = s.floorSample.begin() + s.floorSample.size() / 2;
+            std::nth_element(s.floorSample.begin(), mid, s.floorSample.end());
+            floor = std::max(*mid, std::numeric_limits<double>::min());
+        }
+        complete = scan(spectrum, *l, floor, s.runs);
+    }
+
+    // The stateful part, in frame order
+    pthread_mutex_lock(&orderMutex);
+    if (!complete && !overflowWarned) {
+        overflowWarned = true;
+        qWarning() << "[EventDetector] Chain" << chain << "frame with more than" << kMaxRuns
+                   << "runs above the off level, check the thresholds";
+    }
+    if (seq < nextSeq) {  // given up on, later frames were applied already
+        pthread_mutex_unlock(&orderMutex);
+        return;
+    }
+    while (seq >= nextSeq + kReorder) {  // an earlier frame never arrived (a stopping pool): go on without it
+        Frame &frame = parked[nextSeq % kReorder];
+        if (frame.seq == nextSeq) {
+            apply(*l, frame);
+            frame.seq = UINT64_MAX;
+        }
+        ++nextSeq;
+    }
+
+    Frame &slot = parked[seq % kReorder];
+    slot.seq = seq;
+    slot.stamp = stamp;
+    slot.flags = frameFlags;
+    std::swap(slot.runs, s.runs);  // capacities circulate, nothing allocates once warm
+
+    for (Frame *frame = &parked[nextSeq % kReorder]; frame->seq == nextSeq; frame = &parked[nextSeq % kReorder]) {
+        apply(*l, *frame);
+        frame->seq = UINT64_MAX;
+        ++nextSeq;
+    }
+    pthread_mutex_unlock(&orderMutex);
+}
+
+// Advance the open events by one frame; orderMutex held
+void EventDetector::apply(const Levels &l, Frame &frame)
+{
+    if (frame.flags & FrameCorrupt) {
+        for (const Open &event : open)
+            if (event.frames >= l.minFrames)
+                finish(event, EventTruncated);
+        open.clear();
+        return;
+    }
+
+    const uint64_t frameStart = frame.stamp - std::min(span, frame.stamp);
+    for (Open &event : open) {
+        event.seen = false;
+        if (frame.flags & FrameAfterDrop)
+            event.flags |= EventAfterDrop;
+    }
+
+    for (const Run &run : frame.runs) {
+        Open *match = nullptr;
+        for (Open &event : open) {
+            if (run.hi >= event.lo - 1 && run.lo <= event.hi + 1) {
+                match = &event;
+                break;
+            }
+        }
+
+        const double bin = run.peak + interpolate(run.left, run.peakPower, run.right);
+        const int width = run.hi - run.lo + 1;
+        if (match) {
+            if (!match->seen) {  // follow a drifting event, merge the runs it splits into
+                match->lo = run.lo;
+                match->hi = run.hi;
+                match->frames++;
+                match->misses = 0;
+                match->last = frame.stamp;
+                match->seen = true;
+            } else {
+                match->lo = std::min(match->lo, run.lo);
+                match->hi = std::max(match->hi, run.hi);
+            }
+            match->width = std::max(match->width, width);
+            if (run.peakPower > match->peakPower) {
+                match->peakPower = run.peakPower;
+                match->peakBin = bin;
+            }
+        } else if (run.armed && static_cast<int>(open.size()) < kMaxOpen) {
+            open.push_back({ frameStart, frame.stamp, run.lo, run.hi, 1, 0, run.peakPower, bin, width, 0, true });
+        }
+    }
+
+    for (size_t i = 0; i < open.size(); ) {
+        Open &event = open[i];
+        if (event.seen || ++event.misses <= l.holdFrames) {
+            ++i;
+            continue;
+        }
+        if (event.frames >= l.minFrames)
+            finish(event, 0);
+        event = open.back();
+        open.pop_back();
+    }
+}
+
+void EventDetector::finish(const Open &event, uint8_t extraFlags)
+{
+    EventRecord r;
+    r.start = event.start;
+    r.duration = event.last - event.start;
+    r.frequencyHz = event.peakBin * rate / n;
+    r.peakDb = static_cast<float>(10.0 * std::log10(event.peakPower));
+    r.widthBins = static_cast<uint16_t>(std::min(event.width, 0xFFFF));
+    r.chain = static_cast<uint8_t>(chain);
+    r.flags = event.flags | extraFlags;
+    log->append(r);
+}
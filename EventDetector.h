@@ -0,0 +1,122 @@
+// EventDetector.h
+#ifndef EVENTDETECTOR_H
+#define EVENTDETECTOR_H
+
+#include <fftw3.h>
+#include <pthread.h>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "AppConfig.h"
+
+class EventLog;
+
+// Levels are dB of |X| (20 log10), relative to the frame's noise floor unless `relative` is off
+struct EventSettings {
+    double onDb = AppConfig::eventOnDb;
+    double offDb = AppConfig::eventOffDb;
+    bool relative = AppConfig::eventRelativeToFloor;
+    int holdFrames = AppConfig::eventHoldFrames;
+    int minFrames = AppConfig::eventMinFrames;
+    std::vector<std::pair<double, double>> masksHz = AppConfig::eventMasksHz;
+};
+
+/*!
+ * Spectral event detector of one analysis chain, run on every frame. The
+ * workers reduce each spectrum to runs of adjacent bins above the off
+ * level (masked bins and DC never count); a run with a bin above the on
+ * level opens an event, runs above the off level that overlap it keep it
+ * open, and it ends holdFrames frames after the last one. Finished events
+ * go to the EventLog.
+ *
+ * The scan compares |X|^2 against per-bin thresholds (two bins per SSE2
+ * compare, masks folded in as infinity), so a quiet frame costs one pass
+ * and no logs. In relative mode the floor is the median power of a
+ * strided subset of the bins.
+ *
+ * Frames finish out of order on the pool; the runs are parked by history
+ * sequence number and the open events are advanced strictly in order by
+ * whichever worker completes the next one, under the detector's mutex.
+ * Time resolution is the chain's hop: an event lies within [start,
+ * start + duration).
+ */
+class EventDetector
+{
+public:
+    static constexpr int kMaxRuns = 256;    // per frame, the rest are ignored
+    static constexpr int kMaxOpen = 64;     // concurrent events per chain
+    static constexpr int kReorder = 64;     // frames parked while an earlier one is still in flight
+
+    // frameSpan: ADC samples one frame covers (fftSize * decimation)
+    EventDetector(int fftSize, double sampleRate, uint64_t frameSpan, int chain, int workers, EventLog *log);
+    ~EventDetector();  // parked frames are applied, open events logged as truncated
+
+    void configure(const EventSettings &settings);  // any thread, the next frame scanned uses it
+
+    // Pool worker: every frame of the chain, seq is its history sequence, stamp its SampleTimeline end
+    void process(const fftw_complex *spectrum, uint64_t seq, uint64_t stamp, uint8_t frameFlags, int worker);
+
+private:
+    struct Levels {
+        double on = 0.0, off = 0.0;  // power, or power over the floor when relative
+        bool relative = true;
+        int holdFrames = 1, minFrames = 1;
+        std::vector<double> offScale;  // off per bin, infinity where masked
+        std::vector<int> floorBins;    // bins sampled for the noise floor
+    };
+
+    struct Run {
+        int lo, hi;        // bins, inclusive
+        int peak;
+        double peakPower;
+        double left, right;  // powers beside the peak, for interpolation
+        bool armed;        // reached the on level
+    };
+
+    struct Frame {
+        uint64_t seq = UINT64_MAX;  // UINT64_MAX = slot empty
+        uint64_t stamp = 0;
+        uint8_t flags = 0;
+        std::vector<Run> runs;
+    };
+
+    struct Open {
+        uint64_t start, last;  // first sample of the first frame, end of the last one above the off level
+        int lo, hi;            // bins of the latest run
+        int frames, misses;
+        double peakPower, peakBin;
+        int width;
+        uint8_t flags;
+        bool seen;             // matched in the frame being applied
+    };
+
+    struct Scratch {
+        std::vector<Run> runs;
+        std::vector<double> floorSample;
+    };
+
+    std::shared_ptr<const Levels> prepare(const EventSettings &settings) const;
+    bool scan(const fftw_complex *spectrum, const Levels &levels, double floor, std::vector<Run> &runs) const;
+    void apply(const Levels &levels, Frame &frame);
+    void finish(const Open &event, uint8_t extraFlags);
+
+    const int n;
+    const int half;
+    const double rate;
+    const uint64_t span;
+    const int chain;
+    EventLog *log;
+    std::vector<Scratch> scratch;  // one per worker
+
+    pthread_mutex_t levelsMutex = PTHREAD_MUTEX_INITIALIZER;
+    std::shared_ptr<const Levels> levels;
+
+    pthread_mutex_t orderMutex = PTHREAD_MUTEX_INITIALIZER;  // everything below
+    std::vector<Frame> parked;  // kReorder, by seq % kReorder
+    uint64_t nextSeq = 0;
+    std::vector<Open> open;
+    bool overflowWarned = false;
+};
+
+#endif // EVENTDETECTOR_H
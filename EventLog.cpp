@@ -0,0 +1,162 @@
+// EventLog.cpp
+#include "EventLog.h"
+#include "AppConfig.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+EventLog::EventLog()
+    : slots(new Slot[kCapacity])
+{
+    batch.reserve(kCapacity);
+}
+
+EventLog::~EventLog()
+{
+    stopSpill();
+}
+
+void EventLog::append(const EventRecord &event)
+{
+    const uint64_t index = reserved.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = slots[index % kCapacity];
+
+    // seqlock keyed by the index, so a reader can also tell a slot that was reused
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event = event;
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+}
+
+EventLog::Read EventLog::read(uint64_t index, EventRecord &out) const
+{
+    const Slot &slot = slots[index % kCapacity];
+    const uint64_t complete = 2 * index + 2;
+    const uint64_t before = slot.seq.load(std::memory_order_acquire);
+    if (before < complete)
+        return Read::Pending;  // still being written, or not even started
+    if (before > complete)
+        return Read::Overwritten;
+
+    out = slot.event;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == before ? Read::Ok : Read::Overwritten;
+}
+
+bool EventLog::startSpill(const std::string &fileName)
+{
+    if (spillActive.load())
+        return false;
+
+    file = std::fopen(fileName.c_str(), "wb");
+    if (!file) {
+        qWarning() << "[EventLog] Failed to open file:" << fileName.c_str();
+        return false;
+    }
+
+    EventFileHeader header = {};
+    std::memcpy(header.magic, "UCEVT01", 8);
+    header.headerBytes = sizeof(EventFileHeader);
+    header.recordBytes = sizeof(EventRecord);
+    header.adcSampleRate = AppConfig::adcSampleRate;
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    spillCursor = reserved.load(std::memory_order_acquire);  // the file starts now
+    closing = false;
+    pthread_create(&spiller, nullptr, &EventLog::spillMain, this);
+    spillActive.store(true);
+
+    qDebug() << "[EventLog] Spilling events to" << fileName.c_str();
+    return true;
+}
+
+void EventLog::stopSpill()
+{
+    if (!spillActive.load())
+        return;
+
+    pthread_mutex_lock(&spillMutex);
+    closing = true;
+    pthread_cond_signal(&spillCond);
+    pthread_mutex_unlock(&spillMutex);
+
+    pthread_join(spiller, nullptr);  // its last pass writes whatever is complete
+    std::fclose(file);
+    file = nullptr;
+    spillActive.store(false);
+
+    qDebug() << "[EventLog] Stopped:" << total() << "events," << lost() << "lost";
+}
+
+void* EventLog::spillMain(void *arg)
+{
+    static_cast<EventLog*>(arg)->spillLoop();
+    return nullptr;
+}
+
+void EventLog::spillLoop()
+{
+    pthread_mutex_lock(&spillMutex);
+    while (!closing) {
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += kSpillMs * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&spillCond, &spillMutex, &deadline);
+
+        pthread_mutex_unlock(&spillMutex);
+        drain();
+        pthread_mutex_lock(&spillMutex);
+    }
+    pthread_mutex_unlock(&spillMutex);
+    drain();
+}
+
+// Spill thread: everything complete since the last pass, in index order, one write
+void EventLog::drain()
+{
+    const uint64_t end = reserved.load(std::memory_order_acquire);
+    batch.clear();
+
+    while (spillCursor < end) {
+        if (end - spillCursor > static_cast<uint64_t>(kCapacity)) {  // a whole ring behind
+            lostEvents.fetch_add(end - kCapacity - spillCursor, std::memory_order_relaxed);
+            spillCursor = end - kCapacity;
+        }
+
+        EventRecord event;
+        const Read r = read(spillCursor, event);
+        if (r == Read::Pending)
+            break;  // a worker is mid-append, the file stays in order: next pass
+        if (r == Read::Ok)
+            batch.push_back(event);
+        else
+            lostEvents.fetch_add(1, std::memory_order_relaxed);
+        ++spillCursor;
+    }
+
+    if (!batch.empty()) {
+        std::fwrite(batch.data(), sizeof(EventRecord), batch.size(), file);
+        std::fflush(file);
+    }
+}
+
+int EventLog::recent(std::vector<EventRecord> &out, int count) const
+{
+    const uint64_t end = reserved.load(std::memory_order_acquire);
+    const uint64_t n = std::min<uint64_t>({end, static_cast<uint64_t>(std::max(count, 0)), static_cast<uint64_t>(kCapacity)});
+
+    out.clear();
+    for (uint64_t i = end - n; i < end; ++i) {
+        EventRecord event;
+        if (read(i, event) == Read::Ok)
+            out.push_back(event);
+    }
+    return static_cast<int>(out.size());
+}
@@ -0,0 +1,93 @@
+// EventLog.h
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum EventFlags : uint8_t {
+    EventTruncated = 1,  // ended by a stream gap, a corrupt frame or a pipeline swap, not by fading out
+    EventAfterDrop = 2,  // frames of the chain were dropped while it was open
+};
+
+// One spectral event, also the on-disk record of the .uce file (little-endian)
+struct EventRecord {
+    uint64_t start;       // SampleTimeline index of the first sample of the first frame above the on level
+    uint64_t duration;    // ADC samples from there to the end of the last frame above the off level
+    double frequencyHz;   // strongest bin over the event, parabolically interpolated
+    float peakDb;         // 20 log10 |X| there, absolute (same scale as the stream server)
+    uint16_t widthBins;   // widest run of bins above the off level
+    uint8_t chain;        // analysis chain index
+    uint8_t flags;        // EventFlags
+};
+static_assert(sizeof(EventRecord) == 32, "EventRecord is the file layout");
+
+// .uce event file: one EventFileHeader, then EventRecords in the order they ended
+struct EventFileHeader {
+    char magic[8];          // "UCEVT01"
+    uint32_t headerBytes;   // sizeof(EventFileHeader)
+    uint32_t recordBytes;   // sizeof(EventRecord)
+    double adcSampleRate;   // start and duration count samples at this rate
+};
+
+/*!
+ * Lock-free in-memory log of detected events. Any DSP worker appends with
+ * one fetch_add and a per-slot sequence (seqlock), never waiting on anyone;
+ * the newest kCapacity events stay readable. A spill thread drains the ring
+ * to a .uce file every kSpillMs; if it falls a whole ring behind, the
+ * overwritten events are counted as lost rather than stalling the workers.
+ */
+class EventLog
+{
+public:
+    static constexpr int kCapacity = 1 << 16;  // 2.5 MB
+    static constexpr int kSpillMs = 20;
+
+    EventLog();
+    ~EventLog();
+
+    void append(const EventRecord &event);  // any thread
+
+    bool startSpill(const std::string &fileName);  // GUI thread
+    void stopSpill();                              // writes everything appended so far
+    bool spilling() const { return spillActive.load(std::memory_order_relaxed); }
+
+    // Newest `count` events still in the ring, oldest first
+    int recent(std::vector<EventRecord> &out, int count) const;
+    uint64_t total() const { return reserved.load(std::memory_order_relaxed); }
+    uint64_t lost() const { return lostEvents.load(std::memory_order_relaxed); }  // never reached the file
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq{0};  // 2 * index + 1 while written, 2 * index + 2 once complete
+        EventRecord event;
+    };
+
+    enum class Read { Ok, Pending, Overwritten };
+    Read read(uint64_t index, EventRecord &out) const;
+
+    static void* spillMain(void *arg);
+    void spillLoop();
+    void drain();
+
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> reserved{0};  // events ever appended (or being appended)
+    std::atomic<uint64_t> lostEvents{0};
+
+    // spill side
+    std::FILE *file = nullptr;
+    pthread_t spiller;
+    pthread_mutex_t spillMutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t spillCond = PTHREAD_COND_INITIALIZER;
+    bool closing = false;
+    std::atomic<bool> spillActive{false};
+    uint64_t spillCursor = 0;  // next index to write
+    std::vector<EventRecord> batch;
+};
+
+#endif // EVENTLOG_H
@@ -0,0 +1,412 @@
+// ExportEngine.cpp
+#include "ExportEngine.h"
+#include "AppConfig.h"
+#include "AdcCalibration.h"
+#include "SpectrumHistory.h"
+#include "TimeDProcess.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <QtEndian>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <new>
+
+namespace {
+constexpr size_t kBufferBytes = 4 << 20;  // one write per 4 MB of output
+constexpr size_t kRowBytes = 64;          // worst case for one formatted row or field
+constexpr size_t kRawChunk = 1 << 19;     // values per endian-converted block
+
+// Formatted output accumulated in one big buffer and flushed whole
+class RowWriter {
+public:
+    explicit RowWriter(QFile &f) : file(f), buffer(kBufferBytes), pos(0) {}
+
+    bool reserveRow() { return kBufferBytes - pos >= kRowBytes || flush(); }
+
+    void fixed(double v, int decimals)
+    {
+        pos = std::to_chars(buffer.data() + pos, buffer.data() + kBufferBytes, v,
+                            std::chars_format::fixed, decimals).ptr - buffer.data();
+    }
+    void general(double v)
+    {
+        pos = std::to_chars(buffer.data() + pos, buffer.data() + kBufferBytes, v,
+                            std::chars_format::general, 6).ptr - buffer.data();
+    }
+    void put(char c) { buffer[pos++] = c; }
+    void text(const char *s) { while (*s) buffer[pos++] = *s++; }
+
+    bool flush()
+    {
+        const bool ok = pos == 0 || file.write(buffer.data(), static_cast<qint64>(pos)) == static_cast<qint64>(pos);
+        pos = 0;
+        return ok;
+    }
+
+private:
+    QFile &file;
+    std::vector<char> buffer;
+    size_t pos;
+};
+}
+
+ExportEngine::Format ExportEngine::formatFor(const QString &fileName)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "raw")
+        return Format::Raw;
+    if (suffix == "csv")
+        return Format::Csv;
+    return Format::Text;
+}
+
+ExportEngine::ExportEngine(QObject *parent)
+    : QObject(parent)
+{
+    pthread_create(&thread, nullptr, &ExportEngine::threadMain, this);
+}
+
+ExportEngine::~ExportEngine()
+{
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    jobs.clear();
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&mutex);
+
+    pthread_join(thread, nullptr);
+}
+
+void ExportEngine::exportTime(const QString &fileName, TimeDProcess &source, uint64_t first, uint64_t count,
+                              double sampleRate, const AdcCalibration &calibration)
+{
+    Job job;
+    job.fileName = fileName;
+    job.format = formatFor(fileName);
+    job.source = &source;
+    job.first = first;
+    job.count = count;
+    job.sampleRate = sampleRate;
+    job.calibration = &calibration;
+    enqueue(std::move(job));
+}
+
+void ExportEngine::exportSpectrum(const QString &fileName, std::vector<double> magnitudes, int fftSize, double sampleRate)
+{
+    Job job;
+    job.fileName = fileName;
+    job.format = formatFor(fileName);
+    job.spectrum = true;
+    job.magnitudes = std::move(magnitudes);
+    job.fftSize = fftSize;
+    job.sampleRate = sampleRate;
+    enqueue(std::move(job));
+}
+
+void ExportEngine::exportHistory(const QString &fileName, std::vector<int16_t> codes, std::vector<uint64_t> stamps,
+                                 int fftSize, double sampleRate)
+{
+    Job job;
+    job.fileName = fileName;
+    job.format = formatFor(fileName);
+    job.spectrum = true;
+    job.history = true;
+    job.codes = std::move(codes);
+    job.stamps = std::move(stamps);
+    job.fftSize = fftSize;
+    job.sampleRate = sampleRate;
+    enqueue(std::move(job));
+}
+
+void ExportEngine::enqueue(Job job)
+{
+    pthread_mutex_lock(&mutex);
+    jobs.push_back(std::move(job));
+    pending.fetch_add(1, std::memory_order_relaxed);
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&mutex);
+}
+
+void* ExportEngine::threadMain(void *arg)
+{
+    static_cast<ExportEngine*>(arg)->run();
+    return nullptr;
+}
+
+void ExportEngine::run()
+{
+    for (;;) {
+        pthread_mutex_lock(&mutex);
+        while (jobs.empty() && !stopping)
+            pthread_cond_wait(&wake, &mutex);
+        if (stopping) {
+            pthread_mutex_unlock(&mutex);
+            return;
+        }
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        pthread_mutex_unlock(&mutex);
+
+        percent.store(0, std::memory_order_relaxed);
+        bool ok;
+        if (job.source && !readSamples(job))
+            ok = false;
+        else if (job.history)
+            ok = job.format == Format::Raw ? writeHistoryRaw(job) : writeHistoryText(job);
+        else
+            ok = job.format == Format::Raw ? writeRaw(job) : writeText(job);
+        pending.fetch_sub(1, std::memory_order_relaxed);
+
+        if (stopping)  // abandoned mid-write by the destructor
+            return;
+        if (ok)
+            qDebug() << "[ExportEngine]" << (job.history ? "Spectrum history" : job.spectrum ? "FFT plot" : "Time-domain plot")
+                     << "saved to" << job.fileName;
+        else
+            qWarning() << "[ExportEngine] Failed to write" << job.fileName;
+        Q_EMIT finished(job.fileName, ok);
+    }
+}
+
+// Export thread: copy the job's range out of the time ring before the stream overwrites it
+bool ExportEngine::readSamples(Job &job)
+{
+    try {
+        job.samples.resize(job.count);
+    } catch (const std::bad_alloc &) {
+        qWarning() << "[ExportEngine] No memory for" << job.count << "samples";
+        return false;
+    }
+
+    bool moved = false;
+    for (uint64_t i = 0; i < job.count && !stopping;) {
+        const int n = static_cast<int>(std::min<uint64_t>(kRawChunk, job.count - i));
+        if (job.source->copyRange(job.first + i, n, job.samples.data() + i)) {
+            i += n;
+            continue;
+        }
+        if (i > 0 || moved) {
+            qWarning() << "[ExportEngine] The time window moved on while" << job.fileName << "was being read";
+            return false;
+        }
+        // Queued behind another job, or a short window: take the newest samples instead
+        const uint64_t end = job.source->writeCursor();
+        job.first = end - std::min(end, job.count);
+        moved = true;
+    }
+    return !stopping;
+}
+
+void ExportEngine::reportProgress(size_t done, size_t total)
+{
+    const int p = total ? static_cast<int>(done * 100 / total) : 100;
+    if (p != percent.exchange(p, std::memory_order_relaxed))
+        Q_EMIT progressChanged(p);
+}
+
+bool ExportEngine::writeText(const Job &job)
+{
+    QFile file(job.fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[ExportEngine] Failed to open file:" << job.fileName;
+        return false;
+    }
+
+    RowWriter out(file);
+    bool ok = true;
+
+    if (job.spectrum) {
+        const bool mhz = job.sampleRate > 1e6;
+        const double step = job.sampleRate / job.fftSize / (mhz ? 1e6 : 1e3);
+        const size_t bins = std::min<size_t>(job.magnitudes.size(), job.fftSize / 2 + 1);
+
+        out.text(mhz ? "Frequency (MHz),Log Magnitude\n" : "Frequency (KHz),Log Magnitude\n");
+        for (size_t i = 0; i < bins && ok && !stopping; ++i) {
+            ok = out.reserveRow();
+            out.fixed(i * step, 6);
+            out.put(',');
+            out.general(std::log10(std::max(job.magnitudes[i], AppConfig::epsilon)));
+            out.put('\n');
+            if ((i & 0xFFFF) == 0)
+                reportProgress(i, bins);
+        }
+    } else {
+        const double dt_us = 1e6 / job.sampleRate;
+        const size_t count = job.samples.size();
+        float power[4096];  // µW for the next run of rows, converted through the calibration table
+
+        out.text("Time (us),Power (uW)\n");
+        for (size_t i = 0; i < count && ok && !stopping; ++i) {
+            const size_t k = i % 4096;
+            if (k == 0)
+                job.calibration->toMicroWatts(job.samples.data() + i, static_cast<int>(std::min<size_t>(4096, count - i)), power);
+            ok = out.reserveRow();
+            out.fixed(i * dt_us, 4);  // 12.5 ns steps stay exact
+            out.put(',');
+            out.general(power[k]);
+            out.put('\n');
+            if ((i & 0xFFFF) == 0)
+                reportProgress(i, count);
+        }
+    }
+
+    ok = out.flush() && ok;
+    reportProgress(1, 1);
+    return ok;
+}
+
+bool ExportEngine::writeRaw(const Job &job)
+{
+    QFile file(job.fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[ExportEngine] Failed to open file:" << job.fileName;
+        return false;
+    }
+
+    // Values converted to little-endian block by block (a plain copy on x86)
+    bool ok = true;
+    if (job.spectrum) {
+        const size_t count = std::min<size_t>(job.magnitudes.size(), job.fftSize / 2 + 1);
+        std::vector<double> block(std::min(count, kRawChunk));
+        for (size_t i = 0; i < count && ok && !stopping; i += kRawChunk) {
+            const size_t n = std::min(kRawChunk, count - i);
+            qToLittleEndian<double>(job.magnitudes.data() + i, static_cast<qsizetype>(n), block.data());
+            ok = file.write(reinterpret_cast<const char*>(block.data()), n * sizeof(double)) == static_cast<qint64>(n * sizeof(double));
+            reportProgress(i + n, count);
+        }
+    } else {
+        const size_t count = job.samples.size();
+        std::vector<uint16_t> block(std::min(count, kRawChunk));
+        for (size_t i = 0; i < count && ok && !stopping; i += kRawChunk) {
+            const size_t n = std::min(kRawChunk, count - i);
+            qToLittleEndian<quint16>(job.samples.data() + i, static_cast<qsizetype>(n), block.data());
+            ok = file.write(reinterpret_cast<const char*>(block.data()), n * sizeof(uint16_t)) == static_cast<qint64>(n * sizeof(uint16_t));
+            reportProgress(i + n, count);
+        }
+    }
+    file.close();
+    if (!ok)
+        return false;
+
+    // Sidecar header: everything needed to read the .raw back without this app
+    QFile header(job.fileName + ".hdr");
+    if (!header.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "[ExportEngine] Failed to open file:" << header.fileName();
+        return false;
+    }
+    QString meta = "format=ultracoustics-raw\nversion=1\nbyte_order=little\n";
+    if (job.spectrum) {
+        meta += "content=spectrum\ndtype=float64\n";
+        meta += QString("count=%1\n").arg(std::min<size_t>(job.magnitudes.size(), job.fftSize / 2 + 1));
+        meta += QString("sample_rate_hz=%1\n").arg(job.sampleRate, 0, 'g', 17);
+        meta += QString("fft_size=%1\n").arg(job.fftSize);
+        meta += QString("bin_width_hz=%1\n").arg(job.sampleRate / job.fftSize, 0, 'g', 17);
+        meta += "# value = linear FFT magnitude of bin i, frequency = i * bin_width_hz\n";
+    } else {
+        meta += "content=time\ndtype=uint16\n";
+        meta += QString("count=%1\n").arg(job.samples.size());
+        meta += QString("sample_rate_hz=%1\n").arg(job.sampleRate, 0, 'g', 17);
+        meta += QString("adc_offset=%1\n").arg(job.calibration->offsetCode(), 0, 'g', 17);
+        meta += QString("adc_to_uw=%1\n").arg(job.calibration->slope(job.calibration->offsetCode()), 0, 'g', 17);
+        const QString table = job.calibration->tableFile();
+        if (!table.isEmpty())
+            meta += QString("adc_calibration=%1\n").arg(table);
+        meta += "# value = ADC code of sample i at t = i / sample_rate_hz, power_uW = (value - adc_offset) * adc_to_uw"
+                " (exact on the linear scale; with adc_calibration adc_to_uw is only the table's slope at adc_offset,"
+                " the table gives power(value) - power(adc_offset))\n";
+    }
+    return header.write(meta.toUtf8()) >= 0;
+}
+
+// One row per frame: its end time, then log10 magnitude per bin (same unit as the FFT export)
+bool ExportEngine::writeHistoryText(const Job &job)
+{
+    QFile file(job.fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[ExportEngine] Failed to open file:" << job.fileName;
+        return false;
+    }
+
+    const int bins = job.fftSize / 2 + 1;
+    const size_t frames = job.stamps.size();
+    const bool mhz = job.sampleRate > 1e6;
+    const double step = job.sampleRate / job.fftSize / (mhz ? 1e6 : 1e3);
+    const double logPerCode = SpectrumHistory::kDbStep / 20.0;
+
+    RowWriter out(file);
+    bool ok = true;
+
+    out.text(mhz ? "Time (s)/Frequency (MHz)" : "Time (s)/Frequency (KHz)");  // header row holds the bin frequencies
+    for (int b = 0; b < bins && ok; ++b) {
+        ok = out.reserveRow();
+        out.put(',');
+        out.fixed(b * step, 6);
+    }
+    out.put('\n');
+
+    for (size_t f = 0; f < frames && ok && !stopping; ++f) {
+        ok = out.reserveRow();
+        out.fixed(job.stamps[f] / AppConfig::adcSampleRate, 9);
+        const int16_t *codes = job.codes.data() + f * bins;
+        for (int b = 0; b < bins && ok; ++b) {
+            ok = out.reserveRow();
+            out.put(',');
+            out.fixed(codes[b] * logPerCode, 4);
+        }
+        out.put('\n');
+        reportProgress(f, frames);
+    }
+
+    ok = out.flush() && ok;
+    reportProgress(1, 1);
+    return ok;
+}
+
+// Records of { uint64 stamp, int16 code[bins] }, little-endian, plus the usual sidecar
+bool ExportEngine::writeHistoryRaw(const Job &job)
+{
+    QFile file(job.fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[ExportEngine] Failed to open file:" << job.fileName;
+        return false;
+    }
+
+    const int bins = job.fftSize / 2 + 1;
+    const size_t frames = job.stamps.size();
+    const size_t recordBytes = sizeof(uint64_t) + bins * sizeof(int16_t);
+    std::vector<char> record(recordBytes);
+
+    bool ok = true;
+    for (size_t f = 0; f < frames && ok && !stopping; ++f) {
+        qToLittleEndian<quint64>(&job.stamps[f], 1, record.data());
+        qToLittleEndian<qint16>(job.codes.data() + f * bins, bins, record.data() + sizeof(uint64_t));
+        ok = file.write(record.data(), static_cast<qint64>(recordBytes)) == static_cast<qint64>(recordBytes);
+        reportProgress(f + 1, frames);
+    }
+    file.close();
+    if (!ok)
+        return false;
+
+    QFile header(job.fileName + ".hdr");
+    if (!header.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "[ExportEngine] Failed to open file:" << header.fileName();
+        return false;
+    }
+    QString meta = "format=ultracoustics-raw\nversion=1\nbyte_order=little\n";
+    meta += "content=spectrum-history\ndtype=int16\n";
+    meta += QString("frames=%1\n").arg(frames);
+    meta += QString("bins=%1\n").arg(bins);
+    meta += QString("record_bytes=%1\n").arg(recordBytes);
+    meta += QString("sample_rate_hz=%1\n").arg(job.sampleRate, 0, 'g', 17);
+    meta += QString("fft_size=%1\n").arg(job.fftSize);
+    meta += QString("bin_width_hz=%1\n").arg(job.sampleRate / job.fftSize, 0, 'g', 17);
+    meta += QString("db_step=%1\n").arg(SpectrumHistory::kDbStep, 0, 'g', 17);
+    meta += QString("adc_sample_rate_hz=%1\n").arg(AppConfig::adcSampleRate, 0, 'g', 17);
+    meta += "# record = uint64 stamp, int16 code[bins]; frame ends at stamp / adc_sample_rate_hz seconds\n";
+    meta += "# power dB of bin i = code[i] * db_step, linear magnitude = 10^(code[i] * db_step / 20)\n";
+    return header.write(meta.toUtf8()) >= 0;
+}
@@ -0,0 +1,93 @@
+// ExportEngine.h
+#ifndef EXPORTENGINE_H
+#define EXPORTENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class AdcCalibration;
+class TimeDProcess;
+
+/*!
+ * Writes plot exports on its own thread so multi-second windows never
+ * block the GUI. Text/CSV rows are formatted with std::to_chars into a
+ * large buffer and flushed in one write per buffer; ".raw" exports are
+ * little-endian binary (uint16 ADC codes or float64 magnitudes) with a
+ * "<file>.hdr" key=value sidecar describing them.
+ *
+ * Jobs take ownership of their data and run one at a time, in order. Time
+ * jobs only carry a sample range: the export thread copies it out of the
+ * time ring in chunks when the job starts, at memory speed, so the ring's
+ * headroom (window / 8) covers it; formatting runs slower than the stream
+ * and works from that copy.
+ */
+class ExportEngine : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Format { Text, Csv, Raw };
+    static Format formatFor(const QString &fileName);  // by extension, Text if unknown
+
+    explicit ExportEngine(QObject *parent = nullptr);
+    ~ExportEngine();  // abandons the running job and drops the queued ones
+
+    // Samples [first, first + count) of `source`, or its newest `count` if those moved on before the job
+    // started; source and calibration are the recording device's and must outlive the engine
+    void exportTime(const QString &fileName, TimeDProcess &source, uint64_t first, uint64_t count, double sampleRate,
+                    const AdcCalibration &calibration);
+    void exportSpectrum(const QString &fileName, std::vector<double> magnitudes, int fftSize, double sampleRate);
+    // Frames from SpectrumHistory: codes frame-major, one stamp (SampleTimeline index, ADC rate) per frame
+    void exportHistory(const QString &fileName, std::vector<int16_t> codes, std::vector<uint64_t> stamps,
+                       int fftSize, double sampleRate);
+
+    bool busy() const { return pending.load(std::memory_order_relaxed) > 0; }
+    int progress() const { return percent.load(std::memory_order_relaxed); }  // of the running job
+
+Q_SIGNALS:
+    void progressChanged(int percent);                   // emitted from the export thread
+    void finished(const QString &fileName, bool ok);
+
+private:
+    struct Job {
+        QString fileName;
+        Format format = Format::Text;
+        bool spectrum = false;
+        bool history = false;
+        TimeDProcess *source = nullptr;  // time jobs: samples are read from here when the job starts
+        uint64_t first = 0;
+        uint64_t count = 0;
+        std::vector<uint16_t> samples;
+        std::vector<double> magnitudes;
+        std::vector<int16_t> codes;
+        std::vector<uint64_t> stamps;
+        int fftSize = 0;
+        double sampleRate = 0.0;
+        const AdcCalibration *calibration = nullptr;  // time jobs
+    };
+
+    static void* threadMain(void *arg);
+    void run();
+    void enqueue(Job job);
+    bool readSamples(Job &job);
+    bool writeText(const Job &job);
+    bool writeRaw(const Job &job);
+    bool writeHistoryText(const Job &job);
+    bool writeHistoryRaw(const Job &job);
+    void reportProgress(size_t done, size_t total);
+
+    pthread_t thread;
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+    std::deque<Job> jobs;
+    std::atomic<bool> stopping{false};  // also polled by the running job
+
+    std::atomic<int> pending{0};
+    std::atomic<int> percent{0};
+};
+
+#endif // EXPORTENGINE_H
@@ -1,6 +1,25 @@
 // FFTProcess.cpp
 #include "FFTProcess.h"
+#include "AdcCalibration.h"
 #include "TimeDProcess.h"
+#include "DSPPool.h"
+#include "ThreadPlacement.h"
+#include "ZoomFFT.h"
+#include "Decimator.h"
+#include "Epoch.h"
+#include "ToneTracker.h"
+#include "Persistence.h"
+#include "SpectrumAccumulator.h"
+#include "SpectrumHistory.h"
+#include "SampleRecorder.h"
+#include "SharedPublisher.h"
+#include "StageGraph.h"
+#include "Correlator.h"
+#include "EventDetector.h"
+#include "EventLog.h"
+#include "SampleTimeline.h"
+#include "Arena.h"
+#include "HugePages.h"
 #include "AppConfig.h"
 #include "ri.h"
 
@@ -10,148 +29,877 @@
 #include <cmath>
 #include <QMetaObject>
 #include <QApplication>
+#include <QPointer>
 #include <QThread>
 #include <vector>
 #include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
 
-#define NUM_BUFFERS     8
-#define NUM_FFT_THREADS 3
+#define NUM_BUFFERS     8   // pending-frame queue slots, per chain
+#define FEED_CHUNK      (1 << 16)  // input samples decimated at a time, bounds the decimated scratch
 
-using PeakFrequencyCallback = void(*)(double);
+struct Pipeline;
+struct Acquisition;
 
-// Shared state
-static std::atomic<int> fft_data_ready{0};
-static std::vector<double> fft_magnitude_buffer(AppConfig::fftBins);
-static std::vector<std::vector<double>> fft_buffers(NUM_BUFFERS, std::vector<double>(AppConfig::fftSize));
+/*
+ * One analysis chain per PipelineConfig::chains entry. The callback fans
+ * every block out to all of them: each decimates to its own rate, fills its
+ * own frames and queues them on the shared DSP pool, and publishes its own
+ * spectrum. The view only chooses which one getMagnitudes() returns.
+ */
+struct AnalysisChain {
+    AnalysisChainConfig cfg;
+    Pipeline* owner = nullptr;
+    int index = 0;
+    int bins = 0;
+    int hopSize = 0;
+    Decimator decimator;
+    double* decimated = nullptr;    // callback scratch, FEED_CHUNK / decimation samples
+    std::vector<double> window;     // empty = rectangular
 
-static int write_index = 0;
-static double* fft_queue[NUM_BUFFERS];
-static std::atomic<int> queue_head{0}, queue_tail{0};
-static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+    std::atomic<int> data_ready{0};
+    double* magnitudes = nullptr;
+    SpectrumAccumulator traces;  // sees every frame, a swapped-in chain starts empty
+    std::unique_ptr<SpectrumHistory> history;
+    std::unique_ptr<Correlator> correlator;  // runs while the chain is viewed
+    std::unique_ptr<EventDetector> events;   // every frame, into the device's event_log
 
-static double* current_buffer = fft_buffers[0].data();
-static int buffer_index = 0;
+    // Frame buffers: one being filled, up to NUM_BUFFERS - 1 queued, one per worker in flight
+    std::vector<double*> free_buffers;
+    double* queue[NUM_BUFFERS] = {};
+    uint64_t queue_stamp[NUM_BUFFERS] = {};  // SampleTimeline index just past each queued frame
+    uint8_t queue_flags[NUM_BUFFERS] = {};   // FrameFlags
+    uint64_t next_seq = 0;                    // history sequence, assigned when a worker takes a frame
+    std::atomic<int> queue_head{0}, queue_tail{0};
+    pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static FFTMode internalMode = FFTMode::FullBandwidth;
-static FFTProcess* fft_instance = nullptr;
-static PeakFrequencyCallback peak_callback = nullptr;
+    double* current_buffer = nullptr;
+    int buffer_index = 0;
+    uint64_t frame_end = 0;  // stamp of the frame being completed
+    uint8_t frame_flags = 0; // flags it will be queued with
 
-static void emit_peak(double freq)
+    // One shared plan (new-array execute is thread-safe), one output and windowed input per worker;
+    // every buffer is a 64-byte aligned block of the pipeline's arena
+    fftw_plan plan = nullptr;
+    std::vector<fftw_complex*> outputs;
+    std::vector<double*> windowed;
+
+    // Back-pressure state, only touched by transfer_callback (policy is set from the GUI)
+    std::atomic<int> active_hop{0};
+    int decimate_phase = 0;
+
+    // Effective overlap = 1 - (samples advanced / frames processed) / fftSize
+    std::atomic<uint64_t> samples_advanced{0};
+    std::atomic<uint64_t> frames_processed{0};
+    std::atomic<uint64_t> frames_dropped{0};  // by back-pressure, never reached a worker
+
+    AnalysisChain(const AnalysisChainConfig& config, int decimation, Arena& arena)
+        : cfg(config), decimator(decimation), traces(config.fftSize / 2 + 1, &arena) {}
+};
+
+/*
+ * Everything built from one PipelineConfig. The config never changes after
+ * construction; reconfiguring builds a whole new Pipeline, the callback swaps
+ * it in between two blocks and hands the old one to a worker, which retires
+ * it through Epoch to be freed once its queued frames have drained.
+ *
+ * All of its buffers come from one arena, mapped and touched while it is
+ * built and released with it, so streaming never allocates.
+ */
+struct Pipeline {
+    const PipelineConfig config;
+    Acquisition* const acq;  // the device it was built for
+    Arena arena;  // before the chains, so it outlives them
+    std::vector<std::unique_ptr<AnalysisChain>> chains;
+    std::atomic<int> inflight{0};  // frames submitted to the pool and not finished yet
+
+    Pipeline(const PipelineConfig& c, Acquisition* a) : config(c), acq(a) {}
+    ~Pipeline();
+};
+
+/*
+ * Everything one device streams through, owned by its FFTProcess. The
+ * callback gets it as its libri user pointer and pool tasks reach it through
+ * their chain's pipeline, so several devices run side by side without
+ * sharing any state but the process-wide Epoch and FFTW planner lock.
+ */
+struct Acquisition {
+    const int device;
+    const DeviceConfig placement;
+    FFTProcess* const self;
+    TimeDProcess* const time;
+    SampleTimeline timeline;
+    AdcCalibration calibration;
+
+    std::atomic<Pipeline*> live_pipeline{nullptr};     // read by everyone under an Epoch::Guard
+    std::atomic<Pipeline*> pending_pipeline{nullptr};  // built by the GUI, adopted by the callback
+    std::atomic<int> retired{0};  // pipelines and stage graphs handed to Epoch and not freed yet
+    std::atomic<uint64_t> build_requests{0};  // reconfigure() calls; a build finishing behind a newer one is dropped
+    std::atomic<int> viewed_chain{0};
+    DSPPool* pool = nullptr;  // FFT/magnitude/peak workers of this device only
+
+    PipelineConfig startup_config;  // what the first pipeline is built from, served until it exists
+
+    std::atomic<bool> stop_streaming{false};
+    std::atomic<DeviceState> device_state{DeviceState::Initializing};
+    std::atomic<bool> device_resumed{false};  // the next block follows a reconnect
+    std::atomic<uint64_t> reconnect_count{0};
+    std::atomic<BackpressurePolicy> bp_policy{AppConfig::backpressurePolicy};
+    std::atomic<bool> history_frozen{false};  // paused: keep what led up to the pause
+    std::atomic<bool> emit_peaks{false};      // set once the GUI side is listening
+
+    // Zoom FFT: one capture in flight at a time. The GUI arms it, the callback copies blocks in
+    // until it holds the record the DDC needs, then the pool transforms it.
+    ZoomFFT* zoom_fft = nullptr;
+    std::atomic<bool> zoom_busy{false};   // armed, filling or being transformed
+    std::atomic<bool> zoom_armed{false};  // the callback is filling the capture
+    uint16_t* zoom_capture = nullptr;
+    size_t zoom_capacity = 0;             // samples mapped
+    size_t zoom_want = 0, zoom_filled = 0;
+    uint64_t zoom_next = 0;               // stream index the capture continues at
+    double zoom_capture_center = 0.0, zoom_capture_span = 0.0;  // band it was armed for
+    int zoom_capture_bins = 0;
+    pthread_mutex_t zoom_mutex = PTHREAD_MUTEX_INITIALIZER;
+    double zoom_center = 0.0, zoom_span = 0.0;            // requested band
+    double zoom_done_center = 0.0, zoom_done_span = 0.0;  // band of the stored result
+    std::vector<double> zoom_freqs, zoom_mags;
+
+    // Tone tracker: the callback stages blocks and kicks it, one run at a time catches up from there
+    ToneTracker* tone_tracker = nullptr;
+    std::atomic<bool> tone_busy{false};
+
+    // Digital phosphor: the callback stages blocks, the pool draws every waveform
+    Persistence* persistence = nullptr;
+
+    // Raw capture: the callback copies blocks in, encoding and disk I/O happen elsewhere
+    SampleRecorder* sample_recorder = nullptr;
+    SharedPublisher* shared_publisher = nullptr;
+
+    // Runtime-configured analyses, swapped like pipelines and retired once their tasks drain
+    std::atomic<StageGraph*> stage_graph{nullptr};
+
+    // Reference pulse for the correlators, handed to every chain a new pipeline builds
+    pthread_mutex_t correlation_mutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<double> correlation_pulse;
+
+    // Spectral events of every chain, detected on the workers; settings are handed to every new pipeline
+    EventLog* event_log = nullptr;
+    pthread_mutex_t event_mutex = PTHREAD_MUTEX_INITIALIZER;
+    EventSettings event_settings;
+
+    Acquisition(int index, FFTProcess* owner, TimeDProcess* source)
+        : device(index),
+          placement(index < static_cast<int>(AppConfig::devices.size()) ? AppConfig::devices[index] : DeviceConfig()),
+          self(owner), time(source), timeline(index) {}
+};
+
+// libri is process-wide: the first device watcher initialises it, the last one shuts it down.
+// The bus can only be rescanned (ri_exit + ri_init) while no device handle is open.
+// Units are first opened in device index order: device n waits until ri_open_turn reaches n.
+static pthread_mutex_t ri_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int ri_users = 0;
+static int ri_open_handles = 0;
+static int ri_open_turn = 0;
+
+static void emit_peak(Acquisition& a, double freq, uint64_t stamp)
 {
-    if (!fft_instance) return;
-    QMetaObject::invokeMethod(qApp, [freq]() {
-        if (fft_instance)
-            fft_instance->peakFrequencyUpdated(freq);
+    QPointer<FFTProcess> self(a.self);  // the queued call finds it gone if the device was torn down meanwhile
+    QMetaObject::invokeMethod(qApp, [self, freq, stamp]() {
+        if (self)
+            self->peakFrequencyUpdated(freq, stamp);
     });
 }
 
-static void* fft_thread_func(void*)
+// Device 0 keeps the configured name, device n gets "-n" before the extension
+static std::string per_device(const std::string& name, int device)
 {
-    auto* fft_output = new fftw_complex[AppConfig::fftBins];
-    fftw_plan plan = fftw_plan_dft_r2c_1d(AppConfig::fftSize, nullptr, fft_output, FFTW_ESTIMATE);
+    if (device == 0 || name.empty())
+        return name;
+    const size_t slash = name.find_last_of("/\\");
+    const size_t dot = name.find_last_of('.');
+    const size_t at = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? dot : name.size();
+    return name.substr(0, at) + "-" + std::to_string(device) + name.substr(at);
+}
 
-    while (true) {
-        pthread_mutex_lock(&queue_mutex);
-        while (queue_head == queue_tail)
-            pthread_cond_wait(&queue_not_empty, &queue_mutex);
-        double* fft_input = fft_queue[queue_head];
-        queue_head = (queue_head + 1) % NUM_BUFFERS;
-        pthread_mutex_unlock(&queue_mutex);
+static int chain_decimation(const AnalysisChainConfig& config)
+{
+    return std::max(1, static_cast<int>(std::lround(AppConfig::adcSampleRate / config.sampleRate)));
+}
 
-        fftw_execute_dft_r2c(plan, fft_input, fft_output);
+// The chain the view-side getters serve; null until the first pipeline is built
+static AnalysisChain* viewed(Pipeline* p)
+{
+    if (!p)
+        return nullptr;
+    return p->chains[std::min<int>(p->acq->viewed_chain.load(), static_cast<int>(p->chains.size()) - 1)].get();
+}
 
-        int peakIndex = 0;
-        double peakValue = 0.0;
+// Chains of the live pipeline, none before the first one is built; caller holds an Epoch::Guard
+static const std::vector<std::unique_ptr<AnalysisChain>>& live_chains(const Acquisition& a)
+{
+    static const std::vector<std::unique_ptr<AnalysisChain>> none;
+    const Pipeline* p = a.live_pipeline.load();
+    return p ? p->chains : none;
+}
 
-        const int ignoreBins = AppConfig::fftBins / 10;
-        const int ignoreBinsTop = static_cast<int>(AppConfig::fftBins * 0.99); // ignore spikes at beginning and end
+// Never on the GUI thread: the device's worker thread at start-up, a worker of its pool on reconfigure().
+// Both are placed like the callback (its core's or NUMA node's), so first touch keeps the arena on that node.
+// Returns nullptr if the arena could not map its buffers
+static Pipeline* build_pipeline(Acquisition& a, const PipelineConfig& config, int workers)
+{
+    std::unique_ptr<Pipeline> p(new Pipeline(config, &a));
+    Arena& arena = p->arena;
 
-        for (int j = 0; j < AppConfig::fftBins; ++j) {
-            double re = fft_output[j][0];
-            double im = fft_output[j][1];
-            double mag = std::sqrt(re * re + im * im);
-            fft_magnitude_buffer[j] = mag;
+    for (const AnalysisChainConfig& chainConfig : config.chains) {
+        const int decimation = chain_decimation(chainConfig);
+        auto chain = std::make_unique<AnalysisChain>(chainConfig, decimation, arena);
+        AnalysisChain& c = *chain;
 
-            if (j >= ignoreBins && j <= ignoreBinsTop && mag > peakValue) {
-                peakValue = mag;
-                peakIndex = j;
-            }
+        c.owner = p.get();
+        c.index = static_cast<int>(p->chains.size());
+        c.cfg.sampleRate = AppConfig::adcSampleRate / decimation;
+        c.bins = c.cfg.fftSize / 2 + 1;
+        c.hopSize = std::max(1, static_cast<int>(c.cfg.fftSize * (1.0 - config.overlapFraction)));
+        c.active_hop.store(c.hopSize);
+        c.magnitudes = arena.allocate<double>(c.bins, ArenaUse::Spectra);
+        c.decimated = arena.allocate<double>(FEED_CHUNK / decimation + 1, ArenaUse::Frames);
+        c.window = makeWindow(config.window, c.cfg.fftSize);
+
+        const double framesPerSecond = c.cfg.sampleRate / c.hopSize;
+        const size_t frameBytes = static_cast<size_t>((c.bins + 31) & ~31) * sizeof(int16_t);  // rows padded to 64 bytes
+        const int historyFrames = static_cast<int>(std::min<double>(
+            std::ceil(AppConfig::spectrumHistorySeconds * framesPerSecond),
+            static_cast<double>(AppConfig::spectrumHistoryMaxMB) * 1024.0 * 1024.0 / frameBytes));
+        c.history = std::make_unique<SpectrumHistory>(c.bins, std::max(historyFrames, 1), arena);
+
+        if (AppConfig::correlationEnabled) {
+            c.correlator = std::make_unique<Correlator>(c.cfg.fftSize, c.cfg.sampleRate, c.window, workers, arena);
+            pthread_mutex_lock(&a.correlation_mutex);
+            if (!a.correlation_pulse.empty())
+                c.correlator->setReference(a.correlation_pulse);
+            pthread_mutex_unlock(&a.correlation_mutex);
         }
 
-        if (peak_callback) {
-            double freq = (peakIndex *
-                           ((internalMode == FFTMode::LowBandwidth) ? 200000.0 : 80000000.0)) /AppConfig::fftSize;
-            freq /= (internalMode == FFTMode::LowBandwidth) ? 1000.0 : 1e6;
-            peak_callback(freq);
+        if (AppConfig::eventDetection) {
+            c.events = std::make_unique<EventDetector>(c.cfg.fftSize, c.cfg.sampleRate,
+                                                       static_cast<uint64_t>(c.cfg.fftSize) * decimation,
+                                                       c.index, workers, a.event_log);
+            pthread_mutex_lock(&a.event_mutex);
+            c.events->configure(a.event_settings);
+            pthread_mutex_unlock(&a.event_mutex);
+        }
+
+        c.outputs.resize(workers);
+        for (auto& out : c.outputs)
+            out = arena.allocate<fftw_complex>(c.bins, ArenaUse::Spectra);
+        c.windowed.resize(workers);  // also the DC-removed copy when there is no window
+        for (auto& in : c.windowed)
+            in = arena.allocate<double>(c.cfg.fftSize, ArenaUse::Scratch);
+        for (int i = 0; i < NUM_BUFFERS + workers; ++i)
+            c.free_buffers.push_back(arena.allocate<double>(c.cfg.fftSize, ArenaUse::Frames));
+
+        if (!arena.ok()) {
+            qWarning() << "[FFTProcess] Device" << a.device << "pipeline buffers could not be mapped ("
+                       << arena.mappedBytes() / (1024 * 1024) << "MB so far)";
+            return nullptr;  // before the plan: the chain being built owns none yet
         }
 
-        fft_data_ready.store(1);
+        pthread_mutex_lock(&ZoomFFT::plannerMutex());
+        c.plan = fftw_plan_dft_r2c_1d(c.cfg.fftSize, nullptr, c.outputs[0], FFTW_ESTIMATE);
+        pthread_mutex_unlock(&ZoomFFT::plannerMutex());
+
+        c.current_buffer = c.free_buffers.back();
+        c.free_buffers.pop_back();
+
+        qDebug() << "[FFTProcess] Device" << a.device << "chain" << c.cfg.name << "at" << c.cfg.sampleRate << "Hz, decimation"
+                 << decimation << ", FFT" << c.cfg.fftSize << ", usable to" << c.cfg.sampleRate / 2.0 * c.decimator.usableFraction() << "Hz";
+        p->chains.push_back(std::move(chain));
     }
 
-    delete[] fft_output;
-    return nullptr;
+    arena.seal();
+    qDebug() << "[FFTProcess] Device" << a.device << "pipeline arena:" << arena.mappedBytes() / (1024 * 1024) << "MB mapped,"
+             << arena.hugeBytes() / (1024 * 1024) << "MB on huge pages";
+    return p.release();
 }
 
-static int transfer_callback(uint16_t* data, int ndata, int, void*)
+Pipeline::~Pipeline()
 {
-    TimeDProcess::transferCallback(data, ndata, 0, nullptr);
+    pthread_mutex_lock(&ZoomFFT::plannerMutex());
+    for (auto& chain : chains)
+        fftw_destroy_plan(chain->plan);
+    pthread_mutex_unlock(&ZoomFFT::plannerMutex());
+}
 
-    constexpr int ADC_RATE = 80000000;
-    int targetRate = (internalMode == FFTMode::LowBandwidth) ? 200000 : ADC_RATE;
-    int downsample = ADC_RATE / targetRate;
+static void release_buffer(AnalysisChain& c, double* buffer)
+{
+    pthread_mutex_lock(&c.queue_mutex);
+    c.free_buffers.push_back(buffer);
+    pthread_mutex_unlock(&c.queue_mutex);
+}
 
-    static int skip = 0;
-    for (int i = 0; i < ndata; ++i) {
-        if (skip++ % downsample != 0)
-            continue;
+// Pool task: take the chain's oldest pending frame (if a drop hasn't already taken it) and process it
+static void process_next_frame(AnalysisChain& c)
+{
+    pthread_mutex_lock(&c.queue_mutex);
+    if (c.queue_head == c.queue_tail) {
+        pthread_mutex_unlock(&c.queue_mutex);
+        return;
+    }
+    double* fft_input = c.queue[c.queue_head];
+    const uint64_t stamp = c.queue_stamp[c.queue_head];
+    const uint8_t flags = c.queue_flags[c.queue_head];
+    const uint64_t seq = c.next_seq++;
+    c.queue_head = (c.queue_head + 1) % NUM_BUFFERS;
+    pthread_mutex_unlock(&c.queue_mutex);
 
-        current_buffer[buffer_index++] = static_cast<double>(data[i]);
+    Acquisition& a = *c.owner->acq;
+    if (a.pool->stopRequested()) {
+        release_buffer(c, fft_input);
+        return;
+    }
+
+    // Frames are still read for the next frame's overlap, so DC removal and windowing go to worker scratch
+    const int worker = DSPPool::currentWorker();
+    const double dc = AppConfig::removeDc ? a.calibration.meanCode() : 0.0;
+    bool released = false;
+    if (!c.window.empty() || dc != 0.0) {
+        double* windowed = c.windowed[worker];
+        if (c.window.empty()) {
+            for (int i = 0; i < c.cfg.fftSize; ++i)
+                windowed[i] = fft_input[i] - dc;
+        } else {
+            for (int i = 0; i < c.cfg.fftSize; ++i)
+                windowed[i] = (fft_input[i] - dc) * c.window[i];
+        }
+        release_buffer(c, fft_input);
+        released = true;
+        fft_input = windowed;
+    }
+
+    fftw_complex* fft_output = c.outputs[worker];
+    fftw_execute_dft_r2c(c.plan, fft_input, fft_output);
+    if (!released)
+        release_buffer(c, fft_input);
+
+    // A frame spanning a stream gap is kept in the history, flagged, but stays out of traces and correlation
+    const bool corrupt = flags & FrameCorrupt;
+    if (!corrupt)
+        c.traces.accumulate(reinterpret_cast<const double*>(fft_output));
+    if (!a.history_frozen.load(std::memory_order_relaxed))
+        c.history->store(seq, stamp, reinterpret_cast<const double*>(fft_output), flags);
+    if (!corrupt && c.correlator && c.index == a.viewed_chain.load(std::memory_order_relaxed) && c.owner == a.live_pipeline.load())
+        c.correlator->process(fft_output, stamp, worker);
+    if (c.events)
+        c.events->process(fft_output, seq, stamp, flags, worker);  // corrupt frames too, they end open events
+
+    int peakIndex = 0;
+    double peakValue = 0.0;
+
+    const int ignoreBins = c.bins / 10;
+    // ignore spikes at the beginning and end, and the decimator's roll-off at the top of the band
+    const int ignoreBinsTop = static_cast<int>(c.bins * std::min(0.99, c.decimator.usableFraction()));
+
+    for (int j = 0; j < c.bins; ++j) {
+        double re = fft_output[j][0];
+        double im = fft_output[j][1];
+        double mag = std::sqrt(re * re + im * im);
+        c.magnitudes[j] = mag;
+
+        if (j >= ignoreBins && j <= ignoreBinsTop && mag > peakValue) {
+            peakValue = mag;
+            peakIndex = j;
+        }
+    }
+
+    if (c.owner == a.live_pipeline.load())
+        a.shared_publisher->publishSpectrum(c.index, static_cast<int>(c.owner->chains.size()), c.cfg, stamp,
+                                            c.magnitudes, c.bins);
+
+    if (a.emit_peaks.load(std::memory_order_relaxed) && c.index == a.viewed_chain.load() && c.owner == a.live_pipeline.load()) {
+        double freq = peakIndex * c.cfg.sampleRate / c.cfg.fftSize;
+        freq /= (c.cfg.sampleRate > 1e6) ? 1e6 : 1e3;  // same units as the plot axis
+        emit_peak(a, freq, stamp);
+    }
+
+    c.data_ready.store(1);
+    c.frames_processed.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Pool task: down-convert and transform a full capture
+static void process_zoom(Acquisition& a)
+{
+    const double center = a.zoom_capture_center;
+    const double span = a.zoom_capture_span;
+    if (a.pool->stopRequested()) {
+        a.zoom_busy.store(false);
+        return;
+    }
 
-        if (buffer_index >= AppConfig::fftSize) {
-            int next_tail = (queue_tail + 1) % NUM_BUFFERS;
-            if (next_tail == queue_head) {
-                buffer_index = AppConfig::fftSize - AppConfig::fftHopSize;
-                return 1;
+    int referenceSize = AppConfig::fftSize;
+    {
+        Epoch::Guard guard;
+        if (const AnalysisChain* c = viewed(a.live_pipeline.load()))
+            referenceSize = c->cfg.fftSize;
+    }
+
+    const bool ok = a.zoom_fft->compute(a.zoom_capture, a.zoom_want, AppConfig::adcSampleRate, center, span,
+                                        a.zoom_capture_bins, referenceSize);
+    if (ok) {
+        pthread_mutex_lock(&a.zoom_mutex);
+        a.zoom_freqs = a.zoom_fft->frequencies();
+        a.zoom_mags = a.zoom_fft->magnitudes();
+        a.zoom_done_center = center;
+        a.zoom_done_span = span;
+        pthread_mutex_unlock(&a.zoom_mutex);
+    }
+
+    a.zoom_busy.store(false);
+}
+
+// GUI thread, holding zoom_busy: size the capture for the requested band and hand it to the callback
+static bool arm_zoom(Acquisition& a, double center, double span)
+{
+    // setZoomBand keeps spans wide enough for zoomFftSize bins within zoomMaxCaptureSamples
+    int bins = AppConfig::zoomFftSize;
+    while (bins > 256 && ZoomFFT::samplesNeeded(AppConfig::adcSampleRate, span, bins) > AppConfig::zoomMaxCaptureSamples)
+        bins /= 2;
+    const size_t need = ZoomFFT::samplesNeeded(AppConfig::adcSampleRate, span, bins);
+
+    if (need > a.zoom_capacity) {
+        if (a.zoom_capture)
+            HugePages::release(a.zoom_capture, a.zoom_capacity * sizeof(uint16_t));
+        a.zoom_capacity = 0;
+        a.zoom_capture = static_cast<uint16_t*>(HugePages::allocate(need * sizeof(uint16_t)));
+        if (!a.zoom_capture) {
+            qWarning() << "[FFTProcess] Device" << a.device << "cannot map" << need << "samples for the zoom FFT";
+            return false;
+        }
+        a.zoom_capacity = need;
+    }
+
+    a.zoom_want = need;
+    a.zoom_filled = 0;
+    a.zoom_capture_center = center;
+    a.zoom_capture_span = span;
+    a.zoom_capture_bins = bins;
+    a.zoom_armed.store(true, std::memory_order_release);
+    return true;
+}
+
+// Callback thread, while armed: one contiguous record, then the pool takes over
+static void fill_zoom(Acquisition& a, const uint16_t* data, int ndata, uint64_t firstSample)
+{
+    if (a.zoom_filled > 0 && firstSample != a.zoom_next)
+        a.zoom_filled = 0;  // a gap: start the record over
+    const size_t n = std::min<size_t>(ndata, a.zoom_want - a.zoom_filled);
+    std::memcpy(a.zoom_capture + a.zoom_filled, data, n * sizeof(uint16_t));
+    a.zoom_filled += n;
+    a.zoom_next = firstSample + ndata;
+    if (a.zoom_filled < a.zoom_want)
+        return;
+
+    a.zoom_armed.store(false, std::memory_order_relaxed);
+    Acquisition* acq = &a;
+    a.pool->submit([acq]() { process_zoom(*acq); });
+}
+
+static int queue_depth(const AnalysisChain& c)
+{
+    return (c.queue_tail - c.queue_head + NUM_BUFFERS) % NUM_BUFFERS;
+}
+
+// Drop the frame just filled: keep its last (fftSize - hop) samples as the start of the next one
+static void rewind_in_place(AnalysisChain& c, int hop)
+{
+    const int keep = c.cfg.fftSize - hop;
+    if (keep > 0)
+        std::memmove(c.current_buffer, c.current_buffer + hop, keep * sizeof(double));
+    c.buffer_index = std::max(keep, 0);
+    c.frame_flags = FrameAfterDrop;
+    c.frames_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Hand the filled buffer to the workers and seed the next one with the overlap
+static void queue_current_buffer(AnalysisChain& c, int hop)
+{
+    pthread_mutex_lock(&c.queue_mutex);
+    if (queue_depth(c) >= NUM_BUFFERS - 1) { // DropOldest: evict the stalest pending frame
+        c.free_buffers.push_back(c.queue[c.queue_head]);
+        c.queue_head = (c.queue_head + 1) % NUM_BUFFERS;
+        c.queue_flags[c.queue_head] |= FrameAfterDrop;  // the new oldest, or the frame queued below
+        c.frames_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    c.queue[c.queue_tail] = c.current_buffer;
+    c.queue_stamp[c.queue_tail] = c.frame_end;
+    c.queue_flags[c.queue_tail] = c.frame_flags;
+    c.frame_flags = 0;
+    c.queue_tail = (c.queue_tail + 1) % NUM_BUFFERS;
+
+    double* previous = c.current_buffer;
+    c.current_buffer = c.free_buffers.back();
+    c.free_buffers.pop_back();
+    pthread_mutex_unlock(&c.queue_mutex);
+
+    // Seed the overlap before a worker can pick the frame up and recycle it
+    const int keep = c.cfg.fftSize - hop;
+    if (keep > 0)
+        std::copy(previous + hop, previous + c.cfg.fftSize, c.current_buffer);
+    c.buffer_index = std::max(keep, 0);
+
+    AnalysisChain* chain = &c;
+    c.owner->inflight.fetch_add(1, std::memory_order_relaxed);
+    c.owner->acq->pool->submit([chain]() {
+        process_next_frame(*chain);
+        chain->owner->inflight.fetch_sub(1, std::memory_order_release);
+    });
+}
+
+static void on_frame_complete(AnalysisChain& c)
+{
+    const int depth = queue_depth(c);
+    const bool full = depth >= NUM_BUFFERS - 1;
+    int hop = c.active_hop.load(std::memory_order_relaxed);
+
+    switch (c.owner->acq->bp_policy.load(std::memory_order_relaxed)) {
+    case BackpressurePolicy::DropOldest:
+        queue_current_buffer(c, hop);
+        return;
+
+    case BackpressurePolicy::DecimateFrames:
+        if (depth < NUM_BUFFERS / 2) {
+            c.decimate_phase = 0;
+        } else if (c.decimate_phase++ % std::max(1, AppConfig::decimateFrameStride) != 0) {
+            rewind_in_place(c, hop);
+            return;
+        }
+        break;
+
+    case BackpressurePolicy::AdaptiveHop: {
+        const int step = std::max(1, c.hopSize / 4);
+        if (depth >= (NUM_BUFFERS * 3) / 4)
+            hop = std::min(hop + step, c.cfg.fftSize);
+        else if (depth <= NUM_BUFFERS / 4)
+            hop = std::max(hop - step, c.hopSize);
+        c.active_hop.store(hop, std::memory_order_relaxed);
+        break;
+    }
+
+    case BackpressurePolicy::DropNewest:
+        break;
+    }
+
+    if (full) {
+        rewind_in_place(c, hop);
+        return;
+    }
+
+    queue_current_buffer(c, hop);
+}
+
+// Carry decimator state and the partly filled frame over, so the swap loses no samples
+static void hand_off(Pipeline& from, Pipeline& to)
+{
+    for (auto& next : to.chains) {
+        AnalysisChain* prev = nullptr;
+        for (auto& candidate : from.chains) {
+            if (candidate->decimator.factor() != next->decimator.factor())
+                continue;
+            if (!prev || candidate->index == next->index)
+                prev = candidate.get();
+        }
+        if (!prev)
+            continue;  // new rate: starts filling from this block on
+
+        next->decimator = prev->decimator;
+        const int keep = std::min(prev->buffer_index, next->cfg.fftSize);
+        std::copy(prev->current_buffer + prev->buffer_index - keep,
+                  prev->current_buffer + prev->buffer_index, next->current_buffer);
+        next->buffer_index = keep;
+        if (next->buffer_index >= next->cfg.fftSize)
+            on_frame_complete(*next);
+    }
+}
+
+// Acquisition side only: swap in a pending pipeline between two blocks
+static Pipeline* adopt_pending(Acquisition& a, Pipeline* current)
+{
+    Pipeline* next = a.pending_pipeline.exchange(nullptr, std::memory_order_acquire);
+    if (!next)
+        return current;
+
+    if (current)
+        hand_off(*current, *next);
+    a.live_pipeline.store(next, std::memory_order_release);
+
+    if (current) {
+        // Epoch::retire allocates its node: a worker does it, the callback only queues the hand-off like any frame
+        a.retired.fetch_add(1);
+        a.pool->submit([current]() {
+            Epoch::retire([current]() { current->acq->retired.fetch_sub(1); delete current; },
+                          [current]() { return current->inflight.load(std::memory_order_acquire) == 0; });
+        });
+    }
+    return next;
+}
+
+static void feed_chain(AnalysisChain& c, const uint16_t* data, int ndata, uint64_t firstSample)
+{
+    const int factor = c.decimator.factor();
+    const uint64_t span = static_cast<uint64_t>(c.cfg.fftSize) * factor;
+
+    // In chunks of at most FEED_CHUNK input samples, so the decimated scratch has a fixed size
+    for (int offset = 0; offset < ndata; offset += FEED_CHUNK) {
+        const int count = std::min(ndata - offset, FEED_CHUNK);
+
+        // Output i ends at the input sample `factor` steps before output i + 1; the last one
+        // ends where the decimator's partly accumulated next output begins
+        const int produced = c.decimator.process(data + offset, count, c.decimated);
+        const uint64_t lastEnd = firstSample + offset + count - c.decimator.pending();
+        for (int i = 0; i < produced; ++i) {
+            c.current_buffer[c.buffer_index++] = c.decimated[i];
+            if (c.buffer_index >= c.cfg.fftSize) {
+                c.frame_end = lastEnd - static_cast<uint64_t>(produced - 1 - i) * factor;
+                if (c.owner->acq->timeline.gapWithin(c.frame_end - std::min(span, c.frame_end), c.frame_end))
+                    c.frame_flags |= FrameCorrupt;
+                on_frame_complete(c);
             }
+        }
+        c.samples_advanced.fetch_add(produced, std::memory_order_relaxed);
+    }
+}
 
-            pthread_mutex_lock(&queue_mutex);
-            fft_queue[queue_tail] = current_buffer;
-            queue_tail = next_tail;
-            pthread_cond_signal(&queue_not_empty);
-            pthread_mutex_unlock(&queue_mutex);
+static int transfer_callback(uint16_t* data, int ndata, int dataloss, void* user)
+{
+    Acquisition& a = *static_cast<Acquisition*>(user);
+    if (a.stop_streaming.load(std::memory_order_relaxed))
+        return 0;  // ends ri_start_continuous_transfer
 
-            write_index = (write_index + 1) % NUM_BUFFERS;
-            current_buffer = fft_buffers[write_index].data();
+    static thread_local bool placed = false;  // one callback thread per device
+    if (!placed) {
+        ThreadPlacement::applyAcquisition(a.placement, a.device);
+        placed = true;
+    }
 
-            std::copy(
-                fft_buffers[(write_index - 1 + NUM_BUFFERS) % NUM_BUFFERS].data() + AppConfig::fftHopSize,
-                fft_buffers[(write_index - 1 + NUM_BUFFERS) % NUM_BUFFERS].data() + AppConfig::fftSize,
-                current_buffer
-                );
+    if (a.device_resumed.load(std::memory_order_relaxed) && a.device_resumed.exchange(false))
+        a.timeline.markGap(a.timeline.position(), GapCause::Reconnect);  // whatever the device sent while away is gone
+    const uint64_t firstSample = a.timeline.beginBlock(ndata, dataloss != 0);
+    a.time->appendBlock(data, ndata, firstSample, a.timeline);
+    a.calibration.track(data, ndata);
 
-            buffer_index = AppConfig::fftSize - AppConfig::fftHopSize;
+    if (a.sample_recorder->recording())
+        a.sample_recorder->append(data, ndata, firstSample);
+    a.shared_publisher->appendSamples(data, ndata);
+    if (a.persistence->enabled())
+        a.persistence->append(data, ndata, firstSample);
+
+    Epoch::Guard guard;
+    Pipeline* pipeline = adopt_pending(a, a.live_pipeline.load(std::memory_order_acquire));
+    for (auto& chain : pipeline->chains)
+        feed_chain(*chain, data, ndata, firstSample);
+
+    if (StageGraph* graph = a.stage_graph.load(std::memory_order_acquire))
+        graph->push(data, ndata, firstSample, AppConfig::adcSampleRate);
+
+    if (a.tone_tracker->enabled()) {
+        a.tone_tracker->append(data, ndata, firstSample);
+        if (!a.tone_busy.exchange(true, std::memory_order_acquire)) {
+            Acquisition* acq = &a;
+            a.pool->submit([acq]() {
+                acq->tone_tracker->run(acq->calibration);
+                acq->tone_busy.store(false, std::memory_order_release);
+            });
         }
     }
 
+    if (a.zoom_armed.load(std::memory_order_acquire))
+        fill_zoom(a, data, ndata, firstSample);
+
     return 1;
 }
 
-FFTProcess::FFTProcess(QObject* parent)
-    : QObject(parent)
+FFTProcess::FFTProcess(TimeDProcess* time, int device, QObject* parent)
+    : QObject(parent), acq(new Acquisition(device, this, time))
 {
     this->moveToThread(&workerThread);
 
-    // Start FFT worker threads only once
-    for (int i = 0; i < NUM_FFT_THREADS; ++i)
-        pthread_create(&fftThreads[i], nullptr, fft_thread_func, nullptr);
+    const DeviceConfig placement = acq->placement;
+    acq->pool = new DSPPool(ThreadPlacement::workerCount(placement), [placement, device](int index) {
+        ThreadPlacement::applyWorker(placement, device, index);
+    });
+
+    // Only cheap objects here so the window shows at once; buffers, plans, the
+    // calibration table and shared memory are set up by start() on the worker thread
+    acq->event_log = new EventLog();  // before the first pipeline, its detectors log into it
+    acq->zoom_fft = new ZoomFFT();
+    acq->tone_tracker = new ToneTracker();
+    acq->tone_tracker->configure(AppConfig::trackedTonesHz, AppConfig::toneTrackerRateHz);
+    acq->sample_recorder = new SampleRecorder(acq->pool, &acq->calibration);
+    acq->shared_publisher = new SharedPublisher();
+    acq->persistence = new Persistence(acq->pool, time ? &time->trigger() : nullptr);
+}
+
+static void wait_for_retry(const Acquisition& a)
+{
+    for (int waited = 0; waited < AppConfig::deviceRetryMs && !a.stop_streaming.load(); waited += 50)
+        QThread::msleep(50);
+}
+
+// Worker thread, before the device is opened: everything the constructor left out.
+// False if stopped before a pipeline could be built; until then a failed build is retried.
+static bool initialize_resources(Acquisition& a)
+{
+    ThreadPlacement::lockMemory();  // MCL_FUTURE: covers what is allocated below
+    if (a.placement.acquisitionCore < 0)  // pinned to the node, not a core: build where the callback will run
+        ThreadPlacement::pinCurrentThread(ThreadPlacement::nodeCores(a.placement.numaNode));
+
+    if (!AppConfig::eventLogFile.empty())
+        a.event_log->startSpill(per_device(AppConfig::eventLogFile, a.device));
+    const std::string calibrationFile = a.placement.calibrationFile.empty() ? AppConfig::adcCalibrationFile
+                                                                            : a.placement.calibrationFile;
+    if (!calibrationFile.empty())
+        a.calibration.loadTable(QString::fromStdString(calibrationFile));
+    if (!AppConfig::sharedMemoryName.empty())
+        a.shared_publisher->open(per_device(AppConfig::sharedMemoryName, a.device), AppConfig::sharedRingSamples, a.calibration);
+
+    // A reconfigure() meanwhile waits in pending_pipeline and replaces it at the first block
+    while (!a.live_pipeline.load() && !a.stop_streaming.load()) {
+        if (Pipeline* p = build_pipeline(a, a.startup_config, a.pool->size())) {
+            a.live_pipeline.store(p, std::memory_order_release);
+            break;
+        }
+        qWarning() << "[FFTProcess] Device" << a.device << "not opened without a pipeline, retrying every"
+                   << AppConfig::deviceRetryMs << "ms";
+        wait_for_retry(a);
+    }
+    if (!a.live_pipeline.load())
+        return false;
+    if (!AppConfig::stageGraph.empty())
+        a.self->setStageGraph(AppConfig::stageGraph);
+
+    qDebug() << "[FFTProcess] Device" << a.device << "pipeline ready";
+    return true;
+}
+
+// Worker thread: open the device, stream until it goes away, look for it again. Pipelines,
+// history and every other piece of state stay as they are; the sample timeline just logs a gap.
+// libri hands out units in its enumeration order, one per ri_open_device call, and reports
+// nothing (no serial) that tells them apart. The watchers take turns so device n makes the n-th
+// call and gets the n-th unit libri enumerates, whichever pipeline happens to be built first;
+// until devices 0..n-1 hold their unit (or while one of them is unplugged) device n waits.
+// With one device configured a replug is the same unit; with several, a lost device is not
+// reopened (DeviceState::Lost): the next unit libri hands out could be any of them, and its
+// stream would land in this device's pipeline, calibration and shared memory.
+static void watch_device(Acquisition& a)
+{
+    pthread_mutex_lock(&ri_mutex);
+    if (ri_users++ == 0)
+        ri_init();
+    pthread_mutex_unlock(&ri_mutex);
+
+    bool lost = false;
+    bool had_turn = false;
+    while (!a.stop_streaming.load()) {
+        pthread_mutex_lock(&ri_mutex);
+        if (!had_turn && ri_open_turn < a.device) {
+            pthread_mutex_unlock(&ri_mutex);
+            QThread::msleep(50);  // a lower-numbered device hasn't got its unit yet
+            continue;
+        }
+        ri_device* device = ri_open_device();
+        if (device) {
+            ++ri_open_handles;
+            if (!had_turn) {
+                had_turn = true;
+                ri_open_turn = a.device + 1;
+            }
+        } else if (ri_open_handles == 0) {  // nothing streams: rescan so a unit plugged in meanwhile shows up
+            ri_exit();
+            ri_init();
+        }
+        pthread_mutex_unlock(&ri_mutex);
+        if (!device) {
+            if (a.device_state.exchange(lost ? DeviceState::Reconnecting : DeviceState::Searching) == DeviceState::Initializing)
+                qWarning() << "[FFTProcess] RI device" << a.device << "not found, retrying every" << AppConfig::deviceRetryMs << "ms";
+            wait_for_retry(a);
+            continue;
+        }
+
+        if (lost) {
+            a.device_resumed.store(true);
+            a.reconnect_count.fetch_add(1);
+            qDebug() << "[FFTProcess] Device" << a.device << "reconnected, resuming";
+        }
+        a.device_state.store(DeviceState::Streaming);
+
+        ri_start_continuous_transfer(device, transfer_callback, &a);  // blocks until stop_streaming or the device is lost
+        pthread_mutex_lock(&ri_mutex);
+        ri_close_device(device);
+        --ri_open_handles;
+        pthread_mutex_unlock(&ri_mutex);
+
+        if (!a.stop_streaming.load()) {
+            if (AppConfig::devices.size() > 1) {
+                qWarning() << "[FFTProcess] Device" << a.device << "lost; with" << AppConfig::devices.size()
+                           << "devices configured a replugged unit can't be identified, restart to reopen it";
+                a.device_state.store(DeviceState::Lost);
+                break;
+            }
+            qWarning() << "[FFTProcess] Device" << a.device << "lost, waiting for it to come back";
+            lost = true;
+            a.device_state.store(DeviceState::Reconnecting);
+            wait_for_retry(a);  // the next failed open rescans the bus
+        }
+    }
+
+    pthread_mutex_lock(&ri_mutex);
+    if (--ri_users == 0)
+        ri_exit();
+    pthread_mutex_unlock(&ri_mutex);
 }
 
 FFTProcess::~FFTProcess()
 {
+    // Stop the transfer first so no new frames reach the pool
+    acq->stop_streaming.store(true);
+    acq->emit_peaks.store(false);
+
     workerThread.quit();
     workerThread.wait();
-    // NOTE: You could use pthread_cancel on threads if graceful stop is needed
+
+    delete acq->sample_recorder;  // flushes a running recording, needs the pool for its last chunks
+    acq->sample_recorder = nullptr;
+
+    // The workers finish what is queued, so what this device retired drains and Epoch frees it the
+    // usual way; Epoch is process-wide, and reclaimAll would free what other devices still stream through
+    while (acq->retired.load() > 0) {
+        Epoch::collect();
+        QThread::msleep(1);
+    }
+
+    acq->pool->shutdown();
+    delete acq->pool;
+    acq->pool = nullptr;
+
+    delete acq->shared_publisher;  // workers are gone, nothing publishes any more
+    acq->shared_publisher = nullptr;
+    delete acq->stage_graph.exchange(nullptr);
+
+    delete acq->zoom_fft;
+    if (acq->zoom_capture)
+        HugePages::release(acq->zoom_capture, acq->zoom_capacity * sizeof(uint16_t));
+    delete acq->tone_tracker;
+    delete acq->persistence;  // after the pool: its batches run there
+
+    // Nothing can reach these any more, frames the pool dropped never drain
+    delete acq->pending_pipeline.exchange(nullptr);
+    delete acq->live_pipeline.exchange(nullptr);
+
+    delete acq->event_log;  // after the pipelines, their detectors log the events still open
+    delete acq;
 }
 
 void FFTProcess::start()
@@ -162,39 +910,443 @@ void FFTProcess::start()
     }
 
     connect(&workerThread, &QThread::started, this, [this]() {
-        qDebug() << "[FFTProcess] Thread started";
+        qDebug() << "[FFTProcess] Device" << acq->device << "thread started";
 
-        internalMode = currentMode;
-        fft_instance = this;
-        peak_callback = emit_peak;
+        acq->emit_peaks.store(true);
 
-        ri_init();
-        ri_device* device = ri_open_device();
-        if (!device) {
-            qWarning("RI device not found");
+        if (initialize_resources(*acq))
+            watch_device(*acq);  // returns once stop_streaming is set
+        qDebug() << "[FFTProcess] Device" << acq->device << "transfer stopped";
+    });
+
+    workerThread.start();
+}
+
+void FFTProcess::reconfigure(const PipelineConfig& config)
+{
+    // Plans, buffers and history rings (up to spectrumHistoryMaxMB per chain) take a while: they are built on
+    // the pool, not here, and the callback only swaps a pointer. The device's worker thread can't take the
+    // job, it is parked in watch_device for as long as the device streams.
+    Acquisition* a = acq;
+    const uint64_t request = a->build_requests.fetch_add(1) + 1;
+    a->pool->submit([a, config, request]() {
+        Pipeline* next = build_pipeline(*a, config, a->pool->size());
+        if (!next) {
+            qWarning() << "[FFTProcess] Device" << a->device << "keeps its current pipeline";
             return;
         }
-
-        static int64_t dummy = 0;
-        ri_start_continuous_transfer(device, transfer_callback, &dummy);
+        if (a->build_requests.load() != request) {  // the user changed it again meanwhile, that build wins
+            delete next;
+            return;
+        }
+        delete a->pending_pipeline.exchange(next, std::memory_order_acq_rel);  // superseded before it was ever live
     });
 
-    workerThread.start();
+    Epoch::collect();
+}
+
+bool FFTProcess::setStageGraph(const std::vector<std::string>& spec, std::string* error)
+{
+    StageGraph* next = nullptr;
+    if (!spec.empty()) {
+        std::string why;
+        next = StageGraph::build(spec, acq->pool, &why);
+        if (!next) {
+            qWarning() << "[FFTProcess] Stage graph rejected:" << why.c_str();
+            if (error)
+                *error = why;
+            return false;
+        }
+    }
+
+    StageGraph* previous = acq->stage_graph.exchange(next, std::memory_order_acq_rel);
+    if (previous) {
+        Acquisition* a = acq;
+        a->retired.fetch_add(1);
+        Epoch::retire([a, previous]() { a->retired.fetch_sub(1); delete previous; }, [previous]() { return previous->drained(); });
+    }
+    Epoch::collect();
+    return true;
+}
+
+std::vector<std::string> FFTProcess::stageBranches() const
+{
+    Epoch::Guard guard;
+    StageGraph* graph = acq->stage_graph.load();
+    return graph ? graph->branchNames() : std::vector<std::string>();
+}
+
+bool FFTProcess::stageOutput(const std::string& branch, std::vector<double>& values, StageOutputInfo* info)
+{
+    Epoch::Guard guard;
+    StageGraph* graph = acq->stage_graph.load();
+    return graph && graph->output(branch, values, info);
+}
+
+ToneTracker& FFTProcess::tones()
+{
+    return *acq->tone_tracker;
+}
+
+SampleRecorder& FFTProcess::recorder()
+{
+    return *acq->sample_recorder;
+}
+
+Persistence& FFTProcess::persistence()
+{
+    return *acq->persistence;
+}
+
+PipelineConfig FFTProcess::pipelineConfig() const
+{
+    Epoch::Guard guard;
+    const Pipeline* p = acq->live_pipeline.load();
+    return p ? p->config : acq->startup_config;
 }
 
 bool FFTProcess::getMagnitudes(double* dst, int count)
 {
-    if (fft_data_ready.exchange(0) == 0)
+    Epoch::collect();  // frees pipelines swapped out by the callback once they drain
+
+    Epoch::Guard guard;
+    AnalysisChain* c = viewed(acq->live_pipeline.load());
+    if (!c || c->data_ready.exchange(0) == 0)
         return false;
 
-    for (int i = 0; i < count && i < AppConfig::fftBins; ++i)
-        dst[i] = fft_magnitude_buffer[i];
+    for (int i = 0; i < count && i < c->bins; ++i)
+        dst[i] = c->magnitudes[i];
+
+    return true;
+}
+
+bool FFTProcess::copySpectrum(int chain, double* dst, int count)
+{
+    Epoch::Guard guard;
+    Pipeline* p = acq->live_pipeline.load();
+    if (!p || chain < 0 || chain >= static_cast<int>(p->chains.size()))
+        return false;
+
+    const AnalysisChain& c = *p->chains[chain];
+    for (int i = 0; i < count && i < c.bins; ++i)
+        dst[i] = c.magnitudes[i];
+    return true;
+}
+
+bool FFTProcess::getTrace(SpectrumTrace trace, double* dst, int count)
+{
+    Epoch::Guard guard;
+    AnalysisChain* c = viewed(acq->live_pipeline.load());
+    return c && c->traces.read(trace, dst, count);
+}
+
+void FFTProcess::resetTraces()
+{
+    Epoch::Guard guard;
+    for (auto& chain : live_chains(*acq))
+        chain->traces.reset();
+}
+
+void FFTProcess::freezeHistory(bool frozen)
+{
+    acq->history_frozen.store(frozen);
+}
+
+bool FFTProcess::historyRange(uint64_t& first, uint64_t& last)
+{
+    Epoch::Guard guard;
+    const AnalysisChain* c = viewed(acq->live_pipeline.load());
+    return c && c->history->range(first, last);
+}
 
+bool FFTProcess::historyFrame(uint64_t seq, double* dst, int count, double* seconds, uint8_t* flags)
+{
+    Epoch::Guard guard;
+    const AnalysisChain* c = viewed(acq->live_pipeline.load());
+    uint64_t stamp = 0;
+    if (!c || !c->history->readMagnitudes(seq, dst, count, &stamp, flags))
+        return false;
+    if (seconds)
+        *seconds = stamp / AppConfig::adcSampleRate;
     return true;
 }
 
-void FFTProcess::setMode(FFTMode mode)
+int FFTProcess::copyHistory(uint64_t first, uint64_t last, std::vector<int16_t>& codes, std::vector<uint64_t>& stamps)
+{
+    Epoch::Guard guard;
+    const AnalysisChain* c = viewed(acq->live_pipeline.load());
+    codes.clear();
+    stamps.clear();
+    if (!c)
+        return 0;
+    const SpectrumHistory& h = *c->history;
+
+    codes.resize(static_cast<size_t>(last - first + 1) * h.bins());
+    stamps.clear();
+    for (uint64_t seq = first; seq <= last; ++seq) {
+        uint64_t stamp = 0;
+        if (h.read(seq, codes.data() + stamps.size() * h.bins(), &stamp))
+            stamps.push_back(stamp);  // frames overwritten meanwhile are skipped
+    }
+    codes.resize(stamps.size() * h.bins());
+    return static_cast<int>(stamps.size());
+}
+
+int FFTProcess::chainCount() const
+{
+    Epoch::Guard guard;
+    const Pipeline* p = acq->live_pipeline.load();
+    return static_cast<int>(p ? p->chains.size() : acq->startup_config.chains.size());
+}
+
+AnalysisChainConfig FFTProcess::chainConfig(int index) const
 {
-    currentMode = mode;
-    internalMode = mode;
+    Epoch::Guard guard;
+    const Pipeline* p = acq->live_pipeline.load();
+    if (p)
+        return p->chains[std::clamp(index, 0, static_cast<int>(p->chains.size()) - 1)]->cfg;
+
+    // Not built yet: the rate it will run at
+    AnalysisChainConfig cfg = acq->startup_config.chains[std::clamp(index, 0, static_cast<int>(acq->startup_config.chains.size()) - 1)];
+    cfg.sampleRate = AppConfig::adcSampleRate / chain_decimation(cfg);
+    return cfg;
+}
+
+void FFTProcess::setActiveChain(int index)
+{
+    Epoch::Guard guard;
+    Pipeline* p = acq->live_pipeline.load();
+    if (!p) {
+        acq->viewed_chain.store(std::clamp(index, 0, static_cast<int>(acq->startup_config.chains.size()) - 1));
+        return;
+    }
+    index = std::clamp(index, 0, static_cast<int>(p->chains.size()) - 1);
+    acq->viewed_chain.store(index);
+    p->chains[index]->data_ready.store(1);  // show its latest spectrum right away
+    if (p->chains[index]->correlator)
+        p->chains[index]->correlator->reset();  // whatever it measured while last viewed is stale
+}
+
+int FFTProcess::activeChain() const
+{
+    return acq->viewed_chain.load();
+}
+
+void FFTProcess::setBackpressurePolicy(BackpressurePolicy policy)
+{
+    acq->bp_policy.store(policy);
+    if (policy == BackpressurePolicy::AdaptiveHop)
+        return;
+
+    Epoch::Guard guard;
+    for (auto& chain : live_chains(*acq))
+        chain->active_hop.store(chain->hopSize);
+}
+
+double FFTProcess::effectiveOverlap()
+{
+    Epoch::Guard guard;
+    const AnalysisChain* c = viewed(acq->live_pipeline.load());
+    if (!c)
+        return lastOverlap;
+    const uint64_t samples = c->samples_advanced.load(std::memory_order_relaxed);
+    const uint64_t frames = c->frames_processed.load(std::memory_order_relaxed);
+
+    if (c != lastChain) {  // counters are per chain, and a swap brings new chains
+        lastChain = c;
+        lastSamplesAdvanced = samples;
+        lastFramesProcessed = frames;
+        return lastOverlap;
+    }
+
+    const uint64_t dSamples = samples - lastSamplesAdvanced;
+    const uint64_t dFrames = frames - lastFramesProcessed;
+    lastSamplesAdvanced = samples;
+    lastFramesProcessed = frames;
+
+    if (dFrames == 0)
+        return lastOverlap;
+
+    // negative once samples fall between processed frames
+    const double hop = static_cast<double>(dSamples) / static_cast<double>(dFrames);
+    lastOverlap = 1.0 - hop / c->cfg.fftSize;
+    return lastOverlap;
+}
+
+void FFTProcess::setZoomBand(double centerHz, double spanHz)
+{
+    if (spanHz > 0.0)
+        spanHz = std::max(spanHz, ZoomFFT::minimumSpan(AppConfig::adcSampleRate, AppConfig::zoomFftSize,
+                                                        AppConfig::zoomMaxCaptureSamples));
+
+    pthread_mutex_lock(&acq->zoom_mutex);
+    acq->zoom_center = centerHz;
+    acq->zoom_span = spanHz;
+    pthread_mutex_unlock(&acq->zoom_mutex);
+}
+
+bool FFTProcess::getZoomSpectrum(std::vector<double>& freqsHz, std::vector<double>& mags)
+{
+    pthread_mutex_lock(&acq->zoom_mutex);
+    const double center = acq->zoom_center;
+    const double span = acq->zoom_span;
+    const bool active = acq->zoom_span > 0.0;
+    const bool current = active && acq->zoom_done_center == acq->zoom_center && acq->zoom_done_span == acq->zoom_span;
+    if (current) {
+        freqsHz = acq->zoom_freqs;
+        mags = acq->zoom_mags;
+    }
+    pthread_mutex_unlock(&acq->zoom_mutex);
+
+    // Keep one capture in flight while zoomed
+    if (active && acq->pool && !acq->zoom_busy.exchange(true) && !arm_zoom(*acq, center, span))
+        acq->zoom_busy.store(false);
+
+    return current;
+}
+
+bool FFTProcess::correlation(CorrelationResult& result, std::vector<double>* autocorr, std::vector<double>* cross)
+{
+    Epoch::Guard guard;
+    AnalysisChain* c = viewed(acq->live_pipeline.load());
+    return c && c->correlator && c->correlator->result(result, autocorr, cross);
+}
+
+void FFTProcess::setCorrelationReference(const std::vector<double>& pulse)
+{
+    pthread_mutex_lock(&acq->correlation_mutex);
+    acq->correlation_pulse = pulse;
+    pthread_mutex_unlock(&acq->correlation_mutex);
+
+    Epoch::Guard guard;
+    for (auto& chain : live_chains(*acq))
+        if (chain->correlator)
+            chain->correlator->setReference(pulse);
+}
+
+void FFTProcess::captureCorrelationReference()
+{
+    Epoch::Guard guard;
+    AnalysisChain* c = viewed(acq->live_pipeline.load());
+    if (c && c->correlator)
+        c->correlator->captureReference();
+}
+
+EventLog& FFTProcess::events()
+{
+    return *acq->event_log;
+}
+
+void FFTProcess::setEventSettings(const EventSettings& settings)
+{
+    pthread_mutex_lock(&acq->event_mutex);
+    acq->event_settings = settings;
+    pthread_mutex_unlock(&acq->event_mutex);
+
+    Epoch::Guard guard;
+    for (auto& chain : live_chains(*acq))
+        if (chain->events)
+            chain->events->configure(settings);
+}
+
+DeviceState FFTProcess::deviceState() const
+{
+    return acq->device_state.load();
+}
+
+uint64_t FFTProcess::reconnects() const
+{
+    return acq->reconnect_count.load();
+}
+
+uint64_t FFTProcess::droppedFrames() const
+{
+    Epoch::Guard guard;
+    uint64_t total = 0;
+    for (auto& chain : live_chains(*acq))
+        total += chain->frames_dropped.load(std::memory_order_relaxed);
+    return total;
+}
+
+PipelineMemory FFTProcess::pipelineMemory() const
+{
+    Epoch::Guard guard;
+    PipelineMemory m;
+    const Pipeline* p = acq->live_pipeline.load(std::memory_order_acquire);
+    if (!p)
+        return m;
+    m.frames = p->arena.bytes(ArenaUse::Frames);
+    m.spectra = p->arena.bytes(ArenaUse::Spectra);
+    m.history = p->arena.bytes(ArenaUse::History);
+    m.scratch = p->arena.bytes(ArenaUse::Scratch);
+    m.mapped = p->arena.mappedBytes();
+    m.huge = p->arena.hugeBytes();
+    return m;
+}
+
+int FFTProcess::device() const
+{
+    return acq->device;
+}
+
+SampleTimeline& FFTProcess::timeline()
+{
+    return acq->timeline;
+}
+
+AdcCalibration& FFTProcess::calibration()
+{
+    return acq->calibration;
+}
+
+// Pulses on a noisy baseline, roughly what a DPD80 sees: the FFTs cost the same on any data,
+// but the event detectors, trigger and tone tracker get something to work on
+static std::vector<uint16_t> synthetic_stream(size_t samples)
+{
+    std::vector<uint16_t> out(samples);
+    std::mt19937 rng(12345);
+    std::normal_distribution<double> noise(0.0, 40.0);
+    const double period = AppConfig::adcSampleRate / 1e6;  // 1 MHz repetition
+    for (size_t i = 0; i < samples; ++i) {
+        const double pulse = 8000.0 * std::exp(-std::fmod(static_cast<double>(i), period) / 6.0);
+        out[i] = static_cast<uint16_t>(std::clamp(AppConfig::adcOffset + pulse + noise(rng), 0.0, 65535.0));
+    }
+    return out;
+}
+
+BenchmarkResult FFTProcess::benchmark(double seconds)
+{
+    constexpr int kBlock = 1 << 16;  // samples per callback, a typical libri transfer
+    BenchmarkResult r;
+    if (workerThread.isRunning()) {
+        qWarning() << "[FFTProcess] Device" << acq->device << "is streaming, no benchmark";
+        return r;
+    }
+
+    if (acq->time && acq->time->memoryBytes() == 0)
+        acq->time->resize(static_cast<int>(AppConfig::timeWindowSeconds * AppConfig::adcSampleRate));
+    if (!initialize_resources(*acq))
+        return r;
+    std::vector<uint16_t> stream = synthetic_stream(16 * kBlock);
+
+    const auto begin = std::chrono::steady_clock::now();
+    auto elapsed = [&begin]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    };
+    for (size_t offset = 0; elapsed() < seconds; offset = (offset + kBlock) % stream.size()) {
+        transfer_callback(stream.data() + offset, kBlock, 0, acq);
+        r.samples += kBlock;
+    }
+
+    // Frames still queued count towards the time they take
+    Epoch::Guard guard;
+    const Pipeline* p = acq->live_pipeline.load(std::memory_order_acquire);
+    while (p->inflight.load(std::memory_order_acquire) > 0)
+        QThread::msleep(1);
+    r.seconds = elapsed();
+    for (auto& chain : p->chains) {
+        r.framesProcessed += chain->frames_processed.load(std::memory_order_relaxed);
+        r.framesDropped += chain->frames_dropped.load(std::memory_order_relaxed);
+    }
+    return r;
 }
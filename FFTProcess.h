@@ -1,33 +1,153 @@
 #ifndef FFTPROCESS_H
 #define FFTPROCESS_H
-#define NUM_FFT_THREADS 3
 
 
 #include <QObject>
 #include <QThread>
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <string>
 #include <vector>
-#include "Features.h"  // for FFTMode
+#include "AppConfig.h"
+#include "SpectrumAccumulator.h"
 
+class TimeDProcess;
+class SampleTimeline;
+class AdcCalibration;
+class ToneTracker;
+class SampleRecorder;
+class Persistence;
+struct StageOutputInfo;
+struct CorrelationResult;
+class EventLog;
+struct EventSettings;
+struct Acquisition;
+
+enum class DeviceState {
+    Initializing,  // buffers and plans are still being built
+    Searching,     // no device yet, retried every AppConfig::deviceRetryMs
+    Streaming,
+    Reconnecting,  // the device went away, state is kept until it's back
+    Lost,          // went away with other devices configured: a replugged unit can't be told apart, restart to reopen
+};
+
+// Everything a running pipeline depends on, snapshotted from AppConfig and never mutated
+struct PipelineConfig {
+    std::vector<AnalysisChainConfig> chains = AppConfig::analysisChains;
+    FFTWindow window = AppConfig::fftWindow;
+    double overlapFraction = AppConfig::fftOverlapFraction;
+};
+
+// Bytes the live pipeline's arena handed out, by use, and what it mapped for them
+struct PipelineMemory {
+    size_t frames = 0;
+    size_t spectra = 0;
+    size_t history = 0;
+    size_t scratch = 0;
+    size_t mapped = 0;  // chunk tails included
+    size_t huge = 0;    // of mapped, on huge pages
+};
+
+// What benchmark() pushed through the pipeline, all chains together
+struct BenchmarkResult {
+    uint64_t samples = 0;
+    double seconds = 0.0;
+    uint64_t framesProcessed = 0;
+    uint64_t framesDropped = 0;  // by back-pressure
+};
+
+/*
+ * One device: its acquisition, time ring feed, pipeline, DSP pool and every
+ * per-stream analysis. Nothing is shared between instances, so one per
+ * AppConfig::devices entry streams several detectors at once.
+ */
 class FFTProcess : public QObject {
     Q_OBJECT
 
 public:
-    explicit FFTProcess(QObject *parent = nullptr);
+    // time: the device's time ring, fed by the callback; device: index into AppConfig::devices
+    explicit FFTProcess(TimeDProcess *time, int device = 0, QObject *parent = nullptr);
     ~FFTProcess();
 
+    // Builds the pipeline on the worker thread, then opens the device and keeps
+    // reconnecting it whenever it goes away. Getters return nothing until the first build.
     void start();
-    bool getMagnitudes(double *dst, int count);
-    void setMode(FFTMode mode);
+    DeviceState deviceState() const;
+    uint64_t reconnects() const;
+    int device() const;
+
+    SampleTimeline &timeline();      // this device's sample clock
+    AdcCalibration &calibration();  // this device's code <-> µW scale and zero point
+
+    // Instead of start(): feeds synthetic DPD80 blocks through the callback path on the calling
+    // thread as fast as the pipeline takes them, for `seconds`, then waits for the queued frames
+    BenchmarkResult benchmark(double seconds);
+    bool getMagnitudes(double *dst, int count);  // spectrum of the viewed chain
+    bool copySpectrum(int chain, double *dst, int count);  // latest spectrum of any chain, leaves data_ready alone
+
+    // Returns at once: a new pipeline is built on the DSP pool, the callback swaps it in
+    // at the next block boundary and the old one is freed once its frames drain
+    void reconfigure(const PipelineConfig &config);
+    PipelineConfig pipelineConfig() const;  // the one currently live
+
+    // Extra analyses as a StageGraph spec (see StageGraph.h), swapped in like a pipeline; empty = none.
+    // A spec that doesn't build leaves the running graph alone.
+    bool setStageGraph(const std::vector<std::string> &spec, std::string *error = nullptr);
+    std::vector<std::string> stageBranches() const;
+    bool stageOutput(const std::string &branch, std::vector<double> &values, StageOutputInfo *info = nullptr);
+
+    // All chains run concurrently; switching the view never touches acquisition
+    int chainCount() const;
+    AnalysisChainConfig chainConfig(int index) const;  // sampleRate is the exact decimated rate
+    void setActiveChain(int index);
+    int activeChain() const;
+
+    // Hold/average traces of the viewed chain, accumulated from every frame (not just the drawn ones)
+    bool getTrace(SpectrumTrace trace, double *dst, int count);
+    void resetTraces();  // all chains
+
+    // History ring of the viewed chain: every frame as int16 dB, frozen while paused.
+    // Frames are addressed by sequence number; stamps and seconds are on the SampleTimeline clock.
+    void freezeHistory(bool frozen);
+    bool historyRange(uint64_t &first, uint64_t &last);
+    bool historyFrame(uint64_t seq, double *dst, int count, double *seconds, uint8_t *flags = nullptr);
+    int copyHistory(uint64_t first, uint64_t last, std::vector<int16_t> &codes, std::vector<uint64_t> &stamps);
+
+    void setBackpressurePolicy(BackpressurePolicy policy);
+    double effectiveOverlap();  // overlap actually achieved since the previous call
+    uint64_t droppedFrames() const;  // by back-pressure, all chains of the live pipeline
+    PipelineMemory pipelineMemory() const;  // zero until the first build
+
+    // Zoom FFT over [center - span/2, center + span/2] Hz of the ADC stream, span 0 = off
+    void setZoomBand(double centerHz, double spanHz);
+    bool getZoomSpectrum(std::vector<double> &freqsHz, std::vector<double> &mags);  // true once the band has a result
+
+    // Period, jitter and reference match of the viewed chain, from the autocorrelation of its frames
+    // (see Correlator.h); traces are refreshed by the frame after each request
+    bool correlation(CorrelationResult &result, std::vector<double> *autocorr = nullptr, std::vector<double> *cross = nullptr);
+    void setCorrelationReference(const std::vector<double> &pulse);  // chain-rate samples, empty = none
+    void captureCorrelationReference();  // the viewed chain's next frame, kept until the pipeline is rebuilt
+
+    // Spectral events of every chain, every frame (see EventDetector.h), logged lock-free
+    EventLog &events();
+    void setEventSettings(const EventSettings &settings);  // all chains, kept for rebuilt pipelines
+
+    ToneTracker &tones();  // fed from the time ring on the DSP pool
+    SampleRecorder &recorder();  // lossless raw capture, encoded on the DSP pool
+    Persistence &persistence();  // digital-phosphor image of every waveform, drawn on the DSP pool
 
 Q_SIGNALS:
-    void peakFrequencyUpdated(double frequency);
+    void peakFrequencyUpdated(double frequency, uint64_t stamp);  // stamp: SampleTimeline index just past the frame
 
 private:
-    FFTMode currentMode = FFTMode::FullBandwidth;
     QThread workerThread;
-    pthread_t fftThreads[NUM_FFT_THREADS]; // store FFT thread handles
+    Acquisition *acq;  // all per-device state, its DSP pool is joined in the destructor
+
+    const void *lastChain = nullptr;  // chain the overlap counters belong to
+    uint64_t lastSamplesAdvanced = 0;
+    uint64_t lastFramesProcessed = 0;
+    double lastOverlap = AppConfig::fftOverlapFraction;
 
 };
 
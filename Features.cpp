@@ -1,8 +1,9 @@
 #include "Features.h"
 #include "AppConfig.h"
+#include "ExportEngine.h"
+#include "FFTProcess.h"
+#include "TimeDProcess.h"
 
-#include <QFile>
-#include <QTextStream>
 #include <QFileDialog>
 #include <QInputDialog>
 #include <QLabel>
@@ -11,111 +12,74 @@
 #include <QDir>
 #include <QFileInfo>
 
-#include <cmath>
-#include <algorithm>
+#include <utility>
 
 void Features::togglePause(bool &isPaused) { // flip state
     isPaused = !isPaused;
     qDebug() << "[Features] Pause toggled. isPaused =" << isPaused;
 }
 
-// button function
-void Features::switchMode(FFTMode &mode) { // mode switch, adjust Psuedo Sample rate
-    if (mode == FFTMode::FullBandwidth)
-        mode = FFTMode::LowBandwidth;
-    else
-        mode = FFTMode::FullBandwidth;
+// view selector: every chain keeps running, only the displayed rate changes
+void Features::selectChain(int index, double chainSampleRate) {
+    AppConfig::sampleRate = chainSampleRate;
 
-    AppConfig::sampleRate = (mode == FFTMode::FullBandwidth) ? 80e6 : 200000;
-
-    qDebug() << "[Features] Mode switched to:"<< (mode == FFTMode::FullBandwidth ? "FullBandwidth" : "LowBandwidth");
+    qDebug() << "[Features] Viewing chain" << index << "at" << chainSampleRate << "Hz";
 }
 
-void Features::saveFFTPlot(const QString &fileName,const double *fftBuffer, double sampleRate)
+void Features::promptUserToSavePlot(QWidget *parent, ExportEngine *exporter, std::vector<double> fftBuffer, int fftSize,
+                                    TimeDProcess *time, const AdcCalibration &calibration) // ask user what plot, maybe do this before?
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        qWarning() << "[Features] Failed to open file:" << fileName;
-        return;
-    }
-
-    QTextStream out(&file);
-
-    if (sampleRate > 1e6)
-        out << "Frequency (MHz),Log Magnitude\n";
-    else
-        out << "Frequency (KHz),Log Magnitude\n";
-
-    const int bins = AppConfig::fftBins;
-    const double eps = AppConfig::epsilon;
-    const int fftSize = AppConfig::fftSize;
-
-    for (int i = 0; i < bins; ++i) {
-        double freq = i * (sampleRate / fftSize);
-        freq /= (sampleRate > 1e6) ? 1e6 : 1e3;
-
-        double mag = std::max(fftBuffer[i], eps);
-        out << freq << "," << std::log10(mag) << "\n";
-    }
+    QSettings settings("Ultracoustics", "RealtimePlotApp");
+    QString lastDir = settings.value("lastSavePath", QDir::homePath()).toString();
 
-    file.close();
-    qDebug() << "[Features] FFT plot saved to" << fileName;
-}
+    QString fileName = QFileDialog::getSaveFileName(parent, "Save Plot Data", lastDir,"Text File (*.txt);;CSV File (*.csv);;Raw Binary (*.raw)");
 
-void Features::saveTimePlot(const QString &fileName,const std::vector<uint16_t> &buffer,
-double sampleRate, double timeWindowSeconds)
-{
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        qWarning() << "[Features] Failed to open file:" << fileName;
-        return;
-    }
+    if (fileName.isEmpty()) return;
+    settings.setValue("lastSavePath", QFileInfo(fileName).absolutePath());
 
-    QTextStream out(&file);
-    out << "Time (us),Power (uW)\n";
+    QString choice = QInputDialog::getItem(parent, "Select Plot", "Choose which Plot data to export:",
+    {"Save Time-Domain Plot", "Save Frequency (FFT) Plot"}, 0, false);
 
-    const double dt_us = 1e6 / sampleRate;
-    const double offset = AppConfig::adcOffset;
-    const double scale = AppConfig::adcToMicroWatts;
+    if (choice.isEmpty()) return;
 
-    for (int i = 0; i < static_cast<int>(buffer.size()); ++i) {
-        double time_us = i * dt_us;
-        double power_uW = (static_cast<double>(buffer[i]) - offset) * scale; // unreliable scaling
-        out << time_us << "," << power_uW << "\n";
+    if (choice == "Save Time-Domain Plot") {
+        const uint64_t count = static_cast<uint64_t>(time->sampleCount());
+        const uint64_t end = time->writeCursor();
+        exporter->exportTime(fileName, *time, end - std::min(count, end), std::min(count, end), AppConfig::adcSampleRate, calibration);
+    } else {
+        exporter->exportSpectrum(fileName, std::move(fftBuffer), fftSize, AppConfig::sampleRate);
     }
-
-    file.close();
-    qDebug() << "[Features] Time-domain plot saved to" << fileName;
 }
 
-void Features::promptUserToSavePlot(QWidget *parent,const double *fftBuffer,const std::vector<uint16_t> &timeBuffer) // ask user what plot, maybe do this before?
+void Features::promptUserToSaveHistory(QWidget *parent, ExportEngine *exporter, FFTProcess *fft, uint64_t first, uint64_t last)
 {
     QSettings settings("Ultracoustics", "RealtimePlotApp");
     QString lastDir = settings.value("lastSavePath", QDir::homePath()).toString();
 
-    QString fileName = QFileDialog::getSaveFileName(parent, "Save Plot Data", lastDir,"Text File (*.txt);;CSV File (*.csv);;Raw Binary (*.raw)");
+    QString fileName = QFileDialog::getSaveFileName(parent, "Save Spectrum History", lastDir,"Text File (*.txt);;CSV File (*.csv);;Raw Binary (*.raw)");
 
     if (fileName.isEmpty()) return;
     settings.setValue("lastSavePath", QFileInfo(fileName).absolutePath());
 
-    QString choice = QInputDialog::getItem(parent, "Select Plot", "Choose which Plot data to export:",
-    {"Save Time-Domain Plot", "Save Frequency (FFT) Plot"}, 0, false);
-
-    if (choice.isEmpty()) return;
-
-    if (choice == "Save Time-Domain Plot") {
-        Features::saveTimePlot(fileName, timeBuffer, AppConfig::sampleRate, AppConfig::timeWindowSeconds);
-    } else {
-        Features::saveFFTPlot(fileName, fftBuffer, AppConfig::sampleRate);
+    std::vector<int16_t> codes;
+    std::vector<uint64_t> stamps;
+    const int frames = fft->copyHistory(first, last, codes, stamps);
+    if (frames == 0) {
+        qWarning() << "[Features] No history frames left in range" << first << "-" << last;
+        return;
     }
+
+    const AnalysisChainConfig chain = fft->chainConfig(fft->activeChain());
+    qDebug() << "[Features] Exporting" << frames << "history frames";
+    exporter->exportHistory(fileName, std::move(codes), std::move(stamps), chain.fftSize, chain.sampleRate);
 }
 
-void Features::updatePeakFrequency(QLabel *label, FFTMode mode, double frequency, bool isPaused)  // connected to FFT function, get teh higest magnitude's freq abd display
+void Features::updatePeakFrequency(QLabel *label, double sampleRate, double frequency, bool isPaused)  // connected to FFT function, get teh higest magnitude's freq abd display
 {
     if (!label) return;
     if (isPaused) return; // stop with plot
 
-    QString unit = (mode == FFTMode::LowBandwidth) ? "kHz" : "MHz";
+    QString unit = (sampleRate > 1e6) ? "MHz" : "kHz";
     QString text = QString("Peak: %1 %2").arg(frequency, 0, 'f', 2).arg(unit);
 
     label->setText(text);
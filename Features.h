@@ -9,20 +9,25 @@
 #include <QWidget>
 #include <QLabel>
 
-enum class FFTMode { FullBandwidth = 0, LowBandwidth = 1 };
+class ExportEngine;
+class FFTProcess;
+class AdcCalibration;
+class TimeDProcess;
 
 class Features {
 public:
     static void togglePause(bool &isPaused);
-    static void switchMode(FFTMode &mode);
+    static void selectChain(int index, double chainSampleRate);
 
-    static void saveFFTPlot(const QString &fileName, const double *fftBuffer, double sampleRate);
+    // Asks for a file and plot, then queues the export; the spectrum is handed to the engine, the time
+    // window only as a sample range the engine reads from `time` itself
+    static void promptUserToSavePlot(QWidget *parent, ExportEngine *exporter, std::vector<double> fftBuffer, int fftSize,
+                                     TimeDProcess *time, const AdcCalibration &calibration);
 
-    static void saveTimePlot(const QString &fileName,const std::vector<uint16_t> &buffer,double sampleRate, double timeWindowSeconds);
+    // Frames [first, last] of the viewed chain's history; copied out now, written by the engine
+    static void promptUserToSaveHistory(QWidget *parent, ExportEngine *exporter, FFTProcess *fft, uint64_t first, uint64_t last);
 
-    static void promptUserToSavePlot(QWidget *parent,const double *fftBuffer,const std::vector<uint16_t> &timeBuffer);
-
-    static void updatePeakFrequency(QLabel *label, FFTMode mode, double frequency, bool isPaused);
+    static void updatePeakFrequency(QLabel *label, double sampleRate, double frequency, bool isPaused);
 };
 
 #endif // FEATURES_H
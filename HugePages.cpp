@@ -0,0 +1,129 @@
+// HugePages.cpp
+#include "HugePages.h"
+
+#include <QDebug>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+constexpr size_t kHugePageSize = 2u << 20;  // 2 MB on x86-64
+
+std::atomic<size_t> bytes_in_use{0};
+std::atomic<size_t> huge_bytes_in_use{0};
+
+std::mutex huge_mutex;
+std::unordered_map<void *, bool> huge_blocks;  // ptr -> backed by huge pages
+
+size_t round_up(size_t bytes, size_t unit)
+{
+    return (bytes + unit - 1) / unit * unit;
+}
+
+void *map_pages(size_t bytes, bool tryHuge, bool &huge)
+{
+#ifdef _WIN32
+    const size_t large = tryHuge ? GetLargePageMinimum() : 0;
+    if (large) {
+        void *p = VirtualAlloc(nullptr, round_up(bytes, large),
+                               MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (p) {  // needs SeLockMemoryPrivilege, usually refused
+            huge = true;
+            return p;
+        }
+    }
+    huge = false;
+    return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    const size_t rounded = round_up(bytes, kHugePageSize);
+
+#ifdef MAP_HUGETLB
+    void *p = tryHuge ? mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)
+                      : MAP_FAILED;
+    if (p != MAP_FAILED) {  // only succeeds with a reserved hugetlbfs pool
+        huge = true;
+        return p;
+    }
+#endif
+
+    p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+
+    huge = false;
+#ifdef MADV_HUGEPAGE
+    huge = tryHuge && madvise(p, rounded, MADV_HUGEPAGE) == 0;  // THP: a hint, the kernel may still split
+#endif
+    return p;
+#endif
+}
+}
+
+void *HugePages::allocate(size_t bytes, bool *huge, bool tryHuge)
+{
+    if (bytes == 0)
+        return nullptr;
+
+    bool isHuge = false;
+    void *p = map_pages(bytes, tryHuge, isHuge);
+    if (!p) {
+        qWarning() << "[HugePages] Failed to map" << bytes << "bytes";
+        return nullptr;
+    }
+
+    bytes_in_use.fetch_add(bytes);
+    if (isHuge)
+        huge_bytes_in_use.fetch_add(bytes);
+
+    {
+        std::lock_guard<std::mutex> guard(huge_mutex);
+        huge_blocks[p] = isHuge;
+    }
+
+    if (huge)
+        *huge = isHuge;
+    return p;  // anonymous mappings come back zeroed
+}
+
+void HugePages::release(void *ptr, size_t bytes)
+{
+    if (!ptr)
+        return;
+
+    bool isHuge = false;
+    {
+        std::lock_guard<std::mutex> guard(huge_mutex);
+        auto it = huge_blocks.find(ptr);
+        if (it != huge_blocks.end()) {
+            isHuge = it->second;
+            huge_blocks.erase(it);
+        }
+    }
+
+    bytes_in_use.fetch_sub(bytes);
+    if (isHuge)
+        huge_bytes_in_use.fetch_sub(bytes);
+
+#ifdef _WIN32
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, round_up(bytes, kHugePageSize));
+#endif
+}
+
+size_t HugePages::bytesInUse()
+{
+    return bytes_in_use.load();
+}
+
+size_t HugePages::hugeBytesInUse()
+{
+    return huge_bytes_in_use.load();
+}
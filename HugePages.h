@@ -0,0 +1,23 @@
+// HugePages.h
+#ifndef HUGEPAGES_H
+#define HUGEPAGES_H
+
+#include <cstddef>
+
+/*!
+ * Large zeroed allocations for sample rings. Tries explicit huge pages
+ * (MAP_HUGETLB / MEM_LARGE_PAGES), then transparent huge pages, then plain
+ * pages. Keeps running totals so the UI can show what is actually mapped.
+ * With tryHuge off only plain pages are used.
+ */
+class HugePages
+{
+public:
+    static void *allocate(size_t bytes, bool *huge = nullptr, bool tryHuge = true);
+    static void  release(void *ptr, size_t bytes);
+
+    static size_t bytesInUse();
+    static size_t hugeBytesInUse();
+};
+
+#endif // HUGEPAGES_H
@@ -0,0 +1,401 @@
+// Persistence.cpp
+#include "Persistence.h"
+#include "DSPPool.h"
+#include "HugePages.h"
+#include "TriggerEngine.h"
+#include "AppConfig.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Smallest and largest code of x[0..n)
+void min_max(const uint16_t *x, int n, int *lo, int *hi)
+{
+    int mn = 0xFFFF, mx = 0;
+    int i = 0;
+#ifdef __SSE2__
+    if (n >= 8) {
+        // Signed 16-bit min/max on biased codes is the unsigned comparison
+        const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+        __m128i vmin = _mm_set1_epi16(0x7FFF);
+        __m128i vmax = _mm_set1_epi16(static_cast<short>(0x8000));
+        for (; i + 8 <= n; i += 8) {
+            const __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(x + i)), bias);
+            vmin = _mm_min_epi16(vmin, v);
+            vmax = _mm_max_epi16(vmax, v);
+        }
+        alignas(16) int16_t lanesMin[8], lanesMax[8];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanesMin), vmin);
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanesMax), vmax);
+        for (int k = 0; k < 8; ++k) {
+            mn = std::min(mn, static_cast<int>(static_cast<uint16_t>(lanesMin[k]) ^ 0x8000));
+            mx = std::max(mx, static_cast<int>(static_cast<uint16_t>(lanesMax[k]) ^ 0x8000));
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        mn = std::min(mn, static_cast<int>(x[i]));
+        mx = std::max(mx, static_cast<int>(x[i]));
+    }
+    *lo = mn;
+    *hi = mx;
+}
+
+// One more hit in rows r0..r1 of a column, saturating
+void hit(uint16_t *column, int r0, int r1)
+{
+    int r = r0;
+#ifdef __SSE2__
+    const __m128i one = _mm_set1_epi16(1);
+    for (; r + 8 <= r1 + 1; r += 8) {
+        __m128i *p = reinterpret_cast<__m128i *>(column + r);
+        _mm_storeu_si128(p, _mm_adds_epu16(_mm_loadu_si128(p), one));
+    }
+#endif
+    for (; r <= r1; ++r)
+        column[r] += column[r] != 0xFFFF;
+}
+}
+
+Persistence::Persistence(DSPPool *pool, const TriggerEngine *trigger)
+    : pool(pool), trigger(trigger)
+{
+    incoming.columns = AppConfig::persistenceColumns;
+    incoming.rows = AppConfig::persistenceRows;
+    incoming.decaySeconds = AppConfig::persistenceDecaySeconds;
+    batch.reserve(kMaxBatch);
+    marks.resize(kMaxBatch);
+}
+
+Persistence::~Persistence()
+{
+    if (ring)
+        HugePages::release(ring, capacity * sizeof(uint16_t));
+}
+
+void Persistence::configure(const PersistenceSettings &settings)
+{
+    pthread_mutex_lock(&settingsMutex);
+    incoming.columns = std::clamp(settings.columns, 16, 8192);
+    incoming.rows = std::clamp(settings.rows, 16, 4096);
+    incoming.lowCode = std::clamp(std::min(settings.lowCode, settings.highCode), 0, 0xFFFF);
+    incoming.highCode = std::clamp(std::max(settings.lowCode, settings.highCode), 0, 0xFFFF);
+    incoming.decaySeconds = std::max(0.0, settings.decaySeconds);
+    settingsChanged.store(true, std::memory_order_release);
+    pthread_mutex_unlock(&settingsMutex);
+}
+
+void Persistence::setEnabled(bool on)
+{
+    if (on && !ring) {
+        uint64_t samples = 1 << 16;
+        while (samples < static_cast<uint64_t>(std::max(AppConfig::persistenceRingSamples, 1)))
+            samples <<= 1;
+        ring = static_cast<uint16_t *>(HugePages::allocate(samples * sizeof(uint16_t)));
+        if (!ring) {
+            qWarning() << "[Persistence] No staging ring, persistence stays off";
+            return;
+        }
+        capacity = samples;
+    }
+    if (on) {
+        settingsChanged.store(true, std::memory_order_release);  // start over from the current stream
+        drawn.store(0, std::memory_order_relaxed);
+        lost.store(0, std::memory_order_relaxed);
+    }
+    active.store(on, std::memory_order_release);
+}
+
+void Persistence::append(const uint16_t *data, int ndata, uint64_t firstSample)
+{
+    if (ndata <= 0)
+        return;
+    if (static_cast<uint64_t>(ndata) > capacity) {  // only the newest ring's worth can be kept
+        const uint64_t skip = ndata - capacity;
+        firstSample += skip;
+        data += skip;
+        ndata = static_cast<int>(capacity);
+    }
+    if (firstSample != cursor.load(std::memory_order_relaxed))
+        origin.store(firstSample, std::memory_order_relaxed);  // a gap, or the first block since enabling
+
+    const uint64_t pos = firstSample & (capacity - 1);
+    const uint64_t head = std::min<uint64_t>(ndata, capacity - pos);
+    std::memcpy(ring + pos, data, head * sizeof(uint16_t));
+    std::memcpy(ring, data + head, (ndata - head) * sizeof(uint16_t));
+    cursor.store(firstSample + ndata, std::memory_order_release);
+
+    if (!busy.exchange(true, std::memory_order_acquire))
+        pool->submit([this]() { run(); });
+}
+
+void Persistence::adoptSettings()
+{
+    pthread_mutex_lock(&settingsMutex);
+    cfg = incoming;
+    settingsChanged.store(false, std::memory_order_relaxed);
+    pthread_mutex_unlock(&settingsMutex);
+
+    const size_t cells = static_cast<size_t>(cfg.columns) * cfg.rows;
+    grids.assign(pool->size(), std::vector<uint16_t>(cells, 0));
+    scratch.resize(pool->size());
+
+    pthread_mutex_lock(&imageMutex);
+    image.assign(cells, 0.0f);
+    imageColumns = cfg.columns;
+    imageRows = cfg.rows;
+    ++version;
+    pthread_mutex_unlock(&imageMutex);
+
+    length = 0;  // the next collect() picks the waveform geometry
+    started = false;
+}
+
+// New waveform geometry: the old image no longer lines up
+void Persistence::reset(int waveformLength, int preSamples)
+{
+    length = waveformLength;
+    pre = preSamples;
+    started = false;
+
+    pthread_mutex_lock(&imageMutex);
+    std::fill(image.begin(), image.end(), 0.0f);
+    imageFirst = -pre / AppConfig::adcSampleRate;
+    imageSpan = length / AppConfig::adcSampleRate;
+    ++version;
+    pthread_mutex_unlock(&imageMutex);
+}
+
+// Waveforms complete in the staging ring up to `end`, at most kMaxBatch; the rest waits for the next run
+void Persistence::collect(uint64_t end)
+{
+    batch.clear();
+    // The last quarter of the ring is left to the block the callback may be writing
+    const uint64_t keep = capacity - capacity / 4;
+    const uint64_t readable = std::max(origin.load(std::memory_order_relaxed), end > keep ? end - keep : 0);
+    const int maxLength = static_cast<int>(capacity / 4);
+
+    const bool fromTrigger = trigger && trigger->enabled();
+    if (fromTrigger != triggered) {
+        triggered = fromTrigger;
+        started = false;
+    }
+
+    if (triggered) {
+        if (!started) {
+            seenCaptures = trigger->captureCount();  // captures from before now aren't in the ring
+            started = true;
+        }
+        uint64_t next = seenCaptures;
+        const int count = trigger->capturesSince(next, marks.data(), kMaxBatch);
+        const uint64_t firstSeq = next - count;
+        for (int i = 0; i < count; ++i) {
+            const CaptureMark &m = marks[i];
+            if (m.length > maxLength || m.triggerIndex < static_cast<uint64_t>(m.pre)) {
+                lost.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (m.length != length || m.pre != pre) {
+                if (!batch.empty()) {  // draw what is queued with the old geometry first
+                    next = firstSeq + i;
+                    break;
+                }
+                reset(m.length, m.pre);
+                started = true;  // the marks consumed so far stay consumed
+            }
+            const uint64_t first = m.triggerIndex - m.pre;
+            if (first + m.length > end) {  // published before its block reached the staging ring
+                next = firstSeq + i;
+                break;
+            }
+            if (first < readable)
+                lost.fetch_add(1, std::memory_order_relaxed);
+            else
+                batch.push_back({ first });
+        }
+        seenCaptures = next;
+        return;
+    }
+
+    const int windowLength = std::clamp(static_cast<int>(std::lround(AppConfig::timeWindowSeconds * AppConfig::adcSampleRate)),
+                                        2, std::min(AppConfig::maxTriggerDepthSamples, maxLength));
+    if (windowLength != length || pre != 0)
+        reset(windowLength, 0);
+    if (!started) {
+        nextWindow = end;
+        started = true;
+    }
+    if (nextWindow < readable) {  // fell behind: skip whole windows, keep their phase
+        const uint64_t skipped = (readable - nextWindow + length - 1) / length;
+        lost.fetch_add(skipped, std::memory_order_relaxed);
+        nextWindow += skipped * length;
+    }
+    while (nextWindow + length <= end && static_cast<int>(batch.size()) < kMaxBatch) {
+        batch.push_back({ nextWindow });
+        nextWindow += length;
+    }
+}
+
+void Persistence::run()
+{
+    if (settingsChanged.load(std::memory_order_acquire))
+        adoptSettings();
+
+    const uint64_t end = cursor.load(std::memory_order_acquire);
+    const bool fresh = !started;
+    collect(end);
+    if (fresh)
+        decayedTo = end;
+
+    // Decay follows stream time, so the image also fades while nothing triggers
+    const double tau = cfg.decaySeconds * AppConfig::adcSampleRate;
+    batchDecay = tau > 0.0 ? std::exp(-static_cast<double>(end - decayedTo) / tau) : 1.0;
+    if (batch.empty()) {
+        if (batchDecay < 0.94) {  // about tau / 16 of stream time
+            decayedTo = end;
+            fold();
+        }
+        busy.store(false, std::memory_order_release);
+        return;
+    }
+    decayedTo = end;
+
+    const int count = static_cast<int>(batch.size());
+    const int workers = std::min(pool->size(), count);
+    parts.store(workers, std::memory_order_relaxed);
+    for (int w = 0; w < workers; ++w) {
+        const int begin = count * w / workers;
+        const int stop = count * (w + 1) / workers;
+        pool->submit([this, begin, stop]() {
+            draw(DSPPool::currentWorker(), begin, stop);
+            if (parts.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                fold();
+                busy.store(false, std::memory_order_release);
+            }
+        });
+    }
+}
+
+void Persistence::draw(int worker, int begin, int end)
+{
+    std::vector<uint16_t> &x = scratch[worker];
+    x.resize(length);
+    uint16_t *grid = grids[worker].data();
+    const uint64_t mask = capacity - 1;
+    const uint64_t keep = capacity - capacity / 4;
+
+    uint64_t done = 0;
+    for (int i = begin; i < end; ++i) {
+        if (pool->stopRequested())
+            break;
+        const uint64_t first = batch[i].first;
+        const uint64_t pos = first & mask;
+        const uint64_t head = std::min<uint64_t>(length, capacity - pos);
+        std::memcpy(x.data(), ring + pos, head * sizeof(uint16_t));
+        std::memcpy(x.data() + head, ring, (length - head) * sizeof(uint16_t));
+
+        // Lapped by the callback while copying: part of the copy is newer data
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (cursor.load(std::memory_order_relaxed) > first + keep) {
+            lost.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        rasterize(x.data(), grid);
+        ++done;
+    }
+    drawn.fetch_add(done, std::memory_order_relaxed);
+}
+
+// One waveform into a column-major grid; each column spans its samples' min..max,
+// extended to the previous column's last sample so steep edges stay connected
+void Persistence::rasterize(const uint16_t *x, uint16_t *grid) const
+{
+    const int columns = cfg.columns, rows = cfg.rows;
+    const int low = cfg.lowCode, high = cfg.highCode;
+    const int64_t span = high - low + 1;
+
+    int previous = x[0];
+    for (int c = 0; c < columns; ++c) {
+        const int a = static_cast<int>(static_cast<int64_t>(c) * length / columns);
+        const int b = std::max(static_cast<int>(static_cast<int64_t>(c + 1) * length / columns), a + 1);
+        int lo, hi;
+        min_max(x + a, b - a, &lo, &hi);
+        lo = std::min(lo, previous);
+        hi = std::max(hi, previous);
+        previous = x[b - 1];
+        if (hi < low || lo > high)
+            continue;
+
+        const int r0 = static_cast<int>((std::max(lo, low) - low) * static_cast<int64_t>(rows) / span);
+        const int r1 = static_cast<int>((std::min(hi, high) - low) * static_cast<int64_t>(rows) / span);
+        hit(grid + static_cast<size_t>(c) * rows, r0, r1);
+    }
+}
+
+// image = image * decay + every worker's hits; the grids are zeroed for the next batch
+void Persistence::fold()
+{
+    const size_t cells = image.size();
+    pthread_mutex_lock(&imageMutex);
+    float *img = image.data();
+    const float decay = static_cast<float>(batchDecay);
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128 d = _mm_set1_ps(decay);
+    for (; i + 4 <= cells; i += 4)
+        _mm_storeu_ps(img + i, _mm_mul_ps(_mm_loadu_ps(img + i), d));
+#endif
+    for (; i < cells; ++i)
+        img[i] *= decay;
+
+    for (std::vector<uint16_t> &g : grids) {
+        uint16_t *hits = g.data();
+        i = 0;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= cells; i += 8) {
+            __m128i *p = reinterpret_cast<__m128i *>(hits + i);
+            const __m128i h = _mm_loadu_si128(p);
+            _mm_storeu_ps(img + i, _mm_add_ps(_mm_loadu_ps(img + i), _mm_cvtepi32_ps(_mm_unpacklo_epi16(h, zero))));
+            _mm_storeu_ps(img + i + 4, _mm_add_ps(_mm_loadu_ps(img + i + 4), _mm_cvtepi32_ps(_mm_unpackhi_epi16(h, zero))));
+            _mm_storeu_si128(p, zero);
+        }
+#endif
+        for (; i < cells; ++i) {
+            img[i] += hits[i];
+            hits[i] = 0;
+        }
+    }
+    ++version;
+    pthread_mutex_unlock(&imageMutex);
+}
+
+bool Persistence::snapshot(std::vector<float> &out, int *columns, int *rows, double *firstSeconds, double *spanSeconds)
+{
+    pthread_mutex_lock(&imageMutex);
+    if (version == shown || imageColumns == 0 || imageSpan <= 0.0) {
+        pthread_mutex_unlock(&imageMutex);
+        return false;
+    }
+    shown = version;
+    out.resize(image.size());
+    for (int c = 0; c < imageColumns; ++c) {
+        const float *column = image.data() + static_cast<size_t>(c) * imageRows;
+        for (int r = 0; r < imageRows; ++r)
+            out[static_cast<size_t>(r) * imageColumns + c] = column[r];
+    }
+    *columns = imageColumns;
+    *rows = imageRows;
+    *firstSeconds = imageFirst;
+    *spanSeconds = imageSpan;
+    pthread_mutex_unlock(&imageMutex);
+    return true;
+}
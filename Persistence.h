@@ -0,0 +1,120 @@
+// Persistence.h
+#ifndef PERSISTENCE_H
+#define PERSISTENCE_H
+
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class DSPPool;
+class TriggerEngine;
+struct CaptureMark;
+
+// Image geometry and vertical range; rows are linear in ADC codes
+struct PersistenceSettings {
+    int columns = 1024;
+    int rows = 256;
+    int lowCode = 0;          // bottom edge of row 0
+    int highCode = 0xFFFF;    // top edge of the last row
+    double decaySeconds = 0.5;  // stream time for a hit to fade to 1/e, 0 = never fades
+};
+
+/*!
+ * Digital-phosphor view of the raw stream. Every triggered capture, or with
+ * the trigger off every consecutive time window, is drawn into a column x
+ * row hit-count image, so repetitive pulses build up an intensity map and a
+ * rare glitch stays on screen instead of depending on which waveform a
+ * redraw happens to pick.
+ *
+ * While enabled the callback copies each block into a staging ring (one
+ * memcpy) and kicks run() on the pool, one batch at a time. run() gathers
+ * the waveforms completed since the last batch and splits them over the
+ * workers; each rasterizes its share into its own saturating uint16 grid:
+ * an SSE2 min/max per column, joined to the previous column, and the rows
+ * in between incremented 8 at a time. The last worker to finish folds the
+ * grids into the float image, decayed by the stream time the batch covered.
+ */
+class Persistence
+{
+public:
+    Persistence(DSPPool *pool, const TriggerEngine *trigger);
+    ~Persistence();
+    Persistence(const Persistence &) = delete;
+    Persistence &operator=(const Persistence &) = delete;
+
+    // GUI thread; a new geometry clears the image
+    void configure(const PersistenceSettings &settings);
+    void setEnabled(bool on);
+    bool enabled() const { return active.load(std::memory_order_acquire); }
+
+    // Callback thread, while enabled
+    void append(const uint16_t *data, int ndata, uint64_t firstSample);
+
+    // Image row-major from the bottom row, in (decayed) hits; false if nothing new since the last call.
+    // The x extent is the waveform's, in seconds from its trigger point (window start when untriggered).
+    bool snapshot(std::vector<float> &image, int *columns, int *rows, double *firstSeconds, double *spanSeconds);
+
+    uint64_t waveforms() const { return drawn.load(std::memory_order_relaxed); }  // drawn since enabled
+    uint64_t missed() const { return lost.load(std::memory_order_relaxed); }      // overwritten before a worker got to them
+
+    static constexpr int kMaxBatch = 8192;  // waveforms per batch, bounds the saturating grids too
+
+private:
+    struct Waveform {
+        uint64_t first;  // stream index of its first sample
+    };
+
+    void run();
+    void adoptSettings();
+    void reset(int waveformLength, int preSamples);
+    void collect(uint64_t end);
+    void draw(int worker, int begin, int end);
+    void rasterize(const uint16_t *x, uint16_t *grid) const;
+    void fold();
+
+    DSPPool *pool;
+    const TriggerEngine *trigger;
+
+    // settings mailbox
+    pthread_mutex_t settingsMutex = PTHREAD_MUTEX_INITIALIZER;
+    PersistenceSettings incoming;
+    std::atomic<bool> settingsChanged{true};
+    std::atomic<bool> active{false};
+
+    // staging ring, written by the callback, mapped on first enable
+    uint16_t *ring = nullptr;
+    uint64_t capacity = 0;  // power of two
+    std::atomic<uint64_t> cursor{0};  // stream index just past the newest sample
+    std::atomic<uint64_t> origin{0};  // first sample of the current contiguous run
+    std::atomic<bool> busy{false};    // a batch is in flight
+
+    // batch state, only touched by run(), the subtasks it starts and fold()
+    PersistenceSettings cfg;
+    int length = 0;     // samples per waveform
+    int pre = 0;        // of which before the trigger point
+    bool triggered = false;     // waveforms come from trigger captures, not consecutive windows
+    bool started = false;
+    uint64_t nextWindow = 0;    // untriggered: first sample of the next window
+    uint64_t seenCaptures = 0;  // trigger marks consumed
+    uint64_t decayedTo = 0;     // stream index the image decay has been applied up to
+    std::vector<Waveform> batch;
+    std::vector<CaptureMark> marks;
+    double batchDecay = 1.0;
+    std::atomic<int> parts{0};
+    std::vector<std::vector<uint16_t>> grids;    // per worker, column-major
+    std::vector<std::vector<uint16_t>> scratch;  // per worker, one waveform out of the ring
+
+    // published image, column-major like the grids
+    pthread_mutex_t imageMutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<float> image;
+    int imageColumns = 0, imageRows = 0;
+    double imageFirst = 0.0, imageSpan = 0.0;
+    uint64_t version = 0;
+    uint64_t shown = 0;  // version of the last snapshot
+
+    std::atomic<uint64_t> drawn{0};
+    std::atomic<uint64_t> lost{0};
+};
+
+#endif // PERSISTENCE_H
@@ -9,9 +9,33 @@ TARGET = FFT_Qwt_Plotter
 
 # === Source Files ===
 SOURCES += \
+    AdcCalibration.cpp \
+    Arena.cpp \
+    Correlator.cpp \
+    DSPPool.cpp \
+    DspStage.cpp \
+    Decimator.cpp \
+    Epoch.cpp \
+    EventDetector.cpp \
+    EventLog.cpp \
+    ExportEngine.cpp \
     FFTProcess.cpp \
     Features.cpp \
+    HugePages.cpp \
+    Persistence.cpp \
+    SampleCodec.cpp \
+    SampleRecorder.cpp \
+    SampleTimeline.cpp \
+    SharedPublisher.cpp \
+    SpectrumAccumulator.cpp \
+    SpectrumHistory.cpp \
+    StageGraph.cpp \
+    StreamServer.cpp \
+    ThreadPlacement.cpp \
     TimeDProcess.cpp \
+    ToneTracker.cpp \
+    TriggerEngine.cpp \
+    ZoomFFT.cpp \
     fft_config.cpp \
     main.cpp \
     mainwindow.cpp \
@@ -19,10 +43,35 @@ SOURCES += \
 
 # === Header Files ===
 HEADERS += \
+    AdcCalibration.h \
     AppConfig.h \
+    Arena.h \
+    Correlator.h \
+    DSPPool.h \
+    DspStage.h \
+    Decimator.h \
+    Epoch.h \
+    EventDetector.h \
+    EventLog.h \
+    ExportEngine.h \
     FFTProcess.h \
     Features.h \
+    HugePages.h \
+    Persistence.h \
+    SampleCodec.h \
+    SampleRecorder.h \
+    SampleTimeline.h \
+    SharedPublisher.h \
+    SharedStreamLayout.h \
+    SpectrumAccumulator.h \
+    SpectrumHistory.h \
+    StageGraph.h \
+    StreamServer.h \
+    ThreadPlacement.h \
     TimeDProcess.h \
+    ToneTracker.h \
+    TriggerEngine.h \
+    ZoomFFT.h \
     mainwindow.h \
     plotmanager.h
 
@@ -45,6 +94,8 @@ LIBS += \
     -LC:/Ultracoustics-ALI-Playground/qwt-6.3.0/build/Desktop_Qt_6_9_0_MinGW_64_bit-Debug/lib -lqwt \
     -lpthread -lm
 
+win32: LIBS += -lws2_32  # StreamServer sockets
+
 RESOURCES += \
     icons.qrc
 
@@ -0,0 +1,210 @@
+// SampleCodec.cpp
+#include "SampleCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr int kMaxWidth = 19;  // zigzag of a second-order residual of 16-bit codes
+constexpr uint8_t kSecondOrder = 0x80;
+
+inline uint32_t zigzag(int32_t d) { return (static_cast<uint32_t>(d) << 1) ^ static_cast<uint32_t>(d >> 31); }
+inline int32_t unzigzag(uint32_t z) { return static_cast<int32_t>(z >> 1) ^ -static_cast<int32_t>(z & 1); }
+
+inline int bit_width(uint32_t v)
+{
+    int w = 0;
+    while (v) {
+        ++w;
+        v >>= 1;
+    }
+    return w;
+}
+
+// 128 values of `width` bits -> 16 * width bytes, value 4k + lane in lane `lane`
+void pack(const uint32_t *v, int width, uint8_t *out)
+{
+    if (width == 0)
+        return;
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    int shift = 0;
+    for (int k = 0; k < SampleCodec::kBlock / 4; ++k) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + 4 * k));
+        acc = _mm_or_si128(acc, _mm_sll_epi32(x, _mm_cvtsi32_si128(shift)));
+        shift += width;
+        if (shift >= 32) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), acc);
+            out += 16;
+            shift -= 32;
+            acc = _mm_srl_epi32(x, _mm_cvtsi32_si128(width - shift));  // carried high bits, 0 if none
+        }
+    }
+#else
+    uint32_t acc[4] = {};
+    int shift = 0;
+    for (int k = 0; k < SampleCodec::kBlock / 4; ++k) {
+        for (int lane = 0; lane < 4; ++lane)
+            acc[lane] |= v[4 * k + lane] << shift;
+        shift += width;
+        if (shift >= 32) {
+            std::memcpy(out, acc, 16);
+            out += 16;
+            shift -= 32;
+            for (int lane = 0; lane < 4; ++lane)
+                acc[lane] = shift ? v[4 * k + lane] >> (width - shift) : 0;
+        }
+    }
+#endif
+}
+
+void unpack(const uint8_t *in, int width, uint32_t *v)
+{
+    if (width == 0) {
+        std::fill(v, v + SampleCodec::kBlock, 0u);
+        return;
+    }
+    const uint8_t *end = in + 16 * width;
+#ifdef __SSE2__
+    const __m128i mask = _mm_set1_epi32(static_cast<int>((1u << width) - 1));
+    __m128i word = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    in += 16;
+    int shift = 0;
+    for (int k = 0; k < SampleCodec::kBlock / 4; ++k) {
+        __m128i x = _mm_srl_epi32(word, _mm_cvtsi32_si128(shift));
+        shift += width;
+        if (shift >= 32) {
+            shift -= 32;
+            if (in < end) {
+                word = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+                in += 16;
+                if (shift)
+                    x = _mm_or_si128(x, _mm_sll_epi32(word, _mm_cvtsi32_si128(width - shift)));
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + 4 * k), _mm_and_si128(x, mask));
+    }
+#else
+    const uint32_t mask = (1u << width) - 1;
+    uint32_t word[4];
+    std::memcpy(word, in, 16);
+    in += 16;
+    int shift = 0;
+    for (int k = 0; k < SampleCodec::kBlock / 4; ++k) {
+        uint32_t x[4];
+        for (int lane = 0; lane < 4; ++lane)
+            x[lane] = word[lane] >> shift;
+        shift += width;
+        if (shift >= 32) {
+            shift -= 32;
+            if (in < end) {
+                std::memcpy(word, in, 16);
+                in += 16;
+                if (shift)
+                    for (int lane = 0; lane < 4; ++lane)
+                        x[lane] |= word[lane] << (width - shift);
+            }
+        }
+        for (int lane = 0; lane < 4; ++lane)
+            v[4 * k + lane] = x[lane] & mask;
+    }
+#endif
+}
+}
+
+size_t SampleCodec::maxEncodedBytes(int count)
+{
+    const size_t blocks = count > 1 ? (static_cast<size_t>(count) - 1 + kBlock - 1) / kBlock : 0;
+    return sizeof(uint16_t) + blocks * (1 + 16 * kMaxWidth);
+}
+
+size_t SampleCodec::encode(const uint16_t *in, int count, uint8_t *out)
+{
+    if (count <= 0)
+        return 0;
+
+    uint8_t *p = out;
+    std::memcpy(p, &in[0], sizeof(uint16_t));
+    p += sizeof(uint16_t);
+
+    alignas(16) uint32_t first[kBlock];
+    alignas(16) uint32_t second[kBlock];
+
+    for (int start = 1; start < count; start += kBlock) {
+        const int n = std::min(kBlock, count - start);
+        uint32_t any1 = 0, any2 = 0;
+
+        for (int j = 0; j < n; ++j) {
+            const int i = start + j;
+            const int32_t x = in[i];
+            const int32_t x1 = in[i - 1];
+            const int32_t x2 = i >= 2 ? in[i - 2] : x1;
+            const int32_t d1 = x - x1;
+            const uint32_t z1 = zigzag(d1);
+            const uint32_t z2 = zigzag(d1 - (x1 - x2));
+            first[j] = z1;
+            second[j] = z2;
+            any1 |= z1;
+            any2 |= z2;
+        }
+        std::fill(first + n, first + kBlock, 0u);
+        std::fill(second + n, second + kBlock, 0u);
+
+        const int w1 = bit_width(any1);
+        const int w2 = bit_width(any2);
+        const bool useSecond = w2 < w1;
+        const int width = useSecond ? w2 : w1;
+
+        *p++ = static_cast<uint8_t>(width | (useSecond ? kSecondOrder : 0));
+        pack(useSecond ? second : first, width, p);
+        p += 16 * width;
+    }
+    return static_cast<size_t>(p - out);
+}
+
+bool SampleCodec::decode(const uint8_t *in, size_t bytes, uint16_t *out, int count)
+{
+    if (count <= 0)
+        return true;
+    if (bytes < sizeof(uint16_t))
+        return false;
+
+    const uint8_t *end = in + bytes;
+    std::memcpy(&out[0], in, sizeof(uint16_t));
+    in += sizeof(uint16_t);
+
+    alignas(16) uint32_t residual[kBlock];
+
+    for (int start = 1; start < count; start += kBlock) {
+        if (in >= end)
+            return false;
+        const uint8_t header = *in++;
+        const int width = header & 0x1F;
+        if (width > kMaxWidth || end - in < 16 * width)
+            return false;
+
+        unpack(in, width, residual);
+        in += 16 * width;
+
+        const int n = std::min(kBlock, count - start);
+        if (header & kSecondOrder) {
+            for (int j = 0; j < n; ++j) {
+                const int i = start + j;
+                const int32_t x1 = out[i - 1];
+                const int32_t x2 = i >= 2 ? out[i - 2] : x1;
+                out[i] = static_cast<uint16_t>(2 * x1 - x2 + unzigzag(residual[j]));
+            }
+        } else {
+            int32_t x = out[start - 1];
+            for (int j = 0; j < n; ++j) {
+                x += unzigzag(residual[j]);
+                out[start + j] = static_cast<uint16_t>(x);
+            }
+        }
+    }
+    return in == end;
+}
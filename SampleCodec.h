@@ -0,0 +1,36 @@
+// SampleCodec.h
+#ifndef SAMPLECODEC_H
+#define SAMPLECODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * Lossless codec for raw ADC words. The signal sits in a narrow code range
+ * around adcOffset, so sample-to-sample residuals are small:
+ *
+ *   chunk  = uint16 first sample, then ceil((count - 1) / 128) blocks
+ *   block  = 1 header byte (bits 0-4 width, bit 7 second-order predictor)
+ *            + 16 * width bytes of bit-packed zigzag residuals
+ *
+ * Each block picks the first- (x[i-1]) or second-order (2x[i-1] - x[i-2])
+ * predictor, whichever packs narrower. Packing is vertical over four 32-bit
+ * lanes (two SSE2 ops per value group, scalar fallback writes the same
+ * layout). Chunks are independent, so they encode and decode in parallel.
+ * Multi-byte fields are little-endian hosts' native order.
+ */
+class SampleCodec
+{
+public:
+    static constexpr int kBlock = 128;
+
+    static size_t maxEncodedBytes(int count);
+
+    // Returns bytes written to out (at least maxEncodedBytes(count) of room)
+    static size_t encode(const uint16_t *in, int count, uint8_t *out);
+
+    // False on a truncated or corrupt chunk
+    static bool decode(const uint8_t *in, size_t bytes, uint16_t *out, int count);
+};
+
+#endif // SAMPLECODEC_H
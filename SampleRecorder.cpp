@@ -0,0 +1,220 @@
+// SampleRecorder.cpp
+#include "SampleRecorder.h"
+#include "SampleCodec.h"
+#include "DSPPool.h"
+#include "AppConfig.h"
+#include "AdcCalibration.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+
+SampleRecorder::SampleRecorder(DSPPool *p, const AdcCalibration *c)
+    : pool(p), calibration(c)
+{
+}
+
+SampleRecorder::~SampleRecorder()
+{
+    stop();
+}
+
+bool SampleRecorder::start(const std::string &fileName)
+{
+    pthread_mutex_lock(&fillMutex);
+    if (active.load()) {
+        pthread_mutex_unlock(&fillMutex);
+        return false;
+    }
+
+    file = std::fopen(fileName.c_str(), "wb");
+    if (!file) {
+        pthread_mutex_unlock(&fillMutex);
+        qWarning() << "[SampleRecorder] Failed to open file:" << fileName.c_str();
+        return false;
+    }
+
+    if (!slots) {  // ~16 MB raw + encoded per slot, kept for the next recording
+        slots.reset(new Slot[kSlots]);
+        for (int i = 0; i < kSlots; ++i) {
+            slots[i].raw.resize(kChunkSamples);
+            slots[i].encoded.resize(SampleCodec::maxEncodedBytes(kChunkSamples));
+        }
+    }
+    for (int i = 0; i < kSlots; ++i)
+        slots[i].state.store(Free);
+
+    sampleRate = AppConfig::adcSampleRate;
+    RecordFileHeader header = {};
+    std::memcpy(header.magic, "UCRAW01", 8);
+    header.headerBytes = sizeof(RecordFileHeader);
+    header.chunkSamples = kChunkSamples;
+    header.sampleRate = sampleRate;
+    header.adcOffset = calibration->offsetCode();
+    header.adcToMicroWatts = calibration->slope(header.adcOffset);
+    const QByteArray table = calibration->tableFile().toUtf8();
+    std::memcpy(header.calibrationFile, table.constData(), std::min<size_t>(table.size(), sizeof(header.calibrationFile) - 1));
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    fillSeq = 0;
+    filling = false;
+    submittedSeq = 0;
+    writeSeq = 0;
+    closing = false;
+    samples = 0;
+    dropped = 0;
+    rawBytes = 0;
+    encodedBytes = sizeof(RecordFileHeader);
+
+    pthread_create(&writer, nullptr, &SampleRecorder::writerMain, this);
+    active.store(true);
+    pthread_mutex_unlock(&fillMutex);
+
+    qDebug() << "[SampleRecorder] Recording to" << fileName.c_str();
+    return true;
+}
+
+void SampleRecorder::stop()
+{
+    pthread_mutex_lock(&fillMutex);
+    if (!active.load()) {
+        pthread_mutex_unlock(&fillMutex);
+        return;
+    }
+    active.store(false);
+    if (filling)
+        submit(slots[fillSeq % kSlots]);
+    pthread_mutex_unlock(&fillMutex);
+
+    pthread_mutex_lock(&writeMutex);
+    closing = true;
+    pthread_cond_broadcast(&readyCond);
+    pthread_mutex_unlock(&writeMutex);
+
+    pthread_join(writer, nullptr);  // drains every submitted chunk
+    std::fclose(file);
+    file = nullptr;
+
+    const Stats s = stats();
+    qDebug() << "[SampleRecorder] Stopped:" << s.seconds << "s," << s.droppedSamples << "samples dropped, ratio"
+             << (s.encodedBytes ? static_cast<double>(s.rawBytes) / s.encodedBytes : 0.0);
+}
+
+SampleRecorder::Stats SampleRecorder::stats() const
+{
+    Stats s;
+    s.samples = samples.load(std::memory_order_relaxed);
+    s.droppedSamples = dropped.load(std::memory_order_relaxed);
+    s.rawBytes = rawBytes.load(std::memory_order_relaxed);
+    s.encodedBytes = encodedBytes.load(std::memory_order_relaxed);
+    s.seconds = sampleRate > 0.0 ? s.samples / sampleRate : 0.0;
+    return s;
+}
+
+void SampleRecorder::append(const uint16_t *data, int ndata, uint64_t firstSample)
+{
+    if (!active.load(std::memory_order_relaxed))
+        return;
+
+    pthread_mutex_lock(&fillMutex);
+    if (!active.load(std::memory_order_relaxed)) {
+        pthread_mutex_unlock(&fillMutex);
+        return;
+    }
+
+    int i = 0;
+    while (i < ndata) {
+        Slot &slot = slots[fillSeq % kSlots];
+        if (!filling) {
+            if (slot.state.load(std::memory_order_acquire) != Free) {
+                dropped.fetch_add(ndata - i, std::memory_order_relaxed);  // encoder or disk behind
+                break;
+            }
+            slot.state.store(Filling, std::memory_order_relaxed);
+            slot.firstSample = firstSample + i;
+            slot.count = 0;
+            filling = true;
+        } else if (slot.firstSample + slot.count != firstSample + i) {
+            submit(slot);  // blocks were dropped: close the chunk so the gap shows in the file
+            continue;
+        }
+
+        const int take = std::min(ndata - i, kChunkSamples - slot.count);
+        std::memcpy(slot.raw.data() + slot.count, data + i, take * sizeof(uint16_t));
+        slot.count += take;
+        i += take;
+        samples.fetch_add(take, std::memory_order_relaxed);
+
+        if (slot.count == kChunkSamples)
+            submit(slot);
+    }
+    pthread_mutex_unlock(&fillMutex);
+}
+
+void SampleRecorder::submit(Slot &slot)
+{
+    slot.state.store(Encoding, std::memory_order_relaxed);
+    filling = false;
+    ++fillSeq;
+
+    pthread_mutex_lock(&writeMutex);
+    ++submittedSeq;
+    pthread_mutex_unlock(&writeMutex);
+
+    Slot *s = &slot;
+    pool->submit([this, s]() {
+        s->encodedBytes = SampleCodec::encode(s->raw.data(), s->count, s->encoded.data());
+
+        pthread_mutex_lock(&writeMutex);
+        s->state.store(Ready, std::memory_order_release);
+        pthread_cond_broadcast(&readyCond);
+        pthread_mutex_unlock(&writeMutex);
+    });
+}
+
+void* SampleRecorder::writerMain(void *arg)
+{
+    static_cast<SampleRecorder*>(arg)->writerLoop();
+    return nullptr;
+}
+
+// Writes chunks strictly in capture order, whichever worker finished first
+void SampleRecorder::writerLoop()
+{
+    bool failed = false;
+    for (;;) {
+        pthread_mutex_lock(&writeMutex);
+        for (;;) {
+            if (writeSeq < submittedSeq && slots[writeSeq % kSlots].state.load(std::memory_order_acquire) == Ready)
+                break;
+            if (closing && writeSeq == submittedSeq)
+                break;
+            pthread_cond_wait(&readyCond, &writeMutex);
+        }
+        const bool done = writeSeq == submittedSeq;
+        pthread_mutex_unlock(&writeMutex);
+        if (done)
+            return;
+
+        Slot &slot = slots[writeSeq % kSlots];
+        RecordChunkHeader header = {};
+        header.magic = kChunkMagic;
+        header.sampleCount = static_cast<uint32_t>(slot.count);
+        header.firstSample = slot.firstSample;
+        header.payloadBytes = static_cast<uint32_t>(slot.encodedBytes);
+
+        const bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+                        && std::fwrite(slot.encoded.data(), 1, slot.encodedBytes, file) == slot.encodedBytes;
+        if (!ok && !failed) {
+            qWarning() << "[SampleRecorder] Write failed, disk full?";
+            failed = true;
+        }
+
+        rawBytes.fetch_add(static_cast<uint64_t>(slot.count) * sizeof(uint16_t), std::memory_order_relaxed);
+        encodedBytes.fetch_add(sizeof(header) + slot.encodedBytes, std::memory_order_relaxed);
+
+        slot.state.store(Free, std::memory_order_release);
+        ++writeSeq;  // only this thread advances it
+    }
+}
@@ -0,0 +1,107 @@
+// SampleRecorder.h
+#ifndef SAMPLERECORDER_H
+#define SAMPLERECORDER_H
+
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+class DSPPool;
+class AdcCalibration;
+
+// .ucr capture file: one RecordFileHeader, then RecordChunkHeader + SampleCodec payload per chunk
+struct RecordFileHeader {
+    char magic[8];          // "UCRAW01"
+    uint32_t headerBytes;   // sizeof(RecordFileHeader)
+    uint32_t chunkSamples;  // nominal, the last chunk and chunks before a gap are shorter
+    double sampleRate;
+    double adcOffset;
+    double adcToMicroWatts;     // µW per code at adcOffset: the linear scale, or the measured table's slope there
+    char calibrationFile[256];  // that table, empty = the linear scale holds for every code
+};
+
+struct RecordChunkHeader {
+    uint32_t magic;         // kChunkMagic
+    uint32_t sampleCount;
+    uint64_t firstSample;   // absolute index, a jump from the previous chunk marks dropped samples
+    uint32_t payloadBytes;
+    uint32_t reserved;
+};
+
+/*!
+ * Lossless raw capture. The USB callback copies each block into the chunk
+ * being filled (no encoding, no I/O); full chunks are encoded with
+ * SampleCodec on the DSP pool in parallel and a writer thread appends them
+ * to the file in capture order. If every chunk slot is still busy the
+ * block is dropped and counted, the callback never waits.
+ */
+class SampleRecorder
+{
+public:
+    static constexpr uint32_t kChunkMagic = 0x4B434355;  // "UCCK"
+    static constexpr int kChunkSamples = 1 << 20;         // ~13 ms at 80 MS/s
+    static constexpr int kSlots = 16;
+
+    struct Stats {
+        uint64_t samples = 0;        // recorded
+        uint64_t droppedSamples = 0;
+        uint64_t rawBytes = 0;       // of the chunks written so far
+        uint64_t encodedBytes = 0;
+        double seconds = 0.0;
+    };
+
+    SampleRecorder(DSPPool *pool, const AdcCalibration *calibration);
+    ~SampleRecorder();
+
+    bool start(const std::string &fileName);  // GUI thread
+    void stop();                              // flushes the partial chunk, waits for the writer
+    bool recording() const { return active.load(std::memory_order_relaxed); }
+    Stats stats() const;
+
+    // Callback side: firstSample is the absolute index of data[0]
+    void append(const uint16_t *data, int ndata, uint64_t firstSample);
+
+private:
+    enum SlotState { Free, Filling, Encoding, Ready };
+    struct Slot {
+        std::vector<uint16_t> raw;
+        std::vector<uint8_t> encoded;
+        uint64_t firstSample = 0;
+        int count = 0;
+        size_t encodedBytes = 0;
+        std::atomic<int> state{Free};
+    };
+
+    void submit(Slot &slot);  // hands a filled slot to the pool
+    static void* writerMain(void *arg);
+    void writerLoop();
+
+    DSPPool *pool;
+    const AdcCalibration *calibration;  // the device's, for the header's zero point
+    std::unique_ptr<Slot[]> slots;
+    std::FILE *file = nullptr;
+    pthread_t writer;
+
+    pthread_mutex_t fillMutex = PTHREAD_MUTEX_INITIALIZER;  // callback vs start/stop, uncontended while running
+    std::atomic<bool> active{false};
+    uint64_t fillSeq = 0;   // slot being filled = fillSeq % kSlots
+    bool filling = false;
+
+    pthread_mutex_t writeMutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t readyCond = PTHREAD_COND_INITIALIZER;
+    uint64_t submittedSeq = 0;  // chunks handed to the pool
+    uint64_t writeSeq = 0;      // next chunk to write
+    bool closing = false;
+
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> rawBytes{0};
+    std::atomic<uint64_t> encodedBytes{0};
+    double sampleRate = 0.0;
+};
+
+#endif // SAMPLERECORDER_H
@@ -0,0 +1,76 @@
+// SampleTimeline.cpp
+#include "SampleTimeline.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+uint64_t SampleTimeline::beginBlock(int ndata, bool dataloss)
+{
+    const uint64_t first = next.load(std::memory_order_relaxed);
+    if (dataloss)
+        markGap(first, GapCause::DeviceLoss);
+    next.store(first + static_cast<uint64_t>(ndata), std::memory_order_release);
+    return first;
+}
+
+uint64_t SampleTimeline::position() const
+{
+    return next.load(std::memory_order_acquire);
+}
+
+void SampleTimeline::markGap(uint64_t position, GapCause cause)
+{
+    // Single writer: fill the slot, then publish it with the count
+    const uint64_t n = written.load(std::memory_order_relaxed);
+    log[n % kMaxGaps] = {position, cause};
+    lastGap.store(std::max(lastGap.load(std::memory_order_relaxed), position), std::memory_order_relaxed);
+    written.store(n + 1, std::memory_order_release);
+
+    if (n < 16 || (n & (n - 1)) == 0)  // the first few, then every power of two
+        qWarning() << "[SampleTimeline] Device" << device << "gap at sample" << position << (cause == GapCause::DeviceLoss ? "(device data loss)" : cause == GapCause::Reconnect ? "(reconnect)" : "(time buffer)")
+                   << "," << n + 1 << "so far";
+}
+
+bool SampleTimeline::gapWithin(uint64_t first, uint64_t end) const
+{
+    const uint64_t count = written.load(std::memory_order_acquire);
+    if (count == 0 || lastGap.load(std::memory_order_relaxed) <= first)
+        return false;  // the usual case, no scan
+
+    // Positions are logged in stream order, so walk back until they're at or before `first`
+    const uint64_t oldest = count > kMaxGaps ? count - kMaxGaps : 0;
+    for (uint64_t i = count; i-- > oldest; ) {
+        const uint64_t p = log[i % kMaxGaps].position;
+        if (p <= first)
+            break;
+        if (p < end)
+            return true;
+    }
+    return false;
+}
+
+uint64_t SampleTimeline::gapCount() const
+{
+    return written.load(std::memory_order_acquire);
+}
+
+int SampleTimeline::gaps(uint64_t since, std::vector<TimelineGap> &out) const
+{
+    const uint64_t count = written.load(std::memory_order_acquire);
+    const uint64_t oldest = count > kMaxGaps ? count - kMaxGaps : 0;
+    std::vector<TimelineGap> copy;
+    for (uint64_t i = oldest; i < count; ++i)
+        copy.push_back(log[i % kMaxGaps]);
+
+    // Slots the writer reused while we copied may be torn, they are the oldest ones
+    const uint64_t after = written.load(std::memory_order_acquire);
+    const uint64_t reused = after > oldest + kMaxGaps ? after - (oldest + kMaxGaps) : 0;
+    const size_t torn = std::min<uint64_t>(copy.size(), reused);
+
+    out.clear();
+    for (size_t i = torn; i < copy.size(); ++i)
+        if (copy[i].position >= since)
+            out.push_back(copy[i]);
+    return static_cast<int>(out.size());
+}
@@ -0,0 +1,64 @@
+// SampleTimeline.h
+#ifndef SAMPLETIMELINE_H
+#define SAMPLETIMELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+enum class GapCause : uint8_t {
+    DeviceLoss,   // libri reported dataloss before the block, length unknown
+    TimeBuffer,   // the time ring could not stay contiguous (restarted at the position)
+    Reconnect,    // the device was unplugged or failed and came back
+};
+
+struct TimelineGap {
+    uint64_t position;  // first sample after the discontinuity
+    GapCause cause;
+};
+
+// Frame flags, carried from the callback to the workers and into the history
+enum FrameFlags : uint8_t {
+    FrameAfterDrop = 1,  // frames of this chain were dropped since the previous one
+    FrameCorrupt = 2,    // a stream gap falls inside the frame
+};
+
+/*!
+ * The 64-bit sample clock everything of one device is stamped with: block
+ * n of its stream starts at the sum of all earlier block lengths, at the
+ * ADC rate. Frames, spectra, history entries, peak events and the time
+ * ring all use it, so any two of them line up exactly. Each device
+ * (FFTProcess) owns its own; stamps of different devices don't compare.
+ *
+ * libri only flags that data was lost, not how much, so the clock counts
+ * samples received and the loss is logged as a gap at the first sample
+ * after it. The log is written by the acquisition thread only and read
+ * lock-free; it keeps the newest kMaxGaps entries.
+ */
+class SampleTimeline
+{
+public:
+    static constexpr int kMaxGaps = 1024;
+
+    explicit SampleTimeline(int device = 0) : device(device) {}  // device: only for the log
+
+    // Callback: stamps the block, returns the index of its first sample
+    uint64_t beginBlock(int ndata, bool dataloss);
+    uint64_t position() const;  // one past the newest sample
+
+    void markGap(uint64_t position, GapCause cause);  // acquisition thread only
+
+    // A gap strictly inside [first, end): the samples around it don't belong together
+    bool gapWithin(uint64_t first, uint64_t end) const;
+    uint64_t gapCount() const;
+    int gaps(uint64_t since, std::vector<TimelineGap> &out) const;  // newest kMaxGaps at most, oldest first
+
+private:
+    const int device;
+    std::atomic<uint64_t> next{0};
+    std::atomic<uint64_t> written{0};  // gaps ever logged
+    std::atomic<uint64_t> lastGap{0};  // position of the newest one
+    TimelineGap log[kMaxGaps] = {};
+};
+
+#endif // SAMPLETIMELINE_H
@@ -0,0 +1,233 @@
+// SharedPublisher.cpp
+#include "SharedPublisher.h"
+#include "AdcCalibration.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr size_t kPage = 4096;
+
+size_t round_up(size_t n, size_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+uint64_t wall_clock_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+#ifndef _WIN32
+// A segment under this name that a crashed run left behind: ready (magic set) and its publisher gone.
+// Anything else, a live publisher or one still setting up, keeps the name.
+bool stale_segment(const std::string &shmName)
+{
+    const int fd = shm_open(shmName.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool stale = false;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(UcShmHeader)) {
+        void *p = mmap(nullptr, sizeof(UcShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            const auto *h = static_cast<const UcShmHeader*>(p);
+            if (std::memcmp(h->magic, UCSHM_MAGIC, sizeof(h->magic)) == 0) {
+                const pid_t pid = static_cast<pid_t>(h->publisherPid);
+                stale = pid > 0 && kill(pid, 0) != 0 && errno == ESRCH;
+            }
+            munmap(p, sizeof(UcShmHeader));
+        }
+    }
+    ::close(fd);
+    return stale;
+}
+#endif
+}
+
+SharedPublisher::~SharedPublisher()
+{
+    close();
+}
+
+bool SharedPublisher::open(const std::string &name, uint64_t ringSamples, const AdcCalibration &calibration)
+{
+    static_assert(sizeof(UcShmChain) == 64 && sizeof(UcShmHeader) == 768, "layout is shared with C readers");
+    close();
+
+    uint64_t capacity = 1;
+    while (capacity < ringSamples)
+        capacity <<= 1;
+
+    const size_t slotBytes = round_up(UCSHM_MAX_BINS * sizeof(float), kPage);
+    const size_t spectraOffset = round_up(sizeof(UcShmHeader), kPage);
+    const size_t ringOffset = spectraOffset + UCSHM_MAX_CHAINS * slotBytes;
+    const size_t total = ringOffset + capacity * sizeof(uint16_t);
+
+    void *base = nullptr;
+#ifdef _WIN32
+    const std::string mapName = "Local\\" + name;
+    HANDLE h = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                  static_cast<DWORD>(static_cast<uint64_t>(total) >> 32),
+                                  static_cast<DWORD>(total & 0xFFFFFFFFu), mapName.c_str());
+    if (h && GetLastError() == ERROR_ALREADY_EXISTS) {  // another instance publishes under this name
+        CloseHandle(h);
+        h = nullptr;
+    }
+    if (h) {
+        base = MapViewOfFile(h, FILE_MAP_WRITE, 0, 0, total);
+        if (!base)
+            CloseHandle(h);
+        else
+            mapping = h;
+    }
+#else
+    const std::string shmName = "/" + name;
+    if (stale_segment(shmName))
+        shm_unlink(shmName.c_str());  // left behind by a crashed run, readers still mapping it keep their copy
+    const int fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd >= 0) {
+        if (ftruncate(fd, static_cast<off_t>(total)) == 0) {
+            base = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED)
+                base = nullptr;
+        }
+        ::close(fd);  // the mapping keeps the segment
+        if (!base)
+            shm_unlink(shmName.c_str());
+    }
+#endif
+    if (!base) {
+        qWarning() << "[SharedPublisher] Cannot create shared memory" << name.c_str()
+                   << "(another instance publishing under this name, or a half-created segment to remove by hand)";
+        return false;
+    }
+
+    header = static_cast<UcShmHeader*>(base);
+    ring = reinterpret_cast<uint16_t*>(static_cast<char*>(base) + ringOffset);
+    ringMask = capacity - 1;
+    cursor = 0;
+    bytes = total;
+    segmentName = name;
+    for (auto &next : nextStamp)
+        next = 0;
+
+    header->version = UCSHM_VERSION;
+    header->headerBytes = sizeof(UcShmHeader);
+    header->totalBytes = total;
+    header->sampleRate = AppConfig::adcSampleRate;
+    header->adcOffset = calibration.offsetCode();
+    header->adcToMicroWatts = calibration.slope(header->adcOffset);
+    header->adcFlags = calibration.tableFile().isEmpty() ? 0 : UCSHM_ADC_MEASURED;
+    header->ringOffset = ringOffset;
+    header->ringCapacity = capacity;
+#ifdef _WIN32
+    header->publisherPid = GetCurrentProcessId();
+#else
+    header->publisherPid = static_cast<uint32_t>(getpid());
+#endif
+    header->heartbeatUs = wall_clock_us();
+    for (int i = 0; i < UCSHM_MAX_CHAINS; ++i)
+        header->chains[i].dataOffset = spectraOffset + i * slotBytes;
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    std::memcpy(header->magic, UCSHM_MAGIC, sizeof(header->magic));  // readers check this last
+
+    qDebug() << "[SharedPublisher] Publishing" << name.c_str() << "-" << total / (1024.0 * 1024.0) << "MB,"
+             << capacity / AppConfig::adcSampleRate << "s of samples";
+    return true;
+}
+
+void SharedPublisher::close()
+{
+    if (!header)
+        return;
+
+    std::memset(header->magic, 0, sizeof(header->magic));  // mappings outliving us see a dead segment
+#ifdef _WIN32
+    UnmapViewOfFile(header);
+    CloseHandle(static_cast<HANDLE>(mapping));
+    mapping = nullptr;
+#else
+    munmap(header, bytes);
+    shm_unlink(("/" + segmentName).c_str());
+#endif
+    header = nullptr;
+    ring = nullptr;
+    bytes = 0;
+}
+
+void SharedPublisher::appendSamples(const uint16_t *data, int ndata)
+{
+    if (!header || ndata <= 0)
+        return;
+
+    const uint64_t n = static_cast<uint64_t>(ndata);
+    const uint64_t end = cursor + n;
+    __atomic_store_n(&header->writeHead, end, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);  // readers see the head move before the samples change
+
+    // A block larger than the ring only leaves its tail
+    const uint64_t skip = n > ringMask + 1 ? n - (ringMask + 1) : 0;
+    const uint64_t pos = (cursor + skip) & ringMask;
+    const uint64_t count = n - skip;
+    const uint64_t first = std::min(count, ringMask + 1 - pos);
+    std::memcpy(ring + pos, data + skip, first * sizeof(uint16_t));
+    if (count > first)
+        std::memcpy(ring, data + skip + first, (count - first) * sizeof(uint16_t));
+
+    __atomic_store_n(&header->writeCursor, end, __ATOMIC_RELEASE);
+    header->heartbeatUs = wall_clock_us();
+    cursor = end;
+}
+
+void SharedPublisher::publishSpectrum(int chain, int chainCount, const AnalysisChainConfig &cfg, uint64_t stamp,
+                                      const double *magnitudes, int bins)
+{
+    if (!header || chain < 0 || chain >= UCSHM_MAX_CHAINS)
+        return;
+    if (chainBusy[chain].test_and_set(std::memory_order_acquire))
+        return;  // another worker is writing this slot right now
+
+    if (stamp < nextStamp[chain]) {  // stamps are on the SampleTimeline, they survive pipeline rebuilds
+        chainBusy[chain].clear(std::memory_order_release);
+        return;
+    }
+    const double interval = AppConfig::sharedSpectrumRateHz > 0.0 ? AppConfig::adcSampleRate / AppConfig::sharedSpectrumRateHz : 0.0;
+    nextStamp[chain] = stamp + static_cast<uint64_t>(interval);
+
+    UcShmChain &slot = header->chains[chain];
+    const uint64_t seq = slot.seq;
+    __atomic_store_n(&slot.seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    bins = std::min(bins, UCSHM_MAX_BINS);
+    slot.stamp = stamp;
+    slot.sampleRate = cfg.sampleRate;
+    slot.fftSize = static_cast<uint32_t>(cfg.fftSize);
+    slot.bins = static_cast<uint32_t>(bins);
+    std::snprintf(slot.name, sizeof(slot.name), "%s", cfg.name);
+    float *dst = reinterpret_cast<float*>(reinterpret_cast<char*>(header) + slot.dataOffset);
+    for (int i = 0; i < bins; ++i)
+        dst[i] = static_cast<float>(magnitudes[i]);
+
+    __atomic_store_n(&slot.seq, seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->chainCount, static_cast<uint32_t>(std::min(chainCount, UCSHM_MAX_CHAINS)), __ATOMIC_RELAXED);
+    chainBusy[chain].clear(std::memory_order_release);
+}
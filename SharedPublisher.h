@@ -0,0 +1,57 @@
+// SharedPublisher.h
+#ifndef SHAREDPUBLISHER_H
+#define SHAREDPUBLISHER_H
+
+#include "SharedStreamLayout.h"
+#include "AppConfig.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+class AdcCalibration;
+
+/*!
+ * Publishes the raw sample stream and the latest spectra of every chain
+ * into a named shared-memory segment (layout in SharedStreamLayout.h) so
+ * other local processes can follow the live data while this one owns the
+ * device. Readers map it read-only and never take a lock the acquisition
+ * path could wait on: the callback adds one memcpy into the ring per
+ * block, the workers a rate-limited float copy per spectrum.
+ */
+class SharedPublisher
+{
+public:
+    SharedPublisher() = default;
+    ~SharedPublisher();
+
+    // ringSamples rounded up to a power of two; the µW scale is the calibration's as of now
+    bool open(const std::string &name, uint64_t ringSamples, const AdcCalibration &calibration);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+    size_t memoryBytes() const { return bytes; }
+
+    // Callback thread only
+    void appendSamples(const uint16_t *data, int ndata);
+
+    // Any worker; frames closer than 1 / AppConfig::sharedSpectrumRateHz apart, or racing
+    // another worker on the same chain, are skipped
+    void publishSpectrum(int chain, int chainCount, const AnalysisChainConfig &cfg, uint64_t stamp,
+                         const double *magnitudes, int bins);
+
+private:
+    UcShmHeader *header = nullptr;
+    uint16_t *ring = nullptr;
+    uint64_t ringMask = 0;
+    uint64_t cursor = 0;
+    size_t bytes = 0;
+    std::string segmentName;
+#ifdef _WIN32
+    void *mapping = nullptr;
+#endif
+
+    std::atomic_flag chainBusy[UCSHM_MAX_CHAINS] = {};
+    uint64_t nextStamp[UCSHM_MAX_CHAINS] = {};  // earliest stamp worth publishing, under chainBusy
+};
+
+#endif // SHAREDPUBLISHER_H
@@ -0,0 +1,70 @@
+// SharedStreamLayout.h
+#ifndef SHAREDSTREAMLAYOUT_H
+#define SHAREDSTREAMLAYOUT_H
+
+/*
+ * Layout of the shared-memory segment written by SharedPublisher.
+ * Plain C so sibling processes can include it as is (see
+ * Backend_Base_Funcs/SharedStream_Reader.h for the reader side).
+ *
+ * POSIX: shm_open("/<name>"), Windows: file mapping "Local\<name>".
+ * All offsets are from the start of the segment, everything little-endian.
+ *
+ * Raw ring (cursor protocol, single writer):
+ *   the writer stores writeHead = cursor + n, copies the n samples,
+ *   then stores writeCursor = cursor + n (release).
+ *   Sample i lives at ring[i & (ringCapacity - 1)]. A reader takes
+ *   end = writeCursor (acquire), uses any [first, end) with
+ *   first + ringCapacity >= end, and after consuming it re-reads
+ *   writeHead: the data was intact if first + ringCapacity >= writeHead.
+ *
+ * Spectra (seqlock, one slot per chain):
+ *   seq is odd while the publisher rewrites the slot, a reader copies
+ *   between two equal even reads of seq. seq / 2 = spectra published.
+ */
+
+#include <stdint.h>
+
+#define UCSHM_MAGIC        "UCSHM01"
+#define UCSHM_VERSION      1
+#define UCSHM_DEFAULT_NAME "ultracoustics"
+#define UCSHM_MAX_CHAINS   8
+#define UCSHM_MAX_BINS     65537   /* fftSize 131072 */
+
+#define UCSHM_ADC_MEASURED 1u      /* adcFlags: a measured table is in use, adcToMicroWatts is only its slope at adcOffset */
+
+typedef struct {
+    uint64_t seq;           /* seqlock, the fields below change only inside it */
+    uint64_t stamp;         /* SampleTimeline index (ADC rate) just past the frame */
+    double   sampleRate;    /* chain rate, Hz */
+    uint32_t fftSize;
+    uint32_t bins;          /* fftSize / 2 + 1 */
+    uint64_t dataOffset;    /* float magnitude[bins] (linear FFT magnitude) */
+    char     name[24];
+} UcShmChain;               /* 64 bytes */
+
+typedef struct {
+    char     magic[8];      /* UCSHM_MAGIC, written last when the segment is ready */
+    uint32_t version;
+    uint32_t headerBytes;   /* sizeof(UcShmHeader) */
+    uint64_t totalBytes;
+    double   sampleRate;    /* raw ring, always the ADC rate */
+    double   adcOffset;
+    double   adcToMicroWatts;   /* µW per code at adcOffset; exact for every code unless UCSHM_ADC_MEASURED */
+    uint64_t ringOffset;    /* uint16_t ring[ringCapacity] */
+    uint64_t ringCapacity;  /* samples, power of two */
+    uint32_t chainCount;    /* slots in use */
+    uint32_t publisherPid;
+    uint64_t heartbeatUs;   /* publisher's wall clock (Unix epoch), refreshed with every block */
+    uint64_t adcFlags;      /* UCSHM_ADC_* */
+    uint64_t reserved[5];
+
+    uint64_t writeHead;     /* own cache lines, the callback thread is their only writer */
+    uint64_t padHead[7];
+    uint64_t writeCursor;   /* absolute index one past the newest complete sample */
+    uint64_t padCursor[7];
+
+    UcShmChain chains[UCSHM_MAX_CHAINS];
+} UcShmHeader;              /* 768 bytes */
+
+#endif // SHAREDSTREAMLAYOUT_H
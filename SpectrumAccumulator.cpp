@@ -0,0 +1,136 @@
+// SpectrumAccumulator.cpp
+#include "SpectrumAccumulator.h"
+#include "AppConfig.h"
+#include "Arena.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+SpectrumAccumulator::SpectrumAccumulator(int binCount, Arena *arena)
+    : bins(binCount)
+{
+    const size_t stride = (static_cast<size_t>(std::max(bins, 1)) + 7) & ~size_t(7);  // whole cache lines
+    double *base;
+    if (arena) {
+        base = arena->allocate<double>(6 * stride, ArenaUse::Spectra);  // zeroed
+        if (!base) {  // the arena ran out, its pipeline is given up before it streams
+            maxHold = minHold = linearSum = expAverage = welchSum = welchOut = nullptr;
+            return;
+        }
+    } else {
+        owned.assign(6 * stride, 0.0);
+        base = owned.data();  // 16-byte aligned, all the SSE2 loads need
+    }
+    maxHold = base;
+    minHold = base + stride;
+    linearSum = base + 2 * stride;
+    expAverage = base + 3 * stride;
+    welchSum = base + 4 * stride;
+    welchOut = base + 5 * stride;
+}
+
+void SpectrumAccumulator::accumulate(const double *spectrum)
+{
+    pthread_mutex_lock(&mutex);
+
+    const bool first = frameCount == 0;
+    const double alpha = first ? 1.0 : AppConfig::spectrumAverageAlpha;
+    double *mx = maxHold;
+    double *mn = minHold;
+    double *lin = linearSum;
+    double *ex = expAverage;
+    double *ws = welchSum;
+
+    int i = 0;
+#ifdef __SSE2__
+    const __m128d va = _mm_set1_pd(alpha);
+    for (; i + 2 <= bins; i += 2) {
+        const __m128d a = _mm_loadu_pd(spectrum + 2 * i);      // re0 im0
+        const __m128d b = _mm_loadu_pd(spectrum + 2 * i + 2);  // re1 im1
+        const __m128d a2 = _mm_mul_pd(a, a);
+        const __m128d b2 = _mm_mul_pd(b, b);
+        const __m128d pw = _mm_add_pd(_mm_unpacklo_pd(a2, b2), _mm_unpackhi_pd(a2, b2));
+        const __m128d m = _mm_sqrt_pd(pw);
+        _mm_store_pd(mx + i, first ? m : _mm_max_pd(_mm_load_pd(mx + i), m));
+        _mm_store_pd(mn + i, first ? m : _mm_min_pd(_mm_load_pd(mn + i), m));
+        _mm_store_pd(lin + i, _mm_add_pd(_mm_load_pd(lin + i), pw));
+        const __m128d e = _mm_load_pd(ex + i);
+        _mm_store_pd(ex + i, _mm_add_pd(e, _mm_mul_pd(va, _mm_sub_pd(pw, e))));
+        _mm_store_pd(ws + i, _mm_add_pd(_mm_load_pd(ws + i), pw));
+    }
+#endif
+    for (; i < bins; ++i) {
+        const double re = spectrum[2 * i];
+        const double im = spectrum[2 * i + 1];
+        const double pw = re * re + im * im;
+        const double m = std::sqrt(pw);
+        mx[i] = first ? m : std::max(mx[i], m);
+        mn[i] = first ? m : std::min(mn[i], m);
+        lin[i] += pw;
+        ex[i] += alpha * (pw - ex[i]);
+        ws[i] += pw;
+    }
+
+    ++frameCount;
+    if (++welchCount >= std::max(1, AppConfig::welchFrames)) {
+        const double inv = 1.0 / welchCount;
+        for (int j = 0; j < bins; ++j) {
+            welchOut[j] = welchSum[j] * inv;
+            welchSum[j] = 0.0;
+        }
+        welchCount = 0;
+        welchReady = true;
+    }
+
+    pthread_mutex_unlock(&mutex);
+}
+
+void SpectrumAccumulator::reset()
+{
+    pthread_mutex_lock(&mutex);
+    std::fill(linearSum, linearSum + bins, 0.0);
+    std::fill(expAverage, expAverage + bins, 0.0);
+    std::fill(welchSum, welchSum + bins, 0.0);
+    frameCount = 0;
+    welchCount = 0;
+    welchReady = false;
+    pthread_mutex_unlock(&mutex);
+}
+
+bool SpectrumAccumulator::read(SpectrumTrace trace, double *dst, int count)
+{
+    pthread_mutex_lock(&mutex);
+    const int n = std::min(count, bins);
+    bool ok = frameCount > 0;
+
+    switch (trace) {
+    case SpectrumTrace::MaxHold:
+        std::copy(maxHold, maxHold + n, dst);
+        break;
+    case SpectrumTrace::MinHold:
+        std::copy(minHold, minHold + n, dst);
+        break;
+    case SpectrumTrace::LinearAverage: {
+        const double inv = ok ? 1.0 / static_cast<double>(frameCount) : 0.0;
+        for (int i = 0; i < n; ++i)
+            dst[i] = std::sqrt(linearSum[i] * inv);
+        break;
+    }
+    case SpectrumTrace::ExponentialAverage:
+        for (int i = 0; i < n; ++i)
+            dst[i] = std::sqrt(expAverage[i]);
+        break;
+    case SpectrumTrace::Welch:
+        ok = welchReady;
+        for (int i = 0; i < n; ++i)
+            dst[i] = std::sqrt(welchOut[i]);
+        break;
+    }
+
+    pthread_mutex_unlock(&mutex);
+    return ok;
+}
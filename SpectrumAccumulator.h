@@ -0,0 +1,58 @@
+// SpectrumAccumulator.h
+#ifndef SPECTRUMACCUMULATOR_H
+#define SPECTRUMACCUMULATOR_H
+
+#include <pthread.h>
+#include <cstdint>
+#include <vector>
+
+class Arena;
+
+enum class SpectrumTrace {
+    MaxHold = 0,
+    MinHold,
+    LinearAverage,       // mean power since the last reset
+    ExponentialAverage,  // power, weight AppConfig::spectrumAverageAlpha per frame
+    Welch                // mean power of the last complete block of AppConfig::welchFrames frames
+};
+
+/*!
+ * Per-chain accumulators fed with every FFT frame by the pool worker that
+ * produced it, so frames the GUI never draws still count. Averages are kept
+ * in power and read back as RMS magnitudes; holds are plain magnitudes.
+ * The bin loop runs two bins per SSE2 op. The six traces share one block
+ * (the pipeline's arena, or an owned vector without one), each starting
+ * on a cache line so the loads and stores are aligned.
+ */
+class SpectrumAccumulator
+{
+public:
+    explicit SpectrumAccumulator(int bins = 0, Arena *arena = nullptr);
+    SpectrumAccumulator(const SpectrumAccumulator &) = delete;
+    SpectrumAccumulator &operator=(const SpectrumAccumulator &) = delete;
+
+    // Interleaved re/im pairs (fftw_complex layout); any worker, serialised internally
+    void accumulate(const double *spectrum);
+    void reset();
+
+    // False while the trace has no data yet (e.g. Welch before the first full block)
+    bool read(SpectrumTrace trace, double *dst, int count);
+
+private:
+    int bins;
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    std::vector<double> owned;  // storage when there is no arena
+    double *maxHold;
+    double *minHold;
+    double *linearSum;
+    double *expAverage;
+    double *welchSum;
+    double *welchOut;
+
+    uint64_t frameCount = 0;
+    int welchCount = 0;
+    bool welchReady = false;
+};
+
+#endif // SPECTRUMACCUMULATOR_H
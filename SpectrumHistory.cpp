@@ -0,0 +1,118 @@
+// SpectrumHistory.cpp
+#include "SpectrumHistory.h"
+#include "Arena.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace {
+// 10 log10(p) / kDbStep, to well under half a code: exponent from the bits,
+// log2 of the mantissa from the atanh series (|t| <= 1/3, error ~2e-4 code)
+inline int16_t power_to_code(double p)
+{
+    constexpr double kCodesPerLog2 = 10.0 * 0.30102999566398120 / SpectrumHistory::kDbStep;
+    constexpr double kTwoOverLn2 = 2.0 / 0.69314718055994531;
+
+    p = std::max(p, 1e-30);
+    uint64_t bits;
+    std::memcpy(&bits, &p, sizeof(bits));
+    const int exponent = static_cast<int>((bits >> 52) & 0x7FF) - 1023;
+    bits = (bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull;
+    double m;
+    std::memcpy(&m, &bits, sizeof(m));
+
+    const double t = (m - 1.0) / (m + 1.0);
+    const double t2 = t * t;
+    const double log2m = kTwoOverLn2 * t * (1.0 + t2 * (1.0 / 3.0 + t2 * (1.0 / 5.0)));
+
+    const double code = std::nearbyint((exponent + log2m) * kCodesPerLog2);
+    return static_cast<int16_t>(std::clamp(code, -32768.0, 32767.0));
+}
+}
+
+SpectrumHistory::SpectrumHistory(int bins, int capacity, Arena &arena)
+    : binCount(bins)
+    , slots(std::max(capacity, 1))
+    , rowStride((static_cast<size_t>(bins) + 31) & ~size_t(31))
+    , bytes(static_cast<size_t>(slots) * rowStride * sizeof(int16_t))
+{
+    data = arena.allocate<int16_t>(static_cast<size_t>(slots) * rowStride, ArenaUse::History);  // zero pages, committed as the ring fills
+    version = arena.allocate<std::atomic<uint64_t>>(slots, ArenaUse::History);
+    for (int i = 0; version && i < slots; ++i)  // null if the arena ran out, the pipeline is then given up
+        new (&version[i]) std::atomic<uint64_t>(0);
+    stamps = arena.allocate<uint64_t>(slots, ArenaUse::History);
+    flagBytes = arena.allocate<uint8_t>(slots, ArenaUse::History);
+}
+
+void SpectrumHistory::store(uint64_t seq, uint64_t stamp, const double *spectrum, uint8_t flags)
+{
+    const int slot = static_cast<int>(seq % slots);
+    std::atomic<uint64_t> &v = version[slot];
+    v.store(2 * seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int16_t *dst = data + static_cast<size_t>(slot) * rowStride;
+    for (int i = 0; i < binCount; ++i) {
+        const double re = spectrum[2 * i];
+        const double im = spectrum[2 * i + 1];
+        dst[i] = power_to_code(re * re + im * im);
+    }
+    stamps[slot] = stamp;
+    flagBytes[slot] = flags;
+    v.store(2 * seq + 2, std::memory_order_release);
+
+    uint64_t seen = newest.load(std::memory_order_relaxed);
+    while (seen < seq + 1 && !newest.compare_exchange_weak(seen, seq + 1, std::memory_order_release))
+        ;
+}
+
+bool SpectrumHistory::range(uint64_t &first, uint64_t &last) const
+{
+    const uint64_t end = newest.load(std::memory_order_acquire);
+    if (end == 0)
+        return false;
+    last = end - 1;
+    first = end > static_cast<uint64_t>(slots) ? end - slots : 0;
+    return true;
+}
+
+bool SpectrumHistory::read(uint64_t seq, int16_t *codes, uint64_t *stamp, uint8_t *flags) const
+{
+    const int slot = static_cast<int>(seq % slots);
+    const uint64_t before = version[slot].load(std::memory_order_acquire);
+    if (before != 2 * seq + 2)
+        return false;
+
+    std::memcpy(codes, data + static_cast<size_t>(slot) * rowStride, binCount * sizeof(int16_t));
+    const uint64_t s = stamps[slot];
+    const uint8_t f = flagBytes[slot];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version[slot].load(std::memory_order_relaxed) != before)
+        return false;
+
+    if (stamp)
+        *stamp = s;
+    if (flags)
+        *flags = f;
+    return true;
+}
+
+bool SpectrumHistory::readMagnitudes(uint64_t seq, double *magnitudes, int count, uint64_t *stamp, uint8_t *flags) const
+{
+    thread_local std::vector<int16_t> codes;
+    codes.resize(binCount);
+    if (!read(seq, codes.data(), stamp, flags))
+        return false;
+
+    for (int i = 0; i < std::min(count, binCount); ++i)
+        magnitudes[i] = toMagnitude(codes[i]);
+    return true;
+}
+
+double SpectrumHistory::toMagnitude(int16_t code)
+{
+    return std::pow(10.0, code * kDbStep / 20.0);  // codes are power dB
+}
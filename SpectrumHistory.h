@@ -0,0 +1,61 @@
+// SpectrumHistory.h
+#ifndef SPECTRUMHISTORY_H
+#define SPECTRUMHISTORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class Arena;
+
+/*!
+ * Ring of the last N spectra of one chain, every frame the workers
+ * produced, stored as 16-bit dB (kDbStep per code) so a second of the
+ * 80 MS/s chain fits in a few hundred MB instead of 1.3 GB of doubles.
+ *
+ * Frames are addressed by sequence number, assigned in queue order when a
+ * worker takes the frame, so slot = seq % capacity. Each slot is a seqlock:
+ * workers write different slots without locking and a reader that races a
+ * writer just sees the frame as missing.
+ *
+ * Everything lives in the pipeline's arena; rows are padded to whole
+ * cache lines so two workers storing neighbouring frames never share one.
+ */
+class SpectrumHistory
+{
+public:
+    static constexpr double kDbStep = 0.01;  // dB per code, full int16 range is +-327 dB
+
+    SpectrumHistory(int bins, int capacity, Arena &arena);
+
+    // Worker side: interleaved re/im pairs (fftw_complex layout), flags are FrameFlags
+    void store(uint64_t seq, uint64_t stamp, const double *spectrum, uint8_t flags = 0);
+
+    int bins() const { return binCount; }
+    int capacity() const { return slots; }
+
+    // Sequence range currently held, false while empty
+    bool range(uint64_t &first, uint64_t &last) const;
+
+    // False if the frame was overwritten (or is being written) meanwhile.
+    // stamp = SampleTimeline index (ADC rate) just past the frame's last sample.
+    bool read(uint64_t seq, int16_t *codes, uint64_t *stamp, uint8_t *flags = nullptr) const;
+    bool readMagnitudes(uint64_t seq, double *magnitudes, int count, uint64_t *stamp, uint8_t *flags = nullptr) const;
+
+    static double toMagnitude(int16_t code);
+
+    size_t memoryBytes() const { return bytes; }
+
+private:
+    int binCount;
+    int slots;
+    size_t rowStride;                  // codes per row, whole cache lines
+    size_t bytes;
+    int16_t *data;                     // [slot * rowStride + bin]
+    std::atomic<uint64_t> *version;    // 2*seq+1 writing, 2*seq+2 valid, 0 empty
+    uint64_t *stamps;
+    uint8_t *flagBytes;
+    std::atomic<uint64_t> newest{0};               // highest seq + 1 stored so far
+};
+
+#endif // SPECTRUMHISTORY_H
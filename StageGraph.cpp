@@ -0,0 +1,235 @@
+// StageGraph.cpp
+#include "StageGraph.h"
+#include "DSPPool.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+std::string trim(const std::string &s)
+{
+    const size_t a = s.find_first_not_of(" \t");
+    const size_t b = s.find_last_not_of(" \t");
+    return a == std::string::npos ? std::string() : s.substr(a, b - a + 1);
+}
+
+// Splits on '|' outside parentheses
+std::vector<std::string> split_stages(const std::string &s)
+{
+    std::vector<std::string> parts;
+    int depth = 0;
+    size_t begin = 0;
+    for (size_t i = 0; i <= s.size(); ++i) {
+        if (i < s.size() && s[i] == '(')
+            ++depth;
+        else if (i < s.size() && s[i] == ')')
+            --depth;
+        else if (i == s.size() || (s[i] == '|' && depth == 0)) {
+            parts.push_back(trim(s.substr(begin, i - begin)));
+            begin = i + 1;
+        }
+    }
+    return parts;
+}
+}
+
+StageGraph::StageGraph(DSPPool *p)
+    : pool(p)
+{
+}
+
+StageGraph::~StageGraph() = default;
+
+StageGraph *StageGraph::build(const std::vector<std::string> &spec, DSPPool *pool, std::string *error)
+{
+    auto fail = [&](const std::string &line, const std::string &why) -> StageGraph* {
+        if (error)
+            *error = "\"" + line + "\": " + why;
+        return nullptr;
+    };
+
+    std::unique_ptr<StageGraph> graph(new StageGraph(pool));
+    for (const std::string &line : spec) {
+        if (trim(line).empty())
+            continue;
+
+        const size_t eq = line.find('=');
+        if (eq == std::string::npos)
+            return fail(line, "expected \"name = source | stage | ...\"");
+        const std::string name = trim(line.substr(0, eq));
+        const std::vector<std::string> parts = split_stages(line.substr(eq + 1));
+        if (name.empty() || name == "raw")
+            return fail(line, "branch needs a name other than \"raw\"");
+        if (parts.size() < 2)
+            return fail(line, "a source and at least one stage");
+
+        auto branch = std::make_unique<Branch>();
+        branch->name = name;
+        Branch *source = nullptr;
+        for (auto &b : graph->branches) {
+            if (b->name == name)
+                return fail(line, "branch \"" + name + "\" defined twice");
+            if (b->name == parts[0])
+                source = b.get();
+        }
+        if (parts[0] != "raw" && !source)
+            return fail(line, "source \"" + parts[0] + "\" must be raw or an earlier branch");
+
+        // Stage kinds have to line up; raw codes are converted where samples are expected
+        BlockKind kind = source ? source->outputKind : BlockKind::Raw;
+        for (size_t i = 1; i < parts.size(); ++i) {
+            std::string why;
+            std::unique_ptr<DspStage> stage = DspStage::create(parts[i], &why);
+            if (!stage)
+                return fail(line, why);
+
+            if (stage->input() != kind) {
+                if (kind != BlockKind::Raw || stage->input() != BlockKind::Samples)
+                    return fail(line, "'" + parts[i] + "' takes " + blockKindName(stage->input()) + ", gets "
+                                      + blockKindName(kind));
+                branch->stages.push_back(DspStage::create("samples", nullptr));
+            }
+            kind = stage->output();
+            branch->stages.push_back(std::move(stage));
+        }
+        branch->outputKind = kind;
+
+        std::string chain = parts[0];
+        for (auto &stage : branch->stages)
+            chain += " | " + stage->name();
+        qDebug() << "[StageGraph] Branch" << name.c_str() << ":" << chain.c_str() << "->" << blockKindName(kind);
+
+        if (source)
+            source->taps.push_back(branch.get());
+        else
+            graph->roots.push_back(branch.get());
+        graph->branches.push_back(std::move(branch));
+    }
+    return graph.release();
+}
+
+void StageGraph::push(const uint16_t *data, int ndata, uint64_t firstSample, double sampleRate)
+{
+    if (roots.empty() || ndata <= 0)
+        return;
+
+    // One copy out of the driver's buffer, shared by every root branch
+    BlockRef block = blocks.acquire(BlockKind::Raw, ndata * sizeof(uint16_t));
+    std::memcpy(block->raw(), data, ndata * sizeof(uint16_t));
+    block->count = ndata;
+    block->stamp = firstSample;
+    block->sampleRate = sampleRate;
+
+    for (Branch *root : roots)
+        enqueue(*root, block);
+}
+
+void StageGraph::enqueue(Branch &branch, const BlockRef &block)
+{
+    pthread_mutex_lock(&branch.queueMutex);
+    if (static_cast<int>(branch.queue.size()) >= kMaxQueued) {
+        pthread_mutex_unlock(&branch.queueMutex);
+        branch.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    branch.queue.push_back(block);
+    const bool start = !branch.scheduled;
+    branch.scheduled = true;
+    pthread_mutex_unlock(&branch.queueMutex);
+
+    if (start) {
+        inflight.fetch_add(1, std::memory_order_acq_rel);
+        Branch *b = &branch;
+        pool->submit([this, b]() { run(*b); });
+    }
+}
+
+// Pool task: drains the branch queue in order, the only place its stages run
+void StageGraph::run(Branch &branch)
+{
+    std::vector<BlockRef> current, next;
+    for (;;) {
+        pthread_mutex_lock(&branch.queueMutex);
+        if (branch.queue.empty() || pool->stopRequested()) {
+            branch.queue.clear();
+            branch.scheduled = false;
+            pthread_mutex_unlock(&branch.queueMutex);
+            break;
+        }
+        current.assign(1, std::move(branch.queue.front()));
+        branch.queue.pop_front();
+        pthread_mutex_unlock(&branch.queueMutex);
+
+        for (auto &stage : branch.stages) {
+            next.clear();
+            for (const BlockRef &block : current)
+                stage->process(block, blocks, next);
+            current.swap(next);
+            if (current.empty())
+                break;  // e.g. a frame still filling
+        }
+        if (current.empty())
+            continue;
+
+        pthread_mutex_lock(&branch.outputMutex);
+        branch.latest = current.back();
+        branch.produced += current.size();
+        pthread_mutex_unlock(&branch.outputMutex);
+
+        for (Branch *tap : branch.taps)
+            for (const BlockRef &block : current)
+                enqueue(*tap, block);
+    }
+    next.clear();
+    current.clear();  // blocks go back to the pool before the graph may be retired
+    inflight.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+std::vector<std::string> StageGraph::branchNames() const
+{
+    std::vector<std::string> names;
+    for (const auto &branch : branches)
+        names.push_back(branch->name);
+    return names;
+}
+
+bool StageGraph::output(const std::string &name, std::vector<double> &values, StageOutputInfo *info)
+{
+    auto it = std::find_if(branches.begin(), branches.end(), [&](const auto &b) { return b->name == name; });
+    if (it == branches.end())
+        return false;
+    Branch &branch = **it;
+
+    pthread_mutex_lock(&branch.outputMutex);
+    const BlockRef block = branch.latest;
+    const uint64_t produced = branch.produced;
+    pthread_mutex_unlock(&branch.outputMutex);
+    if (!block)
+        return false;
+
+    // Emitted blocks never change, copying outside the lock is safe
+    if (block->kind == BlockKind::Raw)
+        values.assign(block->raw(), block->raw() + block->count);
+    else
+        values.assign(block->values(), block->values() + block->valueCount());
+
+    if (info) {
+        info->kind = block->kind;
+        info->count = block->count;
+        info->stamp = block->stamp;
+        info->sampleRate = block->sampleRate;
+        info->frameSize = block->frameSize;
+        info->produced = produced;
+    }
+    return true;
+}
+
+uint64_t StageGraph::droppedBlocks() const
+{
+    uint64_t total = 0;
+    for (const auto &branch : branches)
+        total += branch->dropped.load(std::memory_order_relaxed);
+    return total;
+}
@@ -0,0 +1,90 @@
+// StageGraph.h
+#ifndef STAGEGRAPH_H
+#define STAGEGRAPH_H
+
+#include "DspStage.h"
+
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+class DSPPool;
+
+struct StageOutputInfo {
+    BlockKind kind = BlockKind::Samples;
+    int count = 0;
+    uint64_t stamp = 0;
+    double sampleRate = 0.0;
+    int frameSize = 0;
+    uint64_t produced = 0;  // blocks the branch has emitted so far
+};
+
+/*!
+ * Runtime-configured analyses beside the built-in chains. The graph is a
+ * tree of branches, each a list of typed stages:
+ *
+ *     "lf    = raw | decimate(40) | dc | frame(8192, 0.5) | window(hann) | fft",
+ *     "lfmag = lf  | magnitude",
+ *     "lfmax = lf  | maxhold",
+ *     "lfpk  = lfmag | peaks(8)",
+ *
+ * A branch reads the raw stream or the output of an earlier branch; every
+ * block it emits is kept as its latest output (the sink) and handed to
+ * the branches tapping it. Blocks are pooled and shared by reference, a
+ * fan-out copies nothing. Each branch runs as at most one pool task at a
+ * time, in stream order, so independent branches run in parallel on the
+ * DSP workers. A branch that falls kMaxQueued blocks behind drops input.
+ */
+class StageGraph
+{
+public:
+    static constexpr int kMaxQueued = 64;
+
+    // nullptr and *error when a line doesn't parse or stage kinds don't connect
+    static StageGraph *build(const std::vector<std::string> &spec, DSPPool *pool, std::string *error);
+    ~StageGraph();
+
+    // Callback side: one raw block, firstSample is its absolute stream index
+    void push(const uint16_t *data, int ndata, uint64_t firstSample, double sampleRate);
+
+    bool drained() const { return inflight.load(std::memory_order_acquire) == 0; }
+
+    std::vector<std::string> branchNames() const;
+    bool output(const std::string &branch, std::vector<double> &values, StageOutputInfo *info = nullptr);
+    uint64_t droppedBlocks() const;
+    size_t memoryBytes() const { return blocks.bytesAllocated(); }
+
+private:
+    struct Branch {
+        std::string name;
+        std::vector<std::unique_ptr<DspStage>> stages;
+        std::vector<Branch*> taps;  // branches fed by this one's output
+        BlockKind outputKind = BlockKind::Raw;
+
+        pthread_mutex_t queueMutex = PTHREAD_MUTEX_INITIALIZER;
+        std::deque<BlockRef> queue;
+        bool scheduled = false;  // a pool task owns the branch
+
+        pthread_mutex_t outputMutex = PTHREAD_MUTEX_INITIALIZER;
+        BlockRef latest;
+        uint64_t produced = 0;
+
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    explicit StageGraph(DSPPool *pool);
+    void enqueue(Branch &branch, const BlockRef &block);
+    void run(Branch &branch);
+
+    DSPPool *pool;
+    BlockPool blocks;  // declared first: outlives every branch holding its blocks
+    std::vector<std::unique_ptr<Branch>> branches;
+    std::vector<Branch*> roots;  // fed from the raw stream
+    std::atomic<int> inflight{0};
+};
+
+#endif // STAGEGRAPH_H
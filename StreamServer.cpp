@@ -0,0 +1,395 @@
+// StreamServer.cpp
+#include "StreamServer.h"
+#include "SpectrumHistory.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using socket_t = SOCKET;
+#define CLOSE_SOCKET closesocket
+#define POLL WSAPoll
+static bool would_block() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+using socket_t = int;
+#define CLOSE_SOCKET ::close
+#define POLL ::poll
+static bool would_block() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+#endif
+
+namespace {
+constexpr int kPollMs = 5;          // also the worst-case latency added to a frame
+constexpr int kMaxIov = 64;         // frames per scatter-gather send
+constexpr int kMaxClients = 32;
+
+void set_nonblocking(socket_t s)
+{
+#ifdef _WIN32
+    u_long on = 1;
+    ioctlsocket(s, FIONBIO, &on);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline int16_t power_db_code(double magnitude)
+{
+    const double db = 20.0 * std::log10(std::max(magnitude, 1e-15));
+    return static_cast<int16_t>(std::clamp(std::lround(db / SpectrumHistory::kDbStep), -32768L, 32767L));
+}
+
+template <typename T>
+inline uint8_t* put(uint8_t *p, T value)
+{
+    std::memcpy(p, &value, sizeof(T));
+    return p + sizeof(T);
+}
+}
+
+StreamServer::StreamServer() = default;
+
+StreamServer::~StreamServer()
+{
+    stop();
+}
+
+bool StreamServer::start(const std::string &bindAddress, int port)
+{
+    if (active.load())
+        return true;
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        qWarning() << "[StreamServer] WSAStartup failed";
+        return false;
+    }
+#endif
+
+    socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == static_cast<socket_t>(-1)) {
+        qWarning() << "[StreamServer] socket() failed";
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, bindAddress.c_str(), &addr.sin_addr) != 1
+        || bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+        || listen(s, 8) != 0) {
+        qWarning() << "[StreamServer] Cannot listen on" << bindAddress.c_str() << port;
+        CLOSE_SOCKET(s);
+        return false;
+    }
+    set_nonblocking(s);
+    listener = static_cast<intptr_t>(s);
+
+    active.store(true);
+    pthread_create(&thread, nullptr, &StreamServer::threadMain, this);
+    qDebug() << "[StreamServer] Listening on" << bindAddress.c_str() << port;
+    return true;
+}
+
+void StreamServer::stop()
+{
+    if (!active.exchange(false))
+        return;
+    pthread_join(thread, nullptr);
+
+    pthread_mutex_lock(&mutex);
+    while (!clientList.empty())
+        closeClient(clientList.size() - 1, "server stopped");
+    pthread_mutex_unlock(&mutex);
+
+    CLOSE_SOCKET(static_cast<socket_t>(listener));
+    listener = -1;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+std::vector<uint8_t> StreamServer::beginFrame(FrameType type, size_t payloadBytes)
+{
+    std::vector<uint8_t> frame(sizeof(FrameHeader) + payloadBytes);
+    FrameHeader header = {};
+    header.magic = kMagic;
+    header.type = type;
+    header.version = kVersion;
+    header.payloadBytes = static_cast<uint32_t>(payloadBytes);
+    header.timestampUs = now_us();
+    std::memcpy(frame.data(), &header, sizeof(header));  // sequence is stamped in publish()
+    return frame;
+}
+
+void StreamServer::publish(std::vector<uint8_t> bytes)
+{
+    pthread_mutex_lock(&mutex);
+    const uint32_t seq = sequence++;
+    std::memcpy(bytes.data() + offsetof(FrameHeader, sequence), &seq, sizeof(seq));
+
+    auto frame = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+    for (auto &client : clientList) {
+        if (client->overflow)
+            continue;
+        if (static_cast<int>(client->queue.size()) >= kMaxQueuedFrames)
+            client->overflow = true;  // server thread drops it
+        else
+            client->queue.push_back(frame);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void StreamServer::publishSpectrum(int chain, double sampleRate, int fftSize, const double *magnitudes, int bins)
+{
+    if (clientCount() == 0)
+        return;
+
+    const size_t payload = 4 + 4 + 8 + 4 + 4 + static_cast<size_t>(bins) * sizeof(int16_t);
+    std::vector<uint8_t> frame = beginFrame(Spectrum, payload);
+    uint8_t *p = frame.data() + sizeof(FrameHeader);
+    p = put<uint32_t>(p, chain);
+    p = put<uint32_t>(p, bins);
+    p = put<double>(p, sampleRate);
+    p = put<uint32_t>(p, fftSize);
+    p = put<float>(p, static_cast<float>(SpectrumHistory::kDbStep));
+    for (int i = 0; i < bins; ++i)
+        p = put<int16_t>(p, power_db_code(magnitudes[i]));
+    publish(std::move(frame));
+}
+
+void StreamServer::publishPeaks(int chain, double sampleRate, int fftSize, const double *magnitudes, int bins, int maxPeaks)
+{
+    if (clientCount() == 0 || bins < 3)
+        return;
+
+    // Local maxima, strongest first (DC excluded)
+    std::vector<int> peaks;
+    for (int i = 1; i + 1 < bins; ++i)
+        if (magnitudes[i] > magnitudes[i - 1] && magnitudes[i] >= magnitudes[i + 1])
+            peaks.push_back(i);
+    const int count = std::min<int>(maxPeaks, static_cast<int>(peaks.size()));
+    std::partial_sort(peaks.begin(), peaks.begin() + count, peaks.end(),
+                      [magnitudes](int a, int b) { return magnitudes[a] > magnitudes[b]; });
+
+    std::vector<uint8_t> frame = beginFrame(Peaks, 8 + static_cast<size_t>(count) * 16);
+    uint8_t *p = frame.data() + sizeof(FrameHeader);
+    p = put<uint32_t>(p, chain);
+    p = put<uint32_t>(p, count);
+    for (int k = 0; k < count; ++k) {
+        const int bin = peaks[k];
+        p = put<double>(p, bin * sampleRate / fftSize);
+        p = put<float>(p, static_cast<float>(20.0 * std::log10(std::max(magnitudes[bin], 1e-15))));
+        p = put<uint32_t>(p, bin);
+    }
+    publish(std::move(frame));
+}
+
+void StreamServer::publishTimeEnvelope(uint64_t firstSample, double sampleRate, double samplesPerBin,
+                                       const uint16_t *mins, const uint16_t *maxs, int bins)
+{
+    if (clientCount() == 0 || bins <= 0)
+        return;
+
+    std::vector<uint8_t> frame = beginFrame(TimeEnvelope, 8 + 8 + 8 + 4 + 4 + static_cast<size_t>(bins) * 4);
+    uint8_t *p = frame.data() + sizeof(FrameHeader);
+    p = put<uint64_t>(p, firstSample);
+    p = put<double>(p, sampleRate);
+    p = put<double>(p, samplesPerBin);
+    p = put<uint32_t>(p, bins);
+    p = put<uint32_t>(p, 0);
+    std::memcpy(p, mins, bins * sizeof(uint16_t));
+    std::memcpy(p + bins * sizeof(uint16_t), maxs, bins * sizeof(uint16_t));
+    publish(std::move(frame));
+}
+
+void* StreamServer::threadMain(void *arg)
+{
+    static_cast<StreamServer*>(arg)->run();
+    return nullptr;
+}
+
+void StreamServer::run()
+{
+    std::vector<pollfd> fds;
+    while (active.load(std::memory_order_relaxed)) {
+        // Only this thread adds or removes clients, the lock covers the publishers' queue pushes
+        pthread_mutex_lock(&mutex);
+        fds.assign(1, pollfd{ static_cast<socket_t>(listener), POLLIN, 0 });
+        for (auto &client : clientList) {
+            const short events = client->queue.empty() ? POLLIN : (POLLIN | POLLOUT);
+            fds.push_back(pollfd{ static_cast<socket_t>(client->sock), events, 0 });
+        }
+        pthread_mutex_unlock(&mutex);
+
+        if (POLL(fds.data(), static_cast<unsigned long>(fds.size()), kPollMs) < 0)
+            continue;
+
+        if (fds[0].revents & POLLIN)
+            acceptClients();
+
+        // Walk backwards so closing one doesn't shift the ones still to visit
+        for (size_t i = fds.size() - 1; i >= 1; --i) {
+            Client &client = *clientList[i - 1];
+            const short revents = fds[i].revents;
+
+            if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                pthread_mutex_lock(&mutex);
+                closeClient(i - 1, "disconnected");
+                pthread_mutex_unlock(&mutex);
+                continue;
+            }
+            if (revents & POLLIN) {  // clients don't talk; drain and notice orderly shutdowns
+                char sink[256];
+                const auto n = recv(static_cast<socket_t>(client.sock), sink, sizeof(sink), 0);
+                if (n == 0 || (n < 0 && !would_block())) {
+                    pthread_mutex_lock(&mutex);
+                    closeClient(i - 1, "disconnected");
+                    pthread_mutex_unlock(&mutex);
+                    continue;
+                }
+            }
+            if (!flush(client)) {
+                pthread_mutex_lock(&mutex);
+                closeClient(i - 1, client.overflow ? "too slow, queue full" : "send failed");
+                pthread_mutex_unlock(&mutex);
+            }
+        }
+    }
+}
+
+void StreamServer::acceptClients()
+{
+    for (;;) {
+        sockaddr_in addr = {};
+        socklen_t len = sizeof(addr);
+        const socket_t s = accept(static_cast<socket_t>(listener), reinterpret_cast<sockaddr*>(&addr), &len);
+        if (s == static_cast<socket_t>(-1))
+            return;
+
+        char ip[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        const std::string peer = std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+
+        pthread_mutex_lock(&mutex);
+        const bool full = static_cast<int>(clientList.size()) >= kMaxClients;
+        if (!full) {
+            set_nonblocking(s);
+            int on = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+            auto client = std::make_unique<Client>();
+            client->sock = static_cast<intptr_t>(s);
+            client->peer = peer;
+            clientList.push_back(std::move(client));
+            clients.store(static_cast<int>(clientList.size()));
+        }
+        pthread_mutex_unlock(&mutex);
+
+        if (full) {
+            CLOSE_SOCKET(s);
+            qWarning() << "[StreamServer] Refused" << peer.c_str() << "- client limit reached";
+        } else {
+            qDebug() << "[StreamServer] Client connected:" << peer.c_str();
+        }
+    }
+}
+
+// One scatter-gather send over the queued frames, straight from the shared buffers
+bool StreamServer::flush(Client &client)
+{
+    pthread_mutex_lock(&mutex);
+    if (client.overflow) {
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+    const size_t frames = std::min<size_t>(client.queue.size(), kMaxIov);
+    size_t offset = client.offset;
+
+#ifdef _WIN32
+    WSABUF iov[kMaxIov];
+    for (size_t k = 0; k < frames; ++k) {
+        const std::vector<uint8_t> &f = *client.queue[k];
+        iov[k].buf = reinterpret_cast<char*>(const_cast<uint8_t*>(f.data())) + offset;
+        iov[k].len = static_cast<ULONG>(f.size() - offset);
+        offset = 0;
+    }
+#else
+    iovec iov[kMaxIov];
+    for (size_t k = 0; k < frames; ++k) {
+        const std::vector<uint8_t> &f = *client.queue[k];
+        iov[k].iov_base = const_cast<uint8_t*>(f.data()) + offset;
+        iov[k].iov_len = f.size() - offset;
+        offset = 0;
+    }
+#endif
+    pthread_mutex_unlock(&mutex);  // publishers only append, the buffers stay put
+
+    if (frames == 0)
+        return true;
+
+    size_t sent = 0;
+#ifdef _WIN32
+    DWORD n = 0;
+    if (WSASend(static_cast<socket_t>(client.sock), iov, static_cast<DWORD>(frames), &n, 0, nullptr, nullptr) != 0)
+        return would_block();
+    sent = n;
+#else
+    msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = frames;
+    const ssize_t n = sendmsg(client.sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0)
+        return would_block();
+    sent = static_cast<size_t>(n);
+#endif
+
+    pthread_mutex_lock(&mutex);
+    while (sent > 0 && !client.queue.empty()) {
+        const size_t left = client.queue.front()->size() - client.offset;
+        if (sent < left) {
+            client.offset += sent;
+            break;
+        }
+        sent -= left;
+        client.offset = 0;
+        client.queue.pop_front();
+    }
+    pthread_mutex_unlock(&mutex);
+    return true;
+}
+
+// Caller holds the mutex
+void StreamServer::closeClient(size_t index, const char *reason)
+{
+    Client &client = *clientList[index];
+    if (client.overflow)
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    qDebug() << "[StreamServer] Dropping client" << client.peer.c_str() << "-" << reason;
+
+    CLOSE_SOCKET(static_cast<socket_t>(client.sock));
+    clientList.erase(clientList.begin() + static_cast<long>(index));
+    clients.store(static_cast<int>(clientList.size()));
+}
@@ -0,0 +1,95 @@
+// StreamServer.h
+#ifndef STREAMSERVER_H
+#define STREAMSERVER_H
+
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*!
+ * Embedded TCP server pushing published data to any number of clients
+ * (dashboards, loggers; Backend_Base_Funcs/Stream_LoopbackClient.c).
+ *
+ * Every frame is built once into an immutable buffer and shared by all
+ * client queues; the server thread sends straight from those buffers with
+ * one scatter-gather call per client (sendmsg / WSASend), no per-client
+ * copy. Queues are bounded: a client more than kMaxQueuedFrames behind is
+ * disconnected instead of holding memory or stalling the others.
+ *
+ * Wire format, little-endian, one FrameHeader then payloadBytes:
+ *   Spectrum      uint32 chain, uint32 bins, double sampleRate, uint32 fftSize,
+ *                 float dbStep, int16 code[bins] (power dB = code * dbStep)
+ *   Peaks         uint32 chain, uint32 count, { double freqHz, float powerDb, uint32 bin }[count]
+ *   TimeEnvelope  uint64 firstSample, double sampleRate, double samplesPerBin, uint32 bins,
+ *                 uint32 reserved, uint16 min[bins], uint16 max[bins] (raw ADC codes)
+ */
+class StreamServer
+{
+public:
+    enum FrameType : uint16_t { Spectrum = 1, Peaks = 2, TimeEnvelope = 3 };
+
+#pragma pack(push, 1)
+    struct FrameHeader {
+        uint32_t magic;         // kMagic
+        uint16_t type;          // FrameType
+        uint16_t version;       // kVersion
+        uint32_t payloadBytes;
+        uint32_t sequence;      // per server, gaps = frames this client missed
+        uint64_t timestampUs;   // publisher's steady clock
+    };
+#pragma pack(pop)
+
+    static constexpr uint32_t kMagic = 0x54534355;  // "UCST"
+    static constexpr uint16_t kVersion = 1;
+    static constexpr int kMaxQueuedFrames = 64;
+
+    StreamServer();
+    ~StreamServer();
+
+    bool start(const std::string &bindAddress, int port);
+    void stop();
+    bool running() const { return active.load(std::memory_order_relaxed); }
+    int clientCount() const { return clients.load(std::memory_order_relaxed); }
+    uint64_t droppedClients() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Any thread; cheap no-ops without clients
+    void publishSpectrum(int chain, double sampleRate, int fftSize, const double *magnitudes, int bins);
+    void publishPeaks(int chain, double sampleRate, int fftSize, const double *magnitudes, int bins, int maxPeaks);
+    void publishTimeEnvelope(uint64_t firstSample, double sampleRate, double samplesPerBin,
+                             const uint16_t *mins, const uint16_t *maxs, int bins);
+
+private:
+    using Frame = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Client {
+        intptr_t sock;
+        std::string peer;
+        std::deque<Frame> queue;
+        size_t offset = 0;      // bytes of queue.front() already sent
+        bool overflow = false;
+    };
+
+    std::vector<uint8_t> beginFrame(FrameType type, size_t payloadBytes);
+    void publish(std::vector<uint8_t> frame);
+    static void* threadMain(void *arg);
+    void run();
+    void acceptClients();
+    bool flush(Client &client);  // false once the client has to go
+    void closeClient(size_t index, const char *reason);
+
+    pthread_t thread;
+    std::atomic<bool> active{false};
+    intptr_t listener = -1;
+
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;  // client list and queues
+    std::vector<std::unique_ptr<Client>> clientList;
+    std::atomic<int> clients{0};
+    std::atomic<uint64_t> dropped{0};
+    uint32_t sequence = 0;
+};
+
+#endif // STREAMSERVER_H
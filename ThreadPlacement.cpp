@@ -0,0 +1,255 @@
+// ThreadPlacement.cpp
+#include "ThreadPlacement.h"
+#include "AppConfig.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QStringList>
+#include <pthread.h>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+std::mutex report_mutex;
+QStringList report_lines;
+bool memory_locked = false;
+
+#ifdef _WIN32
+// Windows has no plain query for a thread's affinity (only setting one returns the old mask),
+// so the pin functions remember what they set; 0 = never pinned, the process mask applies
+thread_local DWORD_PTR pinned_mask = 0;
+#endif
+
+QString describe_current_thread()
+{
+#ifdef _WIN32
+    HANDLE self = GetCurrentThread();
+    DWORD_PTR processMask = 0, systemMask = 0;
+    GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+    const DWORD_PTR mask = pinned_mask ? pinned_mask : processMask;
+
+    QStringList cores;
+    if (mask == processMask) {
+        cores << "any";
+    } else {
+        for (int c = 0; c < static_cast<int>(sizeof(DWORD_PTR) * 8); ++c)
+            if (mask & (static_cast<DWORD_PTR>(1) << c))
+                cores << QString::number(c);
+    }
+
+    return QString("cores [%1], priority %2").arg(cores.join(',')).arg(GetThreadPriority(self));
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+
+    QStringList cores;
+    const int allowed = CPU_COUNT(&set);
+    if (allowed == ThreadPlacement::coreCount()) {
+        cores << "any";
+    } else {
+        for (int c = 0; c < CPU_SETSIZE; ++c)
+            if (CPU_ISSET(c, &set))
+                cores << QString::number(c);
+    }
+
+    int policy = 0;
+    sched_param param{};
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    const int nice = getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+
+    const char *policyName = policy == SCHED_FIFO ? "FIFO" : policy == SCHED_RR ? "RR" : "OTHER";
+    return QString("cores [%1], %2 prio %3, nice %4, now on core %5")
+        .arg(cores.join(','))
+        .arg(policyName)
+        .arg(param.sched_priority)
+        .arg(nice)
+        .arg(sched_getcpu());
+#else
+    return QString("placement not supported on this platform");
+#endif
+}
+} // namespace
+
+int ThreadPlacement::coreCount()
+{
+    return static_cast<int>(std::thread::hardware_concurrency());
+}
+
+bool ThreadPlacement::pinCurrentThread(int core)
+{
+    if (core < 0)
+        return true;
+
+#ifdef _WIN32
+    const DWORD_PTR mask = static_cast<DWORD_PTR>(1) << core;
+    if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+        return false;
+    pinned_mask = mask;
+    return true;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+bool ThreadPlacement::pinCurrentThread(const std::vector<int> &cores)
+{
+    if (cores.empty())
+        return true;
+
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (int core : cores)
+        mask |= static_cast<DWORD_PTR>(1) << core;
+    if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+        return false;
+    pinned_mask = mask;
+    return true;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core : cores)
+        CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+std::vector<int> ThreadPlacement::nodeCores(int node)
+{
+    std::vector<int> cores;
+    if (node < 0)
+        return cores;
+
+    // "0-7,16-23"
+    QFile list(QString("/sys/devices/system/node/node%1/cpulist").arg(node));
+    if (!list.open(QIODevice::ReadOnly))
+        return cores;
+    for (const QString &range : QString::fromUtf8(list.readLine()).trimmed().split(',')) {
+        const QStringList ends = range.split('-');
+        if (range.isEmpty())
+            continue;
+        const int first = ends[0].toInt();
+        const int last = ends.size() > 1 ? ends[1].toInt() : first;
+        for (int c = first; c <= last; ++c)
+            cores.push_back(c);
+    }
+    return cores;
+}
+
+bool ThreadPlacement::setRealtimePriority(int priority)
+{
+    if (priority <= 0)
+        return true;
+
+#ifdef _WIN32
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    sched_param param{};
+    param.sched_priority = std::min(priority, sched_get_priority_max(SCHED_FIFO));
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;  // needs CAP_SYS_NICE
+#endif
+}
+
+bool ThreadPlacement::setNice(int nice)
+{
+    if (nice == 0)
+        return true;
+
+#ifdef _WIN32
+    const int prio = nice < 0 ? THREAD_PRIORITY_ABOVE_NORMAL : THREAD_PRIORITY_BELOW_NORMAL;
+    return SetThreadPriority(GetCurrentThread(), prio) != 0;
+#elif defined(__linux__)
+    // Linux applies setpriority() to a single thread when given its tid
+    return setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) == 0;
+#else
+    return false;
+#endif
+}
+
+bool ThreadPlacement::lockMemory()
+{
+    if (!AppConfig::lockSampleBuffers || memory_locked)
+        return memory_locked;
+
+#if defined(_WIN32)
+    qWarning() << "[ThreadPlacement] Memory locking is not supported on Windows";
+    return false;
+#else
+    // MCL_FUTURE also covers sample rings and frame buffers allocated later
+    memory_locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    if (!memory_locked)
+        qWarning() << "[ThreadPlacement] mlockall failed (raise RLIMIT_MEMLOCK?)";
+    return memory_locked;
+#endif
+}
+
+// An explicit core wins; otherwise a NUMA node keeps the thread (and what it first touches) local
+void ThreadPlacement::applyAcquisition(const DeviceConfig &config, int device)
+{
+    bool ok = config.acquisitionCore >= 0 ? pinCurrentThread(config.acquisitionCore)
+                                          : pinCurrentThread(nodeCores(config.numaNode));
+    ok &= setRealtimePriority(AppConfig::acquisitionRtPriority);
+    if (!ok)
+        qWarning() << "[ThreadPlacement] Device" << device << "acquisition placement only partially applied";
+
+    record(QString("device %1 acquisition").arg(device));
+}
+
+void ThreadPlacement::applyWorker(const DeviceConfig &config, int device, int index)
+{
+    bool ok = true;
+    if (config.dspFirstCore >= 0 && coreCount() > 0)
+        ok &= pinCurrentThread((config.dspFirstCore + index) % coreCount());
+    else
+        ok &= pinCurrentThread(nodeCores(config.numaNode));
+    ok &= setNice(AppConfig::dspNice);
+    if (!ok)
+        qWarning() << "[ThreadPlacement] Device" << device << "DSP worker" << index << "placement only partially applied";
+
+    record(QString("device %1 dsp worker %2").arg(device).arg(index));
+}
+
+int ThreadPlacement::workerCount(const DeviceConfig &config)
+{
+    if (config.dspThreads > 0)
+        return config.dspThreads;
+
+    // One core per acquisition thread, the rest split evenly between the devices
+    const int devices = std::max<int>(1, static_cast<int>(AppConfig::devices.size()));
+    return std::max(1, (coreCount() - devices) / devices);
+}
+
+void ThreadPlacement::record(const QString &role)
+{
+    QString line = QString("%1: %2").arg(role, describe_current_thread());
+
+    std::lock_guard<std::mutex> guard(report_mutex);
+    report_lines << line;
+}
+
+QString ThreadPlacement::report()
+{
+    std::lock_guard<std::mutex> guard(report_mutex);
+
+    QStringList lines = report_lines;
+    lines << QString("memory locked: %1").arg(memory_locked ? "yes" : "no");
+    return lines.join('\n');
+}
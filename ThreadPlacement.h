@@ -0,0 +1,41 @@
+// ThreadPlacement.h
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <QString>
+#include <cstddef>
+#include <vector>
+
+struct DeviceConfig;
+
+/*!
+ * Core pinning, scheduling class and memory locking for each device's
+ * acquisition (libri callback) thread and DSP workers. Every call is applied to the
+ * calling thread and recorded, so report() shows what the OS actually granted
+ * rather than what AppConfig asked for.
+ */
+class ThreadPlacement
+{
+public:
+    // Applied from inside the thread being placed
+    static void applyAcquisition(const DeviceConfig &config, int device);         // acquisitionCore, AppConfig::acquisitionRtPriority
+    static void applyWorker(const DeviceConfig &config, int device, int index);   // dspFirstCore + index, AppConfig::dspNice
+
+    static int workerCount(const DeviceConfig &config);  // dspThreads, or this device's share of the cores
+
+    static bool pinCurrentThread(int core);
+    static bool pinCurrentThread(const std::vector<int> &cores);  // any of them, the scheduler picks
+    static std::vector<int> nodeCores(int node);  // empty if unknown (or not Linux)
+    static bool setRealtimePriority(int priority);  // SCHED_FIFO (TIME_CRITICAL on Windows)
+    static bool setNice(int nice);
+
+    static bool lockMemory();  // mlockall(MCL_CURRENT | MCL_FUTURE) when lockSampleBuffers is set
+
+    static QString report();   // one line per placed thread
+    static int coreCount();
+
+private:
+    static void record(const QString &role);
+};
+
+#endif // THREADPLACEMENT_H
@@ -1,35 +1,191 @@
 #include "TimeDProcess.h"
 #include "AppConfig.h"
+#include "HugePages.h"
+#include "SampleTimeline.h"
 
-#include <pthread.h>
 #include <QDebug>
+#include <QThread>
 #include <algorithm>
 #include <stdlib.h>
 #include <string.h>
 #include <atomic>
 
 namespace {
-// buffer size = sample‑rate × time‑window
-static int  dynamic_time_buffer_size = AppConfig::timeWindowSeconds * AppConfig::sampleRate;
+constexpr uint64_t kL1Block = 256;        // samples per level-1 min/max entry
+constexpr uint64_t kL2Block = 256 * 256;  // samples per level-2 min/max entry
+}
+
+// Single-producer ring: only the acquisition callback writes, readers copy without locking it out.
+// Indices are SampleTimeline's: `cursor` is one past the newest sample, position = index % capacity.
+// `head` runs ahead of `cursor` by the block being written: it moves before the copy, so a reader that
+// finds head <= first + capacity after its own copy knows no sample from `first` on was being overwritten.
+// Level-1/2 min/max arrays let summary queries cover seconds of data without touching every sample.
+struct TimeRing {
+    uint16_t *data = nullptr;
+    uint16_t *l1min = nullptr, *l1max = nullptr;
+    uint16_t *l2min = nullptr, *l2max = nullptr;
+    uint64_t  capacity = 0;   // window + headroom, multiple of kL2Block
+    int       window = 0;     // samples exposed to readers
+    std::atomic<uint64_t> origin{0};  // first index of the contiguous run held here
+    size_t    bytes = 0;
+    bool      huge = false;
+    std::atomic<uint64_t> cursor{0};
+    std::atomic<uint64_t> head{0};
+};
+
+namespace {
+constexpr int kReadRetries = 4;
+constexpr uint64_t kHandoffTail = 1 << 20;  // samples a resize leaves for the callback to copy
+constexpr int kHandoffWaitMs = 200;         // then the stream is taken as stopped
+
+uint64_t headroom_for(int window)
+{
+    return std::max<uint64_t>(65536, static_cast<uint64_t>(window) / 8);
+}
+
+TimeRing *allocate_ring(int window)
+{
+    auto *r = new TimeRing;
+    r->window = window;
+    r->capacity = (static_cast<uint64_t>(window) + headroom_for(window) + kL2Block - 1) / kL2Block * kL2Block;
+
+    const uint64_t l1 = r->capacity / kL1Block;
+    const uint64_t l2 = r->capacity / kL2Block;
+    r->bytes = (r->capacity + 2 * l1 + 2 * l2) * sizeof(uint16_t);
+
+    auto *base = static_cast<uint16_t *>(HugePages::allocate(r->bytes, &r->huge));
+    if (!base) {
+        delete r;
+        return nullptr;
+    }
 
-static uint16_t   *time_buffer   = nullptr;
-static pthread_mutex_t time_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int   total_samples_collected = 0;
+    r->data  = base;
+    r->l1min = r->data + r->capacity;
+    r->l1max = r->l1min + l1;
+    r->l2min = r->l1max + l1;
+    r->l2max = r->l2min + l2;
+    return r;
 }
 
-TimeDProcess* TimeDProcess::instance = nullptr;  // Static instance pointer
+void free_ring(TimeRing *r)
+{
+    if (!r) return;
+    HugePages::release(r->data, r->bytes);
+    delete r;
+}
+
+void min_max(const uint16_t *p, uint64_t n, uint16_t &mn, uint16_t &mx)
+{
+    uint16_t lo = mn, hi = mx;
+    for (uint64_t i = 0; i < n; ++i) {  // vectorizes to pminuw/pmaxuw
+        lo = std::min(lo, p[i]);
+        hi = std::max(hi, p[i]);
+    }
+    mn = lo;
+    mx = hi;
+}
+
+void fold(uint16_t *mins, uint16_t *maxs, uint64_t slot, bool fresh, uint16_t mn, uint16_t mx)
+{
+    mins[slot] = fresh ? mn : std::min(mins[slot], mn);
+    maxs[slot] = fresh ? mx : std::max(maxs[slot], mx);
+}
+
+// Store samples [first, first + n) and fold them into the summary levels; producer side only.
+// `restart` resets the summary slots of the first segment when the stream doesn't continue from cursor.
+void write_samples(TimeRing *r, uint64_t first, const uint16_t *src, uint64_t n, bool restart)
+{
+    const uint64_t l1cap = r->capacity / kL1Block;
+    const uint64_t l2cap = r->capacity / kL2Block;
+
+    uint64_t idx = first;
+    while (n > 0) {
+        // Segments never cross the physical end of the ring or an L1 block boundary
+        const uint64_t pos = idx % r->capacity;
+        const uint64_t seg = std::min({ n, r->capacity - pos, kL1Block - idx % kL1Block });
+
+        memcpy(r->data + pos, src, seg * sizeof(uint16_t));
+
+        uint16_t mn = 0xFFFF, mx = 0;
+        min_max(src, seg, mn, mx);
+        fold(r->l1min, r->l1max, (idx / kL1Block) % l1cap, restart || idx % kL1Block == 0, mn, mx);
+        fold(r->l2min, r->l2max, (idx / kL2Block) % l2cap, restart || idx % kL2Block == 0, mn, mx);
+
+        restart = false;
+        idx += seg;
+        src += seg;
+        n   -= seg;
+    }
+}
+
+// Raw scan of [a, b), handling the wrap
+void scan_raw(const TimeRing *r, uint64_t a, uint64_t b, uint16_t &mn, uint16_t &mx)
+{
+    while (a < b) {
+        const uint64_t pos = a % r->capacity;
+        const uint64_t seg = std::min(b - a, r->capacity - pos);
+        min_max(r->data + pos, seg, mn, mx);
+        a += seg;
+    }
+}
+
+void scan_level(const uint16_t *mins, const uint16_t *maxs, uint64_t cap, uint64_t block,
+                uint64_t a, uint64_t b, uint16_t &mn, uint16_t &mx)
+{
+    for (uint64_t blk = a / block; blk * block < b; ++blk) {
+        mn = std::min(mn, mins[blk % cap]);
+        mx = std::max(mx, maxs[blk % cap]);
+    }
+}
+
+uint64_t oldest_valid(const TimeRing *r, uint64_t end)
+{
+    const uint64_t origin = r->origin.load(std::memory_order_relaxed);
+    if (end <= origin)
+        return end;  // restarting at a new origin, nothing valid yet
+    const uint64_t kept = std::min<uint64_t>(end - origin, r->window);
+    return end - kept;
+}
+
+// Oldest sample still in the ring: the window plus the headroom the producer hasn't reused yet
+uint64_t oldest_retained(const TimeRing *r, uint64_t end)
+{
+    const uint64_t origin = r->origin.load(std::memory_order_relaxed);
+    if (end <= origin)
+        return end;
+    return end - std::min<uint64_t>(end - origin, r->capacity);
+}
+
+// Append [to->cursor, end) of `from` to `to`; whoever calls this is the only writer of `to`
+void carry_over(const TimeRing *from, TimeRing *to, uint64_t end)
+{
+    to->head.store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint64_t idx = to->cursor.load(std::memory_order_relaxed); idx < end; ) {
+        const uint64_t pos = idx % from->capacity;
+        const uint64_t seg = std::min(end - idx, from->capacity - pos);
+        write_samples(to, idx, from->data + pos, seg, idx == to->origin.load(std::memory_order_relaxed));
+        idx += seg;
+    }
+    to->cursor.store(end, std::memory_order_release);
+}
+}
 
 TimeDProcess::TimeDProcess(QObject *parent)
-    : QObject(parent), started(false)
+    : QObject(parent), started(false),
+      windowSize(AppConfig::timeWindowSeconds * AppConfig::adcSampleRate)
 {
     this->moveToThread(&workerThread);
-    instance = this;  // Set static pointer to current instance
 }
 
 TimeDProcess::~TimeDProcess()
 {
     workerThread.quit();
     workerThread.wait();
+
+    // The owning FFTProcess has stopped its callback by now
+    free_ring(pendingRing.exchange(nullptr));
+    free_ring(ring.exchange(nullptr));
 }
 
 void TimeDProcess::start()
@@ -42,13 +198,8 @@ void TimeDProcess::start()
     connect(&workerThread, &QThread::started, this, [this]() {
         qDebug() << "[TimeDProcess] Thread started";
 
-        pthread_mutex_lock(&time_mutex);
-        if (!time_buffer) {
-            pthread_mutex_unlock(&time_mutex);
-            resize(dynamic_time_buffer_size);
-        } else {
-            pthread_mutex_unlock(&time_mutex);
-        }
+        if (!ring.load())
+            resize(windowSize);
     });
 
     workerThread.start();
@@ -57,82 +208,230 @@ void TimeDProcess::start()
 
 void TimeDProcess::resize(int size)
 {
-    isResizing.store(true);
-
-    pthread_mutex_lock(&time_mutex);
-
-    uint16_t *new_buffer = static_cast<uint16_t *>(calloc(size, sizeof(uint16_t)));
-    if (!new_buffer) {
-        pthread_mutex_unlock(&time_mutex);
+    TimeRing *fresh = allocate_ring(size);
+    if (!fresh) {
         qWarning("[TimeDProcess] Failed to allocate time buffer");
-        isResizing.store(false);
         return;
     }
 
-    uint16_t *old_buffer = time_buffer;
-    time_buffer = new_buffer;
-    dynamic_time_buffer_size = size;
-    total_samples_collected = 0;
+    // Carry the newest history over while capture keeps going, pass after pass until
+    // only a short tail is left, which the callback copies itself before swapping rings
+    activeReaders.fetch_add(1);
+    TimeRing *old = ring.load();
+    if (old) {
+        const uint64_t end = old->cursor.load(std::memory_order_acquire);
+        const uint64_t first = end - std::min<uint64_t>(end - oldest_valid(old, end), size);
+        fresh->origin.store(first);
+        fresh->cursor.store(first);
+        fresh->head.store(first);
+        uint64_t now = end;
+        do {
+            carry_over(old, fresh, now);
+            now = old->cursor.load(std::memory_order_acquire);
+        } while (now - fresh->cursor.load(std::memory_order_relaxed) > kHandoffTail);
+    }
+    activeReaders.fetch_sub(1);
+
+    if (!old) {
+        ring.store(fresh);
+    } else {
+        pendingRing.store(fresh, std::memory_order_release);
+        for (int waited = 0; pendingRing.load(std::memory_order_acquire) == fresh && waited < kHandoffWaitMs; ++waited)
+            QThread::msleep(1);
+
+        // No callback came by: the stream is stopped, finish the copy here
+        TimeRing *expected = fresh;
+        if (pendingRing.compare_exchange_strong(expected, nullptr)) {
+            carry_over(old, fresh, old->cursor.load(std::memory_order_acquire));
+            ring.store(fresh);
+        }
+    }
+    windowSize = size;
+
+    // Wait for the producer and any reader still holding the old ring
+
+    while (producerHazard.load() == old && old)
+        QThread::yieldCurrentThread();
+    while (activeReaders.load() > 0)
+        QThread::yieldCurrentThread();
 
-    pthread_mutex_unlock(&time_mutex);
-    free(old_buffer);
+    free_ring(old);
 
-    isResizing.store(false);
+    qDebug() << "[TimeDProcess] Time buffer" << size << "samples,"
+             << fresh->bytes / (1024 * 1024) << "MB" << (fresh->huge ? "(huge pages)" : "");
 }
 
 int TimeDProcess::sampleCount() const
 {
-    pthread_mutex_lock(&time_mutex);
-    int result = total_samples_collected;
-    pthread_mutex_unlock(&time_mutex);
+    activeReaders.fetch_add(1);
+    TimeRing *r = ring.load();
+    int result = 0;
+    if (r) {
+        const uint64_t end = r->cursor.load(std::memory_order_acquire);
+        result = static_cast<int>(end - oldest_valid(r, end));
+    }
+    activeReaders.fetch_sub(1);
     return result;
 }
 
-void TimeDProcess::getBuffer(uint16_t *dst, int count)
+uint64_t TimeDProcess::writeCursor() const
+{
+    activeReaders.fetch_add(1);
+    TimeRing *r = ring.load();
+    uint64_t end = r ? r->cursor.load(std::memory_order_acquire) : 0;
+    activeReaders.fetch_sub(1);
+    return end;
+}
+
+bool TimeDProcess::copyRange(uint64_t first, int count, uint16_t *dst)
 {
     if (!dst || count <= 0)
-        return;
+        return false;
 
-    pthread_mutex_lock(&time_mutex);
+    activeReaders.fetch_add(1);
+    TimeRing *r = ring.load();
+    bool ok = false;
 
-    if (!time_buffer) {
-        pthread_mutex_unlock(&time_mutex);
-        memset(dst, 0, count * sizeof(uint16_t));
-        return;
-    }
+    if (r) {
+        const uint64_t last = first + static_cast<uint64_t>(count);
+        const uint64_t end = r->cursor.load(std::memory_order_acquire);
 
-    int n     = std::min(count, dynamic_time_buffer_size);
-    int end   = total_samples_collected;
-    int start = (end - n + dynamic_time_buffer_size) % dynamic_time_buffer_size;
+        // Past the window too, so a slower reader (an export) gets the headroom as slack
+        if (first >= oldest_retained(r, end) && last <= end) {
+            // At most two block copies: up to the physical end of the ring, then from its start
+            const uint64_t pos = first % r->capacity;
+            const uint64_t head = std::min<uint64_t>(count, r->capacity - pos);
+            memcpy(dst, r->data + pos, head * sizeof(uint16_t));
+            memcpy(dst + head, r->data, (count - head) * sizeof(uint16_t));
 
-    for (int i = 0; i < n; ++i)
-        dst[i] = time_buffer[(start + i) % dynamic_time_buffer_size];
+            // Consistent unless the producer reserved past the oldest sample we copied
+            std::atomic_thread_fence(std::memory_order_acquire);
+            ok = r->head.load(std::memory_order_relaxed) <= first + r->capacity;
+        }
+    }
 
-    pthread_mutex_unlock(&time_mutex);
+    activeReaders.fetch_sub(1);
+    return ok;
 }
 
-int TimeDProcess::transferCallback(uint16_t *data, int ndata, int /*dataloss*/, void * /*user*/)
+int TimeDProcess::summary(uint64_t first, uint64_t count, int bins, uint16_t *mins, uint16_t *maxs)
 {
-    static int write_idx = 0;
+    if (!mins || !maxs || bins <= 0 || count == 0)
+        return 0;
 
-    if (instance && instance->isResizing.load()) {
-        return 0;  // Skip if resizing in progress
+    activeReaders.fetch_add(1);
+    TimeRing *r = ring.load();
+    if (!r) {
+        activeReaders.fetch_sub(1);
+        return 0;
     }
 
-    pthread_mutex_lock(&time_mutex);
+    int filled = 0;
+    for (int attempt = 0; attempt < kReadRetries && filled == 0; ++attempt) {
+        const uint64_t end = r->cursor.load(std::memory_order_acquire);
+        const uint64_t lo = std::max(first, oldest_valid(r, end));
+        const uint64_t hi = std::min(first + count, end);
+        if (hi <= lo)
+            break;
+
+        const uint64_t span = hi - lo;
+        filled = static_cast<int>(std::min<uint64_t>(bins, span));
+        const uint64_t perBin = span / filled;
+        const uint64_t block = perBin >= 4 * kL2Block ? kL2Block : perBin >= 4 * kL1Block ? kL1Block : 1;
 
-    if (!time_buffer) {
-        pthread_mutex_unlock(&time_mutex);
+        for (int i = 0; i < filled; ++i) {
+            const uint64_t a = lo + (span * i) / filled;
+            const uint64_t b = lo + (span * (i + 1)) / filled;
+            uint16_t mn = 0xFFFF, mx = 0;
+
+            if (block == kL2Block)
+                scan_level(r->l2min, r->l2max, r->capacity / kL2Block, kL2Block, a, b, mn, mx);
+            else if (block == kL1Block)
+                scan_level(r->l1min, r->l1max, r->capacity / kL1Block, kL1Block, a, b, mn, mx);
+            else
+                scan_raw(r, a, b, mn, mx);
+
+            mins[i] = mn;
+            maxs[i] = mx;
+        }
+
+        // A level slot is reset when the block one capacity later begins: check from the oldest slot read
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (r->head.load(std::memory_order_relaxed) > lo - lo % block + r->capacity)
+            filled = 0;
+    }
+
+    activeReaders.fetch_sub(1);
+    return filled;
+}
+
+int TimeDProcess::latestSummary(int bins, uint16_t *mins, uint16_t *maxs)
+{
+    const int count = sampleCount();
+    return summary(writeCursor() - count, count, bins, mins, maxs);
+}
+
+size_t TimeDProcess::memoryBytes() const
+{
+    activeReaders.fetch_add(1);
+    TimeRing *r = ring.load();
+    size_t bytes = r ? r->bytes : 0;
+    activeReaders.fetch_sub(1);
+    return bytes;
+}
+
+bool TimeDProcess::usesHugePages() const
+{
+    activeReaders.fetch_add(1);
+    TimeRing *r = ring.load();
+    bool huge = r && r->huge;
+    activeReaders.fetch_sub(1);
+    return huge;
+}
+
+int TimeDProcess::appendBlock(const uint16_t *data, int ndata, uint64_t first, SampleTimeline &timeline)
+{
+    TimeRing *r = ring.load();
+    producerHazard.store(r);
+    if (!r || ring.load() != r) {   // stopped-stream resize swapping rings right now
+        producerHazard.store(nullptr);
         return 0;
     }
 
-    for (int i = 0; i < ndata; ++i) {
-        time_buffer[write_idx] = data[i];
-        write_idx = (write_idx + 1) % dynamic_time_buffer_size;
+    // A resize left its ring for us: copy what arrived since its last pass, then swap
+    if (TimeRing *fresh = pendingRing.exchange(nullptr, std::memory_order_acq_rel)) {
+        carry_over(r, fresh, r->cursor.load(std::memory_order_relaxed));
+        ring.store(fresh, std::memory_order_release);
+        producerHazard.store(fresh);
+        r = fresh;
     }
 
-    total_samples_collected = std::min(total_samples_collected + ndata, dynamic_time_buffer_size);
+    // A ring holds one contiguous run; a block that doesn't continue it starts a new one
+    const uint64_t cursor = r->cursor.load(std::memory_order_relaxed);
+    bool restart = cursor == r->origin.load(std::memory_order_relaxed);
+    if (first != cursor) {
+        if (!restart)
+            timeline.markGap(first, GapCause::TimeBuffer);
+        r->origin.store(first, std::memory_order_relaxed);
+        restart = true;
+    }
+
+    // Only the newest `capacity` samples of an oversized block can survive anyway
+    uint64_t n = static_cast<uint64_t>(ndata);
+    uint64_t skipped = 0;
+    if (n > r->capacity) {
+        skipped = n - r->capacity;
+        n = r->capacity;
+    }
+
+    // Reserve before copying, so readers of the samples about to be overwritten see it
+    r->head.store(first + skipped + n, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    write_samples(r, first + skipped, data + skipped, n, restart || skipped > 0);
+
+    r->cursor.store(first + skipped + n, std::memory_order_release);
+    producerHazard.store(nullptr, std::memory_order_release);
 
-    pthread_mutex_unlock(&time_mutex);
+    triggerEngine.process(data, ndata, first);
     return 1;
 }
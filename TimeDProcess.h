@@ -4,11 +4,23 @@
 #include <QObject>
 #include <QThread>
 #include <stdint.h>
+#include <atomic>
+#include "TriggerEngine.h"
+
+class SampleTimeline;
+struct TimeRing;
 
 /*!
- * Handles the circular buffer used for the time‑domain plot.
- * It no longer touches the RI device – samples arrive via the
- * static transferCallback forwarded from FFTProcess.
+ * Handles the circular buffer used for the time‑domain plot of one
+ * device. It no longer touches the RI device – samples arrive via
+ * appendBlock from the FFTProcess that owns the device.
+ *
+ * The buffer is a single-writer ring with an atomic 64-bit write cursor:
+ * the callback writes with at most two memcpys and never takes a lock,
+ * readers copy a snapshot and re-check the cursor to detect overwrites.
+ * Storage is mmap'd (huge pages when available) with min/max levels
+ * every 256 and 65536 samples, so multi-second windows are only ever
+ * read through range and summary queries.
  */
 class TimeDProcess : public QObject
 {
@@ -18,19 +30,33 @@ public:
     ~TimeDProcess();
 
     void start();                                // start worker thread
-    void resize(int size);                       // resize circular buffer
-    int  sampleCount() const;                    // total collected samples
-    void getBuffer(uint16_t *dst, int count);    // copy ‘count’ samples to dst
+    void resize(int size);                       // resize circular buffer, keeps capturing
+    int  sampleCount() const;                    // samples currently in the window
+
+    // Range and summary queries, indices are absolute sample numbers (SampleTimeline)
+    uint64_t writeCursor() const;                // one past the newest sample
+    bool copyRange(uint64_t first, int count, uint16_t *dst);  // false if not (or no longer) in the ring, window + headroom
+    int  summary(uint64_t first, uint64_t count, int bins, uint16_t *mins, uint16_t *maxs);
+    int  latestSummary(int bins, uint16_t *mins, uint16_t *maxs);  // min/max envelope of the window
 
-    static TimeDProcess* instance;
+    size_t memoryBytes() const;
+    bool   usesHugePages() const;
 
-    // Called by FFTProcess’ USB callback to feed fresh ADC words
-    static int transferCallback(uint16_t *data, int ndata, int dataloss, void *user);
+    TriggerEngine &trigger() { return triggerEngine; }
+
+    // Called by FFTProcess’ USB callback with the block's index on its device's timeline
+    int appendBlock(const uint16_t *data, int ndata, uint64_t firstSample, SampleTimeline &timeline);
 
 private:
     QThread workerThread;
     bool started;  // instance-level flag to prevent duplicate starts
-    std::atomic<bool> isResizing = false;  // testing line
+    TriggerEngine triggerEngine;  // scans every block after it lands in the ring
+
+    int windowSize;  // buffer size = sample‑rate × time‑window
+    std::atomic<TimeRing *> ring{nullptr};
+    std::atomic<TimeRing *> producerHazard{nullptr};  // ring the callback is writing right now
+    std::atomic<TimeRing *> pendingRing{nullptr};     // resized ring waiting for the callback to finish and adopt it
+    mutable std::atomic<int> activeReaders{0};
 
 };
 
@@ -0,0 +1,258 @@
+// ToneTracker.cpp
+#include "ToneTracker.h"
+#include "HugePages.h"
+#include "AppConfig.h"
+#include "AdcCalibration.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kChunk = 1 << 16;  // samples copied out of the staging ring per step
+
+// frac(a * n) without losing the fraction to a 40+ bit sample index
+double cycles_at(double a, uint64_t n)
+{
+    const double a20 = a * 1048576.0 - std::floor(a * 1048576.0);
+    const double c = std::fmod(a20 * static_cast<double>(n >> 20), 1.0) + a * static_cast<double>(n & 0xFFFFF);
+    return c - std::floor(c);
+}
+}
+
+ToneTracker::ToneTracker()
+{
+    ampHistory.assign(kMaxTones * kHistory, 0.0);
+    phaseHistory.assign(kMaxTones * kHistory, 0.0);
+    scratch.resize(kChunk);
+}
+
+ToneTracker::~ToneTracker()
+{
+    if (ring)
+        HugePages::release(ring, capacity * sizeof(uint16_t));
+}
+
+void ToneTracker::configure(const std::vector<double> &tonesHz, double outputRateHz)
+{
+    if (!ring && !tonesHz.empty()) {
+        uint64_t samples = kChunk;
+        while (samples < static_cast<uint64_t>(std::max(AppConfig::toneTrackerRingSamples, 1)))
+            samples <<= 1;
+        ring = static_cast<uint16_t *>(HugePages::allocate(samples * sizeof(uint16_t)));
+        if (!ring) {
+            qWarning() << "[ToneTracker] No staging ring, tone tracking stays off";
+            return;
+        }
+        capacity = samples;
+    }
+
+    pthread_mutex_lock(&settingsMutex);
+    incomingTones.clear();
+    for (double f : tonesHz)
+        if (f > 0.0 && f < AppConfig::adcSampleRate / 2.0 && static_cast<int>(incomingTones.size()) < kMaxTones)
+            incomingTones.push_back(f);
+    incomingRate = std::clamp(outputRateHz, 1.0, AppConfig::adcSampleRate / 16.0);
+    settingsChanged.store(true, std::memory_order_release);
+    active.store(!incomingTones.empty());
+    pthread_mutex_unlock(&settingsMutex);
+}
+
+void ToneTracker::adoptSettings()
+{
+    pthread_mutex_lock(&settingsMutex);
+    tones = static_cast<int>(incomingTones.size());
+    for (int k = 0; k < tones; ++k)
+        freqs[k] = incomingTones[k];
+    rate = incomingRate;
+    settingsChanged.store(false, std::memory_order_relaxed);
+    pthread_mutex_unlock(&settingsMutex);
+
+    padded = (tones + 1) & ~1;
+    blockLength = std::max(16, static_cast<int>(std::lround(AppConfig::adcSampleRate / rate)));
+    rate = AppConfig::adcSampleRate / blockLength;
+
+    for (int k = 0; k < padded; ++k) {
+        omega[k] = k < tones ? 2.0 * kPi * freqs[k] / AppConfig::adcSampleRate : 0.0;
+        coeff[k] = 2.0 * std::cos(omega[k]);
+    }
+
+    pthread_mutex_lock(&historyMutex);
+    publishedTones.assign(freqs, freqs + tones);
+    publishedRate = rate;
+    historyHead = 0;
+    historyCount = 0;
+    pthread_mutex_unlock(&historyMutex);
+
+    started = false;
+}
+
+void ToneTracker::restart(uint64_t position)
+{
+    nextSample = position;
+    blockStart = position;
+    inBlock = 0;
+    blockSum = 0.0;
+    std::fill(s1, s1 + kMaxTones, 0.0);
+    std::fill(s2, s2 + kMaxTones, 0.0);
+}
+
+void ToneTracker::append(const uint16_t *data, int ndata, uint64_t firstSample)
+{
+    if (ndata <= 0)
+        return;
+    if (static_cast<uint64_t>(ndata) > capacity) {  // only the newest ring's worth can be kept
+        const uint64_t skip = ndata - capacity;
+        firstSample += skip;
+        data += skip;
+        ndata = static_cast<int>(capacity);
+    }
+    if (firstSample != cursor.load(std::memory_order_relaxed))
+        origin.store(firstSample, std::memory_order_relaxed);  // a gap, or the first block since enabling
+
+    // Reserve before copying, so a reader of the samples about to be overwritten sees it
+    head.store(firstSample + ndata, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    const uint64_t pos = firstSample & (capacity - 1);
+    const uint64_t first = std::min<uint64_t>(ndata, capacity - pos);
+    std::memcpy(ring + pos, data, first * sizeof(uint16_t));
+    std::memcpy(ring, data + first, (ndata - first) * sizeof(uint16_t));
+    cursor.store(firstSample + ndata, std::memory_order_release);
+}
+
+void ToneTracker::run(const AdcCalibration &calibration)
+{
+    if (settingsChanged.load(std::memory_order_acquire))
+        adoptSettings();
+    if (!ring || tones == 0)
+        return;
+
+    units = &calibration;
+    const uint64_t end = cursor.load(std::memory_order_acquire);
+    if (!started) {
+        restart(end);
+        dc = calibration.meanCode();
+        started = true;
+        return;
+    }
+    if (nextSample < origin.load(std::memory_order_relaxed)) {
+        restart(end);  // a gap in the stream: the filters can't run across it
+        return;
+    }
+
+    while (nextSample < end) {
+        const int n = static_cast<int>(std::min<uint64_t>(kChunk, end - nextSample));
+        const uint64_t pos = nextSample & (capacity - 1);
+        const uint64_t first = std::min<uint64_t>(n, capacity - pos);
+        std::memcpy(scratch.data(), ring + pos, first * sizeof(uint16_t));
+        std::memcpy(scratch.data() + first, ring, (n - first) * sizeof(uint16_t));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (head.load(std::memory_order_relaxed) > nextSample + capacity) {
+            restart(cursor.load(std::memory_order_acquire));  // lapped by the callback: drop the partial block
+            return;
+        }
+        processChunk(scratch.data(), n);
+        nextSample += n;
+    }
+}
+
+void ToneTracker::processChunk(const uint16_t *x, int n)
+{
+    int i = 0;
+    while (i < n) {
+        const int run = std::min(n - i, blockLength - inBlock);
+
+        // Goertzel recurrence s = x + 2cos(w) s1 - s2, all tones at once
+        for (int j = 0; j < run; ++j) {
+            const double v = static_cast<double>(x[i + j]) - dc;
+            blockSum += x[i + j];
+#ifdef __SSE2__
+            const __m128d vv = _mm_set1_pd(v);
+            for (int k = 0; k < padded; k += 2) {
+                const __m128d a = _mm_load_pd(s1 + k);
+                const __m128d b = _mm_load_pd(s2 + k);
+                const __m128d s = _mm_sub_pd(_mm_add_pd(vv, _mm_mul_pd(_mm_load_pd(coeff + k), a)), b);
+                _mm_store_pd(s2 + k, a);
+                _mm_store_pd(s1 + k, s);
+            }
+#else
+            for (int k = 0; k < padded; ++k) {
+                const double s = v + coeff[k] * s1[k] - s2[k];
+                s2[k] = s1[k];
+                s1[k] = s;
+            }
+#endif
+        }
+
+        i += run;
+        inBlock += run;
+        if (inBlock == blockLength)
+            finishBlock();
+    }
+}
+
+void ToneTracker::finishBlock()
+{
+    const int N = blockLength;
+    const double scale = 2.0 / N * units->slope(dc);  // small signal: linear around the DC code
+
+    pthread_mutex_lock(&historyMutex);
+    for (int k = 0; k < tones; ++k) {
+        // X = (s1 - e^{-jw} s2) e^{-jw(N-1)}, phase referred to absolute sample 0
+        const double w = omega[k];
+        const double re0 = s1[k] - std::cos(w) * s2[k];
+        const double im0 = std::sin(w) * s2[k];
+        const double back = -w * (N - 1);
+        const double re = re0 * std::cos(back) - im0 * std::sin(back);
+        const double im = re0 * std::sin(back) + im0 * std::cos(back);
+
+        const double cycles = cycles_at(freqs[k] / AppConfig::adcSampleRate, blockStart);
+        double phase = std::atan2(im, re) - 2.0 * kPi * cycles;
+        phase = std::remainder(phase, 2.0 * kPi);
+
+        ampHistory[k * kHistory + historyHead] = std::sqrt(re * re + im * im) * scale;
+        phaseHistory[k * kHistory + historyHead] = phase;
+    }
+    historyHead = (historyHead + 1) % kHistory;
+    historyCount = std::min(historyCount + 1, kHistory);
+    pthread_mutex_unlock(&historyMutex);
+
+    dc = blockSum / N;
+    blockSum = 0.0;
+    blockStart += N;
+    inBlock = 0;
+    std::fill(s1, s1 + padded, 0.0);
+    std::fill(s2, s2 + padded, 0.0);
+}
+
+int ToneTracker::snapshot(std::vector<double> &tonesHz, std::vector<double> &amplitude,
+                          std::vector<double> &phase, int points, double *outputRateHz)
+{
+    pthread_mutex_lock(&historyMutex);
+    const int count = std::min(points, historyCount);
+    const int n = static_cast<int>(publishedTones.size());
+    tonesHz = publishedTones;
+    amplitude.resize(static_cast<size_t>(n) * count);
+    phase.resize(static_cast<size_t>(n) * count);
+
+    const int first = (historyHead - count + kHistory) % kHistory;
+    for (int k = 0; k < n; ++k) {
+        for (int i = 0; i < count; ++i) {
+            const int src = k * kHistory + (first + i) % kHistory;
+            amplitude[static_cast<size_t>(k) * count + i] = ampHistory[src];
+            phase[static_cast<size_t>(k) * count + i] = phaseHistory[src];
+        }
+    }
+    if (outputRateHz)
+        *outputRateHz = publishedRate;
+    pthread_mutex_unlock(&historyMutex);
+    return count;
+}
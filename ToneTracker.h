@@ -0,0 +1,100 @@
+// ToneTracker.h
+#ifndef TONETRACKER_H
+#define TONETRACKER_H
+
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class AdcCalibration;
+
+/*!
+ * Bank of Goertzel filters run straight on the 80 MS/s stream, one per
+ * tracked tone. Every outputRate^-1 seconds each filter yields one complex
+ * DFT value at its exact frequency (no bin grid), published as amplitude
+ * (µW) and phase (rad, referred to absolute sample time so a steady tone
+ * reads a flat phase).
+ *
+ * Filter state is kept structure-of-arrays and the per-sample recurrence
+ * runs two tones per SSE2 op. The USB callback copies each block into a
+ * staging ring of toneTrackerRingSamples (one memcpy) and kicks run(), a
+ * pool task that catches up from there. The display ring is no use here:
+ * it only keeps timeWindowSeconds, far less than one block at short windows.
+ */
+class ToneTracker
+{
+public:
+    static constexpr int kMaxTones = 16;
+    static constexpr int kHistory = 4096;  // points kept per tone
+
+    ToneTracker();
+    ~ToneTracker();
+    ToneTracker(const ToneTracker &) = delete;
+    ToneTracker &operator=(const ToneTracker &) = delete;
+
+    // GUI thread; the staging ring is mapped with the first tone
+    void configure(const std::vector<double> &tonesHz, double outputRateHz);
+    bool enabled() const { return active.load(std::memory_order_acquire); }
+
+    // Callback thread, while enabled
+    void append(const uint16_t *data, int ndata, uint64_t firstSample);
+
+    // One caller at a time (the pool task); processes everything staged since the last call
+    void run(const AdcCalibration &calibration);
+
+    // Newest `points` of every tone, tone-major; returns points actually copied
+    int snapshot(std::vector<double> &tonesHz, std::vector<double> &amplitude,
+                 std::vector<double> &phase, int points, double *outputRateHz);
+
+private:
+    void adoptSettings();
+    void restart(uint64_t position);
+    void processChunk(const uint16_t *x, int n);
+    void finishBlock();
+
+    // settings mailbox
+    pthread_mutex_t settingsMutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<double> incomingTones;
+    double incomingRate = 10e3;
+    std::atomic<bool> settingsChanged{false};
+    std::atomic<bool> active{false};
+
+    // filter bank, SoA, padded to an even count for SSE2
+    int tones = 0;
+    int padded = 0;
+    int blockLength = 0;
+    double rate = 10e3;
+    alignas(16) double coeff[kMaxTones] = {};  // 2 cos(w)
+    alignas(16) double s1[kMaxTones] = {};
+    alignas(16) double s2[kMaxTones] = {};
+    double omega[kMaxTones] = {};
+    double freqs[kMaxTones] = {};
+
+    uint64_t nextSample = 0;   // absolute index of the next sample to consume
+    uint64_t blockStart = 0;
+    int inBlock = 0;
+    double dc = 0.0;           // previous block mean, removed before the filters
+    const AdcCalibration *units = nullptr;  // run()'s, scales amplitudes by its slope at dc
+    double blockSum = 0.0;
+    bool started = false;
+    std::vector<uint16_t> scratch;
+
+    // staging ring, written by the callback
+    uint16_t *ring = nullptr;
+    uint64_t capacity = 0;  // power of two
+    std::atomic<uint64_t> head{0};    // reserved up to here before a block is copied in
+    std::atomic<uint64_t> cursor{0};  // stream index just past the newest complete sample
+    std::atomic<uint64_t> origin{0};  // first sample of the current contiguous run
+
+    // published history, ring per tone
+    pthread_mutex_t historyMutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<double> ampHistory;    // [tone * kHistory + i]
+    std::vector<double> phaseHistory;
+    int historyHead = 0;
+    int historyCount = 0;
+    std::vector<double> publishedTones;
+    double publishedRate = 10e3;
+};
+
+#endif // TONETRACKER_H
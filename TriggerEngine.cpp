@@ -0,0 +1,336 @@
+// TriggerEngine.cpp
+#include "TriggerEngine.h"
+#include "AppConfig.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Index of the first sample outside [lo, hi], or n
+int first_outside(const uint16_t *p, int n, uint16_t lo, uint16_t hi)
+{
+    int i = 0;
+#ifdef __SSE2__
+    // SSE2 only has signed 16-bit compares: flip the sign bit on both sides
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i vlo = _mm_set1_epi16(static_cast<short>(lo ^ 0x8000));
+    const __m128i vhi = _mm_set1_epi16(static_cast<short>(hi ^ 0x8000));
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)), bias);
+        __m128i out = _mm_or_si128(_mm_cmplt_epi16(x, vlo), _mm_cmpgt_epi16(x, vhi));
+        int mask = _mm_movemask_epi8(out);
+        if (mask)
+            return i + (__builtin_ctz(mask) >> 1);
+    }
+#endif
+    for (; i < n; ++i)
+        if (p[i] < lo || p[i] > hi)
+            return i;
+    return n;
+}
+
+// Index of the first sample inside [lo, hi], or n
+int first_inside(const uint16_t *p, int n, uint16_t lo, uint16_t hi)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i vlo = _mm_set1_epi16(static_cast<short>(lo ^ 0x8000));
+    const __m128i vhi = _mm_set1_epi16(static_cast<short>(hi ^ 0x8000));
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)), bias);
+        __m128i out = _mm_or_si128(_mm_cmplt_epi16(x, vlo), _mm_cmpgt_epi16(x, vhi));
+        int mask = ~_mm_movemask_epi8(out) & 0xFFFF;
+        if (mask)
+            return i + (__builtin_ctz(mask) >> 1);
+    }
+#endif
+    for (; i < n; ++i)
+        if (p[i] >= lo && p[i] <= hi)
+            return i;
+    return n;
+}
+
+int first_at_or_above(const uint16_t *p, int n, uint16_t t) { return t == 0 ? 0 : first_outside(p, n, 0, t - 1); }
+int first_below(const uint16_t *p, int n, uint16_t t)       { return t == 0 ? n : first_outside(p, n, t, 0xFFFF); }
+int first_above(const uint16_t *p, int n, uint16_t t)       { return t == 0xFFFF ? n : first_outside(p, n, 0, t); }
+int first_at_or_below(const uint16_t *p, int n, uint16_t t) { return t == 0xFFFF ? 0 : first_outside(p, n, t + 1, 0xFFFF); }
+}
+
+TriggerEngine::TriggerEngine()
+{
+    for (auto &slot : slots)
+        slot.samples.resize(AppConfig::maxTriggerDepthSamples);
+
+    uint64_t capacity = 1;
+    while (capacity < static_cast<uint64_t>(AppConfig::maxTriggerDepthSamples) + kStageChunk)
+        capacity <<= 1;
+    staging.resize(capacity);
+    stagingMask = capacity - 1;
+}
+
+void TriggerEngine::configure(const TriggerSettings &settings)
+{
+    TriggerSettings s = settings;
+    s.preSamples = std::clamp(s.preSamples, 0, AppConfig::maxTriggerDepthSamples);
+    s.postSamples = std::clamp(s.postSamples, 1, AppConfig::maxTriggerDepthSamples - s.preSamples);
+    s.upper = std::max(s.upper, s.level);
+
+    pthread_mutex_lock(&settingsMutex);
+    incoming = s;
+    settingsChanged.store(true, std::memory_order_release);
+    pthread_mutex_unlock(&settingsMutex);
+
+    active.store(s.type != TriggerType::Off);
+}
+
+void TriggerEngine::adoptSettings()
+{
+    if (pthread_mutex_trylock(&settingsMutex) != 0)
+        return;  // GUI is mid-update, take it next block
+
+    cfg = incoming;
+    settingsChanged.store(false, std::memory_order_relaxed);
+    pthread_mutex_unlock(&settingsMutex);
+
+    armed = false;
+    inPulse = false;
+    pending = false;
+    holdoffUntil = 0;
+}
+
+void TriggerEngine::process(const uint16_t *data, int n, uint64_t firstIndex)
+{
+    if (settingsChanged.load(std::memory_order_acquire))
+        adoptSettings();
+    if (cfg.type == TriggerType::Off)
+        return;
+
+    // Piecewise, so the staging ring still holds a capture whose post-trigger part ends mid-block
+    for (int done = 0; done < n; done += kStageChunk) {
+        const int m = std::min(n - done, kStageChunk);
+        stage(data + done, m, firstIndex + done);
+        processChunk(data + done, m, firstIndex + done);
+    }
+}
+
+void TriggerEngine::stage(const uint16_t *data, int n, uint64_t firstIndex)
+{
+    if (firstIndex != stagedEnd)
+        stagedFrom = firstIndex;  // gap or first block since enabled: older samples don't continue this run
+
+    const uint64_t at = firstIndex & stagingMask;
+    const uint64_t head = std::min<uint64_t>(n, staging.size() - at);
+    std::memcpy(staging.data() + at, data, head * sizeof(uint16_t));
+    std::memcpy(staging.data(), data + head, (n - head) * sizeof(uint16_t));
+    stagedEnd = firstIndex + n;
+}
+
+void TriggerEngine::processChunk(const uint16_t *data, int n, uint64_t firstIndex)
+{
+    int i = 0;
+    while (true) {
+        if (pending) {
+            if (firstIndex + n < pendingIndex + cfg.postSamples)
+                return;  // post-trigger samples still on their way
+
+            publish();
+            pending = false;
+        }
+
+        if (i >= n)
+            return;
+
+        i = scan(data, i, n, firstIndex);
+        if (!pending)
+            return;
+    }
+}
+
+// Advance the trigger state machine over data[begin, n); returns where to resume
+int TriggerEngine::scan(const uint16_t *p, int i, int n, uint64_t first)
+{
+    if (holdoffUntil > first + i) {
+        if (holdoffUntil >= first + n)
+            return n;
+        i = static_cast<int>(holdoffUntil - first);
+        armed = false;
+        inPulse = false;
+    }
+
+    const uint16_t level = cfg.level;
+    const uint16_t armBelow = level > cfg.hysteresis ? level - cfg.hysteresis : 0;
+    const uint16_t armAbove = level < 0xFFFF - cfg.hysteresis ? level + cfg.hysteresis : 0xFFFF;
+
+    auto fire = [this](uint64_t t) {
+        pending = true;
+        pendingIndex = t;
+        holdoffUntil = t + std::max<uint64_t>(cfg.holdoffSamples, cfg.postSamples);  // captures never overlap
+        armed = false;
+        fired.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    while (i < n) {
+        switch (cfg.type) {
+        case TriggerType::RisingEdge:
+            if (!armed) {
+                i += first_below(p + i, n - i, armBelow);
+                if (i >= n) return n;
+                armed = true;
+            }
+            i += first_at_or_above(p + i, n - i, level);
+            if (i >= n) return n;
+            fire(first + i);
+            return i + 1;
+
+        case TriggerType::FallingEdge:
+            if (!armed) {
+                i += first_above(p + i, n - i, armAbove);
+                if (i >= n) return n;
+                armed = true;
+            }
+            i += first_at_or_below(p + i, n - i, level);
+            if (i >= n) return n;
+            fire(first + i);
+            return i + 1;
+
+        case TriggerType::Level:
+            i += first_at_or_above(p + i, n - i, level);
+            if (i >= n) return n;
+            fire(first + i);
+            return i + 1;
+
+        case TriggerType::PulseWidth:
+            if (!armed) {
+                i += first_below(p + i, n - i, armBelow);
+                if (i >= n) return n;
+                armed = true;
+            }
+            if (!inPulse) {
+                i += first_at_or_above(p + i, n - i, level);
+                if (i >= n) return n;
+                inPulse = true;
+                pulseStart = first + i;
+            }
+            i += first_below(p + i, n - i, armBelow);
+            if (i >= n) return n;
+            inPulse = false;
+            {
+                const uint64_t width = first + i - pulseStart;
+                if (width >= static_cast<uint64_t>(cfg.minWidth) && width <= static_cast<uint64_t>(cfg.maxWidth)) {
+                    fire(pulseStart);
+                    return i + 1;
+                }
+            }
+            break;  // wrong width, still armed: look for the next pulse
+
+        case TriggerType::Window:
+            if (!armed) {
+                i += first_inside(p + i, n - i, cfg.level, cfg.upper);
+                if (i >= n) return n;
+                armed = true;
+            }
+            i += first_outside(p + i, n - i, cfg.level, cfg.upper);
+            if (i >= n) return n;
+            fire(first + i);
+            return i + 1;
+
+        case TriggerType::Off:
+            return n;
+        }
+    }
+    return n;
+}
+
+void TriggerEngine::publish()
+{
+    if (pendingIndex < static_cast<uint64_t>(cfg.preSamples))
+        return;
+
+    const int length = cfg.preSamples + cfg.postSamples;
+    const uint64_t m = marked.load(std::memory_order_relaxed);
+    marks[m % kMarks] = { pendingIndex, cfg.preSamples, length };
+    marked.store(m + 1, std::memory_order_release);
+
+    const int s = newestSlot.load(std::memory_order_relaxed) == 0 ? 1 : 0;
+    Slot &slot = slots[s];
+
+    // seqlock: odd while the slot is being rewritten
+    const uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Always still staged (ring >= max depth + one piece) unless the run started after the pre-trigger part
+    const uint64_t start = pendingIndex - cfg.preSamples;
+    const bool ok = start >= stagedFrom;
+    if (ok) {
+        const uint64_t at = start & stagingMask;
+        const uint64_t head = std::min<uint64_t>(length, staging.size() - at);
+        std::memcpy(slot.samples.data(), staging.data() + at, head * sizeof(uint16_t));
+        std::memcpy(slot.samples.data() + head, staging.data(), (length - head) * sizeof(uint16_t));
+    }
+    slot.triggerIndex = pendingIndex;
+    slot.pre = cfg.preSamples;
+    slot.length = length;
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+
+    if (ok)  // the pre-trigger part reaches back before a gap or before triggering was enabled
+        newestSlot.store(s, std::memory_order_release);
+}
+
+int TriggerEngine::capturesSince(uint64_t &seen, CaptureMark *out, int max) const
+{
+    const uint64_t end = marked.load(std::memory_order_acquire);
+    uint64_t first = std::max(seen, end > kMarks ? end - kMarks : 0);
+    const int count = static_cast<int>(std::min<uint64_t>(end - first, std::max(max, 0)));
+    for (int i = 0; i < count; ++i)
+        out[i] = marks[(first + i) % kMarks];
+
+    // The slot being written next is the oldest one: drop whatever the callback lapped meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t now = marked.load(std::memory_order_relaxed);
+    const uint64_t valid = now >= kMarks ? now - kMarks + 1 : 0;
+    int dropped = valid > first ? static_cast<int>(std::min<uint64_t>(valid - first, count)) : 0;
+    if (dropped > 0)
+        std::copy(out + dropped, out + count, out);
+
+    seen = first + count;
+    return count - dropped;
+}
+
+bool TriggerEngine::latestCapture(std::vector<uint16_t> &dst, uint64_t *triggerIndex, int *preSamples)
+{
+    const int s = newestSlot.load(std::memory_order_acquire);
+    if (s < 0)
+        return false;
+
+    Slot &slot = slots[s];
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        const uint32_t before = slot.seq.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        const uint64_t index = slot.triggerIndex;
+        if (index == lastReturned)
+            return false;
+
+        const int length = slot.length;
+        const int pre = slot.pre;
+        dst.assign(slot.samples.begin(), slot.samples.begin() + length);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != before)
+            continue;
+
+        lastReturned = index;
+        if (triggerIndex) *triggerIndex = index;
+        if (preSamples) *preSamples = pre;
+        return true;
+    }
+    return false;
+}
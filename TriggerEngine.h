@@ -0,0 +1,113 @@
+// TriggerEngine.h
+#ifndef TRIGGERENGINE_H
+#define TRIGGERENGINE_H
+
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+enum class TriggerType { Off = 0, RisingEdge, FallingEdge, Level, PulseWidth, Window };
+
+// Where one published capture lies in the stream
+struct CaptureMark {
+    uint64_t triggerIndex;
+    int pre;
+    int length;
+};
+
+// All levels are raw ADC codes, all lengths are samples at the ADC rate
+struct TriggerSettings {
+    TriggerType type = TriggerType::Off;
+    uint16_t level = 0;          // edge / level / pulse threshold, lower bound for Window
+    uint16_t upper = 0xFFFF;     // Window: fires when the signal leaves [level, upper]
+    uint16_t hysteresis = 32;    // edges must go this far past the level to re-arm
+    int preSamples = 0;          // kept before the trigger point
+    int postSamples = 0;         // kept from the trigger point on
+    uint64_t holdoffSamples = 0; // ignore triggers this long after one fires (at least postSamples)
+    int minWidth = 0;            // PulseWidth: accepted pulse length, samples above level
+    int maxWidth = 0;
+};
+
+/*!
+ * Oscilloscope-style trigger on the raw TimeDProcess stream. process() runs
+ * in the USB callback right after the block lands in the time ring. It copies
+ * the block into its own staging ring, kStageChunk samples at a time, and
+ * scans each piece for threshold crossings (SSE2, 8 samples per compare).
+ * Once the post-trigger samples have arrived the capture is copied out of
+ * the staging ring into one of two preallocated slots; the GUI reads the
+ * newest slot. The staging ring holds maxTriggerDepthSamples plus one piece,
+ * so a capture is complete however the trigger falls within a block (the
+ * display ring only covers timeWindowSeconds and has moved on by then).
+ * Every published capture is also logged as a CaptureMark, so consumers
+ * that want all of them (Persistence) can follow along.
+ */
+class TriggerEngine
+{
+public:
+    TriggerEngine();
+
+    void configure(const TriggerSettings &settings);  // any thread, adopted at the next block
+    bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+    // Callback thread only; firstIndex is the absolute sample number of data[0]
+    void process(const uint16_t *data, int n, uint64_t firstIndex);
+
+    // True when a capture newer than the last one returned is available
+    bool latestCapture(std::vector<uint16_t> &dst, uint64_t *triggerIndex, int *preSamples);
+    uint64_t triggerCount() const { return fired.load(std::memory_order_relaxed); }
+
+    // Captures published since `seen` (advanced past the ones returned), oldest first; those already
+    // overwritten in the kMarks log are skipped. Any thread, one caller per `seen`.
+    int capturesSince(uint64_t &seen, CaptureMark *out, int max) const;
+    uint64_t captureCount() const { return marked.load(std::memory_order_acquire); }
+
+    static constexpr int kMarks = 4096;
+    static constexpr int kStageChunk = 1 << 16;  // samples staged and scanned per step
+
+private:
+    struct Slot {
+        std::vector<uint16_t> samples;
+        std::atomic<uint32_t> seq{0};  // odd while being written
+        uint64_t triggerIndex = 0;
+        int pre = 0;
+        int length = 0;
+    };
+
+    void adoptSettings();
+    void processChunk(const uint16_t *data, int n, uint64_t firstIndex);
+    void stage(const uint16_t *data, int n, uint64_t firstIndex);
+    int  scan(const uint16_t *data, int begin, int n, uint64_t firstIndex);
+    void publish();
+
+    // callback-side state
+    TriggerSettings cfg;
+    bool armed = false;
+    bool inPulse = false;
+    uint64_t pulseStart = 0;
+    uint64_t holdoffUntil = 0;
+    bool pending = false;
+    uint64_t pendingIndex = 0;
+
+    // staging ring, power of two, written by the callback while triggering
+    std::vector<uint16_t> staging;
+    uint64_t stagingMask = 0;
+    uint64_t stagedFrom = 0;  // first sample of the current contiguous run
+    uint64_t stagedEnd = 0;   // one past the newest staged sample
+
+    // settings mailbox, the callback only ever trylocks it
+    pthread_mutex_t settingsMutex = PTHREAD_MUTEX_INITIALIZER;
+    TriggerSettings incoming;
+    std::atomic<bool> settingsChanged{false};
+    std::atomic<bool> active{false};
+
+    Slot slots[2];
+    std::atomic<int> newestSlot{-1};
+    std::atomic<uint64_t> fired{0};
+    uint64_t lastReturned = UINT64_MAX;
+
+    CaptureMark marks[kMarks] = {};
+    std::atomic<uint64_t> marked{0};  // captures ever logged
+};
+
+#endif // TRIGGERENGINE_H
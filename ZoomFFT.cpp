@@ -0,0 +1,232 @@
+// ZoomFFT.cpp
+#include "ZoomFFT.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr int    kCicOrder = 3;
+constexpr int    kMaxCicRatio = 16384;    // keeps 3 stages of bit growth inside 64-bit wraparound
+constexpr int    kFirTaps = 63;
+constexpr double kFirCutoff = 0.25;       // of the CIC output rate: half-band, -6 dB at the /2 stage's Nyquist
+constexpr double kUsableFraction = 0.6;   // share of the output rate shown as span: edges at 0.15, flat passband,
+                                          // and what folds onto them (from 0.35 up) is deep in the stopband
+constexpr double kInputScale = 16.0;      // fixed-point headroom before the integrators
+
+constexpr double kPi = 3.14159265358979323846;
+
+// |H(f)| of an R-times-decimating CIC of kCicOrder stages, f in Hz at the input rate
+double cic_response(double f, double fs, int R)
+{
+    const double x = kPi * f / fs;
+    if (std::abs(x) < 1e-12)
+        return 1.0;
+    return std::pow(std::abs(std::sin(x * R) / (R * std::sin(x))), kCicOrder);
+}
+
+// |H(f)| of the symmetric FIR, f as a fraction of its input rate
+double fir_response(const std::vector<double> &taps, double f)
+{
+    const int mid = static_cast<int>(taps.size()) / 2;
+    double h = taps[mid];
+    for (int k = 1; k <= mid; ++k)
+        h += 2.0 * taps[mid + k] * std::cos(2.0 * kPi * f * k);
+    return std::abs(h);
+}
+}
+
+pthread_mutex_t &ZoomFFT::plannerMutex()
+{
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    return mutex;
+}
+
+ZoomFFT::ZoomFFT()
+{
+    designFilter();
+}
+
+ZoomFFT::~ZoomFFT()
+{
+    pthread_mutex_lock(&plannerMutex());
+    if (plan)
+        fftw_destroy_plan(plan);
+    pthread_mutex_unlock(&plannerMutex());
+    fftw_free(fftIn);
+    fftw_free(fftOut);
+}
+
+int ZoomFFT::cicRatio(double sampleRate, double spanHz)
+{
+    // fs / (2R) * kUsableFraction >= span
+    const int R = static_cast<int>(std::floor(sampleRate * kUsableFraction / (2.0 * spanHz)));
+    return std::clamp(R, 1, kMaxCicRatio);
+}
+
+double ZoomFFT::minimumSpan(double sampleRate, int bins, size_t maxSamples)
+{
+    const size_t perRatio = 2 * static_cast<size_t>(bins) + kFirTaps + kCicOrder + 1;  // samplesNeeded() / R
+    const int R = static_cast<int>(std::clamp<size_t>(maxSamples / perRatio, 1, kMaxCicRatio));
+    return sampleRate * kUsableFraction / (2.0 * R);
+}
+
+size_t ZoomFFT::samplesNeeded(double sampleRate, double spanHz, int bins)
+{
+    const size_t R = static_cast<size_t>(cicRatio(sampleRate, spanHz));
+    return (2 * static_cast<size_t>(bins) + kFirTaps + kCicOrder + 1) * R;
+}
+
+void ZoomFFT::designFilter()
+{
+    // Blackman-windowed sinc, unity DC gain; at a quarter of the rate every even tap but the centre is zero
+    taps.resize(kFirTaps);
+    const int mid = kFirTaps / 2;
+    double sum = 0.0;
+    for (int t = 0; t < kFirTaps; ++t) {
+        const int k = t - mid;
+        const double sinc = k == 0 ? 2.0 * kFirCutoff : std::sin(2.0 * kPi * kFirCutoff * k) / (kPi * k);
+        const double w = 0.42 - 0.5 * std::cos(2.0 * kPi * t / (kFirTaps - 1))
+                       + 0.08 * std::cos(4.0 * kPi * t / (kFirTaps - 1));
+        taps[t] = sinc * w;
+        sum += taps[t];
+    }
+    for (double &t : taps)
+        t /= sum;
+}
+
+void ZoomFFT::ensurePlan(int bins)
+{
+    if (plan && planBins == bins)
+        return;
+
+    fftw_free(fftIn);
+    fftw_free(fftOut);
+    fftIn = static_cast<fftw_complex *>(fftw_malloc(sizeof(fftw_complex) * bins));
+    fftOut = static_cast<fftw_complex *>(fftw_malloc(sizeof(fftw_complex) * bins));
+
+    pthread_mutex_lock(&plannerMutex());
+    if (plan)
+        fftw_destroy_plan(plan);
+    plan = fftw_plan_dft_1d(bins, fftIn, fftOut, FFTW_FORWARD, FFTW_ESTIMATE);
+    pthread_mutex_unlock(&plannerMutex());
+    planBins = bins;
+
+    // 4-term Blackman-Harris: spurs from the mixer and CIC images stay below the noise
+    window.resize(bins);
+    for (int n = 0; n < bins; ++n) {
+        const double a = 2.0 * kPi * n / bins;
+        window[n] = 0.35875 - 0.48829 * std::cos(a) + 0.14128 * std::cos(2 * a) - 0.01168 * std::cos(3 * a);
+    }
+}
+
+bool ZoomFFT::compute(const uint16_t *samples, size_t count, double sampleRate,
+                      double centerHz, double spanHz, int bins, int referenceSize)
+{
+    const int R = cicRatio(sampleRate, spanHz);
+    const size_t needed = samplesNeeded(sampleRate, spanHz, bins);
+    if (!samples || count < needed || bins < 16)
+        return false;
+
+    ensurePlan(bins);
+    samples += count - needed;  // newest data only
+
+    // DC out first so the integrators only carry the signal
+    double mean = 0.0;
+    for (size_t i = 0; i < needed; ++i)
+        mean += samples[i];
+    mean /= static_cast<double>(needed);
+
+    // NCO + CIC. Integrators wrap modulo 2^64 on purpose: the combs undo it exactly.
+    const double step = -2.0 * kPi * centerHz / sampleRate;
+    const double cosStep = std::cos(step), sinStep = std::sin(step);
+    double c = 1.0, s = 0.0;
+
+    uint64_t iI[kCicOrder] = {}, iQ[kCicOrder] = {};
+    uint64_t cI[kCicOrder] = {}, cQ[kCicOrder] = {};
+    const double cicGain = std::pow(static_cast<double>(R), kCicOrder) * kInputScale;
+
+    cicI.clear();
+    cicQ.clear();
+    cicI.reserve(needed / R + 1);
+    cicQ.reserve(needed / R + 1);
+
+    for (size_t n = 0; n < needed; ++n) {
+        if ((n & 1023) == 0) {  // re-anchor the rotator so its amplitude can't drift
+            const double phase = std::fmod(step * static_cast<double>(n), 2.0 * kPi);
+            c = std::cos(phase);
+            s = std::sin(phase);
+        }
+
+        const double v = (samples[n] - mean) * kInputScale;
+        uint64_t xi = static_cast<uint64_t>(std::llround(v * c));
+        uint64_t xq = static_cast<uint64_t>(std::llround(v * s));
+
+        const double cNext = c * cosStep - s * sinStep;
+        s = c * sinStep + s * cosStep;
+        c = cNext;
+
+        for (int k = 0; k < kCicOrder; ++k) {
+            iI[k] += xi;
+            iQ[k] += xq;
+            xi = iI[k];
+            xq = iQ[k];
+        }
+
+        if ((n + 1) % R != 0)
+            continue;
+
+        uint64_t yi = iI[kCicOrder - 1], yq = iQ[kCicOrder - 1];
+        for (int k = 0; k < kCicOrder; ++k) {
+            const uint64_t di = yi - cI[k], dq = yq - cQ[k];
+            cI[k] = yi;
+            cQ[k] = yq;
+            yi = di;
+            yq = dq;
+        }
+        cicI.push_back(static_cast<int64_t>(yi) / cicGain);
+        cicQ.push_back(static_cast<int64_t>(yq) / cicGain);
+    }
+
+    // Comb history is only valid after kCicOrder outputs
+    const size_t settle = kCicOrder + 1;
+    if (cicI.size() < settle + kFirTaps + 2 * static_cast<size_t>(bins))
+        return false;
+
+    // FIR, decimate by 2, window into the FFT input
+    const size_t base = cicI.size() - (kFirTaps + 2 * static_cast<size_t>(bins));
+    double windowSum = 0.0;
+    for (int k = 0; k < bins; ++k) {
+        const double *xi = cicI.data() + base + 2 * k;
+        const double *xq = cicQ.data() + base + 2 * k;
+        double accI = 0.0, accQ = 0.0;
+        for (int t = 0; t < kFirTaps; ++t) {
+            accI += taps[t] * xi[t];
+            accQ += taps[t] * xq[t];
+        }
+        fftIn[k][0] = accI * window[k];
+        fftIn[k][1] = accQ * window[k];
+        windowSum += window[k];
+    }
+
+    fftw_execute(plan);
+
+    // fftshift, keep the span, undo CIC droop and FIR passband, match the r2c magnitude scale
+    const double fsOut = sampleRate / R / 2.0;
+    const double scale = referenceSize / windowSum;
+    freqsHz.clear();
+    mags.clear();
+    for (int k = 0; k < bins; ++k) {
+        const int src = (k + bins / 2) % bins;
+        const double offset = (k - bins / 2) * fsOut / bins;
+        const double f = centerHz + offset;
+        if (std::abs(offset) > spanHz / 2.0 || f < 0.0 || f > sampleRate / 2.0)
+            continue;
+
+        const double re = fftOut[src][0], im = fftOut[src][1];
+        freqsHz.push_back(f);
+        const double droop = cic_response(offset, sampleRate, R) * fir_response(taps, offset / (2.0 * fsOut));
+        mags.push_back(std::sqrt(re * re + im * im) * scale / droop);
+    }
+
+    return !mags.empty();
+}
@@ -0,0 +1,58 @@
+// ZoomFFT.h
+#ifndef ZOOMFFT_H
+#define ZOOMFFT_H
+
+#include <fftw3.h>
+#include <pthread.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Digital down-conversion zoom FFT: NCO mixer -> 3rd-order CIC decimator
+ * -> 63-tap half-band FIR (decimate by 2) -> windowed complex FFT centred on
+ * the band. Gives `bins` points across the requested span for the cost of a
+ * small FFT, wherever the band sits inside 0..fs/2. The span stays inside
+ * the FIR's flat passband; the CIC droop and what is left of the FIR's
+ * response are divided back out per bin, and magnitudes are scaled to match
+ * the full r2c FFT.
+ */
+class ZoomFFT
+{
+public:
+    ZoomFFT();
+    ~ZoomFFT();
+
+    // Raw ADC samples needed for `bins` output points over `spanHz`
+    static size_t samplesNeeded(double sampleRate, double spanHz, int bins);
+    static double minimumSpan(double sampleRate, int bins, size_t maxSamples);  // narrowest span `bins` fit in maxSamples for
+
+    // FFTW's planner is not thread-safe: everyone creating or destroying plans takes this
+    static pthread_mutex_t &plannerMutex();
+
+    // Runs the whole chain over the newest samplesNeeded() of `count`; bins must be a power of two.
+    // referenceSize is the FFT length of the spectrum the result is drawn over.
+    bool compute(const uint16_t *samples, size_t count, double sampleRate,
+                 double centerHz, double spanHz, int bins, int referenceSize);
+
+    const std::vector<double> &frequencies() const { return freqsHz; }  // inside the span only
+    const std::vector<double> &magnitudes() const { return mags; }
+
+private:
+    static int cicRatio(double sampleRate, double spanHz);
+    void ensurePlan(int bins);
+    void designFilter();
+
+    fftw_plan plan = nullptr;
+    int planBins = 0;
+    fftw_complex *fftIn = nullptr;
+    fftw_complex *fftOut = nullptr;
+
+    std::vector<double> taps;
+    std::vector<double> window;
+    std::vector<double> cicI, cicQ;  // CIC output at fs / R
+    std::vector<double> freqsHz;
+    std::vector<double> mags;
+};
+
+#endif // ZOOMFFT_H
@@ -1,8 +1,70 @@
 #include "mainwindow.h"
+#include "FFTProcess.h"
+#include "TimeDProcess.h"
 #include <QApplication>
+#include <QCoreApplication>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// --benchmark [devices] [seconds]: that many pipelines fed synthetic DPD80 data flat out, each
+// with its own acquisition thread, DSP pool and placement from AppConfig::devices; no GUI, no hardware
+static int runBenchmark(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    const int devices = argc > 2 ? std::max(1, atoi(argv[2])) : static_cast<int>(AppConfig::devices.size());
+    const double seconds = argc > 3 ? std::max(0.1, atof(argv[3])) : 10.0;
+    AppConfig::devices.resize(devices);  // unconfigured ones get an equal share of the cores
+    AppConfig::sharedMemoryName = "";    // don't clash with a running instance's segment or files
+    AppConfig::eventLogFile = "";
+
+    std::vector<TimeDProcess *> times;
+    std::vector<FFTProcess *> ffts;
+    for (int d = 0; d < devices; ++d) {
+        times.push_back(new TimeDProcess());
+        ffts.push_back(new FFTProcess(times.back(), d));
+    }
+
+    std::vector<BenchmarkResult> results(devices);
+    std::vector<std::thread> threads;
+    for (int d = 0; d < devices; ++d)
+        threads.emplace_back([&, d]() { results[d] = ffts[d]->benchmark(seconds); });
+    for (std::thread &t : threads)
+        t.join();
+
+    BenchmarkResult total;
+    for (int d = 0; d < devices; ++d) {
+        const BenchmarkResult &r = results[d];
+        const uint64_t frames = r.framesProcessed + r.framesDropped;
+        std::printf("device %d: %.1f MS/s (%.2fx real time), %.0f frames/s, %.2f%% frames dropped\n", d,
+                    r.samples / r.seconds / 1e6, r.samples / r.seconds / AppConfig::adcSampleRate,
+                    r.framesProcessed / r.seconds, frames ? 100.0 * r.framesDropped / frames : 0.0);
+        total.samples += r.samples;
+        total.seconds = std::max(total.seconds, r.seconds);
+        total.framesProcessed += r.framesProcessed;
+        total.framesDropped += r.framesDropped;
+    }
+    const uint64_t frames = total.framesProcessed + total.framesDropped;
+    std::printf("aggregate, %d devices: %.1f MS/s (%.2f devices at full rate), %.0f frames/s, %.2f%% frames dropped\n",
+                devices, total.samples / total.seconds / 1e6, total.samples / total.seconds / AppConfig::adcSampleRate,
+                total.framesProcessed / total.seconds, frames ? 100.0 * total.framesDropped / frames : 0.0);
+
+    for (int d = 0; d < devices; ++d) {
+        delete ffts[d];
+        delete times[d];  // after the FFTProcess that feeds it
+    }
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+        return runBenchmark(argc, argv);
+
     QApplication app(argc, argv);
 
     MainWindow window; // call main window cpp
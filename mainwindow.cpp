@@ -1,22 +1,42 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "AppConfig.h"
+#include "AdcCalibration.h"
 #include "FFTProcess.h"
 #include "TimeDProcess.h"
 #include "PlotManager.h"
 #include "Features.h"
+#include "ThreadPlacement.h"
+#include "HugePages.h"
+#include "ToneTracker.h"
+#include "ExportEngine.h"
+#include "SampleRecorder.h"
+#include "StreamServer.h"
+#include "Correlator.h"
+#include "EventLog.h"
+#include "SampleTimeline.h"
+#include "Persistence.h"
 
 #include <QTimer>
 #include <QDebug>
 #include <QLayout>
+#include <QLabel>
+#include <QFileInfo>
+#include <QSlider>
+#include <QFile>
+#include <QFileDialog>
+#include <QDir>
+#include <algorithm>
 
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , fft(new FFTProcess())
     , time(new TimeDProcess())
+    , fft(new FFTProcess(time))
     , plotManager(nullptr)
+    , exporter(nullptr)
+    , stream(new StreamServer())
 {
     ui->setupUi(this);
 
@@ -48,16 +68,38 @@ MainWindow::MainWindow(QWidget *parent)
 
 
     // ComboBox (mode selector) styling
-    ui->modes->setStyleSheet(
+    const QString comboStyle =
         "QComboBox { color: white; background-color: rgb(95, 95, 95); border: 1px solid gray; }"
-        "QComboBox QAbstractItemView { background-color: rgb(95, 95, 95); color: white; }"
-        );
+        "QComboBox QAbstractItemView { background-color: rgb(95, 95, 95); color: white; }";
+    ui->modes->setStyleSheet(comboStyle);
+    ui->backpressure->setStyleSheet(comboStyle);
+    ui->timeWindow->setStyleSheet(comboStyle);
+    ui->triggerType->setStyleSheet(comboStyle);
+    ui->fftSize->setStyleSheet(comboStyle);
+    ui->fftWindow->setStyleSheet(comboStyle);
+    ui->fftOverlap->setStyleSheet(comboStyle);
+    ui->toneRate->setStyleSheet(comboStyle);
+    ui->holdTraces->setStyleSheet(comboStyle);
+    ui->averageTrace->setStyleSheet(comboStyle);
+    ui->toneList->setStyleSheet("QLineEdit { color: white; background-color: rgb(95, 95, 95); border: 1px solid gray; }");
+    const QString spinStyle = "QDoubleSpinBox { color: white; background-color: rgb(95, 95, 95); border: 1px solid gray; }";
+    ui->triggerLevel->setStyleSheet(spinStyle);
+    ui->triggerUpper->setStyleSheet(spinStyle);
+    ui->backpressure->setCurrentIndex(static_cast<int>(AppConfig::backpressurePolicy));
+    ui->fftSize->setCurrentIndex(1);
+    ui->fftWindow->setCurrentIndex(static_cast<int>(AppConfig::fftWindow));
+    ui->fftOverlap->setCurrentIndex(1);
+    ui->toneRate->setCurrentIndex(1);
+
+    // Status bar telemetry
+    ui->statusbar->setStyleSheet("color: gray;");
 
     // Splitter setup
-    QList<int> initialSizes { height() / 2, height() / 2 };
+    QList<int> initialSizes { height() * 2 / 5, height() * 2 / 5, height() / 5 };
     ui->splitter->setSizes(initialSizes);
     ui->splitter->setStretchFactor(0, 1);
     ui->splitter->setStretchFactor(1, 1);
+    ui->splitter->setStretchFactor(2, 0);
     ui->splitter->setChildrenCollapsible(true);
 
     // General background color for app
@@ -69,48 +111,271 @@ MainWindow::MainWindow(QWidget *parent)
     this->activateWindow();
 
     // Proper single initialization of plot manager
-    plotManager = new PlotManager(ui->FFT_plot, ui->Time_plot, this);
+    plotManager = new PlotManager(ui->FFT_plot, ui->Time_plot, ui->Tone_plot, this);
+    exporter = new ExportEngine(this);
+
+    for (int device = 1; device < static_cast<int>(AppConfig::devices.size()); ++device) {
+        TimeDProcess *t = new TimeDProcess();
+        headless.push_back({ t, new FFTProcess(t, device) });
+    }
 
     connect(ui->PausePlay, &QPushButton::clicked, this, [=]() {
         Features::togglePause(isPaused);
+        enterHistory(isPaused);
     });
 
-    connect(ui->modes, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int) {
-        Features::switchMode(currentMode);
-        time->resize(static_cast<int>(AppConfig::sampleRate * AppConfig::timeWindowSeconds + 1));
-        fft->setMode(currentMode);
+    // History scrubbing, only while paused
+    connect(ui->historySlider, &QSlider::valueChanged, this, [=](int position) {
+        showHistoryFrame(position);
+    });
+    connect(ui->historyMark, &QPushButton::clicked, this, [=]() {
+        historyMarkSeq = historyFirst + ui->historySlider->value();
+        ui->historyMark->setText(QString("Mark: frame %1").arg(ui->historySlider->value()));
+    });
+    connect(ui->historyExport, &QPushButton::clicked, this, [=]() {
+        const uint64_t current = historyFirst + ui->historySlider->value();
+        const bool marked = historyMarkSeq != UINT64_MAX;
+        const uint64_t first = marked ? std::min(historyMarkSeq, current) : historyFirst;
+        const uint64_t last = marked ? std::max(historyMarkSeq, current) : historyLast;
+        Features::promptUserToSaveHistory(this, exporter, fft, first, last);
+    });
 
-        qDebug() << "[MainWindow] Mode change: Starting FFT...";
-        fft->start();
-        qDebug() << "[MainWindow] FFT started.";
+    // One entry per analysis chain; they all run, the combo only picks the one on screen
+    ui->modes->blockSignals(true);
+    ui->modes->clear();
+    for (int i = 0; i < fft->chainCount(); ++i)
+        ui->modes->addItem(fft->chainConfig(i).name);
+    ui->modes->setCurrentIndex(currentChain);
+    ui->modes->blockSignals(false);
 
-        qDebug() << "[MainWindow] Starting Time...";
-        time->start();
-        qDebug() << "[MainWindow] Time started.";
+    connect(ui->modes, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int index) {
+        if (index < 0)
+            return;
+        currentChain = index;
+        const double rate = fft->chainConfig(index).sampleRate;
+        Features::selectChain(index, rate);
+        fft->setActiveChain(index);
+        plotManager->setFrequencyRange(rate);
+        if (isPaused)
+            enterHistory(true);  // scrub the newly viewed chain's history
+    });
+
+    // Pipeline parameters: each change builds a new pipeline that the callback swaps in
+    static const int fftSizes[] = { 6561, 19683, 59049 };
+    connect(ui->fftSize, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int index) {
+        for (AnalysisChainConfig &chain : AppConfig::analysisChains)
+            chain.fftSize = fftSizes[index];
+        fft->reconfigure(PipelineConfig());
+    });
+
+    connect(ui->fftWindow, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int index) {
+        AppConfig::fftWindow = static_cast<FFTWindow>(index);
+        fft->reconfigure(PipelineConfig());
+    });
+
+    static const double overlaps[] = { 0.0, 0.5, 0.75 };
+    connect(ui->fftOverlap, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int index) {
+        AppConfig::fftOverlapFraction = overlaps[index];
+        fft->reconfigure(PipelineConfig());
     });
 
+    // Tone tracker: list of MHz values, applied on enter / focus out
+    static const double toneRates[] = { 1e3, 10e3, 100e3 };
+    auto applyTones = [=]() {
+        AppConfig::trackedTonesHz.clear();
+        for (const QString &part : ui->toneList->text().split(',', Qt::SkipEmptyParts)) {
+            bool ok = false;
+            const double mhz = part.trimmed().toDouble(&ok);
+            if (ok && mhz > 0.0)
+                AppConfig::trackedTonesHz.push_back(mhz * 1e6);
+        }
+        AppConfig::toneTrackerRateHz = toneRates[ui->toneRate->currentIndex()];
+        fft->tones().configure(AppConfig::trackedTonesHz, AppConfig::toneTrackerRateHz);
+        ui->Tone_plot->setVisible(!AppConfig::trackedTonesHz.empty());
+    };
+    connect(ui->toneList, &QLineEdit::editingFinished, this, applyTones);
+    connect(ui->toneRate, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int) { applyTones(); });
+    ui->Tone_plot->setVisible(!AppConfig::trackedTonesHz.empty());
+
+    // Hold/average traces: accumulated on the workers, only selection and reset live here
+    auto applyTraces = [=]() {
+        const int hold = ui->holdTraces->currentIndex();
+        const int average = ui->averageTrace->currentIndex();
+        static const SpectrumTrace averages[] = { SpectrumTrace::LinearAverage, SpectrumTrace::ExponentialAverage,
+                                                  SpectrumTrace::Welch };
+        plotManager->setSpectrumTraces(hold == 1 || hold == 3, hold == 2 || hold == 3,
+                                       average > 0 ? static_cast<int>(averages[average - 1]) : -1);
+    };
+    connect(ui->holdTraces, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int) { applyTraces(); });
+    connect(ui->averageTrace, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int) { applyTraces(); });
+    connect(ui->resetTraces, &QPushButton::clicked, this, [=]() { fft->resetTraces(); });
+
+    static const double timeWindows[] = { 100e-6, 1e-3, 10e-3, 100e-3, 1.0, AppConfig::maxTimeWindowSeconds };
+    connect(ui->timeWindow, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int index) {
+        AppConfig::timeWindowSeconds = timeWindows[index];
+        time->resize(static_cast<int>(AppConfig::adcSampleRate * AppConfig::timeWindowSeconds));  // capture keeps running
+        plotManager->setTimeWindow(AppConfig::timeWindowSeconds);
+        applyTriggerSettings();  // capture depth follows the window
+    });
+
+    connect(ui->triggerType, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int) {
+        applyTriggerSettings();
+    });
+    connect(ui->triggerLevel, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, [=](double) {
+        applyTriggerSettings();
+    });
+    connect(ui->triggerUpper, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, [=](double) {
+        applyTriggerSettings();
+    });
+
+    connect(ui->backpressure, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int index) {
+        AppConfig::backpressurePolicy = static_cast<BackpressurePolicy>(index);
+        fft->setBackpressurePolicy(AppConfig::backpressurePolicy);
+        qDebug() << "[MainWindow] Back-pressure policy:" << ui->backpressure->currentText();
+    });
+
+    // Exports are written on the engine's thread; the spectrum is moved into the job, the time window
+    // is read out of the ring by the engine
     connect(ui->Save, &QPushButton::clicked, this, [=]() {
-        std::vector<double> fftBuf(AppConfig::fftBins, 0.0);
-        fft->getMagnitudes(fftBuf.data(), AppConfig::fftBins);
+        const int fftSize = fft->chainConfig(currentChain).fftSize;
+        std::vector<double> fftBuf(fftSize / 2 + 1, 0.0);
+        fft->getMagnitudes(fftBuf.data(), static_cast<int>(fftBuf.size()));
+
+        Features::promptUserToSavePlot(this, exporter, std::move(fftBuf), fftSize, time, fft->calibration());
+    });
+    QLabel *exportStatus = new QLabel(this);
+    ui->statusbar->addPermanentWidget(exportStatus);
+    connect(exporter, &ExportEngine::progressChanged, this, [=](int percent) {
+        exportStatus->setText(QString("Exporting: %1%").arg(percent));
+    });
+    connect(exporter, &ExportEngine::finished, this, [=](const QString &fileName, bool ok) {
+        exportStatus->setText(QString(ok ? "Saved %1" : "Export failed: %1").arg(QFileInfo(fileName).fileName()));
+    });
+
+    // Raw capture: the callback only copies, chunks are encoded on the pool and written in order
+    connect(ui->Record, &QPushButton::toggled, this, [=](bool on) {
+        if (!on) {
+            fft->recorder().stop();
+            ui->Record->setText("Record");
+            return;
+        }
+        const QString fileName = QFileDialog::getSaveFileName(this, "Record Raw Capture", QDir::homePath(), "Raw Capture (*.ucr)");
+        if (fileName.isEmpty() || !fft->recorder().start(QFile::encodeName(fileName).toStdString())) {
+            ui->Record->blockSignals(true);
+            ui->Record->setChecked(false);
+            ui->Record->blockSignals(false);
+            return;
+        }
+        ui->Record->setText("Stop");
+    });
+
+    connect(ui->Reference, &QPushButton::clicked, this, [=] { fft->captureCorrelationReference(); });
 
-        int count = time->sampleCount();
-        std::vector<uint16_t> timeBuf(count);
-        time->getBuffer(timeBuf.data(), count);
+    connect(ui->Persist, &QPushButton::toggled, this, [=](bool on) { plotManager->setPersistence(fft, on); });
 
-        Features::promptUserToSavePlot(this, fftBuf.data(), timeBuf);
+    connect(ui->Zero, &QPushButton::clicked, this, [=] {
+        fft->calibration().zero();
+        applyTriggerSettings();  // levels are entered in µW, their codes moved with the zero point
     });
 
     connect(fft, &FFTProcess::peakFrequencyUpdated, this, [=](double freq) {
-        Features::updatePeakFrequency(ui->PeakFreq, currentMode, freq, isPaused);
+        Features::updatePeakFrequency(ui->PeakFreq, AppConfig::sampleRate, freq, isPaused);
     });
 
     QTimer *plotTimer = new QTimer(this);
     connect(plotTimer, &QTimer::timeout, this, [=]() {
-        plotManager->updatePlot(fft, time, isPaused, currentMode);
+        plotManager->updatePlot(fft, time, isPaused);
     });
     plotTimer->start(AppConfig::plotRefreshRateMs);
 
-    fft->setMode(currentMode);
+    QTimer *statusTimer = new QTimer(this);
+    connect(statusTimer, &QTimer::timeout, this, [=]() {
+        const double timeMB = time->memoryBytes() / (1024.0 * 1024.0);
+        QString status = QString("Overlap: %1%  |  Time buffer: %2 MB%3  |  Mapped: %4 MB")
+                             .arg(fft->effectiveOverlap() * 100.0, 0, 'f', 1)
+                             .arg(timeMB, 0, 'f', 1)
+                             .arg(time->usesHugePages() ? " (huge pages)" : "")
+                             .arg(HugePages::bytesInUse() / (1024.0 * 1024.0), 0, 'f', 1);
+        const PipelineMemory mem = fft->pipelineMemory();
+        if (mem.mapped) {
+            const double MB = 1024.0 * 1024.0;
+            status += QString("  |  Pipeline: %1 MB%2 (frames %3, spectra %4, history %5, scratch %6)")
+                          .arg(mem.mapped / MB, 0, 'f', 1)
+                          .arg(mem.huge ? " (huge pages)" : "")
+                          .arg(mem.frames / MB, 0, 'f', 1)
+                          .arg(mem.spectra / MB, 0, 'f', 1)
+                          .arg(mem.history / MB, 0, 'f', 1)
+                          .arg(mem.scratch / MB, 0, 'f', 1);
+        }
+        switch (fft->deviceState()) {
+        case DeviceState::Initializing: status.prepend("Starting up...  |  "); break;
+        case DeviceState::Searching:    status.prepend("No device, searching...  |  "); break;
+        case DeviceState::Reconnecting: status.prepend("Device lost, reconnecting...  |  "); break;
+        case DeviceState::Lost:         status.prepend("Device lost, restart to reopen it  |  "); break;
+        case DeviceState::Streaming:
+            if (const uint64_t reconnects = fft->reconnects())
+                status.prepend(QString("Reconnected %1x  |  ").arg(reconnects));
+            break;
+        }
+        if (fft->recorder().recording()) {
+            const SampleRecorder::Stats rec = fft->recorder().stats();
+            status += QString("  |  Rec: %1 s, %2x, %3 MB, %4 dropped")
+                          .arg(rec.seconds, 0, 'f', 1)
+                          .arg(rec.encodedBytes ? static_cast<double>(rec.rawBytes) / rec.encodedBytes : 0.0, 0, 'f', 2)
+                          .arg(rec.encodedBytes / (1024.0 * 1024.0), 0, 'f', 0)
+                          .arg(rec.droppedSamples);
+        }
+        if (stream->running())
+            status += QString("  |  Stream: %1 clients").arg(stream->clientCount());
+        if (!headless.empty()) {
+            int streaming = fft->deviceState() == DeviceState::Streaming;
+            uint64_t dropped = 0;
+            for (const HeadlessDevice &d : headless) {
+                streaming += d.fft->deviceState() == DeviceState::Streaming;
+                dropped += d.fft->droppedFrames();
+            }
+            status += QString("  |  Devices: %1/%2 streaming, %3 frames dropped by the others")
+                          .arg(streaming).arg(headless.size() + 1).arg(dropped);
+        }
+        if (const uint64_t gaps = fft->timeline().gapCount())
+            status += QString("  |  Gaps: %1").arg(gaps);
+        if (const uint64_t dropped = fft->droppedFrames())
+            status += QString("  |  Dropped frames: %1").arg(dropped);
+        if (const uint64_t events = fft->events().total()) {
+            status += QString("  |  Events: %1").arg(events);
+            if (const uint64_t lost = fft->events().lost())
+                status += QString(" (%1 lost)").arg(lost);
+        }
+        CorrelationResult corr;
+        if (fft->correlation(corr) && corr.periodSeconds > 0.0) {
+            status += QString("  |  Period: %1 us, jitter %2 ns (%3)")
+                          .arg(corr.periodSeconds * 1e6, 0, 'f', 4)
+                          .arg(corr.jitterSeconds * 1e9, 0, 'f', 1)
+                          .arg(corr.confidence, 0, 'f', 2);
+        }
+        if (corr.hasReference)
+            status += QString("  |  Ref match: %1 at %2 us").arg(corr.match, 0, 'f', 2).arg(corr.delaySeconds * 1e6, 0, 'f', 3);
+        if (fft->persistence().enabled()) {
+            static uint64_t lastWaveforms = 0;  // the timer runs once a second
+            const uint64_t waveforms = fft->persistence().waveforms();
+            status += QString("  |  Phosphor: %1 waveforms/s").arg(waveforms - std::min(lastWaveforms, waveforms));
+            if (const uint64_t missed = fft->persistence().missed())
+                status += QString(" (%1 missed)").arg(missed);
+            lastWaveforms = waveforms;
+        }
+        ui->statusbar->showMessage(status);
+    });
+    statusTimer->start(1000);
+
+    if (AppConfig::streamPort > 0 && stream->start(AppConfig::streamBindAddress, AppConfig::streamPort)) {
+        QTimer *streamTimer = new QTimer(this);
+        connect(streamTimer, &QTimer::timeout, this, [=]() { publishStream(); });
+        streamTimer->start(static_cast<int>(1000.0 / AppConfig::streamRateHz));
+    }
+
+    fft->setActiveChain(currentChain);
+    Features::selectChain(currentChain, fft->chainConfig(currentChain).sampleRate);
+    plotManager->setFrequencyRange(AppConfig::sampleRate);
 
     // Delay starting the streaming until after the GUI is fully shown
      QTimer::singleShot(0, this, [this] {
@@ -121,12 +386,123 @@ MainWindow::MainWindow(QWidget *parent)
 
         time->start();
         qDebug() << "[MainWindow] Time started.";
+
+        for (const HeadlessDevice &d : headless) {
+            d.fft->start();
+            d.time->start();
+        }
+        if (!headless.empty())
+            qDebug() << "[MainWindow]" << headless.size() << "more devices started.";
     });           // dont start yet
+
+    // Placement of the callback thread is only known once samples flow
+    QTimer::singleShot(2000, this, [this] {
+        const QString placement = ThreadPlacement::report();
+        qDebug().noquote() << "[MainWindow] Thread placement:\n" << placement;
+        ui->statusbar->setToolTip(placement);
+    });
+}
+
+void MainWindow::applyTriggerSettings()
+{
+    const double rate = AppConfig::adcSampleRate;
+    const int depth = static_cast<int>(std::min<double>(rate * AppConfig::timeWindowSeconds,
+                                                        AppConfig::maxTriggerDepthSamples));
+
+    TriggerSettings settings;
+    settings.type = static_cast<TriggerType>(ui->triggerType->currentIndex());
+    settings.level = fft->calibration().toCode(ui->triggerLevel->value());
+    settings.upper = fft->calibration().toCode(ui->triggerUpper->value());
+    settings.preSamples = static_cast<int>(depth * AppConfig::triggerPreFraction);
+    settings.postSamples = depth - settings.preSamples;
+    settings.holdoffSamples = static_cast<uint64_t>(AppConfig::triggerHoldoffSeconds * rate);
+    settings.minWidth = static_cast<int>(AppConfig::triggerMinPulseSeconds * rate);
+    settings.maxWidth = static_cast<int>(AppConfig::triggerMaxPulseSeconds * rate);
+
+    time->trigger().configure(settings);
+    plotManager->setTriggerView(settings.type != TriggerType::Off,
+                                settings.preSamples / rate, settings.postSamples / rate);
+}
+
+void MainWindow::enterHistory(bool paused)
+{
+    fft->freezeHistory(paused);
+    historyMarkSeq = UINT64_MAX;
+    ui->historyMark->setText("Mark range start");
+
+    const bool available = paused && fft->historyRange(historyFirst, historyLast);
+    ui->historySlider->setEnabled(available);
+    ui->historyMark->setEnabled(available);
+    ui->historyExport->setEnabled(available);
+    if (!available) {
+        ui->historyTime->setText(paused ? "History: empty" : "History: live");
+        return;
+    }
+
+    fft->historyFrame(historyLast, nullptr, 0, &historyNewestSeconds);
+
+    ui->historySlider->blockSignals(true);
+    ui->historySlider->setRange(0, static_cast<int>(historyLast - historyFirst));
+    ui->historySlider->setValue(ui->historySlider->maximum());
+    ui->historySlider->blockSignals(false);
+    showHistoryFrame(ui->historySlider->value());
+}
+
+void MainWindow::showHistoryFrame(int position)
+{
+    const uint64_t seq = historyFirst + position;
+    double seconds = 0.0;
+    uint8_t flags = 0;
+    if (!plotManager->showHistoryFrame(fft, seq, &seconds, &flags)) {
+        ui->historyTime->setText(QString("Frame %1: not held").arg(position));
+        return;
+    }
+    ui->historyTime->setText(QString("Frame %1 of %2, %3 ms before pause%4")
+                                 .arg(position)
+                                 .arg(ui->historySlider->maximum())
+                                 .arg((historyNewestSeconds - seconds) * 1e3, 0, 'f', 3)
+                                 .arg((flags & FrameCorrupt) ? " (gap)" : (flags & FrameAfterDrop) ? " (after drop)" : ""));
+}
+
+void MainWindow::publishStream()
+{
+    if (stream->clientCount() == 0) {
+        streamCursor = time->writeCursor();  // a new client starts from live data
+        return;
+    }
+
+    std::vector<double> mags;
+    for (int i = 0; i < fft->chainCount(); ++i) {
+        const AnalysisChainConfig cfg = fft->chainConfig(i);
+        mags.assign(cfg.fftSize / 2 + 1, 0.0);
+        if (!fft->copySpectrum(i, mags.data(), static_cast<int>(mags.size())))
+            continue;
+        stream->publishSpectrum(i, cfg.sampleRate, cfg.fftSize, mags.data(), static_cast<int>(mags.size()));
+        stream->publishPeaks(i, cfg.sampleRate, cfg.fftSize, mags.data(), static_cast<int>(mags.size()), AppConfig::streamPeaks);
+    }
+
+    // Envelope of everything captured since the previous frame, clipped to what the ring still holds
+    const uint64_t end = time->writeCursor();
+    const uint64_t first = std::max<uint64_t>(streamCursor, end - std::min<uint64_t>(end, time->sampleCount()));
+    if (end > first) {
+        std::vector<uint16_t> mins(AppConfig::streamTimeBins), maxs(AppConfig::streamTimeBins);
+        const int bins = time->summary(first, end - first, AppConfig::streamTimeBins, mins.data(), maxs.data());
+        if (bins > 0)
+            stream->publishTimeEnvelope(first, AppConfig::adcSampleRate, static_cast<double>(end - first) / bins,
+                                        mins.data(), maxs.data(), bins);
+    }
+    streamCursor = end;
 }
 
 MainWindow::~MainWindow() {
+    delete exporter;      // a running time export reads fft's calibration
+    delete stream;        // stops the server thread and closes the clients
+    for (const HeadlessDevice &d : headless) {
+        delete d.fft;
+        delete d.time;
+    }
     delete fft;           // safe since no parent
-    delete time;          // safe since no parent
+    delete time;          // safe since no parent, after the fft that feeds it
     delete plotManager;
     delete ui;
 }
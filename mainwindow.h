@@ -3,7 +3,8 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include "Features.h"
+#include <cstdint>
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -12,6 +13,8 @@ QT_END_NAMESPACE
 class FFTProcess;
 class TimeDProcess;
 class PlotManager;
+class ExportEngine;
+class StreamServer;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -21,12 +24,31 @@ public:
     ~MainWindow();
 
 private:
+    void applyTriggerSettings();
+    void enterHistory(bool paused);  // freeze/unfreeze the ring and arm the scrub controls
+    void showHistoryFrame(int position);
+    void publishStream();  // one spectrum + peaks frame per chain and one time envelope
+
+    // Devices 1.. of AppConfig::devices stream headless beside the one on screen
+    struct HeadlessDevice {
+        TimeDProcess *time;
+        FFTProcess   *fft;
+    };
+
     Ui::MainWindow *ui;
+    TimeDProcess   *time;  // before fft, which feeds it
     FFTProcess     *fft;
-    TimeDProcess   *time;
+    std::vector<HeadlessDevice> headless;
     PlotManager    *plotManager;
+    ExportEngine   *exporter;
+    StreamServer   *stream;
+    uint64_t        streamCursor = 0;  // time samples already covered by an envelope frame
     bool            isPaused = false;
-    FFTMode         currentMode = FFTMode::FullBandwidth;
+    int             currentChain = 0;  // analysis chain on screen
+    uint64_t        historyFirst = 0;  // sequence number at slider position 0
+    uint64_t        historyLast = 0;
+    double          historyNewestSeconds = 0.0;
+    uint64_t        historyMarkSeq = UINT64_MAX;  // start of the export range, none = whole history
 };
 
 #endif // MAINWINDOW_H
@@ -1,9 +1,12 @@
 // PlotManager.cpp
 #include "PlotManager.h"
 #include "AppConfig.h"
-#include "Features.h"
+#include "AdcCalibration.h"
 #include "FFTProcess.h"
 #include "TimeDProcess.h"
+#include "ToneTracker.h"
+#include "StageGraph.h"
+#include "Persistence.h"
 
 #include <QPen>
 #include <qwt_text.h>
@@ -15,12 +18,20 @@
 #include <qwt_scale_widget.h>
 #include <qwt_plot_panner.h>
 #include <qwt_plot_magnifier.h>
+#include <qwt_plot_spectrogram.h>
+#include <qwt_matrix_raster_data.h>
+#include <qwt_color_map.h>
 
 class ClampedPanner : public QwtPlotPanner {
 public:
     ClampedPanner(QWidget *canvas, QwtPlot *plot, double minX, double maxX)
         : QwtPlotPanner(canvas), plot_(plot), minX_(minX), maxX_(maxX) {}
 
+    void setBounds(double minX, double maxX) {
+        minX_ = minX;
+        maxX_ = maxX;
+    }
+
 protected:
     void moveCanvas(int dx, int dy) override {
         QwtPlotPanner::moveCanvas(dx, dy);
@@ -53,6 +64,11 @@ public:
     ClampedMagnifier(QWidget *canvas, QwtPlot *plot, double minX, double maxX)
         : QwtPlotMagnifier(canvas), plot_(plot), minX_(minX), maxX_(maxX) {}
 
+    void setBounds(double minX, double maxX) {
+        minX_ = minX;
+        maxX_ = maxX;
+    }
+
 protected:
     void rescale(double factor) override {
         QwtPlotMagnifier::rescale(factor);
@@ -87,8 +103,8 @@ private:
 };
 
 
-PlotManager::PlotManager(QwtPlot *fftPlot, QwtPlot *timePlot, QObject *parent)
-    : QObject(parent), fftPlot_(fftPlot), timePlot_(timePlot)
+PlotManager::PlotManager(QwtPlot *fftPlot, QwtPlot *timePlot, QwtPlot *tonePlot, QObject *parent)
+    : QObject(parent), fftPlot_(fftPlot), timePlot_(timePlot), tonePlot_(tonePlot)
 {
     QColor lightGray(183, 182, 191);
     QColor backgroundColor(13, 13, 13);
@@ -156,25 +172,77 @@ PlotManager::PlotManager(QwtPlot *fftPlot, QwtPlot *timePlot, QObject *parent)
         }
     }
 
+    // Tone tracker plot: amplitude left, phase right, newest point at t = 0
+    QwtPlotGrid *toneGrid = new QwtPlotGrid();
+    toneGrid->setMajorPen(QColor(183, 182, 191, 80), 0.5);
+    toneGrid->attach(tonePlot_);
+
+    tonePlot_->setCanvasBackground(backgroundColor);
+    QwtText toneTitle("Tracked Tones");
+    toneTitle.setColor(lightGray);
+    tonePlot_->setTitle(toneTitle);
+    tonePlot_->enableAxis(QwtPlot::yRight, true);
+    tonePlot_->setAxisTitle(QwtPlot::xBottom, QwtText("Time (ms)"));
+    tonePlot_->setAxisTitle(QwtPlot::yLeft, QwtText("Amplitude (µW)"));
+    tonePlot_->setAxisTitle(QwtPlot::yRight, QwtText("Phase (rad)"));
+    tonePlot_->setAxisScale(QwtPlot::yRight, -3.2, 3.2);
+    tonePlot_->setAxisMaxMajor(QwtPlot::yLeft, 4);
+
+    for (int axis = 0; axis < QwtPlot::axisCnt; ++axis) {
+        if (auto *scaleWidget = tonePlot_->axisWidget(axis)) {
+            QPalette pal = scaleWidget->palette();
+            pal.setColor(QPalette::WindowText, lightGray);
+            pal.setColor(QPalette::Text, lightGray);
+            scaleWidget->setPalette(pal);
+        }
+    }
+
     // FFT curve
     fftCurve_ = new QwtPlotCurve("FFT");
     fftCurve_->setPen(QPen(neonPink, 0.45));
     fftCurve_->setRenderHint(QwtPlotItem::RenderAntialiased, true);
     fftCurve_->attach(fftPlot_);
 
+    // Hold/average traces, drawn over the live spectrum and hidden until selected
+    maxHoldCurve_ = new QwtPlotCurve("Max Hold");
+    maxHoldCurve_->setPen(QPen(QColor(255, 214, 112), 0.45));
+    minHoldCurve_ = new QwtPlotCurve("Min Hold");
+    minHoldCurve_->setPen(QPen(QColor(150, 255, 150), 0.45));
+    averageCurve_ = new QwtPlotCurve("Average");
+    averageCurve_->setPen(QPen(QColor(112, 214, 255), 0.6));
+    stageCurve_ = new QwtPlotCurve("Stage graph");
+    stageCurve_->setPen(QPen(QColor(235, 235, 235), 0.6));
+    for (QwtPlotCurve *curve : { maxHoldCurve_, minHoldCurve_, averageCurve_, stageCurve_ }) {
+        curve->setRenderHint(QwtPlotItem::RenderAntialiased, true);
+        curve->setVisible(false);
+        curve->attach(fftPlot_);
+    }
+
     // Time curve
     timeCurve_ = new QwtPlotCurve("Time Domain");
     timeCurve_->setPen(QPen(neonPink, 0.45));
     timeCurve_->attach(timePlot_);
 
+    // Phosphor image over the same axes, shown instead of the curve in persistence mode
+    auto *phosphorColors = new QwtLinearColorMap(backgroundColor, Qt::white);
+    phosphorColors->addColorStop(0.5, neonPink);
+    phosphorData_ = new QwtMatrixRasterData();
+    phosphorData_->setInterval(Qt::ZAxis, QwtInterval(0.0, 1.0));
+    phosphor_ = new QwtPlotSpectrogram("Persistence");
+    phosphor_->setRenderThreadCount(0);  // one per core
+    phosphor_->setColorMap(phosphorColors);
+    phosphor_->setData(phosphorData_);
+    phosphor_->setVisible(false);
+    phosphor_->attach(timePlot_);
+
     // Interactive controls
-    auto *fftPanner = new ClampedPanner(fftPlot_->canvas(), fftPlot_, fftXMin_, fftXMax_);
-    fftPanner->setMouseButton(Qt::LeftButton);
-    new ClampedMagnifier(fftPlot_->canvas(), fftPlot_, fftXMin_, fftXMax_);
+    fftPanner_ = new ClampedPanner(fftPlot_->canvas(), fftPlot_, fftXMin_, fftXMax_);
+    fftPanner_->setMouseButton(Qt::LeftButton);
+    fftMagnifier_ = new ClampedMagnifier(fftPlot_->canvas(), fftPlot_, fftXMin_, fftXMax_);
 
-    auto *timePanner = new ClampedPanner(timePlot_->canvas(), timePlot_, timeXMin_, timeXMax_);
-    timePanner->setMouseButton(Qt::LeftButton);
-    new ClampedMagnifier(timePlot_->canvas(), timePlot_, timeXMin_, timeXMax_);
+    timePanner_ = new ClampedPanner(timePlot_->canvas(), timePlot_, timeXMin_, timeXMax_);
+    timePanner_->setMouseButton(Qt::LeftButton);
+    timeMagnifier_ = new ClampedMagnifier(timePlot_->canvas(), timePlot_, timeXMin_, timeXMax_);
 
     // Zoom buttons
     createZoomButtons(fftPlot_, fftPlusX_, fftMinusX_, fftPlusY_, fftMinusY_);
@@ -184,60 +252,365 @@ PlotManager::PlotManager(QwtPlot *fftPlot, QwtPlot *timePlot, QObject *parent)
     timePlot_->installEventFilter(this);
 }
 
-void PlotManager::updateFFT(const double *fftBuffer, double sampleRate)
+void PlotManager::updateFFT(const double *fftBuffer, int fftSize, double sampleRate)
 {
-    const double binWidth_Hz = sampleRate / AppConfig::fftSize;
-    QVector<double> freqs;
-    QVector<double> mags_Log;
+    const double binWidth_Hz = sampleRate / fftSize;
+    const int bins = fftSize / 2 + 1;
+    fftX_.resize(bins);
+    fftY_.resize(bins);
 
-    for (int i = 0; i < AppConfig::fftBins; ++i) {
+    for (int i = 0; i < bins; ++i) {
         double freq = static_cast<double>(i) * binWidth_Hz / (sampleRate > 1e6 ? 1e6 : 1e3);
         double magLin = std::max(fftBuffer[i], AppConfig::epsilon);
-        freqs.append(freq);
-        mags_Log.append(std::log10(magLin));
+        fftX_[i] = freq;
+        fftY_[i] = std::log10(magLin);
     }
 
-    fftCurve_->setSamples(freqs, mags_Log);
+    fftCurve_->setRawSamples(fftX_.data(), fftY_.data(), bins);
+    fftPlot_->setAxisTitle(QwtPlot::xBottom, QwtText(sampleRate > 1e6 ? "Frequency (MHz)" : "Frequency (KHz)"));
+    fftPlot_->replot();
+}
+
+void PlotManager::setFrequencyRange(double sampleRate)
+{
+    fftXMin_ = 0.0;
+    fftXMax_ = (sampleRate / 2.0) / (sampleRate > 1e6 ? 1e6 : 1e3);
     fftPlot_->setAxisTitle(QwtPlot::xBottom, QwtText(sampleRate > 1e6 ? "Frequency (MHz)" : "Frequency (KHz)"));
+    fftPlot_->setAxisScale(QwtPlot::xBottom, fftXMin_, fftXMax_);
+    fftPanner_->setBounds(fftXMin_, fftXMax_);
+    fftMagnifier_->setBounds(fftXMin_, fftXMax_);
+    fftPlot_->replot();
+}
+
+void PlotManager::setSpectrumTraces(bool maxHold, bool minHold, int average)
+{
+    showMaxHold_ = maxHold;
+    showMinHold_ = minHold;
+    averageTrace_ = average;
+    maxHoldCurve_->setVisible(false);  // shown again once they hold data
+    minHoldCurve_->setVisible(false);
+    averageCurve_->setVisible(false);
     fftPlot_->replot();
 }
 
-void PlotManager::updateTime(const std::vector<uint16_t> &timeBuffer,double sampleRate, double timeWindowSeconds, int maxPointsToPlot)
+// Sets the selected trace curves without replotting
+void PlotManager::updateTraces(FFTProcess* fft, int fftSize, double sampleRate)
+{
+    const struct { bool on; SpectrumTrace trace; QwtPlotCurve *curve; CurveSamples &samples; } traces[] = {
+        { showMaxHold_, SpectrumTrace::MaxHold, maxHoldCurve_, maxHoldSamples_ },
+        { showMinHold_, SpectrumTrace::MinHold, minHoldCurve_, minHoldSamples_ },
+        { averageTrace_ >= 0, static_cast<SpectrumTrace>(std::max(averageTrace_, 0)), averageCurve_, averageSamples_ },
+    };
+
+    const int bins = fftSize / 2 + 1;
+    const double step = sampleRate / fftSize / (sampleRate > 1e6 ? 1e6 : 1e3);
+    traceBuffer_.resize(bins);
+
+    for (const auto &t : traces) {
+        if (!t.on || !fft->getTrace(t.trace, traceBuffer_.data(), bins)) {
+            t.curve->setVisible(false);
+            continue;
+        }
+
+        t.samples.x.resize(bins);
+        t.samples.y.resize(bins);
+        for (int i = 0; i < bins; ++i) {
+            t.samples.x[i] = i * step;
+            t.samples.y[i] = std::log10(std::max(traceBuffer_[i], AppConfig::epsilon));
+        }
+        t.curve->setRawSamples(t.samples.x.data(), t.samples.y.data(), bins);
+        t.curve->setVisible(true);
+    }
+
+    // Stage graph branch on its own frequency grid (it may run at another rate than the chain)
+    StageOutputInfo info;
+    if (AppConfig::stageGraphPlot.empty()
+        || !fft->stageOutput(AppConfig::stageGraphPlot, traceBuffer_, &info)
+        || info.kind != BlockKind::Spectrum || info.frameSize <= 0) {
+        stageCurve_->setVisible(false);
+        return;
+    }
+    const double stageStep = info.sampleRate / info.frameSize / (sampleRate > 1e6 ? 1e6 : 1e3);
+    stageSamples_.x.resize(info.count);
+    stageSamples_.y.resize(info.count);
+    for (int i = 0; i < info.count; ++i) {
+        stageSamples_.x[i] = i * stageStep;
+        stageSamples_.y[i] = std::log10(std::max(traceBuffer_[i], AppConfig::epsilon));
+    }
+    stageCurve_->setRawSamples(stageSamples_.x.data(), stageSamples_.y.data(), info.count);
+    stageCurve_->setVisible(true);
+}
+
+void PlotManager::updateZoom(const std::vector<double> &freqsHz, const std::vector<double> &mags, double sampleRate)
+{
+    const double unit = sampleRate > 1e6 ? 1e6 : 1e3;
+    const size_t count = std::min(freqsHz.size(), mags.size());
+    fftX_.resize(count);
+    fftY_.resize(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        fftX_[i] = freqsHz[i] / unit;
+        fftY_[i] = std::log10(std::max(mags[i], AppConfig::epsilon));
+    }
+
+    fftCurve_->setRawSamples(fftX_.data(), fftY_.data(), static_cast<int>(count));
+    fftPlot_->replot();
+}
+
+void PlotManager::updateTime(const uint16_t *mins, const uint16_t *maxs, int bins, double startSeconds, double spanSeconds,
+                             const AdcCalibration &calibration)
+{
+    if (bins <= 0)
+        return;
+
+    const double x0 = startSeconds * timeUnitScale_;
+    const double dx = spanSeconds * timeUnitScale_ / bins;
+
+    // Min/max envelope: one vertical stroke per bin keeps spikes visible at any window length
+    timeX_.resize(2 * bins);
+    timeY_.resize(2 * bins);  // µW
+
+    lowPower_.resize(bins);
+    highPower_.resize(bins);
+    calibration.toMicroWatts(mins, bins, lowPower_.data());
+    calibration.toMicroWatts(maxs, bins, highPower_.data());
+
+    for (int i = 0; i < bins; ++i) {
+        const double x = x0 + static_cast<double>(i) * dx;
+        timeX_[2 * i] = x;
+        timeY_[2 * i] = lowPower_[i];
+        timeX_[2 * i + 1] = x;
+        timeY_[2 * i + 1] = highPower_[i];
+    }
+
+    timeCurve_->setRawSamples(timeX_.data(), timeY_.data(), 2 * bins);
+    timePlot_->setAxisTitle(QwtPlot::yLeft, QwtText("Power (µW)"));
+    timePlot_->replot();
+}
+
+void PlotManager::updateTriggered(const std::vector<uint16_t> &capture, int preSamples, const AdcCalibration &calibration)
+{
+    const int length = static_cast<int>(capture.size());
+    const int bins = std::min(length, std::max(1, AppConfig::maxPointsToPlot / 2));
+    if (bins <= 0)
+        return;
+
+    timeMins_.resize(bins);
+    timeMaxs_.resize(bins);
+    for (int b = 0; b < bins; ++b) {
+        const int first = static_cast<int>(static_cast<int64_t>(length) * b / bins);
+        const int last = static_cast<int>(static_cast<int64_t>(length) * (b + 1) / bins);
+        const auto range = std::minmax_element(capture.begin() + first, capture.begin() + std::max(last, first + 1));
+        timeMins_[b] = *range.first;
+        timeMaxs_[b] = *range.second;
+    }
+
+    // x = 0 at the trigger point
+    updateTime(timeMins_.data(), timeMaxs_.data(), bins,
+               -preSamples / AppConfig::adcSampleRate, length / AppConfig::adcSampleRate, calibration);
+}
+
+void PlotManager::setTriggerView(bool triggered, double preSeconds, double postSeconds)
+{
+    triggered_ = triggered;
+    if (!triggered) {
+        setTimeWindow(AppConfig::timeWindowSeconds);
+        return;
+    }
+
+    setTimeWindow(preSeconds + postSeconds);  // picks the unit
+    timeXMin_ = -preSeconds * timeUnitScale_;
+    timeXMax_ = postSeconds * timeUnitScale_;
+    timePlot_->setAxisScale(QwtPlot::xBottom, timeXMin_, timeXMax_);
+    timePanner_->setBounds(timeXMin_, timeXMax_);
+    timeMagnifier_->setBounds(timeXMin_, timeXMax_);
+    timePlot_->replot();
+}
+
+void PlotManager::setTimeWindow(double seconds)
+{
+    QString unit;
+    if (seconds >= 1.0) {
+        timeUnitScale_ = 1.0;
+        unit = "s";
+    } else if (seconds >= 1e-3) {
+        timeUnitScale_ = 1e3;
+        unit = "ms";
+    } else {
+        timeUnitScale_ = 1e6;
+        unit = "\u00b5s";
+    }
+
+    timeXMin_ = 0.0;
+    timeXMax_ = seconds * timeUnitScale_;
+    timePlot_->setAxisTitle(QwtPlot::xBottom, QwtText(QString("Time (%1)").arg(unit)));
+    timePlot_->setAxisScale(QwtPlot::xBottom, timeXMin_, timeXMax_);
+    timePanner_->setBounds(timeXMin_, timeXMax_);
+    timeMagnifier_->setBounds(timeXMin_, timeXMax_);
+    timePlot_->replot();
+}
+
+void PlotManager::updateTones(FFTProcess* fft)
+{
+    double rate = 0.0;
+    const int points = fft->tones().snapshot(toneFreqs_, toneAmps_, tonePhases_,
+                                             ToneTracker::kHistory, &rate);
+    const int tones = static_cast<int>(toneFreqs_.size());
+
+    static const QColor palette[] = { QColor(255, 112, 198), QColor(112, 214, 255), QColor(255, 214, 112),
+                                      QColor(150, 255, 150), QColor(200, 160, 255), QColor(255, 160, 120) };
+    while (static_cast<int>(toneAmpCurves_.size()) < tones) {
+        const QColor color = palette[toneAmpCurves_.size() % 6];
+        auto *amp = new QwtPlotCurve();
+        amp->setPen(QPen(color, 0.8));
+        amp->attach(tonePlot_);
+        auto *phase = new QwtPlotCurve();
+        phase->setPen(QPen(color, 0.5, Qt::DotLine));
+        phase->setYAxis(QwtPlot::yRight);
+        phase->attach(tonePlot_);
+        toneAmpCurves_.push_back(amp);
+        tonePhaseCurves_.push_back(phase);
+    }
+
+    toneTimes_.resize(points);
+    for (int i = 0; i < points; ++i)
+        toneTimes_[i] = -(points - 1 - i) / rate * 1e3;
+
+    for (int k = 0; k < static_cast<int>(toneAmpCurves_.size()); ++k) {
+        if (k >= tones || points == 0) {
+            toneAmpCurves_[k]->setSamples(QVector<double>(), QVector<double>());
+            tonePhaseCurves_[k]->setSamples(QVector<double>(), QVector<double>());
+            continue;
+        }
+        const double *amp = toneAmps_.data() + static_cast<size_t>(k) * points;
+        const double *phase = tonePhases_.data() + static_cast<size_t>(k) * points;
+        toneAmpCurves_[k]->setRawSamples(toneTimes_.data(), amp, points);  // toneAmps_/tonePhases_ stay put until the next snapshot
+        tonePhaseCurves_[k]->setRawSamples(toneTimes_.data(), phase, points);
+        toneAmpCurves_[k]->setTitle(QString("%1 MHz").arg(toneFreqs_[k] / 1e6, 0, 'f', 4));
+    }
+
+    if (points > 0)
+        tonePlot_->setAxisScale(QwtPlot::xBottom, toneTimes_.front(), 0.0);
+    tonePlot_->replot();
+}
+
+void PlotManager::setPersistence(FFTProcess* fft, bool on)
 {
-    const int plotSamples = static_cast<int>(timeBuffer.size());
-    const int step = std::max(1, plotSamples / maxPointsToPlot);
-    const double dt_us = timeWindowSeconds * 1e6 / (plotSamples - 1);
+    persistence_ = on;
+    phosphorLowCode_ = phosphorHighCode_ = -1;  // configured from the y axis on the next tick
+    phosphorTimer_.invalidate();
+    fft->persistence().setEnabled(on);
 
-    QVector<double> timeX_us;
-    QVector<double> powerY_uW;
+    timeCurve_->setVisible(!on);
+    phosphor_->setVisible(on);
+    timePlot_->replot();
+}
 
-    for (int i = 0; i < plotSamples; i += step) {
-        timeX_us.append(static_cast<double>(i) * dt_us);
-        double power_uW = (static_cast<double>(timeBuffer[i]) - AppConfig::adcOffset) * AppConfig::adcToMicroWatts;
-        powerY_uW.append(power_uW);
+void PlotManager::updatePersistence(FFTProcess* fft)
+{
+    // Rows span the visible y range: a y zoom re-bins and starts the image over
+    const auto yDiv = timePlot_->axisScaleDiv(QwtPlot::yLeft);
+    const int lowCode = fft->calibration().toCode(yDiv.lowerBound());
+    const int highCode = fft->calibration().toCode(yDiv.upperBound());
+    if (lowCode != phosphorLowCode_ || highCode != phosphorHighCode_) {
+        PersistenceSettings settings;
+        settings.columns = AppConfig::persistenceColumns;
+        settings.rows = AppConfig::persistenceRows;
+        settings.lowCode = lowCode;
+        settings.highCode = highCode;
+        settings.decaySeconds = AppConfig::persistenceDecaySeconds;
+        fft->persistence().configure(settings);
+        phosphorLowCode_ = lowCode;
+        phosphorHighCode_ = highCode;
+        phosphorYMin_ = yDiv.lowerBound();
+        phosphorYMax_ = yDiv.upperBound();
     }
 
-    timeCurve_->setSamples(timeX_us, powerY_uW);
+    if (phosphorTimer_.isValid() && phosphorTimer_.elapsed() < AppConfig::persistenceRefreshMs)
+        return;
+    int columns = 0, rows = 0;
+    double firstSeconds = 0.0, spanSeconds = 0.0;
+    if (!fft->persistence().snapshot(phosphorImage_, &columns, &rows, &firstSeconds, &spanSeconds))
+        return;
+    phosphorTimer_.restart();
+
+    // Log intensity, so a glitch seen once stays visible next to a trace hit millions of times
+    const float peak = *std::max_element(phosphorImage_.begin(), phosphorImage_.end());
+    const double norm = peak > 0.0f ? 1.0 / std::log1p(static_cast<double>(peak)) : 0.0;
+    phosphorValues_.resize(static_cast<int>(phosphorImage_.size()));
+    for (int i = 0; i < phosphorValues_.size(); ++i)
+        phosphorValues_[i] = std::log1p(static_cast<double>(phosphorImage_[i])) * norm;
+
+    // Row 0 of the image is the bottom of the y range, as the raster expects
+    phosphorData_->setValueMatrix(phosphorValues_, columns);
+    phosphorData_->setInterval(Qt::XAxis, QwtInterval(firstSeconds * timeUnitScale_,
+                                                      (firstSeconds + spanSeconds) * timeUnitScale_));
+    phosphorData_->setInterval(Qt::YAxis, QwtInterval(phosphorYMin_, phosphorYMax_));
+    phosphor_->invalidateCache();
     timePlot_->setAxisTitle(QwtPlot::yLeft, QwtText("Power (µW)"));
     timePlot_->replot();
 }
 
-void PlotManager::updatePlot(FFTProcess* fft, TimeDProcess* time, bool isPaused, FFTMode /*mode*/)
+void PlotManager::updatePlot(FFTProcess* fft, TimeDProcess* time, bool isPaused)
 {
     if (isPaused) return;
 
-    std::vector<double> fftBuffer(AppConfig::fftBins);
-    fft->getMagnitudes(fftBuffer.data(), AppConfig::fftBins);
+    const AnalysisChainConfig chain = fft->chainConfig(fft->activeChain());
+    fftBuffer_.resize(chain.fftSize / 2 + 1);
+    const bool fresh = fft->getMagnitudes(fftBuffer_.data(), static_cast<int>(fftBuffer_.size()));
 
-    if (fftBuffer[10] > 0.0)
-        updateFFT(fftBuffer.data(), AppConfig::sampleRate);
+    // Zoomed in past half the band: let the DDC zoom FFT spend its bins on the visible span
+    const double unit = chain.sampleRate > 1e6 ? 1e6 : 1e3;
+    const auto fftDiv = fftPlot_->axisScaleDiv(QwtPlot::xBottom);
+    const double loHz = fftDiv.lowerBound() * unit;
+    const double hiHz = fftDiv.upperBound() * unit;
+    const bool zoomed = (hiHz - loHz) < 0.5 * (fftXMax_ - fftXMin_) * unit;
+    fft->setZoomBand(zoomed ? (loHz + hiHz) / 2.0 : 0.0, zoomed ? hiHz - loHz : 0.0);
 
-    int count = time->sampleCount();
-    if (count > 0) {
-        std::vector<uint16_t> buffer(count);
-        time->getBuffer(buffer.data(), count);
-        updateTime(buffer, AppConfig::sampleRate, AppConfig::timeWindowSeconds, AppConfig::maxPointsToPlot);
+    if (fresh)
+        updateTraces(fft, chain.fftSize, chain.sampleRate);  // drawn by the replot below
+
+    if (zoomed && fft->getZoomSpectrum(zoomFreqs_, zoomMags_))
+        updateZoom(zoomFreqs_, zoomMags_, chain.sampleRate);
+    else if (fresh)
+        updateFFT(fftBuffer_.data(), chain.fftSize, chain.sampleRate);
+
+    if (fft->tones().enabled())
+        updateTones(fft);
+
+    // Persistence: every waveform is already in the image, nothing to pick here
+    if (persistence_) {
+        updatePersistence(fft);
+        return;
+    }
+
+    // Triggered: hold the last capture until the next one arrives
+    if (triggered_) {
+        uint64_t triggerIndex = 0;
+        int pre = 0;
+        if (time->trigger().latestCapture(captureBuffer_, &triggerIndex, &pre))
+            updateTriggered(captureBuffer_, pre, fft->calibration());
+        return;
     }
+
+    // Summary query only: the window may hold seconds of samples
+    const int bins = std::max(1, AppConfig::maxPointsToPlot / 2);
+    timeMins_.resize(bins);
+    timeMaxs_.resize(bins);
+    const int filled = time->latestSummary(bins, timeMins_.data(), timeMaxs_.data());
+    if (filled > 0)
+        updateTime(timeMins_.data(), timeMaxs_.data(), filled, 0.0, AppConfig::timeWindowSeconds, fft->calibration());
+}
+
+bool PlotManager::showHistoryFrame(FFTProcess* fft, uint64_t seq, double *seconds, uint8_t *flags)
+{
+    const AnalysisChainConfig chain = fft->chainConfig(fft->activeChain());
+    fftBuffer_.resize(chain.fftSize / 2 + 1);
+    if (!fft->historyFrame(seq, fftBuffer_.data(), static_cast<int>(fftBuffer_.size()), seconds, flags))
+        return false;
+
+    updateFFT(fftBuffer_.data(), chain.fftSize, chain.sampleRate);
+    return true;
 }
 
 void PlotManager::createZoomButtons(QwtPlot *plot,
@@ -8,20 +8,38 @@
 #include <qwt_plot_curve.h>
 #include <QToolButton>
 #include <QEvent>
-#include "Features.h"
+#include <QElapsedTimer>
+#include <vector>
+#include <cstdint>
+#include "SpectrumAccumulator.h"
 
 class FFTProcess;
 class TimeDProcess;
+class AdcCalibration;
+class ClampedPanner;
+class ClampedMagnifier;
+class QwtPlotSpectrogram;
+class QwtMatrixRasterData;
 
 class PlotManager : public QObject {
     Q_OBJECT
 public:
-    explicit PlotManager(QwtPlot *fftPlot, QwtPlot *timePlot, QObject *parent = nullptr);
+    explicit PlotManager(QwtPlot *fftPlot, QwtPlot *timePlot, QwtPlot *tonePlot, QObject *parent = nullptr);
 
-    void updateFFT(const double *fftBuffer, double sampleRate);
-    void updateTime(const std::vector<uint16_t> &timeBuffer,
-                    double sampleRate, double timeWindowSeconds, int maxPointsToPlot);
-    void updatePlot(FFTProcess* fft, TimeDProcess* time, bool isPaused, FFTMode mode);
+    void updateFFT(const double *fftBuffer, int fftSize, double sampleRate);
+    void setFrequencyRange(double sampleRate);  // x-axis and pan/zoom bounds for the viewed chain
+    void updateZoom(const std::vector<double> &freqsHz, const std::vector<double> &mags, double sampleRate);
+    // Codes to µW through the calibration of the device they came from
+    void updateTime(const uint16_t *mins, const uint16_t *maxs, int bins, double startSeconds, double spanSeconds,
+                    const AdcCalibration &calibration);
+    void updateTriggered(const std::vector<uint16_t> &capture, int preSamples, const AdcCalibration &calibration);
+    void setTimeWindow(double seconds);
+    void setTriggerView(bool triggered, double preSeconds, double postSeconds);
+    void setSpectrumTraces(bool maxHold, bool minHold, int average);  // average: SpectrumTrace, -1 = none
+    void updateTones(FFTProcess* fft);
+    void setPersistence(FFTProcess* fft, bool on);  // phosphor image instead of the time curve
+    void updatePlot(FFTProcess* fft, TimeDProcess* time, bool isPaused);
+    bool showHistoryFrame(FFTProcess* fft, uint64_t seq, double *seconds, uint8_t *flags = nullptr);  // paused view, false if no longer held
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event) override;
@@ -33,6 +51,8 @@ private Q_SLOTS:
     void zoomOutY();
 
 private:
+    void updateTraces(FFTProcess* fft, int fftSize, double sampleRate);
+    void updatePersistence(FFTProcess* fft);
     void createZoomButtons(QwtPlot *plot,
                            QToolButton *&plusX, QToolButton *&minusX,
                            QToolButton *&plusY, QToolButton *&minusY);
@@ -41,9 +61,21 @@ private:
                              QToolButton *plusY, QToolButton *minusY);
 
 private:
+    // Curve samples are filled in place and handed to Qwt with setRawSamples, so a
+    // tick neither allocates nor copies; each curve keeps its own pair alive
+    struct CurveSamples {
+        std::vector<double> x;
+        std::vector<double> y;
+    };
+
     QwtPlot *fftPlot_;
     QwtPlot *timePlot_;
+    QwtPlot *tonePlot_;
     QwtPlotCurve *fftCurve_;
+    QwtPlotCurve *maxHoldCurve_;
+    QwtPlotCurve *minHoldCurve_;
+    QwtPlotCurve *averageCurve_;
+    QwtPlotCurve *stageCurve_;  // AppConfig::stageGraphPlot branch
     QwtPlotCurve *timeCurve_;
 
     // Zoom buttons
@@ -61,6 +93,55 @@ private:
     double fftXMax_;
     double timeXMin_;
     double timeXMax_;
+    double timeUnitScale_ = 1e6;  // seconds -> axis unit
+
+    ClampedPanner *fftPanner_;
+    ClampedMagnifier *fftMagnifier_;
+    std::vector<double> fftBuffer_;
+    std::vector<double> fftX_;  // fftCurve_, live spectrum or zoom band
+    std::vector<double> fftY_;
+
+    ClampedPanner *timePanner_;
+    ClampedMagnifier *timeMagnifier_;
+    std::vector<uint16_t> timeMins_;
+    std::vector<uint16_t> timeMaxs_;
+    std::vector<float> lowPower_;   // envelope in µW
+    std::vector<float> highPower_;
+    std::vector<double> timeX_;  // timeCurve_, two points per envelope bin
+    std::vector<double> timeY_;
+
+    bool showMaxHold_ = false;
+    bool showMinHold_ = false;
+    int averageTrace_ = -1;
+    std::vector<double> traceBuffer_;
+    CurveSamples maxHoldSamples_;
+    CurveSamples minHoldSamples_;
+    CurveSamples averageSamples_;
+    CurveSamples stageSamples_;
+
+    std::vector<double> zoomFreqs_;
+    std::vector<double> zoomMags_;
+
+    std::vector<QwtPlotCurve *> toneAmpCurves_;    // yLeft, µW
+    std::vector<QwtPlotCurve *> tonePhaseCurves_;  // yRight, rad
+    std::vector<double> toneFreqs_;
+    std::vector<double> toneAmps_;
+    std::vector<double> tonePhases_;
+    std::vector<double> toneTimes_;  // x of every tone curve, ms
+
+    bool triggered_ = false;
+    std::vector<uint16_t> captureBuffer_;
+
+    QwtPlotSpectrogram *phosphor_;
+    QwtMatrixRasterData *phosphorData_;  // owned by phosphor_
+    bool persistence_ = false;
+    int phosphorLowCode_ = -1;   // rows the image was configured for, follows the y axis
+    int phosphorHighCode_ = -1;
+    double phosphorYMin_ = 0.0;
+    double phosphorYMax_ = 0.0;
+    QElapsedTimer phosphorTimer_;
+    std::vector<float> phosphorImage_;
+    QVector<double> phosphorValues_;
 };
 
 #endif // PLOTMANAGER_H